@@ -0,0 +1,105 @@
+#include "batch.hpp"
+#include "driver.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+BatchChecker::BatchChecker(std::vector<std::string> paths, FunctionCache &cache, int workers)
+        : paths(std::move(paths)), cache(cache), workers(workers), stream(nullptr), nextToWrite(0),
+          failedCount(0) {
+    if (this->workers <= 0) {
+        this->workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+std::string BatchChecker::resultPath(const std::string &path) {
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".in") == 0) {
+        return path.substr(0, path.size() - 3) + ".res";
+    }
+    return path + ".res";
+}
+
+void BatchChecker::_failed(const std::string &path, const char *what) {
+    std::lock_guard<std::mutex> guard(failedLock);
+    std::cerr << path << ": " << what << std::endl;
+    failedCount++;
+}
+
+void BatchChecker::_check(size_t index) {
+    const std::string &path = paths[index];
+    trace::Span span(path, "file");
+    std::string output;
+    std::ifstream in(path, std::ios::binary);
+    bool readable = static_cast<bool>(in);
+    if (readable) {
+        std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        output = checkSource(std::move(source), &cache);
+    } else {
+        _failed(path, strerror(errno));
+    }
+
+    if (!stream) {
+        if (readable) {
+            std::ofstream out(resultPath(path), std::ios::binary | std::ios::trunc);
+            if (!out.write(output.data(), output.size()) || !out.flush()) {
+                _failed(resultPath(path), strerror(errno));
+            }
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(streamLock);
+    outputs[index] = std::move(output);
+    // an unreadable file gets no frame, but must not hold back the ones after it
+    finished[index] = readable ? 1 : 2;
+    _flush();
+}
+
+void BatchChecker::_flush() {
+    while (nextToWrite < paths.size() && finished[nextToWrite]) {
+        if (finished[nextToWrite] == 1) {
+            const std::string &output = outputs[nextToWrite];
+            *stream << output.size() << ' ' << paths[nextToWrite] << '\n';
+            stream->write(output.data(), output.size());
+        }
+        std::string().swap(outputs[nextToWrite]);
+        nextToWrite++;
+    }
+}
+
+void BatchChecker::run(std::ostream *framed) {
+    stream = framed;
+    if (stream) {
+        outputs.assign(paths.size(), std::string());
+        finished.assign(paths.size(), 0);
+        nextToWrite = 0;
+    }
+
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t index = next++; index < paths.size(); index = next++) {
+            _check(index);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < workers; ++i) {
+        threads.emplace_back([&work, i]() {
+            trace::nameThread("worker " + std::to_string(i));
+            work();
+        });
+    }
+    work();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    if (stream) {
+        stream->flush();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "funccache.hpp"
+
+/* BatchChecker class
+ * Checks many programs in one process, on a pool of worker threads that take the next file as
+ * soon as they finish one. Each file's output is exactly what hw3 < file prints. It goes either
+ * to the file with the .in extension replaced by .res (or .res appended), or, as a framed
+ * stream, to one output in the order the files were given. Each frame is a header line
+ * "<bytes> <path>" followed by exactly that many bytes of output:
+ *
+ *     38 tests/t-def-as-func.in
+ *     line 6: symbol foo is already defined
+ *
+ * Workers share one function cache, so functions common to several files are checked once.
+ * Files that cannot be read or written are reported on stderr and produce no output.
+ */
+class BatchChecker {
+private:
+    std::vector<std::string> paths;
+    FunctionCache &cache;
+    int workers;
+
+    // Framed stream state: outputs that are done but wait for an earlier file
+    std::ostream *stream;
+    std::vector<std::string> outputs;
+    std::vector<char> finished;
+    size_t nextToWrite;
+    std::mutex streamLock;
+
+    size_t failedCount;
+    std::mutex failedLock;
+
+    // Checks paths[index] and delivers its output
+    void _check(size_t index);
+    void _failed(const std::string &path, const char *what);
+    // Writes out every finished output from nextToWrite on, in order
+    void _flush();
+
+public:
+    // A count of 0 workers uses one per hardware thread
+    BatchChecker(std::vector<std::string> paths, FunctionCache &cache, int workers);
+
+    // Checks every file, writing each output to its .res file, or to `framed` if given
+    void run(std::ostream *framed = nullptr);
+
+    size_t files() const { return paths.size(); }
+    size_t failed() const { return failedCount; }
+    int workerCount() const { return workers; }
+
+    // The path the output of a file goes to in .res mode
+    static std::string resultPath(const std::string &path);
+};
+
+#endif //BATCH_HPP
@@ -0,0 +1,71 @@
+#!/bin/bash
+# Checks the LLVM IR emitter: every benchmark program is emitted with --emit-llvm, run with lli
+# and its output compared against the .out file. Then a large generated program measures how
+# fast IR is produced, in MB of IR per second of the whole hw3 run.
+#
+#   bench/llvm_bench.sh               # from the repository root, after make
+#   HW3=/path/to/hw3 LLI=lli-14 FUNCTIONS=20000 bench/llvm_bench.sh
+
+HW3=${HW3:-./hw3}
+LLI=${LLI:-lli}
+FUNCTIONS=${FUNCTIONS:-5000}
+BENCH_DIR=$(dirname "$0")
+
+TIMEFORMAT=%R
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+printf "%-16s %10s  %s\n" "Program" "Seconds" "Status"
+for bench_in in "$BENCH_DIR"/*.in; do
+    bench_name=$(basename "$bench_in" .in)
+    "$HW3" --emit-llvm < "$bench_in" > "$work/$bench_name.ll"
+
+    seconds=$( { time "$LLI" "$work/$bench_name.ll" > "$work/$bench_name.res"; } 2>&1 )
+
+    if diff -q "$work/$bench_name.res" "$BENCH_DIR/$bench_name.out" > /dev/null; then
+        status="ok"
+    else
+        status="WRONG OUTPUT"
+        ((failed++))
+    fi
+    printf "%-16s %10s  %s\n" "$bench_name" "$seconds" "$status"
+done
+
+# A program of many small functions with loops, short-circuit conditions and arrays
+for ((i = 0; i < FUNCTIONS; i++)); do
+    cat <<FUNC
+int f$i(int n, byte b) {
+    int a[16];
+    int i = 0;
+    int sum = 0;
+    while (i < n and i < 16) {
+        if (i / 2 * 2 == i or not (b > 100b)) {
+            a[i] = i * n + sum;
+        } else {
+            a[i] = (int)(b + (byte)i);
+        }
+        sum = sum + a[i] / (i + 1);
+        i = i + 1;
+    }
+    return sum;
+}
+FUNC
+done > "$work/large.in"
+echo "void main() { printi(f0(10, 7b)); }" >> "$work/large.in"
+
+start=$(date +%s%N)
+"$HW3" --emit-llvm < "$work/large.in" > "$work/large.ll"
+elapsed=$(( $(date +%s%N) - start ))
+bytes=$(stat -c %s "$work/large.ll")
+# bytes / 1e6 / (ns / 1e9), kept in tenths
+rate=$(( bytes * 10000 / (elapsed > 0 ? elapsed : 1) ))
+printf "\nIR generation: %d functions, %d bytes in %d ms, %d.%d MB/s\n" \
+    "$FUNCTIONS" "$bytes" $((elapsed / 1000000)) $((rate / 10)) $((rate % 10))
+
+if [ "$("$LLI" "$work/large.ll")" != "$("$HW3" --run < "$work/large.in")" ]; then
+    echo "large program: WRONG OUTPUT"
+    ((failed++))
+fi
+
+exit $failed
@@ -0,0 +1,38 @@
+#!/bin/bash
+# Runs every benchmark program with the execution engine, checks its output against the .out
+# file next to it and reports the wall time. Extra arguments are passed to hw3 instead of --run,
+# so other engines can be compared on the same programs.
+#
+#   bench/run_bench.sh                 # from the repository root, after make
+#   HW3=/path/to/hw3 bench/run_bench.sh --run --fold
+
+HW3=${HW3:-./hw3}
+BENCH_DIR=$(dirname "$0")
+FLAGS=("$@")
+if [ ${#FLAGS[@]} -eq 0 ]; then
+    FLAGS=(--run)
+fi
+
+TIMEFORMAT=%R
+failed=0
+
+printf "%-16s %10s  %s\n" "Program" "Seconds" "Status"
+for bench_in in "$BENCH_DIR"/*.in; do
+    bench_name=$(basename "$bench_in" .in)
+    bench_out="$BENCH_DIR/$bench_name.out"
+    bench_res=$(mktemp)
+
+    seconds=$( { time "$HW3" "${FLAGS[@]}" < "$bench_in" > "$bench_res"; } 2>&1 )
+
+    if diff -q "$bench_res" "$bench_out" > /dev/null; then
+        status="ok"
+    else
+        status="WRONG OUTPUT"
+        ((failed++))
+    fi
+    rm -f "$bench_res"
+
+    printf "%-16s %10s  %s\n" "$bench_name" "$seconds" "$status"
+done
+
+exit $failed
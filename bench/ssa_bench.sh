@@ -0,0 +1,64 @@
+#!/bin/bash
+# Measures the SSA optimizer: every program of the test corpus that checks is lowered and
+# optimized with --ssa-stats, and the instructions removed by each pass are summed. Then one
+# function grown to increasing sizes shows that optimization time stays close to linear.
+#
+#   bench/ssa_bench.sh                # from the repository root, after make
+#   HW3=/path/to/hw3 bench/ssa_bench.sh tests allTests
+
+HW3=${HW3:-./hw3}
+BENCH_DIR=$(dirname "$0")
+if [ $# -eq 0 ]; then
+    set -- "$BENCH_DIR/../tests" "$BENCH_DIR/../tests2" "$BENCH_DIR/../allTests" "$BENCH_DIR"
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+programs=0
+before=0
+sccp=0
+gvn=0
+dce=0
+for program in $(find "$@" -name '*.in' | sort); do
+    # programs that fail the check print an error line instead of the IR
+    "$HW3" --ssa-stats --dump-ssa < "$program" > "$work/ir" 2> "$work/stats"
+    read -r _ total _ removed _ _ pass1 _ pass2 _ pass3 < <(tr -d ',()' < "$work/stats")
+    [ -n "$total" ] || continue
+    ((programs++))
+    ((before += total))
+    ((sccp += pass1))
+    ((gvn += pass2))
+    ((dce += pass3))
+done
+removed=$((sccp + gvn + dce))
+printf "Corpus: %d programs, %d instructions, %d removed (%d.%d%%)\n" \
+    "$programs" "$before" "$removed" $((removed * 100 / (before > 0 ? before : 1))) \
+    $((removed * 1000 / (before > 0 ? before : 1) % 10))
+printf "  sccp %d, gvn %d, dce %d\n\n" "$sccp" "$gvn" "$dce"
+
+# One function of n statement groups, each a constant chain, a redundant expression and a
+# branch on a known condition
+printf "%-12s %14s %10s %10s\n" "Groups" "Instructions" "Removed" "ms"
+for n in 1000 2000 4000 8000; do
+    {
+        echo "void main() {"
+        echo "    int x = 1;"
+        echo "    int y = 2;"
+        for ((i = 0; i < n; i++)); do
+            cat <<GROUP
+    int a$i = x * 3 + $i;
+    int b$i = y * 3 + $i;
+    if (a$i == x * 3 + $i) { y = b$i - a$i + y; } else { x = x + 1; }
+GROUP
+        done
+        echo "    printi(x);"
+        echo "    printi(y);"
+        echo "}"
+    } > "$work/large.in"
+    start=$(date +%s%N)
+    "$HW3" --ssa-stats < "$work/large.in" > /dev/null 2> "$work/stats"
+    elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+    read -r _ total _ removed _ < <(tr -d ',()' < "$work/stats")
+    printf "%-12s %14s %10s %10s\n" "$n" "$total" "$removed" "$elapsed"
+done
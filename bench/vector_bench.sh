@@ -0,0 +1,83 @@
+#!/bin/bash
+# Compares the scalar and the vectorized paths on array kernels: each kernel runs with the
+# bytecode VM and with the native code, without and with --vectorize, and the outputs must match.
+# Every kernel program repeats one loop over arrays of LENGTH elements ROUNDS times.
+#
+#   bench/vector_bench.sh             # from the repository root, after make
+#   HW3=/path/to/hw3 LENGTH=1000 ROUNDS=200000 bench/vector_bench.sh
+
+HW3=${HW3:-./hw3}
+LENGTH=${LENGTH:-4096}
+ROUNDS=${ROUNDS:-20000}
+
+TIMEFORMAT=%R
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# kernel NAME TYPE STATEMENT: a program running STATEMENT over arrays a, b and c of TYPE
+kernel() {
+    cat > "$work/$1.in" <<KERNEL
+void main() {
+    $2 a[$LENGTH];
+    $2 b[$LENGTH];
+    $2 c[$LENGTH];
+    int k = 7;
+    byte m = 3b;
+    int i = 0;
+    while (i < $LENGTH) {
+        b[i] = ($2)(i * 7);
+        c[i] = ($2)(i * 3 + 1);
+        i = i + 1;
+    }
+    int round = 0;
+    while (round < $ROUNDS) {
+        i = 0;
+        while (i < $LENGTH) {
+            $3
+            i = i + 1;
+        }
+        round = round + 1;
+    }
+    int sum = 0;
+    i = 0;
+    while (i < $LENGTH) {
+        sum = sum * 31 + (int)a[i];
+        i = i + 1;
+    }
+    printi(sum);
+}
+KERNEL
+}
+
+kernel int_add int "a[i] = b[i] + c[i];"
+kernel int_axpy int "a[i] = b[i] * k + c[i];"
+kernel int_update int "a[i] = a[i] * 3 - b[i]; c[i] = c[i] + i;"
+kernel byte_add byte "a[i] = b[i] + c[i];"
+kernel byte_blend byte "a[i] = b[i] * m + (byte)((int)c[i] - i);"
+
+printf "%-12s %10s %10s %8s %10s %10s %8s  %s\n" \
+    "Kernel" "VM" "VM vec" "Speedup" "Native" "Nat. vec" "Speedup" "Status"
+for program in "$work"/*.in; do
+    name=$(basename "$program" .in)
+    status="ok"
+    times=()
+    for engine in --run --jit; do
+        scalar=$( { time "$HW3" $engine < "$program" > "$work/scalar"; } 2>&1 )
+        vector=$( { time "$HW3" $engine --vectorize < "$program" > "$work/vector" 2> /dev/null; } 2>&1 )
+        if ! diff -q "$work/scalar" "$work/vector" > /dev/null; then
+            status="WRONG OUTPUT"
+        fi
+        # seconds to milliseconds, so the speedup is integer arithmetic
+        s=$(echo "$scalar" | tr -d .)
+        v=$(echo "$vector" | tr -d .)
+        s=$((10#$s))
+        v=$((10#$v))
+        speedup=$((s * 10 / (v > 0 ? v : 1)))
+        times+=("$scalar" "$vector" "$((speedup / 10)).$((speedup % 10))x")
+    done
+    [ "$status" = "ok" ] || ((failed++))
+    printf "%-12s %10s %10s %8s %10s %10s %8s  %s\n" "$name" "${times[@]}" "$status"
+done
+
+exit $failed
@@ -0,0 +1,527 @@
+#include "bounds.hpp"
+#include "walker.hpp"
+#include <algorithm>
+#include <unordered_set>
+
+static const int64_t INT_LO = INT32_MIN;
+static const int64_t INT_HI = INT32_MAX;
+
+// Rounds of plain joins at a loop head before the bounds that still grow are widened
+static const int JOIN_ROUNDS = 2;
+// Loops nested deeper than this are analyzed in a single pass
+static const int MAX_ITERATED_LOOPS = 3;
+
+namespace {
+    // Array accesses of a function, and the ones marked in bounds
+    class AccessCounter : public TreeWalker {
+    public:
+        int accesses = 0;
+        int eliminated = 0;
+
+        using TreeWalker::visit;
+
+        void visit(ast::ArrayDereference &node) override {
+            accesses++;
+            eliminated += node.computedInBounds;
+            TreeWalker::visit(node);
+        }
+
+        void visit(ast::ArrayAssign &node) override {
+            accesses++;
+            eliminated += node.computedInBounds;
+            TreeWalker::visit(node);
+        }
+    };
+}
+
+BoundsAnalyzer::BoundsAnalyzer() : result{0, 0}, params(0), marking(false), loops(0) {}
+
+int BoundsAnalyzer::accesses() const {
+    int total = 0;
+    for (const auto &function : functions) {
+        total += function.accesses;
+    }
+    return total;
+}
+
+int BoundsAnalyzer::eliminated() const {
+    int total = 0;
+    for (const auto &function : functions) {
+        total += function.eliminated;
+    }
+    return total;
+}
+
+/* Helpers */
+
+BoundsAnalyzer::Interval BoundsAnalyzer::_value(ast::Exp &exp) {
+    if (!state.reachable) {
+        return _range(exp.computedType);
+    }
+    exp.accept(*this);
+    return result;
+}
+
+BoundsAnalyzer::Interval BoundsAnalyzer::_range(ast::BuiltInType type) {
+    switch (type) {
+        case ast::BuiltInType::BOOL:
+            return {0, 1};
+        case ast::BuiltInType::BYTE:
+            return {0, 255};
+        default:
+            return {INT_LO, INT_HI};
+    }
+}
+
+BoundsAnalyzer::Interval &BoundsAnalyzer::_slot(const ast::ID &id) {
+    return state.slots[id.computedOffset + params];
+}
+
+bool BoundsAnalyzer::_inBounds(Interval index, int length) const {
+    return index.lo >= 0 && index.hi < length;
+}
+
+void BoundsAnalyzer::_refine(ast::Exp &condition, bool truth) {
+    if (!state.reachable) {
+        return;
+    }
+    bool wasMarking = marking;
+    marking = false;
+
+    if (auto boolean = dynamic_cast<ast::Bool *>(&condition)) {
+        if (boolean->value != truth) {
+            state.reachable = false;
+        }
+    } else if (auto negation = dynamic_cast<ast::Not *>(&condition)) {
+        _refine(*negation->exp, !truth);
+    } else if (auto conjunction = dynamic_cast<ast::And *>(&condition)) {
+        if (truth) {
+            _refine(*conjunction->left, true);
+            _refine(*conjunction->right, true);
+        } else {
+            // either the left operand failed, or it held and the right one failed
+            State before = state;
+            _refine(*conjunction->left, false);
+            State leftFailed = state;
+            state = before;
+            _refine(*conjunction->left, true);
+            _refine(*conjunction->right, false);
+            _join(state, leftFailed);
+        }
+    } else if (auto disjunction = dynamic_cast<ast::Or *>(&condition)) {
+        if (!truth) {
+            _refine(*disjunction->left, false);
+            _refine(*disjunction->right, false);
+        } else {
+            State before = state;
+            _refine(*disjunction->left, true);
+            State leftHeld = state;
+            state = before;
+            _refine(*disjunction->left, false);
+            _refine(*disjunction->right, true);
+            _join(state, leftHeld);
+        }
+    } else if (auto relOp = dynamic_cast<ast::RelOp *>(&condition)) {
+        static const ast::RelOpType negated[] = {
+                ast::RelOpType::NE, ast::RelOpType::EQ, ast::RelOpType::GE,
+                ast::RelOpType::LE, ast::RelOpType::GT, ast::RelOpType::LT,
+        };
+        _refineCompare(*relOp, truth ? relOp->op : negated[relOp->op]);
+    }
+
+    marking = wasMarking;
+}
+
+void BoundsAnalyzer::_refineCompare(ast::RelOp &node, ast::RelOpType op) {
+    Interval left = _value(*node.left);
+    Interval right = _value(*node.right);
+
+    switch (op) {
+        case ast::RelOpType::EQ:
+            left.lo = right.lo = std::max(left.lo, right.lo);
+            left.hi = right.hi = std::min(left.hi, right.hi);
+            break;
+        case ast::RelOpType::NE:
+            // only an interval of one value can take a bound off the other side
+            if (right.lo == right.hi) {
+                left.lo += left.lo == right.lo;
+                left.hi -= left.hi == right.lo;
+            } else if (left.lo == left.hi) {
+                right.lo += right.lo == left.lo;
+                right.hi -= right.hi == left.lo;
+            }
+            break;
+        case ast::RelOpType::LT:
+            left.hi = std::min(left.hi, right.hi - 1);
+            right.lo = std::max(right.lo, left.lo + 1);
+            break;
+        case ast::RelOpType::LE:
+            left.hi = std::min(left.hi, right.hi);
+            right.lo = std::max(right.lo, left.lo);
+            break;
+        case ast::RelOpType::GT:
+            left.lo = std::max(left.lo, right.lo + 1);
+            right.hi = std::min(right.hi, left.hi - 1);
+            break;
+        case ast::RelOpType::GE:
+            left.lo = std::max(left.lo, right.lo);
+            right.hi = std::min(right.hi, left.hi);
+            break;
+    }
+
+    if (left.lo > left.hi || right.lo > right.hi) {
+        state.reachable = false;
+        return;
+    }
+    // only variables keep what the comparison tells about them
+    if (auto id = dynamic_cast<ast::ID *>(node.left.get())) {
+        _slot(*id) = left;
+    }
+    if (auto id = dynamic_cast<ast::ID *>(node.right.get())) {
+        _slot(*id) = right;
+    }
+}
+
+void BoundsAnalyzer::_join(State &into, const State &other) {
+    if (!other.reachable) {
+        return;
+    }
+    if (!into.reachable) {
+        into = other;
+        return;
+    }
+    for (size_t i = 0; i < into.slots.size(); i++) {
+        into.slots[i].lo = std::min(into.slots[i].lo, other.slots[i].lo);
+        into.slots[i].hi = std::max(into.slots[i].hi, other.slots[i].hi);
+    }
+}
+
+bool BoundsAnalyzer::_includes(const State &outer, const State &inner) {
+    if (!inner.reachable) {
+        return true;
+    }
+    if (!outer.reachable) {
+        return false;
+    }
+    for (size_t i = 0; i < outer.slots.size(); i++) {
+        if (inner.slots[i].lo < outer.slots[i].lo || inner.slots[i].hi > outer.slots[i].hi) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BoundsAnalyzer::_widen(State &head, const State &next) {
+    if (!head.reachable) {
+        head = next;
+        return;
+    }
+    for (size_t i = 0; i < head.slots.size(); i++) {
+        if (next.slots[i].lo < head.slots[i].lo) {
+            head.slots[i].lo = INT_LO;
+        }
+        if (next.slots[i].hi > head.slots[i].hi) {
+            head.slots[i].hi = INT_HI;
+        }
+    }
+}
+
+BoundsAnalyzer::State BoundsAnalyzer::_iterate(ast::While &node, const State &head, State &exit) {
+    state = head;
+    _value(*node.condition);
+
+    State after = state;
+    _refine(*node.condition, true);
+    breakStates.push_back(State{false, {}});
+    continueStates.push_back(State{false, {}});
+    node.body->accept(*this);
+
+    State back = state;
+    _join(back, continueStates.back());
+    state = after;
+    _refine(*node.condition, false);
+    exit = state;
+    _join(exit, breakStates.back());
+
+    breakStates.pop_back();
+    continueStates.pop_back();
+    return back;
+}
+
+BoundsAnalyzer::State BoundsAnalyzer::_assume(ast::While &node, const State &entry) const {
+    std::unordered_set<int> assigned;
+    AssignmentCollector collector(assigned);
+    node.accept(collector);
+
+    State head = entry;
+    for (int offset : assigned) {
+        head.slots[offset + params] = {INT_LO, INT_HI};
+    }
+    return head;
+}
+
+/* Expressions: `result` is the interval of the expression just visited */
+
+void BoundsAnalyzer::visit(ast::Num &node) {
+    result = {node.value, node.value};
+}
+
+void BoundsAnalyzer::visit(ast::NumB &node) {
+    result = {node.value, node.value};
+}
+
+void BoundsAnalyzer::visit(ast::String &node) {
+    result = {0, 0};
+}
+
+void BoundsAnalyzer::visit(ast::Bool &node) {
+    result = {node.value, node.value};
+}
+
+void BoundsAnalyzer::visit(ast::ID &node) {
+    result = node.computedIsArray ? _range(node.computedType) : _slot(node);
+}
+
+void BoundsAnalyzer::visit(ast::BinOp &node) {
+    Interval left = _value(*node.left);
+    Interval right = _value(*node.right);
+
+    Interval value = _range(node.computedType);
+    switch (node.op) {
+        case ast::BinOpType::ADD:
+            value = {left.lo + right.lo, left.hi + right.hi};
+            break;
+        case ast::BinOpType::SUB:
+            value = {left.lo - right.hi, left.hi - right.lo};
+            break;
+        case ast::BinOpType::MUL:
+        case ast::BinOpType::DIV:
+            // both are monotonic in each operand while the divisor keeps its sign
+            if (node.op == ast::BinOpType::MUL || right.lo > 0 || right.hi < 0) {
+                int64_t corners[4];
+                int i = 0;
+                for (int64_t a : {left.lo, left.hi}) {
+                    for (int64_t b : {right.lo, right.hi}) {
+                        corners[i++] = node.op == ast::BinOpType::MUL ? a * b : a / b;
+                    }
+                }
+                value = {*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4)};
+            }
+            break;
+    }
+
+    // a result that may wrap around can be anything of its type
+    Interval limits = _range(node.computedType);
+    if (value.lo < limits.lo || value.hi > limits.hi) {
+        value = limits;
+    }
+    result = value;
+}
+
+void BoundsAnalyzer::visit(ast::RelOp &node) {
+    _value(*node.left);
+    _value(*node.right);
+    result = {0, 1};
+}
+
+void BoundsAnalyzer::visit(ast::Not &node) {
+    _value(*node.exp);
+    result = {0, 1};
+}
+
+void BoundsAnalyzer::visit(ast::And &node) {
+    _value(*node.left);
+    // the right operand only runs where the left one held
+    State before = state;
+    _refine(*node.left, true);
+    _value(*node.right);
+    state = before;
+    result = {0, 1};
+}
+
+void BoundsAnalyzer::visit(ast::Or &node) {
+    _value(*node.left);
+    State before = state;
+    _refine(*node.left, false);
+    _value(*node.right);
+    state = before;
+    result = {0, 1};
+}
+
+void BoundsAnalyzer::visit(ast::Cast &node) {
+    Interval value = _value(*node.exp);
+    Interval limits = _range(node.target_type->computedType);
+    if (value.lo < limits.lo || value.hi > limits.hi) {
+        value = limits;
+    }
+    result = value;
+}
+
+void BoundsAnalyzer::visit(ast::ArrayDereference &node) {
+    Interval index = _value(*node.index);
+    if (marking && state.reachable) {
+        node.computedInBounds = _inBounds(index, node.id->computedArrLength);
+    }
+    result = _range(node.computedType);
+}
+
+void BoundsAnalyzer::visit(ast::ExpList &node) {
+    for (auto &exp : node.exps) {
+        _value(*exp);
+    }
+}
+
+void BoundsAnalyzer::visit(ast::Call &node) {
+    if (node.args) {
+        node.args->accept(*this);
+    }
+    result = _range(node.computedType);
+}
+
+/* Types */
+
+void BoundsAnalyzer::visit(ast::ArrayType &node) {}
+
+void BoundsAnalyzer::visit(ast::PrimitiveType &node) {}
+
+/* Statements */
+
+void BoundsAnalyzer::visit(ast::ArrayAssign &node) {
+    Interval index = _value(*node.index);
+    _value(*node.exp);
+    if (marking && state.reachable) {
+        node.computedInBounds = _inBounds(index, node.id->computedArrLength);
+    }
+}
+
+void BoundsAnalyzer::visit(ast::Statements &node) {
+    for (auto &statement : node.statements) {
+        // nothing after a Return, Break or Continue runs
+        if (!state.reachable) {
+            break;
+        }
+        statement->accept(*this);
+    }
+}
+
+void BoundsAnalyzer::visit(ast::Block &node) {
+    node.statements->accept(*this);
+}
+
+void BoundsAnalyzer::visit(ast::Break &node) {
+    _join(breakStates.back(), state);
+    state.reachable = false;
+}
+
+void BoundsAnalyzer::visit(ast::Continue &node) {
+    _join(continueStates.back(), state);
+    state.reachable = false;
+}
+
+void BoundsAnalyzer::visit(ast::Return &node) {
+    if (node.exp) {
+        _value(*node.exp);
+    }
+    state.reachable = false;
+}
+
+void BoundsAnalyzer::visit(ast::If &node) {
+    _value(*node.condition);
+    State before = state;
+    _refine(*node.condition, true);
+    node.then->accept(*this);
+    State then = state;
+
+    state = before;
+    _refine(*node.condition, false);
+    if (node.otherwise && state.reachable) {
+        node.otherwise->accept(*this);
+    }
+    _join(state, then);
+}
+
+void BoundsAnalyzer::visit(ast::While &node) {
+    State entry = state;
+    State exit;
+    if (!entry.reachable) {
+        return;
+    }
+
+    if (loops >= MAX_ITERATED_LOOPS) {
+        _iterate(node, _assume(node, entry), exit);
+        state = exit;
+        return;
+    }
+
+    loops++;
+    bool wasMarking = marking;
+    marking = false;
+
+    // up to a state at the head that every pass through the body stays within
+    State head = entry;
+    for (int round = 0;; round++) {
+        State next = _iterate(node, head, exit);
+        _join(next, entry);
+        if (_includes(head, next)) {
+            break;
+        }
+        if (round < JOIN_ROUNDS) {
+            _join(head, next);
+        } else {
+            _widen(head, next);
+        }
+    }
+    // one more pass takes back what widening gave away past the loop's condition
+    State narrowed = _iterate(node, head, exit);
+    _join(narrowed, entry);
+    head = narrowed;
+
+    marking = wasMarking;
+    _iterate(node, head, exit);
+    loops--;
+    state = exit;
+}
+
+void BoundsAnalyzer::visit(ast::VarDecl &node) {
+    if (node.type->computedIsArray) {
+        return;
+    }
+    Interval value = node.init_exp ? _value(*node.init_exp) : Interval{0, 0};
+    if (state.reachable) {
+        _slot(*node.id) = value;
+    }
+}
+
+void BoundsAnalyzer::visit(ast::Assign &node) {
+    Interval value = _value(*node.exp);
+    if (state.reachable && !node.id->computedIsArray) {
+        _slot(*node.id) = value;
+    }
+}
+
+void BoundsAnalyzer::visit(ast::Formal &node) {}
+
+void BoundsAnalyzer::visit(ast::Formals &node) {}
+
+void BoundsAnalyzer::visit(ast::FuncDecl &node) {
+    params = static_cast<int>(node.formals->formals.size());
+    state = State{true, std::vector<Interval>(params + node.computedFrameSize, Interval{INT_LO, INT_HI})};
+    for (auto &formal : node.formals->formals) {
+        _slot(*formal->id) = _range(formal->type->computedType);
+    }
+    marking = true;
+    node.body->accept(*this);
+    marking = false;
+
+    AccessCounter counter;
+    node.body->accept(counter);
+    if (counter.accesses > 0) {
+        functions.push_back({node.id->value, counter.accesses, counter.eliminated});
+    }
+}
+
+void BoundsAnalyzer::visit(ast::Funcs &node) {
+    for (auto &func : node.funcs) {
+        func->accept(*this);
+    }
+}
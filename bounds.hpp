@@ -0,0 +1,121 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* BoundsAnalyzer class
+ * Interval range analysis over the int and byte variables of a checked tree, to find the array
+ * accesses whose index is always within the array's length; it sets computedInBounds on those
+ * ArrayDereference and ArrayAssign nodes, and the backends leave out their bounds checks.
+ *
+ * Each variable slot holds an interval of the values it may have. Conditions of If and While
+ * narrow the intervals on each branch (i < n bounds i by n - 1 inside the loop), the right
+ * operand of And and Or is analyzed where the left one already held or failed, and bytes never
+ * leave [0, 255]. A While is iterated to a fixpoint, widening the bounds that keep growing to
+ * the limits of their type after a few rounds and then narrowing once, so loop induction
+ * variables end up with the range the condition allows. Accesses are marked only in a final
+ * pass over the fixpoint, never from an intermediate state.
+ */
+class BoundsAnalyzer : public Visitor {
+public:
+    // Array accesses of a function, and how many were proven in bounds
+    struct Report {
+        std::string name;
+        int accesses;
+        int eliminated;
+    };
+
+private:
+    struct Interval {
+        int64_t lo;
+        int64_t hi;
+    };
+
+    // Intervals of the variable slots, parameters first; nothing is reachable in a state after
+    // a Return, Break or Continue
+    struct State {
+        bool reachable = true;
+        std::vector<Interval> slots;
+    };
+
+    State state;
+    // Interval of the expression visited last
+    Interval result;
+    int params;
+    // Whether accesses visited now may be marked
+    bool marking;
+    // Enclosing loops being analyzed
+    int loops;
+    // Innermost loop last: states joined at its Breaks and Continues
+    std::vector<State> breakStates;
+    std::vector<State> continueStates;
+
+    std::vector<Report> functions;
+
+    Interval _value(ast::Exp &exp);
+    static Interval _range(ast::BuiltInType type);
+    Interval &_slot(const ast::ID &id);
+    // Whether every index in `index` is within an array of `length`
+    bool _inBounds(Interval index, int length) const;
+
+    // Narrows the state to where `condition` evaluates to `truth`
+    void _refine(ast::Exp &condition, bool truth);
+    void _refineCompare(ast::RelOp &node, ast::RelOpType op);
+
+    static void _join(State &into, const State &other);
+    static bool _includes(const State &outer, const State &inner);
+    // Joins `next` into `head`, moving the bounds that grew to the limits of an int
+    static void _widen(State &head, const State &next);
+    // One pass over a loop from the state at its head: returns the state coming back to the
+    // head, and sets the one after the loop
+    State _iterate(ast::While &node, const State &head, State &exit);
+    // Head of a loop nested too deep to iterate: every slot it assigns may hold any int
+    State _assume(ast::While &node, const State &entry) const;
+
+public:
+    BoundsAnalyzer();
+
+    // Array accesses in the whole program, and the ones proven in bounds
+    int accesses() const;
+    int eliminated() const;
+
+    // Every function with array accesses, in source order
+    const std::vector<Report> &report() const { return functions; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif //BOUNDS_HPP
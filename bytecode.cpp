@@ -0,0 +1,577 @@
+#include "bytecode.hpp"
+#include <algorithm>
+#include <climits>
+#include "constfold.hpp"
+
+namespace bytecode {
+    const char *opcodeName(Opcode op) {
+        static const char *names[OPCODE_COUNT] = {
+                "loadk", "mov", "add", "sub", "mul", "div", "addb", "subb", "mulb", "divb", "addi", "subi",
+                "shli", "shlbi", "shri", "truncb", "not", "eq", "ne", "lt", "le", "gt", "ge", "jmp", "jz", "jnz",
+                "jeq", "jne", "jlt", "jle", "jgt", "jge", "jeqi", "jnei", "jlti", "jlei", "jgti", "jgei", "aload",
+                "astore", "aloadu", "astoreu", "zero", "call", "ret", "retv", "print", "printi", "vloop"
+        };
+        return op < OPCODE_COUNT ? names[op] : "?";
+    }
+
+    // Opcode of a comparison producing a value, or of a compare-and-branch with an immediate
+    static Opcode compareOpcode(ast::RelOpType op, Opcode eq) {
+        switch (op) {
+            case ast::RelOpType::EQ:
+                return static_cast<Opcode>(eq);
+            case ast::RelOpType::NE:
+                return static_cast<Opcode>(eq + 1);
+            case ast::RelOpType::LT:
+                return static_cast<Opcode>(eq + 2);
+            case ast::RelOpType::LE:
+                return static_cast<Opcode>(eq + 3);
+            case ast::RelOpType::GT:
+                return static_cast<Opcode>(eq + 4);
+            case ast::RelOpType::GE:
+                return static_cast<Opcode>(eq + 5);
+        }
+        return eq;
+    }
+
+    static ast::RelOpType negate(ast::RelOpType op) {
+        switch (op) {
+            case ast::RelOpType::EQ:
+                return ast::RelOpType::NE;
+            case ast::RelOpType::NE:
+                return ast::RelOpType::EQ;
+            case ast::RelOpType::LT:
+                return ast::RelOpType::GE;
+            case ast::RelOpType::GT:
+                return ast::RelOpType::LE;
+            case ast::RelOpType::LE:
+                return ast::RelOpType::GT;
+            case ast::RelOpType::GE:
+                return ast::RelOpType::LT;
+        }
+        return op;
+    }
+
+    // a op b == b mirror(op) a
+    static ast::RelOpType mirror(ast::RelOpType op) {
+        switch (op) {
+            case ast::RelOpType::LT:
+                return ast::RelOpType::GT;
+            case ast::RelOpType::GT:
+                return ast::RelOpType::LT;
+            case ast::RelOpType::LE:
+                return ast::RelOpType::GE;
+            case ast::RelOpType::GE:
+                return ast::RelOpType::LE;
+            default:
+                return op;
+        }
+    }
+
+    Compiler::Compiler() : params(0), firstTemp(0), nextTemp(0), maxRegisters(0), dest(0) {}
+
+    Program Compiler::compile(ast::Funcs &funcs) {
+        Compiler compiler;
+        funcs.accept(compiler);
+        return std::move(compiler.program);
+    }
+
+    /* Helpers */
+
+    int Compiler::_emit(Opcode op, int a, int b, int c, int d) {
+        program.code.push_back({op, a, b, c, d});
+        return static_cast<int>(program.code.size()) - 1;
+    }
+
+    int Compiler::_label() {
+        labels.push_back(-1);
+        return static_cast<int>(labels.size()) - 1;
+    }
+
+    void Compiler::_place(int label) {
+        labels[label] = static_cast<int>(program.code.size());
+    }
+
+    void Compiler::_jump(Opcode op, int a, int b, int label) {
+        fixups.emplace_back(_emit(op, a, b), label);
+    }
+
+    void Compiler::_patch() {
+        for (const auto &fixup : fixups) {
+            Instr &instr = program.code[fixup.first];
+            int target = labels[fixup.second];
+            if (instr.op == JMP) {
+                instr.a = target;
+            } else if (instr.op == JZ || instr.op == JNZ) {
+                instr.b = target;
+            } else {
+                instr.c = target;
+            }
+        }
+        fixups.clear();
+        labels.clear();
+    }
+
+    int Compiler::_temp(int count) {
+        int reg = nextTemp;
+        nextTemp += count;
+        maxRegisters = std::max(maxRegisters, nextTemp);
+        return reg;
+    }
+
+    int Compiler::_slot(const ast::ID &id) const {
+        return id.computedOffset + params;
+    }
+
+    int Compiler::_function(const std::string &name) const {
+        for (size_t i = 0; i < functionNames.size(); ++i) {
+            if (functionNames[i] == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void Compiler::_expr(ast::Exp &exp, int reg) {
+        int saved = dest;
+        dest = reg;
+        exp.accept(*this);
+        dest = saved;
+    }
+
+    int Compiler::_operand(ast::Exp &exp) {
+        auto id = dynamic_cast<ast::ID *>(&exp);
+        if (id) {
+            return _slot(*id);
+        }
+        int reg = _temp();
+        _expr(exp, reg);
+        return reg;
+    }
+
+    void Compiler::_branch(ast::Exp &exp, bool when, int label) {
+        if (auto relOp = dynamic_cast<ast::RelOp *>(&exp)) {
+            ast::RelOpType op = when ? relOp->op : negate(relOp->op);
+            ast::Exp *left = relOp->left.get();
+            ast::Exp *right = relOp->right.get();
+            int value;
+            if (ConstantFolder::literalValue(*left, value) && !ConstantFolder::literalValue(*right, value)) {
+                std::swap(left, right);
+                op = mirror(op);
+            }
+            int mark = nextTemp;
+            int leftReg = _operand(*left);
+            if (ConstantFolder::literalValue(*right, value)) {
+                _jump(compareOpcode(op, JEQI), leftReg, value, label);
+            } else {
+                _jump(compareOpcode(op, JEQ), leftReg, _operand(*right), label);
+            }
+            nextTemp = mark;
+            return;
+        }
+
+        if (auto boolean = dynamic_cast<ast::Bool *>(&exp)) {
+            if (boolean->value == when) {
+                _jump(JMP, 0, 0, label);
+            }
+            return;
+        }
+
+        if (auto notExp = dynamic_cast<ast::Not *>(&exp)) {
+            _branch(*notExp->exp, !when, label);
+            return;
+        }
+
+        if (auto andExp = dynamic_cast<ast::And *>(&exp)) {
+            if (when) {
+                int skip = _label();
+                _branch(*andExp->left, false, skip);
+                _branch(*andExp->right, true, label);
+                _place(skip);
+            } else {
+                _branch(*andExp->left, false, label);
+                _branch(*andExp->right, false, label);
+            }
+            return;
+        }
+
+        if (auto orExp = dynamic_cast<ast::Or *>(&exp)) {
+            if (when) {
+                _branch(*orExp->left, true, label);
+                _branch(*orExp->right, true, label);
+            } else {
+                int skip = _label();
+                _branch(*orExp->left, true, skip);
+                _branch(*orExp->right, false, label);
+                _place(skip);
+            }
+            return;
+        }
+
+        int mark = nextTemp;
+        _jump(when ? JNZ : JZ, _operand(exp), 0, label);
+        nextTemp = mark;
+    }
+
+    void Compiler::_call(ast::Call &node, int result) {
+        const std::string &name = node.func_id->value;
+        int mark = nextTemp;
+
+        if (name == "print") {
+            auto literal = dynamic_cast<ast::String *>(node.args->exps[0].get());
+            auto found = stringIndices.find(literal->index);
+            if (found == stringIndices.end()) {
+                found = stringIndices.emplace(literal->index, static_cast<int>(program.strings.size())).first;
+                program.strings.push_back(literal->value());
+            }
+            _emit(PRINT, found->second);
+        } else if (name == "printi") {
+            _emit(PRINTI, _operand(*node.args->exps[0]));
+        } else {
+            // the arguments go straight into the callee's parameter slots, which are numbered
+            // from the last parameter
+            int count = static_cast<int>(node.args->exps.size());
+            int window = _temp(count);
+            for (int i = 0; i < count; ++i) {
+                _expr(*node.args->exps[i], window + count - 1 - i);
+            }
+            _emit(CALL, result, _function(name), window);
+        }
+
+        nextTemp = mark;
+    }
+
+    /* Expressions */
+
+    void Compiler::visit(ast::Num &node) {
+        _emit(LOADK, dest, node.value);
+    }
+
+    void Compiler::visit(ast::NumB &node) {
+        _emit(LOADK, dest, node.value);
+    }
+
+    void Compiler::visit(ast::String &node) {}
+
+    void Compiler::visit(ast::Bool &node) {
+        _emit(LOADK, dest, node.value);
+    }
+
+    void Compiler::visit(ast::ID &node) {
+        if (_slot(node) != dest) {
+            _emit(MOV, dest, _slot(node));
+        }
+    }
+
+    void Compiler::visit(ast::BinOp &node) {
+        int target = dest;
+        int mark = nextTemp;
+        bool isByte = node.computedType == ast::BuiltInType::BYTE;
+        int left = _operand(*node.left);
+
+        int value;
+        if (!isByte && (node.op == ast::BinOpType::ADD || node.op == ast::BinOpType::SUB) &&
+            ConstantFolder::literalValue(*node.right, value)) {
+            _emit(node.op == ast::BinOpType::ADD ? ADDI : SUBI, target, left, value);
+            nextTemp = mark;
+            return;
+        }
+        if (node.computedShift > 0) {
+            Opcode op = node.op == ast::BinOpType::DIV ? SHRI : isByte ? SHLBI : SHLI;
+            _emit(op, target, left, node.computedShift);
+            nextTemp = mark;
+            return;
+        }
+
+        int right = _operand(*node.right);
+        Opcode op = ADD;
+        switch (node.op) {
+            case ast::BinOpType::ADD:
+                op = isByte ? ADDB : ADD;
+                break;
+            case ast::BinOpType::SUB:
+                op = isByte ? SUBB : SUB;
+                break;
+            case ast::BinOpType::MUL:
+                op = isByte ? MULB : MUL;
+                break;
+            case ast::BinOpType::DIV:
+                op = isByte ? DIVB : DIV;
+                break;
+        }
+        _emit(op, target, left, right);
+        nextTemp = mark;
+    }
+
+    void Compiler::visit(ast::RelOp &node) {
+        int target = dest;
+        int mark = nextTemp;
+        int left = _operand(*node.left);
+        int right = _operand(*node.right);
+        _emit(compareOpcode(node.op, EQ), target, left, right);
+        nextTemp = mark;
+    }
+
+    void Compiler::visit(ast::Not &node) {
+        int target = dest;
+        int mark = nextTemp;
+        _emit(NOT, target, _operand(*node.exp));
+        nextTemp = mark;
+    }
+
+    void Compiler::visit(ast::And &node) {
+        // the target may be read by the operands, so it is only written at the end
+        int target = dest;
+        int isFalse = _label();
+        int end = _label();
+        _branch(node, false, isFalse);
+        _emit(LOADK, target, 1);
+        _jump(JMP, 0, 0, end);
+        _place(isFalse);
+        _emit(LOADK, target, 0);
+        _place(end);
+    }
+
+    void Compiler::visit(ast::Or &node) {
+        int target = dest;
+        int isFalse = _label();
+        int end = _label();
+        _branch(node, false, isFalse);
+        _emit(LOADK, target, 1);
+        _jump(JMP, 0, 0, end);
+        _place(isFalse);
+        _emit(LOADK, target, 0);
+        _place(end);
+    }
+
+    void Compiler::visit(ast::Cast &node) {
+        int target = dest;
+        if (node.target_type->computedType == ast::BuiltInType::BYTE &&
+            node.exp->computedType != ast::BuiltInType::BYTE) {
+            int mark = nextTemp;
+            _emit(TRUNCB, target, _operand(*node.exp));
+            nextTemp = mark;
+        } else {
+            _expr(*node.exp, target);
+        }
+    }
+
+    void Compiler::visit(ast::ArrayDereference &node) {
+        int target = dest;
+        int mark = nextTemp;
+        int index = _operand(*node.index);
+        _emit(node.computedInBounds ? ALOADU : ALOAD, target, _slot(*node.id), index, node.id->computedArrLength);
+        nextTemp = mark;
+    }
+
+    void Compiler::visit(ast::ExpList &node) {}
+
+    void Compiler::visit(ast::Call &node) {
+        _call(node, dest);
+    }
+
+    /* Types */
+
+    void Compiler::visit(ast::ArrayType &node) {}
+
+    void Compiler::visit(ast::PrimitiveType &node) {}
+
+    /* Statements */
+
+    void Compiler::visit(ast::ArrayAssign &node) {
+        int mark = nextTemp;
+        int index = _operand(*node.index);
+        int value = _operand(*node.exp);
+        _emit(node.computedInBounds ? ASTOREU : ASTORE, value, _slot(*node.id), index, node.id->computedArrLength);
+        nextTemp = mark;
+    }
+
+    void Compiler::visit(ast::Statements &node) {
+        for (auto &statement : node.statements) {
+            _statement(*statement);
+        }
+    }
+
+    void Compiler::visit(ast::Block &node) {
+        node.statements->accept(*this);
+    }
+
+    void Compiler::visit(ast::Break &node) {
+        _jump(JMP, 0, 0, breakLabels.back());
+    }
+
+    void Compiler::visit(ast::Continue &node) {
+        _jump(JMP, 0, 0, continueLabels.back());
+    }
+
+    void Compiler::visit(ast::Return &node) {
+        if (node.exp) {
+            int mark = nextTemp;
+            _emit(RET, _operand(*node.exp));
+            nextTemp = mark;
+        } else {
+            _emit(RETV);
+        }
+    }
+
+    void Compiler::_statement(ast::Statement &statement) {
+        if (auto call = dynamic_cast<ast::Call *>(&statement)) {
+            _call(*call, -1);
+        } else {
+            statement.accept(*this);
+        }
+    }
+
+    void Compiler::visit(ast::If &node) {
+        int otherwise = _label();
+        int end = _label();
+        _branch(*node.condition, false, otherwise);
+        _statement(*node.then);
+        if (node.otherwise) {
+            _jump(JMP, 0, 0, end);
+            _place(otherwise);
+            _statement(*node.otherwise);
+        } else {
+            _place(otherwise);
+        }
+        _place(end);
+    }
+
+    void Compiler::_vectorLoop(ast::While &node) {
+        auto &condition = dynamic_cast<ast::RelOp &>(*node.condition);
+        VectorLoop loop;
+        loop.counter = _slot(dynamic_cast<ast::ID &>(*condition.left));
+        if (auto bound = dynamic_cast<ast::ID *>(condition.right.get())) {
+            loop.bound = _slot(*bound);
+            loop.immediate = false;
+        } else if (auto num = dynamic_cast<ast::Num *>(condition.right.get())) {
+            loop.bound = num->value;
+            loop.immediate = true;
+        } else {
+            loop.bound = dynamic_cast<ast::NumB &>(*condition.right).value;
+            loop.immediate = true;
+        }
+        loop.inclusive = condition.op == ast::RelOpType::LE;
+        loop.length = INT_MAX;
+        loop.vectors = 0;
+
+        // every statement but the last, the counter step, is a store at the counter
+        auto &statements = dynamic_cast<ast::Block &>(*node.body).statements->statements;
+        for (size_t i = 0; i + 1 < statements.size(); ++i) {
+            auto &store = dynamic_cast<ast::ArrayAssign &>(*statements[i]);
+            int length = store.id->computedArrLength;
+            _vector(*store.exp, loop, 0);
+            loop.body.push_back({VSTORE, 0, _slot(*store.id), length});
+            loop.length = std::min(loop.length, length);
+        }
+
+        _emit(VLOOP, static_cast<int>(program.loops.size()));
+        program.loops.push_back(std::move(loop));
+    }
+
+    void Compiler::_vector(ast::Exp &exp, VectorLoop &loop, int vector) {
+        loop.vectors = std::max(loop.vectors, vector + 1);
+        if (auto num = dynamic_cast<ast::Num *>(&exp)) {
+            loop.body.push_back({VSPLATK, vector, num->value, 0});
+        } else if (auto numB = dynamic_cast<ast::NumB *>(&exp)) {
+            loop.body.push_back({VSPLATK, vector, numB->value, 0});
+        } else if (auto id = dynamic_cast<ast::ID *>(&exp)) {
+            int slot = _slot(*id);
+            loop.body.push_back(slot == loop.counter ? VectorInstr{VINDEX, vector, 0, 0}
+                                                     : VectorInstr{VSPLAT, vector, slot, 0});
+        } else if (auto element = dynamic_cast<ast::ArrayDereference *>(&exp)) {
+            int length = element->id->computedArrLength;
+            loop.body.push_back({VLOAD, vector, _slot(*element->id), length});
+            loop.length = std::min(loop.length, length);
+        } else if (auto binOp = dynamic_cast<ast::BinOp *>(&exp)) {
+            _vector(*binOp->left, loop, vector);
+            _vector(*binOp->right, loop, vector + 1);
+            VectorOpcode op = binOp->op == ast::BinOpType::ADD ? VADD : binOp->op == ast::BinOpType::SUB ? VSUB : VMUL;
+            loop.body.push_back({op, vector, vector, vector + 1});
+            if (binOp->computedType == ast::BuiltInType::BYTE) {
+                loop.body.push_back({VTRUNCB, vector, vector, 0});
+            }
+        } else {
+            auto &cast = dynamic_cast<ast::Cast &>(exp);
+            _vector(*cast.exp, loop, vector);
+            if (cast.target_type->computedType == ast::BuiltInType::BYTE &&
+                cast.exp->computedType != ast::BuiltInType::BYTE) {
+                loop.body.push_back({VTRUNCB, vector, vector, 0});
+            }
+        }
+    }
+
+    void Compiler::visit(ast::While &node) {
+        if (node.computedVectorizable) {
+            _vectorLoop(node);
+        }
+
+        int body = _label();
+        int condition = _label();
+        int end = _label();
+
+        _jump(JMP, 0, 0, condition);
+        _place(body);
+        continueLabels.push_back(condition);
+        breakLabels.push_back(end);
+        _statement(*node.body);
+        continueLabels.pop_back();
+        breakLabels.pop_back();
+        _place(condition);
+        _branch(*node.condition, true, body);
+        _place(end);
+    }
+
+    void Compiler::visit(ast::VarDecl &node) {
+        int slot = _slot(*node.id);
+        if (node.type->computedIsArray) {
+            _emit(ZERO, slot, node.type->computedArrLength);
+        } else if (node.init_exp) {
+            _expr(*node.init_exp, slot);
+        } else {
+            _emit(LOADK, slot, 0);
+        }
+    }
+
+    void Compiler::visit(ast::Assign &node) {
+        _expr(*node.exp, _slot(*node.id));
+    }
+
+    void Compiler::visit(ast::Formal &node) {}
+
+    void Compiler::visit(ast::Formals &node) {}
+
+    void Compiler::visit(ast::FuncDecl &node) {
+        Function &function = program.functions[_function(node.id->value)];
+        function.entry = static_cast<int>(program.code.size());
+
+        params = static_cast<int>(node.formals->formals.size());
+        firstTemp = params + node.computedFrameSize;
+        nextTemp = firstTemp;
+        maxRegisters = firstTemp;
+
+        node.body->accept(*this);
+        // falling off the end of a function that returns a value returns 0
+        if (node.return_type->computedType == ast::BuiltInType::VOID) {
+            _emit(RETV);
+        } else {
+            int zero = _temp();
+            _emit(LOADK, zero, 0);
+            _emit(RET, zero);
+        }
+        _patch();
+
+        function.registers = maxRegisters;
+    }
+
+    void Compiler::visit(ast::Funcs &node) {
+        for (auto &func : node.funcs) {
+            functionNames.push_back(func->id->value);
+            program.functions.push_back({func->id->value, 0, static_cast<int>(func->formals->formals.size()), 0});
+        }
+        program.main = _function("main");
+
+        for (auto &func : node.funcs) {
+            func->accept(*this);
+        }
+    }
+}
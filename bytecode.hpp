@@ -0,0 +1,228 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+namespace bytecode {
+    /* Register-based bytecode
+     * Every function runs in a window of 32-bit registers. The first registers are the variable
+     * slots the semantic analysis assigned (parameters first, then locals by frame offset, an
+     * array taking one register per element), followed by temporaries. Jump targets are
+     * instruction indices.
+     */
+    enum Opcode : uint8_t {
+        LOADK,      // a = imm b
+        MOV,        // a = b
+        ADD,        // a = b + c, and so on, int arithmetic wraps at 32 bits
+        SUB,
+        MUL,
+        DIV,        // traps on division by zero
+        ADDB,       // byte arithmetic wraps at 8 bits, division is unsigned
+        SUBB,
+        MULB,
+        DIVB,
+        ADDI,       // a = b + imm c
+        SUBI,       // a = b - imm c
+        SHLI,       // a = b << imm c, multiplication by 2^c wrapping at 32 bits
+        SHLBI,      // a = (b << imm c) & 0xFF
+        SHRI,       // a = b / 2^imm c by shifting, rounding toward zero like DIV
+        TRUNCB,     // a = b & 0xFF
+        NOT,        // a = !b
+        EQ,         // a = b == c, and so on
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+        JMP,        // goto a
+        JZ,         // if !a goto b
+        JNZ,        // if a goto b
+        JEQ,        // if a == b goto c, and so on
+        JNE,
+        JLT,
+        JLE,
+        JGT,
+        JGE,
+        JEQI,       // if a == imm b goto c, and so on
+        JNEI,
+        JLTI,
+        JLEI,
+        JGTI,
+        JGEI,
+        ALOAD,      // a = b[c], array of length d starting at register b, traps out of bounds
+        ASTORE,     // b[c] = a, array of length d
+        ALOADU,     // ALOAD and ASTORE without the bounds check, for an index known to be in range
+        ASTOREU,
+        ZERO,       // registers a .. a + b - 1 = 0
+        CALL,       // a = function b, with its registers starting at c (a < 0: no result)
+        RET,        // return a
+        RETV,       // return without a value
+        PRINT,      // print string a
+        PRINTI,     // print register a
+        VLOOP,      // runs whole vectors of iterations of vector loop a
+        OPCODE_COUNT
+    };
+
+    struct Instr {
+        Opcode op;
+        int32_t a, b, c, d;
+    };
+
+    /* Vector loops
+     * A loop the vectorizer marked, `while (i < n) { x[i] = ...; i = i + 1; }`, is compiled as
+     * usual and also to a VectorLoop that a VLOOP instruction right before it runs. VLOOP does
+     * nothing unless every iteration stays within the arrays, and otherwise runs as many whole
+     * vectors of iterations as there are and leaves the counter after them, so the loop itself
+     * runs what remains. A lane is one register, 32 bits, for byte arrays too: byte values are
+     * truncated after each operation as in the scalar code.
+     */
+    enum VectorOpcode : uint8_t {
+        VLOAD,      // v[a] = elements of the array starting at register b, of length c
+        VSTORE,     // elements of the array starting at register b, of length c = v[a]
+        VSPLAT,     // v[a] = register b in every lane
+        VSPLATK,    // v[a] = imm b in every lane
+        VINDEX,     // v[a] = the counter of each lane's iteration
+        VADD,       // v[a] = v[b] + v[c], wrapping at 32 bits, and so on
+        VSUB,
+        VMUL,
+        VTRUNCB     // v[a] = v[b] & 0xFF
+    };
+
+    struct VectorInstr {
+        VectorOpcode op;
+        int32_t a, b, c;
+    };
+
+    struct VectorLoop {
+        // Register of the counter, and register or immediate of the bound
+        int counter;
+        int bound;
+        bool immediate;
+        // i <= n rather than i < n
+        bool inclusive;
+        // Length of the shortest array the loop accesses
+        int length;
+        // Vector registers the body needs
+        int vectors;
+        // One iteration of every lane, statement by statement
+        std::vector<VectorInstr> body;
+    };
+
+    struct Function {
+        std::string name;
+        // Index of the first instruction
+        int entry;
+        int params;
+        // Registers the function needs: variable slots and temporaries
+        int registers;
+    };
+
+    struct Program {
+        std::vector<Instr> code;
+        std::vector<Function> functions;
+        // print arguments, escapes decoded, each distinct one once
+        std::vector<std::string> strings;
+        std::vector<VectorLoop> loops;
+        int main;
+    };
+
+    const char *opcodeName(Opcode op);
+
+    /* Compiler class
+     * Lowers a checked ast::Funcs tree to a Program. Conditions compile to compare-and-branch
+     * instructions, with an immediate operand when one side is a literal, and while loops are
+     * laid out with the condition at the bottom so each iteration runs one branch.
+     */
+    class Compiler : public Visitor {
+    private:
+        Program program;
+        std::vector<std::string> functionNames;
+        // Index in program.strings of each string pool entry printed so far
+        std::unordered_map<int, int> stringIndices;
+
+        // State of the function being compiled
+        int params;
+        int firstTemp;
+        int nextTemp;
+        int maxRegisters;
+        // Register the expression being visited writes to
+        int dest;
+        // Instruction index of each label, -1 until placed
+        std::vector<int> labels;
+        // Jumps to patch once their label is placed: instruction index and label
+        std::vector<std::pair<int, int>> fixups;
+        // Innermost loop last: where continue and break go
+        std::vector<int> continueLabels;
+        std::vector<int> breakLabels;
+
+        int _emit(Opcode op, int a = 0, int b = 0, int c = 0, int d = 0);
+        int _label();
+        void _place(int label);
+        void _jump(Opcode op, int a, int b, int label);
+        void _patch();
+
+        int _temp(int count = 1);
+        int _slot(const ast::ID &id) const;
+        int _function(const std::string &name) const;
+
+        // Evaluates into a given register
+        void _expr(ast::Exp &exp, int reg);
+        // Evaluates into any register: a scalar variable is read in place
+        int _operand(ast::Exp &exp);
+        // Jumps to `label` if the condition evaluates to `when`, falls through otherwise
+        void _branch(ast::Exp &exp, bool when, int label);
+        void _call(ast::Call &node, int result);
+        // Compiles a statement; a call statement drops its result
+        void _statement(ast::Statement &statement);
+        // Emits the VLOOP of a loop the vectorizer marked
+        void _vectorLoop(ast::While &node);
+        // Evaluates into vector register `vector` of `loop`
+        void _vector(ast::Exp &exp, VectorLoop &loop, int vector);
+
+
+    public:
+        Compiler();
+
+        // Entry point: compiles a checked program
+        static Program compile(ast::Funcs &funcs);
+
+        void visit(ast::Num &node) override;
+        void visit(ast::NumB &node) override;
+        void visit(ast::String &node) override;
+        void visit(ast::Bool &node) override;
+        void visit(ast::ID &node) override;
+        void visit(ast::BinOp &node) override;
+        void visit(ast::RelOp &node) override;
+        void visit(ast::Not &node) override;
+        void visit(ast::And &node) override;
+        void visit(ast::Or &node) override;
+        void visit(ast::ArrayType &node) override;
+        void visit(ast::PrimitiveType &node) override;
+        void visit(ast::ArrayDereference &node) override;
+        void visit(ast::ArrayAssign &node) override;
+        void visit(ast::Cast &node) override;
+        void visit(ast::ExpList &node) override;
+        void visit(ast::Call &node) override;
+        void visit(ast::Statements &node) override;
+        void visit(ast::Block &node) override;
+        void visit(ast::Break &node) override;
+        void visit(ast::Continue &node) override;
+        void visit(ast::Return &node) override;
+        void visit(ast::If &node) override;
+        void visit(ast::While &node) override;
+        void visit(ast::VarDecl &node) override;
+        void visit(ast::Assign &node) override;
+        void visit(ast::Formal &node) override;
+        void visit(ast::Formals &node) override;
+        void visit(ast::FuncDecl &node) override;
+        void visit(ast::Funcs &node) override;
+    };
+}
+
+#endif //BYTECODE_HPP
@@ -0,0 +1,104 @@
+#include "callgraph.hpp"
+#include "walker.hpp"
+#include <algorithm>
+
+CallGraph::CallGraph(ast::Funcs &funcs) {
+    for (auto &func : funcs.funcs) {
+        indices.emplace(func->id->value, static_cast<int>(functions.size()));
+        functions.push_back(func.get());
+    }
+
+    int count = static_cast<int>(functions.size());
+    callees.resize(count);
+    callSites.assign(count, 0);
+    recursive.assign(count, false);
+    for (int caller = 0; caller < count; caller++) {
+        CallCollector collector;
+        functions[caller]->body->accept(collector);
+        for (const auto &name : collector.callees) {
+            int callee = find(name);
+            if (callee < 0) {
+                continue;
+            }
+            callSites[callee]++;
+            if (std::find(callees[caller].begin(), callees[caller].end(), callee) == callees[caller].end()) {
+                callees[caller].push_back(callee);
+            }
+            if (callee == caller) {
+                recursive[caller] = true;
+            }
+        }
+    }
+
+    _components();
+}
+
+int CallGraph::find(const std::string &name) const {
+    auto found = indices.find(name);
+    return found == indices.end() ? -1 : found->second;
+}
+
+void CallGraph::_components() {
+    int count = static_cast<int>(functions.size());
+    std::vector<int> order(count, -1);
+    std::vector<int> low(count, 0);
+    std::vector<bool> onStack(count, false);
+    std::vector<int> stack;
+    component.assign(count, -1);
+    int visited = 0;
+
+    // Depth-first search frames: a function and the next of its callees to look at
+    std::vector<std::pair<int, size_t>> frames;
+    for (int root = 0; root < count; root++) {
+        if (order[root] >= 0) {
+            continue;
+        }
+        frames.emplace_back(root, 0);
+        order[root] = low[root] = visited++;
+        stack.push_back(root);
+        onStack[root] = true;
+
+        while (!frames.empty()) {
+            int function = frames.back().first;
+            size_t &next = frames.back().second;
+            if (next < callees[function].size()) {
+                int callee = callees[function][next++];
+                if (order[callee] < 0) {
+                    order[callee] = low[callee] = visited++;
+                    stack.push_back(callee);
+                    onStack[callee] = true;
+                    frames.emplace_back(callee, 0);
+                } else if (onStack[callee]) {
+                    low[function] = std::min(low[function], order[callee]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (!frames.empty()) {
+                int caller = frames.back().first;
+                low[caller] = std::min(low[caller], low[function]);
+            }
+            if (low[function] != order[function]) {
+                continue;
+            }
+            // the root of a component: everything above it on the stack belongs to it
+            std::vector<int> members;
+            int member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                component[member] = static_cast<int>(components.size());
+                members.push_back(member);
+            } while (member != function);
+            if (members.size() > 1) {
+                for (int m : members) {
+                    recursive[m] = true;
+                }
+            }
+            std::sort(members.begin(), members.end());
+            components.push_back(std::move(members));
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef CALLGRAPH_HPP
+#define CALLGRAPH_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nodes.hpp"
+
+/* CallGraph class
+ * Which functions of a checked program call which, and the graph's strongly connected
+ * components: a function is recursive when it can reach itself through calls, directly or
+ * through others in its component. The library functions print and printi are not part of it.
+ */
+class CallGraph {
+public:
+    // Functions in source order; everything else refers to them by index
+    std::vector<ast::FuncDecl *> functions;
+    // Functions each one calls, each listed once
+    std::vector<std::vector<int>> callees;
+    // Number of calls naming each function in the whole program
+    std::vector<int> callSites;
+    // Strongly connected components, each one after every component it calls into
+    std::vector<std::vector<int>> components;
+    std::vector<int> component;
+    std::vector<bool> recursive;
+
+    explicit CallGraph(ast::Funcs &funcs);
+
+    // Index of a function, or -1 for a library function
+    int find(const std::string &name) const;
+
+private:
+    std::unordered_map<std::string, int> indices;
+
+    // Tarjan's algorithm, without recursion so long call chains cannot overflow the stack
+    void _components();
+};
+
+#endif //CALLGRAPH_HPP
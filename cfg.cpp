@@ -0,0 +1,203 @@
+#include "cfg.hpp"
+#include <algorithm>
+
+namespace {
+    /* Adds the statements of a function to a ControlFlowGraph */
+    class CFGBuilder : public Visitor {
+    private:
+        ControlFlowGraph &cfg;
+        int current;
+        // Innermost loop first: where continue and break go
+        std::vector<int> loopHeaders;
+        std::vector<int> loopExits;
+
+        void _item(ast::Node &node) {
+            cfg.blocks[current].items.push_back(&node);
+        }
+
+        // Ends the current block with a jump; whatever follows starts an unreachable block
+        void _jump(int target) {
+            cfg.addEdge(current, target);
+            current = cfg.newBlock();
+        }
+
+        static bool _literal(ast::Exp &exp, bool &value) {
+            auto boolean = dynamic_cast<ast::Bool *>(&exp);
+            if (boolean) {
+                value = boolean->value;
+            }
+            return boolean != nullptr;
+        }
+
+    public:
+        CFGBuilder(ControlFlowGraph &cfg, int start) : cfg(cfg), current(start) {}
+
+        int end() const { return current; }
+
+        void visit(ast::Num &node) override {}
+        void visit(ast::NumB &node) override {}
+        void visit(ast::String &node) override {}
+        void visit(ast::Bool &node) override {}
+        void visit(ast::ID &node) override {}
+        void visit(ast::BinOp &node) override {}
+        void visit(ast::RelOp &node) override {}
+        void visit(ast::Not &node) override {}
+        void visit(ast::And &node) override {}
+        void visit(ast::Or &node) override {}
+        void visit(ast::ArrayType &node) override {}
+        void visit(ast::PrimitiveType &node) override {}
+        void visit(ast::ArrayDereference &node) override {}
+        void visit(ast::Cast &node) override {}
+        void visit(ast::ExpList &node) override {}
+        void visit(ast::Formal &node) override {}
+        void visit(ast::Formals &node) override {}
+        void visit(ast::Funcs &node) override {}
+
+        void visit(ast::ArrayAssign &node) override { _item(node); }
+        void visit(ast::Call &node) override { _item(node); }
+        void visit(ast::VarDecl &node) override { _item(node); }
+        void visit(ast::Assign &node) override { _item(node); }
+
+        void visit(ast::Statements &node) override {
+            for (auto &statement : node.statements) {
+                statement->accept(*this);
+            }
+        }
+
+        void visit(ast::Block &node) override {
+            node.statements->accept(*this);
+        }
+
+        void visit(ast::Break &node) override {
+            _jump(loopExits.back());
+        }
+
+        void visit(ast::Continue &node) override {
+            _jump(loopHeaders.back());
+        }
+
+        void visit(ast::Return &node) override {
+            _item(node);
+            _jump(cfg.exit);
+        }
+
+        void visit(ast::If &node) override {
+            _item(*node.condition);
+            int condition = current;
+            int join = cfg.newBlock();
+            bool value = false;
+            bool constant = _literal(*node.condition, value);
+
+            current = cfg.newBlock();
+            if (!constant || value) {
+                cfg.addEdge(condition, current);
+            }
+            node.then->accept(*this);
+            cfg.addEdge(current, join);
+
+            if (node.otherwise) {
+                current = cfg.newBlock();
+                if (!constant || !value) {
+                    cfg.addEdge(condition, current);
+                }
+                node.otherwise->accept(*this);
+                cfg.addEdge(current, join);
+            } else if (!constant || !value) {
+                cfg.addEdge(condition, join);
+            }
+            current = join;
+        }
+
+        void visit(ast::While &node) override {
+            int header = cfg.newBlock();
+            int body = cfg.newBlock();
+            int exit = cfg.newBlock();
+            bool value = false;
+            bool constant = _literal(*node.condition, value);
+
+            cfg.addEdge(current, header);
+            current = header;
+            _item(*node.condition);
+            if (!constant || value) {
+                cfg.addEdge(header, body);
+            }
+            if (!constant || !value) {
+                cfg.addEdge(header, exit);
+            }
+
+            loopHeaders.push_back(header);
+            loopExits.push_back(exit);
+            current = body;
+            node.body->accept(*this);
+            cfg.addEdge(current, header);
+            loopHeaders.pop_back();
+            loopExits.pop_back();
+
+            current = exit;
+        }
+
+        void visit(ast::FuncDecl &node) override {
+            node.body->accept(*this);
+        }
+    };
+}
+
+/* ControlFlowGraph class implementation */
+
+ControlFlowGraph::ControlFlowGraph(ast::FuncDecl &func) : func(&func) {
+    entry = newBlock();
+    exit = newBlock();
+
+    int start = newBlock();
+    addEdge(entry, start);
+
+    CFGBuilder builder(*this, start);
+    func.accept(builder);
+    fallthrough = builder.end();
+    addEdge(fallthrough, exit);
+}
+
+int ControlFlowGraph::newBlock() {
+    blocks.emplace_back();
+    return static_cast<int>(blocks.size()) - 1;
+}
+
+void ControlFlowGraph::addEdge(int from, int to) {
+    blocks[from].succs.push_back(to);
+    blocks[to].preds.push_back(from);
+}
+
+std::vector<int> ControlFlowGraph::reversePostorder() const {
+    std::vector<int> order;
+    std::vector<char> visited(blocks.size(), 0);
+    // explicit stack of (block, next successor to look at), functions can be huge
+    std::vector<std::pair<int, size_t>> stack;
+
+    stack.emplace_back(entry, 0);
+    visited[entry] = 1;
+    while (!stack.empty()) {
+        auto &top = stack.back();
+        const auto &succs = blocks[top.first].succs;
+        if (top.second < succs.size()) {
+            int next = succs[top.second++];
+            if (!visited[next]) {
+                visited[next] = 1;
+                stack.emplace_back(next, 0);
+            }
+        } else {
+            order.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::vector<bool> ControlFlowGraph::reachable() const {
+    std::vector<bool> result(blocks.size(), false);
+    for (int block : reversePostorder()) {
+        result[block] = true;
+    }
+    return result;
+}
@@ -0,0 +1,42 @@
+#ifndef CFG_HPP
+#define CFG_HPP
+
+#include <vector>
+#include "nodes.hpp"
+
+/* Basic block
+ * Holds, in execution order, the simple statements (VarDecl, Assign, ArrayAssign, Call, Return)
+ * and the branch conditions (If and While conditions) it evaluates.
+ */
+struct BasicBlock {
+    std::vector<ast::Node *> items;
+    std::vector<int> succs;
+    std::vector<int> preds;
+};
+
+/* ControlFlowGraph class
+ * Control flow graph of one checked function, built from If, While, Break, Continue and Return.
+ * Conditions that are boolean literals only get the edge that can be taken.
+ */
+class ControlFlowGraph {
+public:
+    std::vector<BasicBlock> blocks;
+    // Entry and exit blocks; every Return and the end of the body lead to the exit
+    int entry;
+    int exit;
+    // Block that reaches the exit by falling off the end of the body
+    int fallthrough;
+    ast::FuncDecl *func;
+
+    explicit ControlFlowGraph(ast::FuncDecl &func);
+
+    int newBlock();
+    void addEdge(int from, int to);
+
+    // Blocks reachable from the entry, in reverse postorder
+    std::vector<int> reversePostorder() const;
+
+    std::vector<bool> reachable() const;
+};
+
+#endif //CFG_HPP
@@ -0,0 +1,284 @@
+#include "constfold.hpp"
+#include <cstdint>
+#include <climits>
+
+ConstantFolder::ConstantFolder() : foldedCount(0) {}
+
+/* FanC value semantics */
+
+int ConstantFolder::evalBinOp(ast::BinOpType op, int left, int right, ast::BuiltInType type) {
+    // unsigned arithmetic wraps around instead of overflowing
+    uint32_t l = static_cast<uint32_t>(left);
+    uint32_t r = static_cast<uint32_t>(right);
+    uint32_t value = 0;
+
+    switch (op) {
+        case ast::BinOpType::ADD:
+            value = l + r;
+            break;
+        case ast::BinOpType::SUB:
+            value = l - r;
+            break;
+        case ast::BinOpType::MUL:
+            value = l * r;
+            break;
+        case ast::BinOpType::DIV:
+            if (type == ast::BuiltInType::BYTE) {
+                value = l / r;
+            } else if (left == INT_MIN && right == -1) {
+                value = l; // wraps back to INT_MIN
+            } else {
+                value = static_cast<uint32_t>(left / right);
+            }
+            break;
+    }
+
+    if (type == ast::BuiltInType::BYTE) {
+        return static_cast<int>(value & 0xFF);
+    }
+    return static_cast<int32_t>(value);
+}
+
+bool ConstantFolder::evalRelOp(ast::RelOpType op, int left, int right) {
+    switch (op) {
+        case ast::RelOpType::EQ:
+            return left == right;
+        case ast::RelOpType::NE:
+            return left != right;
+        case ast::RelOpType::LT:
+            return left < right;
+        case ast::RelOpType::GT:
+            return left > right;
+        case ast::RelOpType::LE:
+            return left <= right;
+        case ast::RelOpType::GE:
+            return left >= right;
+    }
+    return false;
+}
+
+int ConstantFolder::evalCast(int value, ast::BuiltInType to) {
+    return to == ast::BuiltInType::BYTE ? (value & 0xFF) : value;
+}
+
+bool ConstantFolder::literalValue(const ast::Exp &exp, int &value) {
+    if (auto num = dynamic_cast<const ast::Num *>(&exp)) {
+        value = num->value;
+        return true;
+    }
+    if (auto numB = dynamic_cast<const ast::NumB *>(&exp)) {
+        value = numB->value;
+        return true;
+    }
+    if (auto boolean = dynamic_cast<const ast::Bool *>(&exp)) {
+        value = boolean->value;
+        return true;
+    }
+    return false;
+}
+
+/* Helpers */
+
+void ConstantFolder::_fold(std::shared_ptr<ast::Exp> &exp) {
+    result = nullptr;
+    exp->accept(*this);
+    if (result) {
+        exp = result;
+        foldedCount++;
+    }
+    result = nullptr;
+}
+
+template<typename T>
+void ConstantFolder::_foldAll(std::vector<std::shared_ptr<T>> &nodes) {
+    for (auto &node : nodes) {
+        node->accept(*this);
+    }
+}
+
+std::shared_ptr<ast::Exp> ConstantFolder::_number(int value, ast::BuiltInType type, int line) {
+    std::shared_ptr<ast::Exp> literal;
+    if (type == ast::BuiltInType::BYTE) {
+        auto numB = std::make_shared<ast::NumB>("0");
+        numB->value = value;
+        literal = numB;
+    } else {
+        auto num = std::make_shared<ast::Num>("0");
+        num->value = value;
+        literal = num;
+    }
+    literal->line = line;
+    literal->computedType = type;
+    return literal;
+}
+
+std::shared_ptr<ast::Exp> ConstantFolder::_bool(bool value, int line) {
+    auto literal = std::make_shared<ast::Bool>(value);
+    literal->line = line;
+    literal->computedType = ast::BuiltInType::BOOL;
+    return literal;
+}
+
+/* Expressions */
+
+void ConstantFolder::visit(ast::Num &node) {}
+
+void ConstantFolder::visit(ast::NumB &node) {}
+
+void ConstantFolder::visit(ast::String &node) {}
+
+void ConstantFolder::visit(ast::Bool &node) {}
+
+void ConstantFolder::visit(ast::ID &node) {}
+
+void ConstantFolder::visit(ast::BinOp &node) {
+    _fold(node.left);
+    _fold(node.right);
+
+    int left, right;
+    bool constantRight = literalValue(*node.right, right);
+    if (node.op == ast::BinOpType::DIV && constantRight && right == 0) {
+        zeroDivisions.push_back(node.line);
+        return;
+    }
+    if (!constantRight || !literalValue(*node.left, left)) {
+        return;
+    }
+    result = _number(evalBinOp(node.op, left, right, node.computedType), node.computedType, node.line);
+}
+
+void ConstantFolder::visit(ast::RelOp &node) {
+    _fold(node.left);
+    _fold(node.right);
+
+    int left, right;
+    if (literalValue(*node.left, left) && literalValue(*node.right, right)) {
+        result = _bool(evalRelOp(node.op, left, right), node.line);
+    }
+}
+
+void ConstantFolder::visit(ast::Not &node) {
+    _fold(node.exp);
+
+    int value;
+    if (literalValue(*node.exp, value)) {
+        result = _bool(!value, node.line);
+    }
+}
+
+void ConstantFolder::visit(ast::And &node) {
+    _fold(node.left);
+    _fold(node.right);
+
+    int left, right;
+    if (literalValue(*node.left, left)) {
+        // false and x: x is never evaluated. true and x: just x
+        result = left ? node.right : _bool(false, node.line);
+    } else if (literalValue(*node.right, right) && right) {
+        result = node.left;
+    }
+}
+
+void ConstantFolder::visit(ast::Or &node) {
+    _fold(node.left);
+    _fold(node.right);
+
+    int left, right;
+    if (literalValue(*node.left, left)) {
+        // true or x: x is never evaluated. false or x: just x
+        result = left ? _bool(true, node.line) : node.right;
+    } else if (literalValue(*node.right, right) && !right) {
+        result = node.left;
+    }
+}
+
+void ConstantFolder::visit(ast::Cast &node) {
+    _fold(node.exp);
+
+    int value;
+    if (literalValue(*node.exp, value)) {
+        ast::BuiltInType to = node.target_type->computedType;
+        result = _number(evalCast(value, to), to, node.line);
+    }
+}
+
+void ConstantFolder::visit(ast::ArrayDereference &node) {
+    _fold(node.index);
+}
+
+void ConstantFolder::visit(ast::ExpList &node) {
+    for (auto &exp : node.exps) {
+        _fold(exp);
+    }
+}
+
+void ConstantFolder::visit(ast::Call &node) {
+    node.args->accept(*this);
+    result = nullptr;
+}
+
+/* Types */
+
+void ConstantFolder::visit(ast::ArrayType &node) {}
+
+void ConstantFolder::visit(ast::PrimitiveType &node) {}
+
+/* Statements */
+
+void ConstantFolder::visit(ast::ArrayAssign &node) {
+    _fold(node.index);
+    _fold(node.exp);
+}
+
+void ConstantFolder::visit(ast::Statements &node) {
+    _foldAll(node.statements);
+}
+
+void ConstantFolder::visit(ast::Block &node) {
+    node.statements->accept(*this);
+}
+
+void ConstantFolder::visit(ast::Break &node) {}
+
+void ConstantFolder::visit(ast::Continue &node) {}
+
+void ConstantFolder::visit(ast::Return &node) {
+    if (node.exp) {
+        _fold(node.exp);
+    }
+}
+
+void ConstantFolder::visit(ast::If &node) {
+    _fold(node.condition);
+    node.then->accept(*this);
+    if (node.otherwise) {
+        node.otherwise->accept(*this);
+    }
+}
+
+void ConstantFolder::visit(ast::While &node) {
+    _fold(node.condition);
+    node.body->accept(*this);
+}
+
+void ConstantFolder::visit(ast::VarDecl &node) {
+    if (node.init_exp) {
+        _fold(node.init_exp);
+    }
+}
+
+void ConstantFolder::visit(ast::Assign &node) {
+    _fold(node.exp);
+}
+
+void ConstantFolder::visit(ast::Formal &node) {}
+
+void ConstantFolder::visit(ast::Formals &node) {}
+
+void ConstantFolder::visit(ast::FuncDecl &node) {
+    node.body->accept(*this);
+}
+
+void ConstantFolder::visit(ast::Funcs &node) {
+    _foldAll(node.funcs);
+}
@@ -0,0 +1,78 @@
+#ifndef CONSTFOLD_HPP
+#define CONSTFOLD_HPP
+
+#include <memory>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* ConstantFolder class
+ * Replaces constant BinOp, RelOp, Cast, Not, And and Or subtrees with a single literal, in place.
+ * Runs on a checked tree, since the computed types decide between int and byte arithmetic.
+ * Division by a constant zero is left as is and reported through divisionsByZero().
+ */
+class ConstantFolder : public Visitor {
+private:
+    // Literal that replaces the expression just visited, if it turned out to be constant
+    std::shared_ptr<ast::Exp> result;
+    std::vector<int> zeroDivisions;
+    int foldedCount;
+
+    void _fold(std::shared_ptr<ast::Exp> &exp);
+    template<typename T>
+    void _foldAll(std::vector<std::shared_ptr<T>> &nodes);
+
+    std::shared_ptr<ast::Exp> _number(int value, ast::BuiltInType type, int line);
+    std::shared_ptr<ast::Exp> _bool(bool value, int line);
+
+public:
+    ConstantFolder();
+
+    // FanC semantics: int arithmetic wraps around at 32 bits, byte arithmetic at 8 bits and
+    // divides unsigned. `type` is the type of the result. Division by zero is not defined.
+    static int evalBinOp(ast::BinOpType op, int left, int right, ast::BuiltInType type);
+    static bool evalRelOp(ast::RelOpType op, int left, int right);
+    static int evalCast(int value, ast::BuiltInType to);
+
+    // If the expression is an int, byte or bool literal, stores its value and returns true
+    static bool literalValue(const ast::Exp &exp, int &value);
+
+    // Lines of divisions by a constant zero that were left in the tree
+    const std::vector<int> &divisionsByZero() const { return zeroDivisions; }
+
+    // Number of expressions replaced by a literal
+    int folded() const { return foldedCount; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif //CONSTFOLD_HPP
@@ -0,0 +1,362 @@
+#include "dataflow.hpp"
+#include "walker.hpp"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <set>
+
+/* SparseBitSet class implementation */
+
+SparseBitSet::SparseBitSet(std::vector<int> items) {
+    std::sort(items.begin(), items.end());
+    for (int item : items) {
+        if (words.empty() || words.back().index != item / 64) {
+            words.push_back({item / 64, 0});
+        }
+        words.back().bits |= uint64_t(1) << (item % 64);
+    }
+}
+
+void SparseBitSet::unionWith(const SparseBitSet &other) {
+    if (other.words.empty()) {
+        return;
+    }
+    std::vector<Word> merged;
+    merged.reserve(words.size() + other.words.size());
+    auto a = words.cbegin();
+    auto b = other.words.cbegin();
+    while (a != words.cend() || b != other.words.cend()) {
+        if (b == other.words.cend() || (a != words.cend() && a->index < b->index)) {
+            merged.push_back(*a++);
+        } else if (a == words.cend() || b->index < a->index) {
+            merged.push_back(*b++);
+        } else {
+            merged.push_back({a->index, a->bits | b->bits});
+            ++a;
+            ++b;
+        }
+    }
+    words = std::move(merged);
+}
+
+void SparseBitSet::transfer(const SparseBitSet &gen, const SparseBitSet &kill) {
+    std::vector<Word> result;
+    result.reserve(words.size() + gen.words.size());
+    auto value = words.cbegin();
+    auto g = gen.words.cbegin();
+    auto k = kill.words.cbegin();
+    while (value != words.cend() || g != gen.words.cend()) {
+        int index = g == gen.words.cend() || (value != words.cend() && value->index < g->index) ? value->index : g->index;
+        uint64_t bits = 0;
+        if (value != words.cend() && value->index == index) {
+            bits = (value++)->bits;
+            while (k != kill.words.end() && k->index < index) {
+                ++k;
+            }
+            if (k != kill.words.end() && k->index == index) {
+                bits &= ~k->bits;
+            }
+        }
+        if (g != gen.words.end() && g->index == index) {
+            bits |= (g++)->bits;
+        }
+        if (bits) {
+            result.push_back({index, bits});
+        }
+    }
+    words = std::move(result);
+}
+
+/* Solver */
+
+DataflowResult solveDataflow(const ControlFlowGraph &cfg, const DataflowProblem &problem) {
+    size_t count = cfg.blocks.size();
+    std::vector<int> order = cfg.reversePostorder();
+    if (!problem.forward) {
+        std::reverse(order.begin(), order.end());
+    }
+
+    // position of every block in `order`, -1 if unreachable
+    std::vector<int> position(count, -1);
+    for (size_t i = 0; i < order.size(); ++i) {
+        position[order[i]] = static_cast<int>(i);
+    }
+
+    DataflowResult result;
+    result.in.assign(count, SparseBitSet());
+    result.out.assign(count, SparseBitSet());
+    // for backward problems the meet happens at the end of a block and the transfer produces
+    // its start
+    std::vector<SparseBitSet> &meets = problem.forward ? result.in : result.out;
+    std::vector<SparseBitSet> &values = problem.forward ? result.out : result.in;
+    int boundaryBlock = problem.forward ? cfg.entry : cfg.exit;
+
+    // positions of the queued blocks, earliest first
+    std::priority_queue<int, std::vector<int>, std::greater<int>> worklist;
+    std::vector<char> queued(order.size(), 1);
+    for (size_t i = 0; i < order.size(); ++i) {
+        worklist.push(static_cast<int>(i));
+    }
+
+    while (!worklist.empty()) {
+        int block = order[worklist.top()];
+        queued[worklist.top()] = 0;
+        worklist.pop();
+
+        SparseBitSet meet;
+        if (block == boundaryBlock) {
+            meet = problem.boundary;
+        } else {
+            const auto &sources = problem.forward ? cfg.blocks[block].preds : cfg.blocks[block].succs;
+            for (int source : sources) {
+                if (position[source] >= 0) {
+                    meet.unionWith(values[source]);
+                }
+            }
+        }
+
+        SparseBitSet value = meet;
+        value.transfer(problem.gen[block], problem.kill[block]);
+        meets[block] = std::move(meet);
+        if (value == values[block]) {
+            continue;
+        }
+        values[block] = std::move(value);
+
+        const auto &targets = problem.forward ? cfg.blocks[block].succs : cfg.blocks[block].preds;
+        for (int target : targets) {
+            int at = position[target];
+            if (at >= 0 && !queued[at]) {
+                queued[at] = 1;
+                worklist.push(at);
+            }
+        }
+    }
+    return result;
+}
+
+/* Flow analyses */
+
+namespace {
+    // Scalar variables an expression reads
+    class UseCollector : public TreeWalker {
+    public:
+        std::vector<ast::ID *> uses;
+
+        using TreeWalker::visit;
+
+        void visit(ast::ID &node) override {
+            if (!node.computedIsArray) {
+                uses.push_back(&node);
+            }
+        }
+
+        void visit(ast::Call &node) override {
+            node.args->accept(*this);
+        }
+
+        void visit(ast::ArrayDereference &node) override {
+            node.index->accept(*this);
+        }
+    };
+
+    // What one block item does to the scalar variables
+    struct ItemEffect {
+        std::vector<ast::ID *> uses;
+        // Variable assigned after the uses, if any
+        ast::ID *def = nullptr;
+        // Variable declared without an initial value
+        ast::ID *declared = nullptr;
+    };
+}
+
+static ItemEffect effectOf(ast::Node *item) {
+    ItemEffect effect;
+    UseCollector collector;
+
+    if (auto varDecl = dynamic_cast<ast::VarDecl *>(item)) {
+        if (varDecl->type->computedIsArray) {
+            return effect;
+        }
+        if (varDecl->init_exp) {
+            varDecl->init_exp->accept(collector);
+            effect.def = varDecl->id.get();
+        } else {
+            effect.declared = varDecl->id.get();
+        }
+    } else if (auto assign = dynamic_cast<ast::Assign *>(item)) {
+        assign->exp->accept(collector);
+        effect.def = assign->id.get();
+    } else if (auto arrayAssign = dynamic_cast<ast::ArrayAssign *>(item)) {
+        arrayAssign->index->accept(collector);
+        arrayAssign->exp->accept(collector);
+    } else if (auto ret = dynamic_cast<ast::Return *>(item)) {
+        if (ret->exp) {
+            ret->exp->accept(collector);
+        }
+    } else {
+        // a call statement or a branch condition
+        item->accept(collector);
+    }
+
+    effect.uses = std::move(collector.uses);
+    return effect;
+}
+
+std::vector<FlowWarning> analyzeFlow(ast::FuncDecl &func) {
+    std::vector<FlowWarning> warnings;
+    ControlFlowGraph cfg(func);
+    std::vector<bool> reachable = cfg.reachable();
+
+    // parameters have negative offsets, so slots are shifted by the parameter count
+    int params = static_cast<int>(func.formals->formals.size());
+    size_t width = params + func.computedFrameSize;
+    auto slot = [params](const ast::ID *id) { return static_cast<size_t>(id->computedOffset + params); };
+
+    std::vector<std::vector<ItemEffect>> effects(cfg.blocks.size());
+    for (size_t block = 0; block < cfg.blocks.size(); ++block) {
+        if (!reachable[block]) continue;
+        for (auto item : cfg.blocks[block].items) {
+            effects[block].push_back(effectOf(item));
+        }
+    }
+
+    if (func.return_type->computedType != ast::BuiltInType::VOID && reachable[cfg.fallthrough]) {
+        warnings.push_back({func.id->line, "function " + func.id->value + " may end without returning a value"});
+    }
+
+    // Per-slot scratch state for walking one block, and the slots it touched, to reset it after
+    std::vector<char> state(width, 0);
+    std::vector<size_t> touched;
+    auto touch = [&](size_t at, char value) {
+        if (!state[at]) {
+            touched.push_back(at);
+        }
+        state[at] = value;
+    };
+    auto resetTouched = [&]() {
+        for (size_t at : touched) {
+            state[at] = 0;
+        }
+        touched.clear();
+    };
+
+    // Only variables read in some block before that block writes them carry facts from block to
+    // block; they are numbered densely, the others map to -1
+    enum { WRITTEN = 1 };
+    std::vector<int> number(width, -1);
+    std::vector<size_t> slotOf;
+    for (size_t block = 0; block < cfg.blocks.size(); ++block) {
+        for (const auto &effect : effects[block]) {
+            for (auto use : effect.uses) {
+                if (!state[slot(use)] && number[slot(use)] < 0) {
+                    number[slot(use)] = static_cast<int>(slotOf.size());
+                    slotOf.push_back(slot(use));
+                }
+            }
+            ast::ID *written = effect.def ? effect.def : effect.declared;
+            if (written) {
+                touch(slot(written), WRITTEN);
+            }
+        }
+        resetTouched();
+    }
+
+    // Variables that may be unassigned, the complement of definite assignment: forward, may.
+    // Parameters are assigned on entry, and every path to a local passes its declaration.
+    enum { ASSIGNED = 1, UNASSIGNED = 2 };
+    DataflowProblem unassigned;
+    unassigned.forward = true;
+    unassigned.gen.resize(cfg.blocks.size());
+    unassigned.kill.resize(cfg.blocks.size());
+    for (size_t block = 0; block < cfg.blocks.size(); ++block) {
+        for (const auto &effect : effects[block]) {
+            if (effect.def && number[slot(effect.def)] >= 0) {
+                touch(slot(effect.def), ASSIGNED);
+            } else if (effect.declared && number[slot(effect.declared)] >= 0) {
+                touch(slot(effect.declared), UNASSIGNED);
+            }
+        }
+        std::vector<int> gen, kill;
+        for (size_t at : touched) {
+            kill.push_back(number[at]);
+            if (state[at] == UNASSIGNED) {
+                gen.push_back(number[at]);
+            }
+        }
+        unassigned.gen[block] = SparseBitSet(std::move(gen));
+        unassigned.kill[block] = SparseBitSet(std::move(kill));
+        resetTouched();
+    }
+    DataflowResult unassignedResult = solveDataflow(cfg, unassigned);
+
+    std::set<std::pair<int, size_t>> reported;
+    for (size_t block = 0; block < cfg.blocks.size(); ++block) {
+        if (!reachable[block]) continue;
+        unassignedResult.in[block].forEach([&](int variable) { touch(slotOf[variable], UNASSIGNED); });
+        for (const auto &effect : effects[block]) {
+            for (auto use : effect.uses) {
+                if (state[slot(use)] == UNASSIGNED && reported.insert({use->line, slot(use)}).second) {
+                    warnings.push_back({use->line, "variable " + use->value + " may be used uninitialized"});
+                }
+            }
+            if (effect.def) {
+                touch(slot(effect.def), ASSIGNED);
+            } else if (effect.declared) {
+                touch(slot(effect.declared), UNASSIGNED);
+            }
+        }
+        resetTouched();
+    }
+
+    // Live variables: backward, may
+    enum { LIVE = 1, DEAD = 2 };
+    DataflowProblem live;
+    live.forward = false;
+    live.gen.resize(cfg.blocks.size());
+    live.kill.resize(cfg.blocks.size());
+    for (size_t block = 0; block < cfg.blocks.size(); ++block) {
+        std::vector<int> gen, kill;
+        for (const auto &effect : effects[block]) {
+            for (auto use : effect.uses) {
+                if (!state[slot(use)]) {
+                    gen.push_back(number[slot(use)]);
+                }
+            }
+            ast::ID *written = effect.def ? effect.def : effect.declared;
+            if (written) {
+                touch(slot(written), WRITTEN);
+                if (number[slot(written)] >= 0) {
+                    kill.push_back(number[slot(written)]);
+                }
+            }
+        }
+        live.gen[block] = SparseBitSet(std::move(gen));
+        live.kill[block] = SparseBitSet(std::move(kill));
+        resetTouched();
+    }
+    DataflowResult liveResult = solveDataflow(cfg, live);
+
+    for (size_t block = 0; block < cfg.blocks.size(); ++block) {
+        if (!reachable[block]) continue;
+        liveResult.out[block].forEach([&](int variable) { touch(slotOf[variable], LIVE); });
+        for (auto it = effects[block].rbegin(); it != effects[block].rend(); ++it) {
+            if (it->def && state[slot(it->def)] != LIVE) {
+                warnings.push_back({it->def->line, "value assigned to " + it->def->value + " is never used"});
+            }
+            ast::ID *written = it->def ? it->def : it->declared;
+            if (written) {
+                touch(slot(written), DEAD);
+            }
+            for (auto use : it->uses) {
+                touch(slot(use), LIVE);
+            }
+        }
+        resetTouched();
+    }
+
+    std::stable_sort(warnings.begin(), warnings.end(), [](const FlowWarning &a, const FlowWarning &b) {
+        return a.line < b.line;
+    });
+    return warnings;
+}
@@ -0,0 +1,83 @@
+#ifndef DATAFLOW_HPP
+#define DATAFLOW_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "nodes.hpp"
+#include "cfg.hpp"
+
+/* SparseBitSet class
+ * Set of variable numbers as a sorted list of the 64-bit words that have a bit set. Flow facts
+ * hold for few variables at any one point of a function, and variables live at the same time
+ * tend to have close numbers, so a set costs about the words its variables fall in rather than
+ * all of the function's variables.
+ */
+class SparseBitSet {
+private:
+    struct Word {
+        int index;
+        uint64_t bits;
+
+        bool operator==(const Word &other) const { return index == other.index && bits == other.bits; }
+    };
+
+    std::vector<Word> words;
+
+public:
+    SparseBitSet() = default;
+    // Takes numbers in any order, with repeats
+    explicit SparseBitSet(std::vector<int> items);
+
+    // Calls f on every number of the set, in increasing order
+    template<typename F>
+    void forEach(F f) const {
+        for (const Word &word : words) {
+            for (uint64_t bits = word.bits; bits; bits &= bits - 1) {
+                f(word.index * 64 + __builtin_ctzll(bits));
+            }
+        }
+    }
+
+    void unionWith(const SparseBitSet &other);
+    // this = gen | (this & ~kill)
+    void transfer(const SparseBitSet &gen, const SparseBitSet &kill);
+
+    bool operator==(const SparseBitSet &other) const { return words == other.words; }
+    bool operator!=(const SparseBitSet &other) const { return !(words == other.words); }
+};
+
+/* Gen/kill dataflow problem over the blocks of a ControlFlowGraph
+ * The meet is union; a must problem is solved as the may problem of its complement.
+ */
+struct DataflowProblem {
+    bool forward = true;
+    std::vector<SparseBitSet> gen;
+    std::vector<SparseBitSet> kill;
+    // Value flowing into the entry (forward) or out of the exit (backward)
+    SparseBitSet boundary;
+};
+
+struct DataflowResult {
+    // Values at the start and at the end of every block, in execution order
+    std::vector<SparseBitSet> in;
+    std::vector<SparseBitSet> out;
+};
+
+// Solves the problem over the reachable blocks with a worklist, taking blocks in reverse
+// postorder (postorder for backward problems). A block is queued again only when the value
+// flowing into it changed.
+DataflowResult solveDataflow(const ControlFlowGraph &cfg, const DataflowProblem &problem);
+
+struct FlowWarning {
+    int line;
+    std::string message;
+};
+
+// Runs the flow analyses on a checked function: missing return in a non-void function, use of
+// a variable that may be uninitialized, and stores that are never read. Only the variables some
+// block reads before writing them are tracked across blocks; the others are settled within the
+// block. Warnings are sorted by line.
+std::vector<FlowWarning> analyzeFlow(ast::FuncDecl &func);
+
+#endif //DATAFLOW_HPP
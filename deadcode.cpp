@@ -0,0 +1,208 @@
+#include "deadcode.hpp"
+#include "walker.hpp"
+#include <unordered_map>
+#include <unordered_set>
+
+static bool literalCondition(const ast::Exp &exp, bool &value) {
+    auto boolean = dynamic_cast<const ast::Bool *>(&exp);
+    if (boolean) {
+        value = boolean->value;
+    }
+    return boolean != nullptr;
+}
+
+DeadCodeEliminator::DeadCodeEliminator() : remove(false), completes(true), removedStatements(0) {}
+
+/* Helpers */
+
+bool DeadCodeEliminator::_prune(std::shared_ptr<ast::Statement> &statement) {
+    replacement = nullptr;
+    remove = false;
+    completes = true;
+    statement->accept(*this);
+    if (remove) {
+        removedStatements++;
+    } else if (replacement) {
+        statement = replacement;
+    }
+    bool keep = !remove;
+    replacement = nullptr;
+    remove = false;
+    return keep;
+}
+
+std::shared_ptr<ast::Statement> DeadCodeEliminator::_emptyBlock() {
+    return std::make_shared<ast::Block>(std::make_shared<ast::Statements>());
+}
+
+/* Expressions: nothing to prune */
+
+void DeadCodeEliminator::visit(ast::Num &node) {}
+
+void DeadCodeEliminator::visit(ast::NumB &node) {}
+
+void DeadCodeEliminator::visit(ast::String &node) {}
+
+void DeadCodeEliminator::visit(ast::Bool &node) {}
+
+void DeadCodeEliminator::visit(ast::ID &node) {}
+
+void DeadCodeEliminator::visit(ast::BinOp &node) {}
+
+void DeadCodeEliminator::visit(ast::RelOp &node) {}
+
+void DeadCodeEliminator::visit(ast::Not &node) {}
+
+void DeadCodeEliminator::visit(ast::And &node) {}
+
+void DeadCodeEliminator::visit(ast::Or &node) {}
+
+void DeadCodeEliminator::visit(ast::Cast &node) {}
+
+void DeadCodeEliminator::visit(ast::ArrayDereference &node) {}
+
+void DeadCodeEliminator::visit(ast::ExpList &node) {}
+
+void DeadCodeEliminator::visit(ast::Call &node) {}
+
+/* Types */
+
+void DeadCodeEliminator::visit(ast::ArrayType &node) {}
+
+void DeadCodeEliminator::visit(ast::PrimitiveType &node) {}
+
+/* Statements */
+
+void DeadCodeEliminator::visit(ast::ArrayAssign &node) {}
+
+void DeadCodeEliminator::visit(ast::Statements &node) {
+    std::vector<std::shared_ptr<ast::Statement>> live;
+    bool reachable = true;
+
+    for (auto &statement : node.statements) {
+        if (!reachable) {
+            removedStatements++;
+            continue;
+        }
+        if (_prune(statement)) {
+            live.push_back(statement);
+        }
+        reachable = completes;
+    }
+
+    node.statements = std::move(live);
+    completes = reachable;
+}
+
+void DeadCodeEliminator::visit(ast::Block &node) {
+    node.statements->accept(*this);
+}
+
+void DeadCodeEliminator::visit(ast::Break &node) {
+    loopBreaks.back() = true;
+    completes = false;
+}
+
+void DeadCodeEliminator::visit(ast::Continue &node) {
+    completes = false;
+}
+
+void DeadCodeEliminator::visit(ast::Return &node) {
+    completes = false;
+}
+
+void DeadCodeEliminator::visit(ast::If &node) {
+    bool value;
+    if (literalCondition(*node.condition, value)) {
+        // keep the branch that is taken, in a Block of its own since it had its own scope
+        std::shared_ptr<ast::Statement> taken = value ? node.then : node.otherwise;
+        if (!taken || !_prune(taken)) {
+            completes = true;
+            remove = true;
+            return;
+        }
+        bool takenCompletes = completes;
+        replacement = std::make_shared<ast::Block>(std::make_shared<ast::Statements>(taken));
+        completes = takenCompletes;
+        return;
+    }
+
+    if (!_prune(node.then)) {
+        node.then = _emptyBlock();
+    }
+    bool thenCompletes = completes;
+    bool otherwiseCompletes = true;
+    if (node.otherwise) {
+        if (!_prune(node.otherwise)) {
+            node.otherwise = nullptr;
+        }
+        otherwiseCompletes = completes;
+    }
+    completes = thenCompletes || otherwiseCompletes;
+}
+
+void DeadCodeEliminator::visit(ast::While &node) {
+    bool value;
+    bool constant = literalCondition(*node.condition, value);
+    if (constant && !value) {
+        completes = true;
+        remove = true;
+        return;
+    }
+
+    loopBreaks.push_back(false);
+    if (!_prune(node.body)) {
+        node.body = _emptyBlock();
+    }
+    bool broke = loopBreaks.back();
+    loopBreaks.pop_back();
+
+    // only an infinite loop without a break never gets to the next statement
+    completes = !constant || broke;
+}
+
+void DeadCodeEliminator::visit(ast::VarDecl &node) {}
+
+void DeadCodeEliminator::visit(ast::Assign &node) {}
+
+void DeadCodeEliminator::visit(ast::Formal &node) {}
+
+void DeadCodeEliminator::visit(ast::Formals &node) {}
+
+void DeadCodeEliminator::visit(ast::FuncDecl &node) {
+    loopBreaks.clear();
+    node.body->accept(*this);
+}
+
+void DeadCodeEliminator::visit(ast::Funcs &node) {
+    // prune the bodies first, so calls made only from dead code do not keep a function alive
+    std::unordered_map<std::string, std::vector<std::string>> callees;
+    for (auto &func : node.funcs) {
+        func->accept(*this);
+        CallCollector collector;
+        func->body->accept(collector);
+        callees[func->id->value] = std::move(collector.callees);
+    }
+
+    std::unordered_set<std::string> called = {"main"};
+    std::vector<std::string> worklist = {"main"};
+    while (!worklist.empty()) {
+        std::string name = worklist.back();
+        worklist.pop_back();
+        for (const auto &callee : callees[name]) {
+            if (called.insert(callee).second) {
+                worklist.push_back(callee);
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<ast::FuncDecl>> live;
+    for (auto &func : node.funcs) {
+        if (called.count(func->id->value)) {
+            live.push_back(func);
+        } else {
+            removedFunctions.push_back(func->id->value);
+        }
+    }
+    node.funcs = std::move(live);
+}
@@ -0,0 +1,74 @@
+#ifndef DEADCODE_HPP
+#define DEADCODE_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* DeadCodeEliminator class
+ * Prunes a checked tree: statements that follow a Return, Break or Continue (or anything else
+ * that cannot complete normally), branches and loops whose condition is a boolean literal, and
+ * functions that cannot be reached from main through calls. Runs after the semantic analysis, so
+ * every diagnostic is still reported for the whole program; the scopes printed are not affected.
+ */
+class DeadCodeEliminator : public Visitor {
+private:
+    // Statement that replaces the one just visited, or nullptr to keep it
+    std::shared_ptr<ast::Statement> replacement;
+    // The statement just visited is removed altogether
+    bool remove;
+    // The statement just visited can complete normally
+    bool completes;
+    // Innermost loop last: whether a reachable Break leaves it
+    std::vector<bool> loopBreaks;
+    int removedStatements;
+    std::vector<std::string> removedFunctions;
+
+    // Prunes a statement in place, returns false if it should be dropped
+    bool _prune(std::shared_ptr<ast::Statement> &statement);
+    std::shared_ptr<ast::Statement> _emptyBlock();
+
+public:
+    DeadCodeEliminator();
+
+    // Number of statements removed, not counting the ones nested in them
+    int statementsRemoved() const { return removedStatements; }
+
+    // Names of the functions removed, in source order
+    const std::vector<std::string> &functionsRemoved() const { return removedFunctions; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif //DEADCODE_HPP
@@ -0,0 +1,173 @@
+#include "driver.hpp"
+#include "output.hpp"
+#include "semanticvisitor.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include <sstream>
+#include <mutex>
+#include <cstdio>
+
+static std::mutex parserLock;
+
+std::shared_ptr<ast::Node> parseBufferLocked(std::string &source) {
+    std::lock_guard<std::mutex> guard(parserLock);
+    STATS_PHASE(PARSE);
+    trace::Span span("parse", "phase");
+    return parseBuffer(source);
+}
+
+std::string checkSource(std::string source, FunctionCache *cache) {
+    std::shared_ptr<ast::Node> root;
+    std::ostringstream out;
+    try {
+        root = parseBufferLocked(source);
+        STATS_COUNT_NODES(*root);
+        SemanticVisitor semanticVisitor;
+        semanticVisitor.setFunctionCache(cache);
+        {
+            STATS_PHASE(SEMANTIC);
+            trace::Span span("semantic", "phase");
+            root->accept(semanticVisitor);
+        }
+        STATS_PHASE(OUTPUT);
+        trace::Span span("output", "phase");
+        semanticVisitor.printScopes(out);
+    } catch (const output::CompileError &error) {
+        STATS_PHASE(OUTPUT);
+        trace::Span span("output", "phase");
+        out << error.message;
+    }
+    return out.str();
+}
+
+namespace {
+    // Writes stream output into a temporary file
+    class SpoolBuf : public std::streambuf {
+    private:
+        FILE *file;
+
+    protected:
+        int_type overflow(int_type c) override {
+            return (c == traits_type::eof() || fputc(c, file) != EOF) ? traits_type::not_eof(c) : traits_type::eof();
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize n) override {
+            return fwrite(s, 1, n, file);
+        }
+
+    public:
+        explicit SpoolBuf(FILE *file) : file(file) {}
+    };
+
+    // Hands functions to funcDeclHandler for the duration of one parse
+    class HandlerScope {
+    public:
+        explicit HandlerScope(std::function<void(std::shared_ptr<ast::FuncDecl>)> handler) {
+            funcDeclHandler = std::move(handler);
+        }
+
+        ~HandlerScope() {
+            funcDeclHandler = nullptr;
+        }
+    };
+}
+
+// Copies the rest of a file into a new temporary file, positioned at its start
+static FILE *copyToTemporary(FILE *source) {
+    FILE *copy = std::tmpfile();
+    if (!copy) {
+        return nullptr;
+    }
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), source)) > 0) {
+        if (fwrite(chunk, 1, n, copy) != n) {
+            fclose(copy);
+            return nullptr;
+        }
+    }
+    rewind(copy);
+    return copy;
+}
+
+void streamCheckSource(FILE *source, std::ostream &out) {
+    std::lock_guard<std::mutex> guard(parserLock);
+
+    // both passes read the program from `start`
+    FILE *input = source;
+    long start = ftell(source);
+    if (start < 0 || fseek(source, start, SEEK_SET) != 0) {
+        input = copyToTemporary(source);
+        start = 0;
+    }
+    // without a temporary file, the text of a pipe has to stay in memory
+    std::string text;
+    if (!input) {
+        char chunk[65536];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), source)) > 0) {
+            text.append(chunk, n);
+        }
+    }
+    auto parse = [&]() {
+        if (!input) {
+            parseSource(text);
+        } else if (fseek(input, start, SEEK_SET) == 0) {
+            parseFile(input);
+        }
+    };
+
+    // scope lines go to a temporary file, or stay in memory if none can be created
+    FILE *spool = std::tmpfile();
+    SpoolBuf spoolBuf(spool);
+    std::stringstream memorySpool;
+    std::ostream fileSpool(&spoolBuf);
+    std::ostream &spoolStream = spool ? fileSpool : memorySpool;
+
+    try {
+        // signatures only: the bodies are dropped as soon as each function is parsed. This also
+        // reports any lexical or syntax error, which must win over semantic errors.
+        auto signatures = std::make_shared<ast::Funcs>();
+        {
+            HandlerScope handler([&](std::shared_ptr<ast::FuncDecl> func) {
+                func->body = nullptr;
+                signatures->push_back(func);
+            });
+            parse();
+        }
+
+        SemanticVisitor semanticVisitor;
+        semanticVisitor.declareFunctions(*signatures);
+        signatures = nullptr;
+
+        {
+            HandlerScope handler([&](std::shared_ptr<ast::FuncDecl> func) {
+                semanticVisitor.checkFunction(*func);
+                semanticVisitor.symbols().drainScopes(spoolStream);
+            });
+            parse();
+        }
+
+        semanticVisitor.symbols().printHead(out);
+        if (spool) {
+            rewind(spool);
+            char chunk[65536];
+            size_t n;
+            while ((n = fread(chunk, 1, sizeof(chunk), spool)) > 0) {
+                out.write(chunk, n);
+            }
+        } else {
+            out << memorySpool.str();
+        }
+        semanticVisitor.symbols().printTail(out);
+    } catch (const output::CompileError &error) {
+        out << error.message;
+    }
+
+    if (spool) {
+        fclose(spool);
+    }
+    if (input && input != source) {
+        fclose(input);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef DRIVER_HPP
+#define DRIVER_HPP
+
+#include <cstdio>
+#include <string>
+#include <memory>
+#include <functional>
+#include <ostream>
+#include "nodes.hpp"
+#include "funccache.hpp"
+
+// Parses a program held in memory instead of stdin, from a copy of it. Defined in scanner.lex,
+// next to the flex buffer functions it uses. The scanner and parser keep global state, so calls
+// must not overlap.
+std::shared_ptr<ast::Node> parseSource(const char *source, size_t size);
+std::shared_ptr<ast::Node> parseSource(const std::string &source);
+// Parses a program held in a string the caller is done with, without copying it: two NUL bytes
+// are appended and the scanner reads the text in place, overwriting some of it as it goes.
+std::shared_ptr<ast::Node> parseBuffer(std::string &source);
+// Parses a program read from an open file, from its current position. The scanner reads it a
+// block at a time, so the text is never held in memory whole.
+std::shared_ptr<ast::Node> parseFile(FILE *file);
+
+// parseBuffer under the lock every function here parses with, so it may be called from
+// several threads
+std::shared_ptr<ast::Node> parseBufferLocked(std::string &source);
+
+// Set by the parser; when funcDeclHandler is set, functions are handed to it one by one as they
+// are parsed and `program` ends up holding none of them
+extern std::shared_ptr<ast::Node> program;
+extern std::function<void(std::shared_ptr<ast::FuncDecl>)> funcDeclHandler;
+
+// Parses and checks a whole program and returns exactly what hw3 prints for it: the scope dump,
+// or the first error. Safe to call from several threads; only parsing is serialized. The source
+// is taken by value and scanned in place, so a caller done with it can move it in.
+std::string checkSource(std::string source, FunctionCache *cache = nullptr);
+
+// Checks the program in a file like checkSource and writes the same output, but holds at most
+// one function in memory at a time. A first parse keeps only the signatures; a second one, from
+// the same position, checks each function as soon as it is parsed and frees it. A file that
+// cannot be seeked, like a pipe, is first copied to a temporary file. Scope lines are spooled
+// to a temporary file too, since an error in a later function means none of them may be
+// printed.
+void streamCheckSource(FILE *source, std::ostream &out);
+
+#endif //DRIVER_HPP
@@ -0,0 +1,424 @@
+#include "elfobject.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+
+using x86::Operand;
+
+// .bss layout: stack limit, bytes of output buffered, the output buffer
+static const size_t bssLimit = 0;
+static const size_t bssUsed = 8;
+static const size_t bssBuffer = 16;
+static const int32_t outputCapacity = 1 << 16;
+static const size_t bssSize = bssBuffer + outputCapacity;
+
+// Stack left below the limit for the runtime, and the most _start takes from RLIMIT_STACK
+static const int32_t stackReserve = 256 << 10;
+static const int32_t maxStack = 1 << 30;
+
+static const int sysWrite = 1;
+static const int sysGetrlimit = 97;
+static const int sysExitGroup = 231;
+static const int rlimitStack = 3;
+
+// Section header indices
+enum Section {
+    SEC_NULL,
+    SEC_TEXT,
+    SEC_RODATA,
+    SEC_BSS,
+    SEC_RELA_TEXT,
+    SEC_SYMTAB,
+    SEC_STRTAB,
+    SEC_SHSTRTAB,
+    SEC_NOTE_STACK,
+    SECTION_COUNT
+};
+
+/* ElfObject class implementation */
+
+ElfObject::ElfObject(const x86::NativeCode &code, const bytecode::Program &program) : text(code.text) {
+    // the functions, in the order they are laid out
+    std::vector<size_t> order(program.functions.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return code.functions[a] < code.functions[b];
+    });
+
+    size_t runtime[x86::RUNTIME_COUNT];
+    size_t start = 0;
+    size_t mainCall = 0;
+    _runtime(runtime, start, mainCall);
+    _link(code, runtime, mainCall);
+    // the runtime functions are laid out back to back, up to _start
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        size_t end = i + 1 < symbols.size() ? symbols[i + 1].offset : start;
+        symbols[i].size = end - symbols[i].offset;
+    }
+
+    symbols.push_back({"_start", start, text.size() - start, true});
+    for (size_t i = 0; i < order.size(); ++i) {
+        size_t offset = code.functions[order[i]];
+        size_t end = i + 1 < order.size() ? code.functions[order[i + 1]] : code.text.size();
+        symbols.push_back({program.functions[order[i]].name, offset, end - offset, true});
+    }
+
+    _write();
+}
+
+bool ElfObject::write(const char *path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+    return static_cast<bool>(file);
+}
+
+/* Runtime */
+
+void ElfObject::_runtime(size_t offsets[x86::RUNTIME_COUNT], size_t &start, size_t &mainCall) {
+    x86::Assembler as(text);
+    auto bss = [&](size_t field, size_t target) {
+        relocations.push_back({field, true, target});
+    };
+    while (as.size() % 16) {
+        as.byte(0xCC);
+    }
+
+    // flush(): writes out the buffered output; gives up on the first real write error
+    size_t flush = as.size();
+    symbols.push_back({"fanc_flush", flush, 0, false});
+    as.push(x86::RBX);
+    as.push(x86::R12);
+    bss(as.op({0x8D}, x86::RBX, Operand::ripRelative(), true), bssBuffer);
+    bss(as.op({0x8B}, x86::R12, Operand::ripRelative(), true), bssUsed);
+    size_t flushLoop = as.size();
+    as.op({0x85}, x86::R12, Operand::r(x86::R12), true);
+    size_t flushed = as.jcc(x86::CC_E);
+    as.movImm(x86::RAX, sysWrite);
+    as.movImm(x86::RDI, 1);
+    as.op({0x89}, x86::RBX, Operand::r(x86::RSI), true);
+    as.op({0x89}, x86::R12, Operand::r(x86::RDX), true);
+    as.syscall();
+    as.group1(7, Operand::r(x86::RAX), -EINTR, true);
+    as.patchRel32(as.jcc(x86::CC_E), flushLoop);
+    as.op({0x85}, x86::RAX, Operand::r(x86::RAX), true);
+    size_t failed = as.jcc(x86::CC_LE);
+    as.op({0x01}, x86::RAX, Operand::r(x86::RBX), true);
+    as.op({0x29}, x86::RAX, Operand::r(x86::R12), true);
+    as.patchRel32(as.jmp(), flushLoop);
+    as.patchRel32(flushed, as.size());
+    as.patchRel32(failed, as.size());
+    as.op({0x33}, x86::RAX, Operand::r(x86::RAX));
+    bss(as.op({0x89}, x86::RAX, Operand::ripRelative(), true), bssUsed);
+    as.pop(x86::R12);
+    as.pop(x86::RBX);
+    as.ret();
+
+    // putc(edi): buffers one byte
+    size_t putc = as.size();
+    symbols.push_back({"fanc_putc", putc, 0, false});
+    bss(as.op({0x8B}, x86::RAX, Operand::ripRelative(), true), bssUsed);
+    as.group1(7, Operand::r(x86::RAX), outputCapacity, true);
+    size_t room = as.jcc(x86::CC_B);
+    as.push(x86::RDI);
+    as.patchRel32(as.call(), flush);
+    as.pop(x86::RDI);
+    as.op({0x33}, x86::RAX, Operand::r(x86::RAX));
+    as.patchRel32(room, as.size());
+    bss(as.op({0x8D}, x86::RDX, Operand::ripRelative(), true), bssBuffer);
+    as.op({0x89}, x86::RDI, Operand::r(x86::RCX));
+    as.op({0x88}, x86::RCX, Operand::mem(x86::RDX, x86::RAX, 1, 0));
+    as.op({0xFF}, 0, Operand::r(x86::RAX), true);
+    bss(as.op({0x89}, x86::RAX, Operand::ripRelative(), true), bssUsed);
+    as.ret();
+
+    // write(rdi text, esi length): buffers the bytes; r13 is only saved to keep rsp aligned
+    size_t write = as.size();
+    symbols.push_back({"fanc_write", write, 0, false});
+    as.push(x86::RBX);
+    as.push(x86::R12);
+    as.push(x86::R13);
+    as.op({0x89}, x86::RDI, Operand::r(x86::RBX), true);
+    as.op({0x89}, x86::RSI, Operand::r(x86::R12));
+    size_t writeLoop = as.size();
+    as.op({0x85}, x86::R12, Operand::r(x86::R12));
+    size_t written = as.jcc(x86::CC_E);
+    as.op({0x0F, 0xB6}, x86::RDI, Operand::mem(x86::RBX, 0));
+    as.patchRel32(as.call(), putc);
+    as.op({0xFF}, 0, Operand::r(x86::RBX), true);
+    as.op({0xFF}, 1, Operand::r(x86::R12));
+    as.patchRel32(as.jmp(), writeLoop);
+    as.patchRel32(written, as.size());
+    as.pop(x86::R13);
+    as.pop(x86::R12);
+    as.pop(x86::RBX);
+    as.ret();
+
+    // print(rdi text, esi length)
+    offsets[x86::RT_PRINT] = as.size();
+    symbols.push_back({"fanc_print", as.size(), 0, false});
+    as.group1(5, Operand::r(x86::RSP), 8, true);
+    as.patchRel32(as.call(), write);
+    as.movImm(x86::RDI, '\n');
+    as.patchRel32(as.call(), putc);
+    as.group1(0, Operand::r(x86::RSP), 8, true);
+    as.ret();
+
+    // printi(edi): digits are produced backwards into a buffer on the stack
+    offsets[x86::RT_PRINTI] = as.size();
+    symbols.push_back({"fanc_printi", as.size(), 0, false});
+    as.push(x86::RBX);
+    as.group1(5, Operand::r(x86::RSP), 32, true);
+    as.op({0x8D}, x86::RBX, Operand::mem(x86::RSP, 32), true);
+    as.op({0xFF}, 1, Operand::r(x86::RBX), true);
+    as.op({0xC6}, 0, Operand::mem(x86::RBX, 0));
+    as.byte('\n');
+    as.op({0x89}, x86::RDI, Operand::r(x86::RAX));
+    as.op({0x89}, x86::RDI, Operand::r(x86::R8));
+    // the magnitude of INT_MIN only fits unsigned, which div handles
+    as.op({0x85}, x86::RAX, Operand::r(x86::RAX));
+    size_t positive = as.jcc(x86::CC_NS);
+    as.op({0xF7}, 3, Operand::r(x86::RAX));
+    as.patchRel32(positive, as.size());
+    as.movImm(x86::RCX, 10);
+    size_t digit = as.size();
+    as.op({0x33}, x86::RDX, Operand::r(x86::RDX));
+    as.op({0xF7}, 6, Operand::r(x86::RCX));
+    as.op({0x80}, 0, Operand::r(x86::RDX));
+    as.byte('0');
+    as.op({0xFF}, 1, Operand::r(x86::RBX), true);
+    as.op({0x88}, x86::RDX, Operand::mem(x86::RBX, 0));
+    as.op({0x85}, x86::RAX, Operand::r(x86::RAX));
+    as.patchRel32(as.jcc(x86::CC_NE), digit);
+    as.op({0x85}, x86::R8, Operand::r(x86::R8));
+    size_t nonNegative = as.jcc(x86::CC_NS);
+    as.op({0xFF}, 1, Operand::r(x86::RBX), true);
+    as.op({0xC6}, 0, Operand::mem(x86::RBX, 0));
+    as.byte('-');
+    as.patchRel32(nonNegative, as.size());
+    as.op({0x89}, x86::RBX, Operand::r(x86::RDI), true);
+    as.op({0x8D}, x86::RSI, Operand::mem(x86::RSP, 32), true);
+    as.op({0x29}, x86::RBX, Operand::r(x86::RSI), true);
+    as.patchRel32(as.call(), write);
+    as.group1(0, Operand::r(x86::RSP), 32, true);
+    as.pop(x86::RBX);
+    as.ret();
+
+    // trap(edi): prints the error line, flushes and exits with status 1
+    offsets[x86::RT_TRAP] = as.size();
+    symbols.push_back({"fanc_trap", as.size(), 0, false});
+    as.group1(4, Operand::r(x86::RSP), -16, true);
+    std::vector<size_t> printTrap;
+    for (int trap = 0; trap < x86::TRAP_COUNT; ++trap) {
+        size_t next = 0;
+        if (trap + 1 < x86::TRAP_COUNT) {
+            as.group1(7, Operand::r(x86::RDI), trap);
+            next = as.jcc(x86::CC_NE);
+        }
+        const char *message = x86::trapMessage(trap);
+        relocations.push_back({as.op({0x8D}, x86::RDI, Operand::ripRelative(), true), false, rodata.size()});
+        rodata.insert(rodata.end(), message, message + strlen(message));
+        as.movImm(x86::RSI, static_cast<int32_t>(strlen(message)));
+        printTrap.push_back(as.jmp());
+        if (next) {
+            as.patchRel32(next, as.size());
+        }
+    }
+    for (size_t field : printTrap) {
+        as.patchRel32(field, as.size());
+    }
+    as.patchRel32(as.call(), offsets[x86::RT_PRINT]);
+    as.patchRel32(as.call(), flush);
+    as.movImm(x86::RAX, sysExitGroup);
+    as.movImm(x86::RDI, 1);
+    as.syscall();
+
+    // _start: the stack limit leaves stackReserve of the stack rlimit unused; an unlimited
+    // stack is taken as maxStack
+    start = as.size();
+    as.group1(5, Operand::r(x86::RSP), 16, true);
+    as.op({0xC7}, 0, Operand::mem(x86::RSP, 0), true);
+    as.dword(8 << 20);
+    as.movImm(x86::RAX, sysGetrlimit);
+    as.movImm(x86::RDI, rlimitStack);
+    as.op({0x89}, x86::RSP, Operand::r(x86::RSI), true);
+    as.syscall();
+    as.op({0x8B}, x86::RAX, Operand::mem(x86::RSP, 0), true);
+    as.movImm(x86::RCX, maxStack);
+    as.op({0x3B}, x86::RAX, Operand::r(x86::RCX), true);
+    size_t limited = as.jcc(x86::CC_BE);
+    as.op({0x89}, x86::RCX, Operand::r(x86::RAX), true);
+    as.patchRel32(limited, as.size());
+    as.group1(5, Operand::r(x86::RAX), stackReserve, true);
+    as.op({0x8D}, x86::RCX, Operand::mem(x86::RSP, 16), true);
+    as.op({0x29}, x86::RAX, Operand::r(x86::RCX), true);
+    bss(as.op({0x89}, x86::RCX, Operand::ripRelative(), true), bssLimit);
+    as.group1(0, Operand::r(x86::RSP), 16, true);
+    // main is patched in by _link
+    mainCall = as.call();
+    as.patchRel32(as.call(), flush);
+    as.movImm(x86::RAX, sysExitGroup);
+    as.op({0x33}, x86::RDI, Operand::r(x86::RDI));
+    as.syscall();
+}
+
+void ElfObject::_link(const x86::NativeCode &code, const size_t runtime[x86::RUNTIME_COUNT], size_t mainCall) {
+    x86::Assembler as(text);
+    as.patchRel32(mainCall, code.functions[code.main]);
+
+    std::vector<size_t> strings;
+    for (const auto &literal : code.strings) {
+        strings.push_back(rodata.size());
+        rodata.insert(rodata.end(), literal.begin(), literal.end());
+    }
+
+    for (const auto &reference : code.references) {
+        switch (reference.kind) {
+            case x86::Reference::RUNTIME:
+                as.patchRel32(reference.offset, runtime[reference.index]);
+                break;
+            case x86::Reference::STRING:
+                relocations.push_back({reference.offset, false, strings[reference.index]});
+                break;
+            case x86::Reference::STACK_LIMIT:
+                relocations.push_back({reference.offset, true, bssLimit});
+                break;
+        }
+    }
+}
+
+/* Object file layout */
+
+template<typename T>
+static void append(std::vector<uint8_t> &out, const T &value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void align(std::vector<uint8_t> &out, size_t alignment) {
+    while (out.size() % alignment) {
+        out.push_back(0);
+    }
+}
+
+static uint32_t addName(std::vector<uint8_t> &table, const std::string &name) {
+    uint32_t offset = static_cast<uint32_t>(table.size());
+    table.insert(table.end(), name.begin(), name.end());
+    table.push_back(0);
+    return offset;
+}
+
+void ElfObject::_write() {
+    std::vector<Elf64_Shdr> sections(SECTION_COUNT);
+    std::vector<uint8_t> shstrtab(1, 0);
+    std::vector<uint8_t> strtab(1, 0);
+    const char *names[SECTION_COUNT] = {
+            "", ".text", ".rodata", ".bss", ".rela.text", ".symtab", ".strtab", ".shstrtab", ".note.GNU-stack"
+    };
+    for (int section = SEC_TEXT; section < SECTION_COUNT; ++section) {
+        sections[section].sh_name = addName(shstrtab, names[section]);
+    }
+
+    // symbol table: null, one per section relocations refer to, local runtime functions, then
+    // the globals
+    std::vector<Elf64_Sym> symtab(1);
+    for (int section : {SEC_TEXT, SEC_RODATA, SEC_BSS}) {
+        Elf64_Sym symbol{};
+        symbol.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+        symbol.st_shndx = static_cast<Elf64_Section>(section);
+        symtab.push_back(symbol);
+    }
+    std::stable_partition(symbols.begin(), symbols.end(), [](const Symbol &symbol) {
+        return !symbol.global;
+    });
+    size_t firstGlobal = 0;
+    for (const auto &entry : symbols) {
+        if (entry.global && !firstGlobal) {
+            firstGlobal = symtab.size();
+        }
+        Elf64_Sym symbol{};
+        symbol.st_name = addName(strtab, entry.name);
+        symbol.st_info = ELF64_ST_INFO(entry.global ? STB_GLOBAL : STB_LOCAL, STT_FUNC);
+        symbol.st_shndx = SEC_TEXT;
+        symbol.st_value = entry.offset;
+        symbol.st_size = entry.size;
+        symtab.push_back(symbol);
+    }
+
+    std::vector<Elf64_Rela> rela;
+    for (const auto &relocation : relocations) {
+        Elf64_Rela entry{};
+        entry.r_offset = relocation.field;
+        entry.r_info = ELF64_R_INFO(relocation.bss ? 3 : 2, R_X86_64_PC32);
+        // the field is the last thing in its instruction, and rip points past it
+        entry.r_addend = static_cast<Elf64_Sxword>(relocation.target) - 4;
+        rela.push_back(entry);
+    }
+
+    image.clear();
+    image.resize(sizeof(Elf64_Ehdr));
+    auto place = [&](int section, const void *data, size_t size, size_t alignment) {
+        align(image, alignment);
+        sections[section].sh_offset = image.size();
+        sections[section].sh_size = size;
+        sections[section].sh_addralign = alignment;
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        image.insert(image.end(), bytes, bytes + size);
+    };
+    place(SEC_TEXT, text.data(), text.size(), 16);
+    place(SEC_RODATA, rodata.data(), rodata.size(), 1);
+    place(SEC_RELA_TEXT, rela.data(), rela.size() * sizeof(Elf64_Rela), 8);
+    place(SEC_SYMTAB, symtab.data(), symtab.size() * sizeof(Elf64_Sym), 8);
+    place(SEC_STRTAB, strtab.data(), strtab.size(), 1);
+    place(SEC_SHSTRTAB, shstrtab.data(), shstrtab.size(), 1);
+
+    sections[SEC_TEXT].sh_type = SHT_PROGBITS;
+    sections[SEC_TEXT].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+    sections[SEC_RODATA].sh_type = SHT_PROGBITS;
+    sections[SEC_RODATA].sh_flags = SHF_ALLOC;
+    sections[SEC_BSS].sh_type = SHT_NOBITS;
+    sections[SEC_BSS].sh_flags = SHF_ALLOC | SHF_WRITE;
+    sections[SEC_BSS].sh_offset = image.size();
+    sections[SEC_BSS].sh_size = bssSize;
+    sections[SEC_BSS].sh_addralign = 16;
+    sections[SEC_RELA_TEXT].sh_type = SHT_RELA;
+    sections[SEC_RELA_TEXT].sh_flags = SHF_INFO_LINK;
+    sections[SEC_RELA_TEXT].sh_link = SEC_SYMTAB;
+    sections[SEC_RELA_TEXT].sh_info = SEC_TEXT;
+    sections[SEC_RELA_TEXT].sh_entsize = sizeof(Elf64_Rela);
+    sections[SEC_SYMTAB].sh_type = SHT_SYMTAB;
+    sections[SEC_SYMTAB].sh_link = SEC_STRTAB;
+    sections[SEC_SYMTAB].sh_info = static_cast<Elf64_Word>(firstGlobal ? firstGlobal : symtab.size());
+    sections[SEC_SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+    sections[SEC_STRTAB].sh_type = SHT_STRTAB;
+    sections[SEC_SHSTRTAB].sh_type = SHT_STRTAB;
+    // an empty .note.GNU-stack asks for a non-executable stack
+    sections[SEC_NOTE_STACK].sh_type = SHT_PROGBITS;
+    sections[SEC_NOTE_STACK].sh_offset = image.size();
+    sections[SEC_NOTE_STACK].sh_addralign = 1;
+
+    align(image, 8);
+    size_t sectionHeaders = image.size();
+    for (const auto &section : sections) {
+        append(image, section);
+    }
+
+    Elf64_Ehdr header{};
+    memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    header.e_type = ET_REL;
+    header.e_machine = EM_X86_64;
+    header.e_version = EV_CURRENT;
+    header.e_shoff = sectionHeaders;
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_shentsize = sizeof(Elf64_Shdr);
+    header.e_shnum = SECTION_COUNT;
+    header.e_shstrndx = SEC_SHSTRTAB;
+    memcpy(image.data(), &header, sizeof(header));
+}
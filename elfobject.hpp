@@ -0,0 +1,59 @@
+#ifndef ELFOBJECT_HPP
+#define ELFOBJECT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+#include "x86.hpp"
+
+/* ElfObject class
+ * Packs NativeCode into a relocatable x86-64 ELF object that the system linker turns into a
+ * standalone executable, with no assembler and no C library involved:
+ *
+ *     hw3 --emit-object prog.o < prog.fanc && ld -o prog prog.o && ./prog
+ *
+ * The object holds the program's functions, one global symbol each, a small runtime written
+ * directly in machine code (buffered output through the write system call, and the traps), and
+ * _start, which sets the stack limit from RLIMIT_STACK, calls main and exits. String literals go
+ * in .rodata and the output buffer and stack limit in .bss, reached through R_X86_64_PC32
+ * relocations.
+ */
+class ElfObject {
+private:
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> rodata;
+    // Symbols: local ones first, as ELF requires
+    struct Symbol {
+        std::string name;
+        size_t offset;
+        size_t size;
+        bool global;
+    };
+    std::vector<Symbol> symbols;
+    // rel32 fields in .text pointing into .rodata or .bss, plus the offset they point at
+    struct Relocation {
+        size_t field;
+        bool bss;
+        size_t target;
+    };
+    std::vector<Relocation> relocations;
+    std::vector<uint8_t> image;
+
+    // Lays out the runtime functions and _start after the program's code: returns their
+    // offsets, and the rel32 field of the call to main
+    void _runtime(size_t offsets[x86::RUNTIME_COUNT], size_t &start, size_t &mainCall);
+    // Resolves the code's references: calls into the runtime directly, data by relocation
+    void _link(const x86::NativeCode &code, const size_t runtime[x86::RUNTIME_COUNT], size_t mainCall);
+    void _write();
+
+public:
+    ElfObject(const x86::NativeCode &code, const bytecode::Program &program);
+
+    // The whole object file
+    const std::vector<uint8_t> &bytes() const { return image; }
+    bool write(const char *path) const;
+};
+
+#endif //ELFOBJECT_HPP
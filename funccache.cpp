@@ -0,0 +1,427 @@
+#include "funccache.hpp"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* FingerprintVisitor class implementation */
+
+FingerprintVisitor::FingerprintVisitor(int baseLine) : baseLine(baseLine) {}
+
+void FingerprintVisitor::_tag(char tag, const ast::Node &node) {
+    out += tag;
+    _int(node.line - baseLine);
+}
+
+void FingerprintVisitor::_int(long long value) {
+    out += std::to_string(value);
+    out += ';';
+}
+
+void FingerprintVisitor::_str(const std::string &value) {
+    // length prefixed, so no string can be confused with the structure around it
+    _int(value.size());
+    out += value;
+}
+
+void FingerprintVisitor::_name(const std::string &value) {
+    _str(value);
+    names.insert(value);
+}
+
+void FingerprintVisitor::visit(ast::Num &node) {
+    _tag('n', node);
+    _int(node.value);
+}
+
+void FingerprintVisitor::visit(ast::NumB &node) {
+    _tag('b', node);
+    _int(node.value);
+}
+
+void FingerprintVisitor::visit(ast::String &node) {
+    _tag('s', node);
+    _str(node.value());
+}
+
+void FingerprintVisitor::visit(ast::Bool &node) {
+    _tag('t', node);
+    _int(node.value);
+}
+
+void FingerprintVisitor::visit(ast::ID &node) {
+    _tag('i', node);
+    _name(node.value);
+}
+
+void FingerprintVisitor::visit(ast::BinOp &node) {
+    _tag('+', node);
+    _int(node.op);
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::RelOp &node) {
+    _tag('<', node);
+    _int(node.op);
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::Not &node) {
+    _tag('!', node);
+    node.exp->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::And &node) {
+    _tag('&', node);
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::Or &node) {
+    _tag('|', node);
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::ArrayType &node) {
+    _tag('A', node);
+    _int(node.type);
+    node.length->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::PrimitiveType &node) {
+    _tag('P', node);
+    _int(node.type);
+}
+
+void FingerprintVisitor::visit(ast::ArrayDereference &node) {
+    _tag('[', node);
+    node.id->accept(*this);
+    node.index->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::ArrayAssign &node) {
+    _tag(']', node);
+    node.id->accept(*this);
+    node.index->accept(*this);
+    node.exp->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::Cast &node) {
+    _tag('c', node);
+    node.target_type->accept(*this);
+    node.exp->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::ExpList &node) {
+    _tag('L', node);
+    _int(node.exps.size());
+    for (auto &exp : node.exps) {
+        exp->accept(*this);
+    }
+}
+
+void FingerprintVisitor::visit(ast::Call &node) {
+    _tag('C', node);
+    node.func_id->accept(*this);
+    node.args->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::Statements &node) {
+    _tag('S', node);
+    _int(node.statements.size());
+    for (auto &statement : node.statements) {
+        statement->accept(*this);
+    }
+}
+
+void FingerprintVisitor::visit(ast::Block &node) {
+    _tag('{', node);
+    node.statements->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::Break &node) {
+    _tag('B', node);
+}
+
+void FingerprintVisitor::visit(ast::Continue &node) {
+    _tag('K', node);
+}
+
+void FingerprintVisitor::visit(ast::Return &node) {
+    _tag('R', node);
+    _int(node.exp != nullptr);
+    if (node.exp) {
+        node.exp->accept(*this);
+    }
+}
+
+void FingerprintVisitor::visit(ast::If &node) {
+    _tag('?', node);
+    _int(node.otherwise != nullptr);
+    node.condition->accept(*this);
+    node.then->accept(*this);
+    if (node.otherwise) {
+        node.otherwise->accept(*this);
+    }
+}
+
+void FingerprintVisitor::visit(ast::While &node) {
+    _tag('W', node);
+    node.condition->accept(*this);
+    node.body->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::VarDecl &node) {
+    _tag('V', node);
+    _int(node.init_exp != nullptr);
+    node.id->accept(*this);
+    node.type->accept(*this);
+    if (node.init_exp) {
+        node.init_exp->accept(*this);
+    }
+}
+
+void FingerprintVisitor::visit(ast::Assign &node) {
+    _tag('=', node);
+    node.id->accept(*this);
+    node.exp->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::Formal &node) {
+    _tag('f', node);
+    node.id->accept(*this);
+    node.type->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::Formals &node) {
+    _tag('F', node);
+    _int(node.formals.size());
+    for (auto &formal : node.formals) {
+        formal->accept(*this);
+    }
+}
+
+void FingerprintVisitor::visit(ast::FuncDecl &node) {
+    // the declaration's own line may come from the next function's first token, skip it
+    out += 'D';
+    node.id->accept(*this);
+    node.return_type->accept(*this);
+    node.formals->accept(*this);
+    node.body->accept(*this);
+}
+
+void FingerprintVisitor::visit(ast::Funcs &node) {
+    for (auto &func : node.funcs) {
+        func->accept(*this);
+    }
+}
+
+/* FunctionCache class implementation */
+
+FunctionCache::FunctionCache(std::string dir, size_t capacity)
+    : dir(std::move(dir)), capacity(capacity), used(0), hits(0), misses(0) {
+    if (!this->dir.empty()) {
+        mkdir(this->dir.c_str(), 0755);
+    }
+}
+
+uint64_t FunctionCache::hash(const std::string &bytes) {
+    // 64-bit FNV-1a
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : bytes) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::string FunctionCache::keyFor(ast::FuncDecl &func, SymTable &globals) {
+    FingerprintVisitor fingerprint(func.id->line);
+    func.accept(fingerprint);
+
+    std::string key = "hw3fn1\n";
+    key += fingerprint.fingerprint();
+
+    // signatures of everything the body mentions; names that are not global are recorded too,
+    // since a function declared under that name later would change the result
+    for (const auto &name : fingerprint.referencedNames()) {
+        key += '\n';
+        key += name;
+        key += ' ';
+        Symbol *symbol = globals.lookup(name);
+        if (!symbol) {
+            key += '-';
+            continue;
+        }
+        key += symbol->isFunction ? 'f' : 'v';
+        key += output::toString(symbol->type);
+        for (auto type : symbol->paramTypes) {
+            key += ',';
+            key += output::toString(type);
+        }
+    }
+    return key;
+}
+
+std::string FunctionCache::_path(uint64_t hash) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.fn", (unsigned long long) hash);
+    return dir + "/" + name;
+}
+
+static bool readChunk(std::istream &in, std::string &chunk) {
+    size_t size;
+    if (!(in >> size) || in.get() != '\n') {
+        return false;
+    }
+    chunk.resize(size);
+    return static_cast<bool>(in.read(&chunk[0], size));
+}
+
+static void writeChunk(std::ostream &out, const std::string &chunk) {
+    out << chunk.size() << '\n';
+    out.write(chunk.data(), chunk.size());
+}
+
+bool FunctionCache::_load(uint64_t hash, const std::string &key, Entry &entry) const {
+    std::ifstream in(_path(hash), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    if (!readChunk(in, entry.key) || entry.key != key) {
+        return false; // a different function that happens to share the hash
+    }
+    if (!readChunk(in, entry.scopes)) {
+        return false;
+    }
+    int failed;
+    if (!(in >> failed >> entry.errorLine) || in.get() != ' ' || !readChunk(in, entry.errorText)) {
+        return false;
+    }
+    entry.failed = failed != 0;
+    return true;
+}
+
+void FunctionCache::_save(uint64_t hash, const Entry &entry) const {
+    std::string path = _path(hash);
+    // unique to this process and this call, as several threads of one server or session may save
+    // the same entry at once
+    static std::atomic<unsigned long> saves{0};
+    std::string tmpPath = path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(saves++);
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return;
+        }
+        writeChunk(out, entry.key);
+        writeChunk(out, entry.scopes);
+        out << (entry.failed ? 1 : 0) << ' ' << entry.errorLine << ' ';
+        writeChunk(out, entry.errorText);
+    }
+    // rename is atomic, so concurrent runs never see a half written entry
+    std::rename(tmpPath.c_str(), path.c_str());
+}
+
+size_t FunctionCache::_sizeOf(const Entry &entry) {
+    return sizeof(Slot) + entry.key.size() + entry.scopes.size() + entry.errorText.size();
+}
+
+void FunctionCache::_remember(uint64_t hash, Entry entry) {
+    auto it = entries.find(hash);
+    if (it != entries.end()) {
+        used -= _sizeOf(it->second.entry);
+        recency.erase(it->second.use);
+        entries.erase(it);
+    }
+
+    size_t size = _sizeOf(entry);
+    if (size > capacity) {
+        return; // would not fit even alone
+    }
+    while (used + size > capacity) {
+        auto oldest = entries.find(recency.back());
+        used -= _sizeOf(oldest->second.entry);
+        entries.erase(oldest);
+        recency.pop_back();
+    }
+
+    recency.push_front(hash);
+    used += size;
+    entries[hash] = Slot{std::move(entry), recency.begin()};
+}
+
+void FunctionCache::_put(uint64_t hash, Entry entry) {
+    if (!dir.empty()) {
+        _save(hash, entry);
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    _remember(hash, std::move(entry));
+}
+
+bool FunctionCache::lookup(const std::string &key, Entry &entry) {
+    uint64_t h = hash(key);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = entries.find(h);
+        if (it != entries.end() && it->second.entry.key == key) {
+            hits++;
+            recency.splice(recency.begin(), recency, it->second.use);
+            entry = it->second.entry;
+            return true;
+        }
+    }
+
+    if (!dir.empty() && _load(h, key, entry)) {
+        std::lock_guard<std::mutex> guard(lock);
+        hits++;
+        _remember(h, entry);
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    misses++;
+    return false;
+}
+
+void FunctionCache::storeScopes(const std::string &key, const std::string &scopes) {
+    Entry entry;
+    entry.key = key;
+    entry.scopes = scopes;
+    _put(hash(key), std::move(entry));
+}
+
+bool FunctionCache::storeError(const std::string &key, int baseLine, const output::CompileError &error) {
+    std::string prefix = "line " + std::to_string(error.lineno);
+    if (error.lineno < 0 || error.message.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.failed = true;
+    entry.errorLine = error.lineno - baseLine;
+    entry.errorText = error.message.substr(prefix.size());
+    _put(hash(key), std::move(entry));
+    return true;
+}
+
+output::CompileError FunctionCache::errorOf(const Entry &entry, int baseLine) {
+    int lineno = baseLine + entry.errorLine;
+    return output::CompileError(lineno, "line " + std::to_string(lineno) + entry.errorText);
+}
+
+unsigned long FunctionCache::hitCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return hits;
+}
+
+unsigned long FunctionCache::missCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return misses;
+}
@@ -0,0 +1,141 @@
+#ifndef FUNCCACHE_HPP
+#define FUNCCACHE_HPP
+
+#include <string>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <cstdint>
+#include <mutex>
+#include "visitor.hpp"
+#include "nodes.hpp"
+#include "symtable.hpp"
+
+/* FingerprintVisitor class
+ * Serializes a function into a canonical byte string. Line numbers are stored relative to the
+ * line of the function's name, so moving a function up or down the file keeps its fingerprint.
+ * Every identifier the function mentions is collected as well: those are the only global
+ * symbols the result of checking the function can depend on.
+ */
+class FingerprintVisitor : public Visitor {
+private:
+    std::string out;
+    std::set<std::string> names;
+    int baseLine;
+
+    void _tag(char tag, const ast::Node &node);
+    void _int(long long value);
+    void _str(const std::string &value);
+    void _name(const std::string &value);
+
+public:
+    explicit FingerprintVisitor(int baseLine);
+
+    const std::string &fingerprint() const { return out; }
+    const std::set<std::string> &referencedNames() const { return names; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+/* FunctionCache class
+ * Remembers the result of checking a single function: the scope dump lines it produced and the
+ * error it stopped with, if any. Entries are keyed by the function's fingerprint together with
+ * the global signatures of every name it mentions, so a function is re-checked only when its
+ * own text or one of the signatures it depends on changes.
+ * Entries are kept in memory up to a capacity in bytes, evicting the least recently used one
+ * first, and, when a directory is given, also stored one file per entry, so an evicted entry
+ * is loaded again on its next lookup. All methods are safe to call from several threads.
+ */
+class FunctionCache {
+public:
+    struct Entry {
+        std::string key;
+        // Scope dump lines of the function, as emitted by the ScopePrinter
+        std::string scopes;
+        bool failed = false;
+        // Error line relative to the function's base line, and the error text following the
+        // "line N" prefix
+        int errorLine = 0;
+        std::string errorText;
+    };
+
+    // Memory the in-memory entries may take before the least recently used are evicted
+    static const size_t DEFAULT_CAPACITY = 64 << 20;
+
+private:
+    struct Slot {
+        Entry entry;
+        std::list<uint64_t>::iterator use;
+    };
+
+    std::string dir;
+    size_t capacity;
+    size_t used;
+    std::unordered_map<uint64_t, Slot> entries;
+    // Hashes of the in-memory entries, most recently used first
+    std::list<uint64_t> recency;
+    unsigned long hits;
+    unsigned long misses;
+    mutable std::mutex lock;
+
+    std::string _path(uint64_t hash) const;
+    bool _load(uint64_t hash, const std::string &key, Entry &entry) const;
+    void _save(uint64_t hash, const Entry &entry) const;
+    void _put(uint64_t hash, Entry entry);
+    // Stores an entry in memory and evicts until the rest fit; the lock must be held
+    void _remember(uint64_t hash, Entry entry);
+    static size_t _sizeOf(const Entry &entry);
+
+public:
+    // An empty directory keeps the cache in memory only
+    explicit FunctionCache(std::string dir = "", size_t capacity = DEFAULT_CAPACITY);
+
+    static uint64_t hash(const std::string &bytes);
+
+    // Builds the cache key of a function, given the table holding all function signatures
+    static std::string keyFor(ast::FuncDecl &func, SymTable &globals);
+
+    // Copies the cached result for the key into entry and returns true; counts a hit or a miss
+    bool lookup(const std::string &key, Entry &entry);
+
+    void storeScopes(const std::string &key, const std::string &scopes);
+    // Returns false if the error cannot be replayed relative to baseLine and was not stored
+    bool storeError(const std::string &key, int baseLine, const output::CompileError &error);
+
+    // Rebuilds the error a cached entry stopped with, for a function now starting at baseLine
+    static output::CompileError errorOf(const Entry &entry, int baseLine);
+
+    unsigned long hitCount() const;
+    unsigned long missCount() const;
+};
+
+#endif //FUNCCACHE_HPP
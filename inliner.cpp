@@ -0,0 +1,616 @@
+#include "inliner.hpp"
+#include "walker.hpp"
+#include <algorithm>
+
+// Largest callee, in tree nodes, inlined at every call
+static const int INLINE_COST = 40;
+// Largest callee inlined at its only call, which leaves the function itself dead
+static const int SINGLE_CALL_COST = 400;
+// Callers stop growing past this many nodes
+static const int CALLER_SIZE = 4000;
+
+namespace {
+    // Number of nodes in a subtree
+    class NodeCounter : public TreeWalker {
+    protected:
+        void enter(ast::Node &node) override {
+            count++;
+        }
+
+    public:
+        int count = 0;
+    };
+
+    // Returns of a function body, and whether one of them is inside a loop
+    class ReturnFinder : public TreeWalker {
+    private:
+        int loops = 0;
+
+    public:
+        int returns = 0;
+        bool inLoop = false;
+
+        using TreeWalker::visit;
+
+        void visit(ast::While &node) override {
+            loops++;
+            TreeWalker::visit(node);
+            loops--;
+        }
+
+        void visit(ast::Return &node) override {
+            returns++;
+            inLoop = inLoop || loops > 0;
+            TreeWalker::visit(node);
+        }
+    };
+}
+
+static int size(ast::Node &node) {
+    NodeCounter counter;
+    node.accept(counter);
+    return counter.count;
+}
+
+static bool nonZeroLiteral(const ast::Exp &exp) {
+    if (auto num = dynamic_cast<const ast::Num *>(&exp)) {
+        return num->value != 0;
+    }
+    if (auto numB = dynamic_cast<const ast::NumB *>(&exp)) {
+        return numB->value != 0;
+    }
+    return false;
+}
+
+// A new local of the caller, in the given slot
+static std::shared_ptr<ast::ID> local(const std::string &name, ast::BuiltInType type, int offset, int line) {
+    auto id = std::make_shared<ast::ID>(name.c_str());
+    id->line = line;
+    id->computedType = type;
+    id->computedOffset = offset;
+    return id;
+}
+
+static std::shared_ptr<ast::VarDecl> declare(const std::shared_ptr<ast::ID> &id, std::shared_ptr<ast::Exp> init) {
+    auto type = std::make_shared<ast::PrimitiveType>(id->computedType);
+    type->line = id->line;
+    type->computedType = id->computedType;
+    auto declaration = std::make_shared<ast::VarDecl>(id, type, init);
+    declaration->line = id->line;
+    return declaration;
+}
+
+namespace {
+    /* Copies a callee's body into a caller: locals move to the caller's slots, and a Return assigns
+     * the result local and leaves the loop that wraps the copy, or just assigns it when it is the
+     * body's last statement */
+    class BodyCopier : public Visitor {
+    private:
+        std::shared_ptr<ast::Node> result;
+        // First slot of the callee's locals, and of its parameters
+        int base;
+        int paramBase;
+        int params;
+        std::shared_ptr<ast::ID> resultLocal;
+        ast::Return *tail;
+
+        template <typename T>
+        std::shared_ptr<T> _copy(const std::shared_ptr<T> &node) {
+            if (!node) {
+                return nullptr;
+            }
+            result = nullptr;
+            node->accept(*this);
+            return std::dynamic_pointer_cast<T>(result);
+        }
+
+        std::shared_ptr<ast::ID> _variable(const ast::ID &id) {
+            auto copy = std::make_shared<ast::ID>(id);
+            // parameters have negative offsets, the last one first
+            copy->computedOffset = id.computedOffset >= 0 ? base + id.computedOffset
+                                                          : paramBase + params + id.computedOffset;
+            return copy;
+        }
+
+    public:
+        BodyCopier(int base, int paramBase, int params, std::shared_ptr<ast::ID> resultLocal, ast::Return *tail)
+                : base(base), paramBase(paramBase), params(params), resultLocal(std::move(resultLocal)), tail(tail) {}
+
+        std::shared_ptr<ast::Statements> copy(const std::shared_ptr<ast::Statements> &body) {
+            return _copy(body);
+        }
+
+        void visit(ast::Num &node) override { result = std::make_shared<ast::Num>(node); }
+        void visit(ast::NumB &node) override { result = std::make_shared<ast::NumB>(node); }
+        void visit(ast::String &node) override { result = std::make_shared<ast::String>(node); }
+        void visit(ast::Bool &node) override { result = std::make_shared<ast::Bool>(node); }
+        void visit(ast::ID &node) override { result = _variable(node); }
+
+        void visit(ast::BinOp &node) override {
+            auto copy = std::make_shared<ast::BinOp>(node);
+            copy->left = _copy(node.left);
+            copy->right = _copy(node.right);
+            result = copy;
+        }
+
+        void visit(ast::RelOp &node) override {
+            auto copy = std::make_shared<ast::RelOp>(node);
+            copy->left = _copy(node.left);
+            copy->right = _copy(node.right);
+            result = copy;
+        }
+
+        void visit(ast::Not &node) override {
+            auto copy = std::make_shared<ast::Not>(node);
+            copy->exp = _copy(node.exp);
+            result = copy;
+        }
+
+        void visit(ast::And &node) override {
+            auto copy = std::make_shared<ast::And>(node);
+            copy->left = _copy(node.left);
+            copy->right = _copy(node.right);
+            result = copy;
+        }
+
+        void visit(ast::Or &node) override {
+            auto copy = std::make_shared<ast::Or>(node);
+            copy->left = _copy(node.left);
+            copy->right = _copy(node.right);
+            result = copy;
+        }
+
+        void visit(ast::ArrayType &node) override {
+            auto copy = std::make_shared<ast::ArrayType>(node);
+            copy->length = _copy(node.length);
+            result = copy;
+        }
+
+        void visit(ast::PrimitiveType &node) override { result = std::make_shared<ast::PrimitiveType>(node); }
+
+        void visit(ast::ArrayDereference &node) override {
+            auto copy = std::make_shared<ast::ArrayDereference>(node);
+            copy->id = _variable(*node.id);
+            copy->index = _copy(node.index);
+            result = copy;
+        }
+
+        void visit(ast::ArrayAssign &node) override {
+            auto copy = std::make_shared<ast::ArrayAssign>(node);
+            copy->id = _variable(*node.id);
+            copy->index = _copy(node.index);
+            copy->exp = _copy(node.exp);
+            result = copy;
+        }
+
+        void visit(ast::Cast &node) override {
+            auto copy = std::make_shared<ast::Cast>(node);
+            copy->exp = _copy(node.exp);
+            copy->target_type = _copy(node.target_type);
+            result = copy;
+        }
+
+        void visit(ast::ExpList &node) override {
+            auto copy = std::make_shared<ast::ExpList>(node);
+            for (auto &exp : copy->exps) {
+                exp = _copy(exp);
+            }
+            result = copy;
+        }
+
+        void visit(ast::Call &node) override {
+            // the function name is not a variable, it stays as it is
+            auto copy = std::make_shared<ast::Call>(node);
+            copy->args = _copy(node.args);
+            result = copy;
+        }
+
+        void visit(ast::Statements &node) override {
+            auto copy = std::make_shared<ast::Statements>(node);
+            copy->statements.clear();
+            for (auto &statement : node.statements) {
+                // a Return at the very end may leave nothing behind
+                if (auto statementCopy = _copy(statement)) {
+                    copy->statements.push_back(statementCopy);
+                }
+            }
+            result = copy;
+        }
+
+        void visit(ast::Block &node) override {
+            auto copy = std::make_shared<ast::Block>(node);
+            copy->statements = _copy(node.statements);
+            result = copy;
+        }
+
+        void visit(ast::Break &node) override { result = std::make_shared<ast::Break>(node); }
+        void visit(ast::Continue &node) override { result = std::make_shared<ast::Continue>(node); }
+
+        void visit(ast::Return &node) override {
+            std::shared_ptr<ast::Statement> assign;
+            if (node.exp) {
+                auto target = std::make_shared<ast::ID>(*resultLocal);
+                assign = std::make_shared<ast::Assign>(target, _copy(node.exp));
+                assign->line = node.line;
+            }
+            if (&node == tail) {
+                result = assign;
+                return;
+            }
+
+            auto statements = std::make_shared<ast::Statements>();
+            if (assign) {
+                statements->push_back(assign);
+            }
+            auto leave = std::make_shared<ast::Break>();
+            leave->line = node.line;
+            statements->push_back(leave);
+            auto block = std::make_shared<ast::Block>(statements);
+            block->line = node.line;
+            result = block;
+        }
+
+        void visit(ast::If &node) override {
+            auto copy = std::make_shared<ast::If>(node);
+            copy->condition = _copy(node.condition);
+            copy->then = _copy(node.then);
+            copy->otherwise = _copy(node.otherwise);
+            result = copy;
+        }
+
+        void visit(ast::While &node) override {
+            auto copy = std::make_shared<ast::While>(node);
+            copy->condition = _copy(node.condition);
+            copy->body = _copy(node.body);
+            result = copy;
+        }
+
+        void visit(ast::VarDecl &node) override {
+            auto copy = std::make_shared<ast::VarDecl>(node);
+            copy->id = _variable(*node.id);
+            copy->type = _copy(node.type);
+            copy->init_exp = _copy(node.init_exp);
+            result = copy;
+        }
+
+        void visit(ast::Assign &node) override {
+            auto copy = std::make_shared<ast::Assign>(node);
+            copy->id = _variable(*node.id);
+            copy->exp = _copy(node.exp);
+            result = copy;
+        }
+
+        void visit(ast::Formal &node) override {}
+        void visit(ast::Formals &node) override {}
+        void visit(ast::FuncDecl &node) override {}
+        void visit(ast::Funcs &node) override {}
+    };
+}
+
+Inliner::Inliner() : graph(nullptr), function(nullptr), caller(-1), blocked(false), conditional(false) {}
+
+int Inliner::callsInlined() const {
+    return static_cast<int>(std::count_if(decisions.begin(), decisions.end(),
+                                          [](const Decision &decision) { return decision.inlined; }));
+}
+
+/* Helpers */
+
+std::vector<std::shared_ptr<ast::Statement>> Inliner::_statement(std::shared_ptr<ast::Statement> statement) {
+    std::vector<std::shared_ptr<ast::Statement>> outer = std::move(pending);
+    pending.clear();
+    blocked = false;
+    conditional = false;
+
+    bool inlined = false;
+    if (auto call = dynamic_cast<ast::Call *>(statement.get())) {
+        _call(*call, inlined);
+    } else {
+        statement->accept(*this);
+    }
+
+    std::vector<std::shared_ptr<ast::Statement>> replacement = std::move(pending);
+    if (!inlined) {
+        replacement.push_back(statement);
+    }
+    pending = std::move(outer);
+    return replacement;
+}
+
+void Inliner::_nested(std::shared_ptr<ast::Statement> &statement) {
+    std::vector<std::shared_ptr<ast::Statement>> replacement = _statement(statement);
+    if (replacement.size() == 1) {
+        statement = replacement.front();
+        return;
+    }
+    auto statements = std::make_shared<ast::Statements>();
+    statements->statements = std::move(replacement);
+    auto block = std::make_shared<ast::Block>(statements);
+    block->line = statement->line;
+    statement = block;
+}
+
+void Inliner::_exp(std::shared_ptr<ast::Exp> &exp) {
+    if (auto call = dynamic_cast<ast::Call *>(exp.get())) {
+        bool inlined;
+        if (auto result = _call(*call, inlined)) {
+            exp = result;
+        }
+        return;
+    }
+    exp->accept(*this);
+}
+
+std::shared_ptr<ast::ID> Inliner::_call(ast::Call &node, bool &inlined) {
+    inlined = false;
+    if (node.args) {
+        for (auto &arg : node.args->exps) {
+            _exp(arg);
+        }
+    }
+
+    int callee = graph->find(node.func_id->value);
+    if (callee < 0) {
+        // print and printi stay, and so must their output's place
+        blocked = true;
+        return nullptr;
+    }
+
+    int cost = 0;
+    const char *reason = _reject(callee, cost);
+    decisions.push_back({node.line, function->id->value, node.func_id->value, reason == nullptr, cost,
+                         reason ? reason : ""});
+    if (reason) {
+        blocked = true;
+        return nullptr;
+    }
+
+    inlined = true;
+    sizes[caller] += cost;
+    return _inline(node, *graph->functions[callee]);
+}
+
+const char *Inliner::_reject(int callee, int &cost) {
+    cost = sizes[callee];
+    if (graph->recursive[callee]) {
+        return "recursive";
+    }
+    if (conditional) {
+        return "not always evaluated";
+    }
+    if (blocked) {
+        return "would run before code that must come first";
+    }
+    if (cost > (graph->callSites[callee] == 1 ? SINGLE_CALL_COST : INLINE_COST)) {
+        return "too large";
+    }
+    if (sizes[caller] + cost > CALLER_SIZE) {
+        return "caller too large";
+    }
+    ReturnFinder finder;
+    graph->functions[callee]->body->accept(finder);
+    if (finder.inLoop) {
+        return "returns from inside a loop";
+    }
+    return nullptr;
+}
+
+std::shared_ptr<ast::ID> Inliner::_inline(ast::Call &node, ast::FuncDecl &callee) {
+    auto &formals = callee.formals->formals;
+    int params = static_cast<int>(formals.size());
+    ast::BuiltInType type = callee.return_type->computedType;
+    bool returns = type != ast::BuiltInType::VOID;
+
+    // the callee's locals, then its parameters, then the result
+    int base = function->computedFrameSize;
+    int paramBase = base + callee.computedFrameSize;
+    function->computedFrameSize += callee.computedFrameSize + params + (returns ? 1 : 0);
+
+    auto statements = std::make_shared<ast::Statements>();
+    std::shared_ptr<ast::ID> result;
+    if (returns) {
+        // uninitialized, it holds 0 for a callee that falls off its end
+        result = local(callee.id->value + "Result", type, paramBase + params, node.line);
+        statements->push_back(declare(result, nullptr));
+    }
+    for (int i = 0; i < params; i++) {
+        // parameter i has offset -1 - i
+        auto param = local(formals[i]->id->value, formals[i]->id->computedType, paramBase + params - 1 - i, node.line);
+        statements->push_back(declare(param, node.args->exps[i]));
+    }
+
+    auto &body = callee.body->statements;
+    auto tail = body.empty() ? nullptr : dynamic_cast<ast::Return *>(body.back().get());
+    ReturnFinder finder;
+    callee.body->accept(finder);
+
+    BodyCopier copier(base, paramBase, params, result, tail);
+    std::shared_ptr<ast::Statements> copy = copier.copy(callee.body);
+    if (finder.returns > (tail ? 1 : 0)) {
+        // a Return anywhere else leaves this loop
+        auto leave = std::make_shared<ast::Break>();
+        leave->line = node.line;
+        copy->push_back(leave);
+        auto condition = std::make_shared<ast::Bool>(true);
+        condition->line = node.line;
+        condition->computedType = ast::BuiltInType::BOOL;
+        auto loopBody = std::make_shared<ast::Block>(copy);
+        loopBody->line = node.line;
+        auto loop = std::make_shared<ast::While>(condition, loopBody);
+        loop->line = node.line;
+        statements->push_back(loop);
+    } else {
+        for (auto &statement : copy->statements) {
+            statements->push_back(statement);
+        }
+    }
+
+    auto block = std::make_shared<ast::Block>(statements);
+    block->line = node.line;
+    pending.push_back(block);
+
+    if (!returns) {
+        return nullptr;
+    }
+    auto use = std::make_shared<ast::ID>(*result);
+    return use;
+}
+
+/* Expressions: calls in them are inlined where evaluation order allows */
+
+void Inliner::visit(ast::Num &node) {}
+
+void Inliner::visit(ast::NumB &node) {}
+
+void Inliner::visit(ast::String &node) {}
+
+void Inliner::visit(ast::Bool &node) {}
+
+void Inliner::visit(ast::ID &node) {}
+
+void Inliner::visit(ast::BinOp &node) {
+    _exp(node.left);
+    _exp(node.right);
+    // a division that may trap must still come before any call to its right
+    if (node.op == ast::BinOpType::DIV && !nonZeroLiteral(*node.right)) {
+        blocked = true;
+    }
+}
+
+void Inliner::visit(ast::RelOp &node) {
+    _exp(node.left);
+    _exp(node.right);
+}
+
+void Inliner::visit(ast::Not &node) {
+    _exp(node.exp);
+}
+
+void Inliner::visit(ast::And &node) {
+    _exp(node.left);
+    bool outer = conditional;
+    conditional = true;
+    _exp(node.right);
+    conditional = outer;
+}
+
+void Inliner::visit(ast::Or &node) {
+    _exp(node.left);
+    bool outer = conditional;
+    conditional = true;
+    _exp(node.right);
+    conditional = outer;
+}
+
+void Inliner::visit(ast::Cast &node) {
+    _exp(node.exp);
+}
+
+void Inliner::visit(ast::ArrayDereference &node) {
+    _exp(node.index);
+    blocked = true;
+}
+
+void Inliner::visit(ast::ExpList &node) {
+    for (auto &exp : node.exps) {
+        _exp(exp);
+    }
+}
+
+void Inliner::visit(ast::Call &node) {
+    bool inlined;
+    _call(node, inlined);
+}
+
+/* Types */
+
+void Inliner::visit(ast::ArrayType &node) {}
+
+void Inliner::visit(ast::PrimitiveType &node) {}
+
+/* Statements */
+
+void Inliner::visit(ast::ArrayAssign &node) {
+    _exp(node.index);
+    _exp(node.exp);
+}
+
+void Inliner::visit(ast::Statements &node) {
+    std::vector<std::shared_ptr<ast::Statement>> statements;
+    for (auto &statement : node.statements) {
+        for (auto &replacement : _statement(statement)) {
+            statements.push_back(replacement);
+        }
+    }
+    node.statements = std::move(statements);
+}
+
+void Inliner::visit(ast::Block &node) {
+    node.statements->accept(*this);
+}
+
+void Inliner::visit(ast::Break &node) {}
+
+void Inliner::visit(ast::Continue &node) {}
+
+void Inliner::visit(ast::Return &node) {
+    if (node.exp) {
+        _exp(node.exp);
+    }
+}
+
+void Inliner::visit(ast::If &node) {
+    _exp(node.condition);
+    _nested(node.then);
+    if (node.otherwise) {
+        _nested(node.otherwise);
+    }
+}
+
+void Inliner::visit(ast::While &node) {
+    // the condition runs again on every iteration, not once before the loop
+    conditional = true;
+    _exp(node.condition);
+    _nested(node.body);
+}
+
+void Inliner::visit(ast::VarDecl &node) {
+    if (node.init_exp) {
+        _exp(node.init_exp);
+    }
+}
+
+void Inliner::visit(ast::Assign &node) {
+    _exp(node.exp);
+}
+
+void Inliner::visit(ast::Formal &node) {}
+
+void Inliner::visit(ast::Formals &node) {}
+
+void Inliner::visit(ast::FuncDecl &node) {
+    function = &node;
+    caller = graph->find(node.id->value);
+    node.body->accept(*this);
+    sizes[caller] = size(*node.body);
+}
+
+void Inliner::visit(ast::Funcs &node) {
+    CallGraph callGraph(node);
+    graph = &callGraph;
+    sizes.clear();
+    for (auto *func : callGraph.functions) {
+        sizes.push_back(size(*func->body));
+    }
+
+    // callees first, so their bodies are final by the time they are copied
+    for (const auto &component : callGraph.components) {
+        for (int index : component) {
+            callGraph.functions[index]->accept(*this);
+        }
+    }
+    graph = nullptr;
+
+    std::stable_sort(decisions.begin(), decisions.end(),
+                     [](const Decision &a, const Decision &b) { return a.line < b.line; });
+}
@@ -0,0 +1,108 @@
+#ifndef INLINER_HPP
+#define INLINER_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+#include "callgraph.hpp"
+
+/* Inliner class
+ * Replaces calls to small functions with a copy of the callee's body on a checked tree. The
+ * functions are processed callee first along the call graph, so what a callee inlined itself is
+ * part of its size; functions in a recursive component are never inlined.
+ *
+ * The copy goes in a Block before the statement holding the call: one local per parameter
+ * initialized with the argument, one for the result, then the body. Every local of the copy is
+ * given a fresh frame slot past the ones the caller already uses. A Return becomes an assignment
+ * to the result local, and a Break out of a `while (true)` that wraps the body unless the only
+ * Return is its last statement; callees that return from inside a loop are left alone. The call
+ * itself becomes a read of the result local, or goes away when it is a statement.
+ *
+ * Since the copy runs before the rest of the statement, a call is only inlined when whatever the
+ * statement evaluates before it cannot trap or have effects: it must not follow a call that
+ * stays, an array read, or a division by anything but a non-zero literal, and must not sit in a
+ * While condition or the right operand of And or Or.
+ */
+class Inliner : public Visitor {
+public:
+    // One call considered for inlining
+    struct Decision {
+        int line;
+        std::string caller;
+        std::string callee;
+        bool inlined;
+        // Size of the callee in tree nodes, and why it was not inlined
+        int cost;
+        std::string reason;
+    };
+
+private:
+    CallGraph *graph;
+    ast::FuncDecl *function;
+    int caller;
+    // Nodes in each function's body, kept up to date as calls are inlined
+    std::vector<int> sizes;
+    // Code to run before the statement being visited, in evaluation order
+    std::vector<std::shared_ptr<ast::Statement>> pending;
+    // The statement being visited already evaluated something a call cannot be moved before
+    bool blocked;
+    // The expression being visited is not always evaluated when its statement runs
+    bool conditional;
+    std::vector<Decision> decisions;
+
+    // Visits a statement and returns what replaces it: the code of its inlined calls followed by
+    // the statement itself, unless that was an inlined call
+    std::vector<std::shared_ptr<ast::Statement>> _statement(std::shared_ptr<ast::Statement> statement);
+    // Same, for the single statement of an If branch or a While body
+    void _nested(std::shared_ptr<ast::Statement> &statement);
+    void _exp(std::shared_ptr<ast::Exp> &exp);
+    // Visits the arguments of a call and inlines it if it can: returns the local that holds its
+    // result, or nullptr
+    std::shared_ptr<ast::ID> _call(ast::Call &node, bool &inlined);
+    // Why a call to `callee` cannot be inlined here, or nullptr
+    const char *_reject(int callee, int &cost);
+    std::shared_ptr<ast::ID> _inline(ast::Call &node, ast::FuncDecl &callee);
+
+public:
+    Inliner();
+
+    int callsInlined() const;
+
+    // Every call to a function of the program, in source order
+    const std::vector<Decision> &report() const { return decisions; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif //INLINER_HPP
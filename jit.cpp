@@ -0,0 +1,169 @@
+#include "jit.hpp"
+#include <cerrno>
+#include <charconv>
+#include <csetjmp>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Room left below the stack limit for the runtime stubs
+static const size_t stackReserve = 64 << 10;
+static const size_t flushThreshold = 1 << 16;
+
+/* Runtime stubs, called from the generated code */
+
+namespace {
+    // State of the program running on this thread
+    struct Runtime {
+        std::string output;
+        int fd;
+        jmp_buf trapped;
+    };
+
+    thread_local Runtime *current = nullptr;
+
+    void flush(Runtime &runtime) {
+        const char *data = runtime.output.data();
+        size_t size = runtime.output.size();
+        while (size > 0) {
+            ssize_t written = ::write(runtime.fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            data += written;
+            size -= written;
+        }
+        runtime.output.clear();
+    }
+
+    void runtimePrint(const char *text, int length) {
+        current->output.append(text, length);
+        current->output += '\n';
+        if (current->output.size() > flushThreshold) {
+            flush(*current);
+        }
+    }
+
+    void runtimePrinti(int value) {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        current->output.append(digits, result.ptr - digits);
+        current->output += '\n';
+        if (current->output.size() > flushThreshold) {
+            flush(*current);
+        }
+    }
+
+    [[noreturn]] void runtimeTrap(int trap) {
+        current->output += x86::trapMessage(trap);
+        current->output += '\n';
+        // no destructors run in generated frames, so jumping over them is fine
+        longjmp(current->trapped, 1);
+    }
+}
+
+/* JitProgram class implementation */
+
+JitProgram::JitProgram(const x86::NativeCode &code, size_t stackSize)
+        : memory(nullptr), size(0), stack(nullptr), stackSize(stackSize), entry(nullptr) {
+    std::vector<uint8_t> text = code.text;
+    x86::Assembler as(text);
+
+    // entry thunk: switch to the program stack, call main, switch back
+    size_t thunk = as.size();
+    as.push(x86::RBP);
+    as.op({0x89}, x86::RSP, x86::Operand::r(x86::RBP), true);
+    as.op({0x89}, x86::RDI, x86::Operand::r(x86::RSP), true);
+    as.patchRel32(as.call(), code.functions[code.main]);
+    as.op({0x89}, x86::RBP, x86::Operand::r(x86::RSP), true);
+    as.pop(x86::RBP);
+    as.ret();
+
+    const void *stubs[x86::RUNTIME_COUNT] = {
+            reinterpret_cast<const void *>(&runtimePrint),
+            reinterpret_cast<const void *>(&runtimePrinti),
+            reinterpret_cast<const void *>(&runtimeTrap)
+    };
+    size_t trampolines[x86::RUNTIME_COUNT];
+    for (int stub = 0; stub < x86::RUNTIME_COUNT; ++stub) {
+        trampolines[stub] = as.size();
+        as.movImm64(x86::RAX, reinterpret_cast<uint64_t>(stubs[stub]));
+        as.op({0xFF}, 4, x86::Operand::r(x86::RAX));
+    }
+
+    while (text.size() % 8) {
+        as.byte(0xCC);
+    }
+    stack = mmap(nullptr, stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stack == MAP_FAILED) {
+        stack = nullptr;
+        return;
+    }
+    size_t limit = as.size();
+    as.qword(reinterpret_cast<uint64_t>(stack) + stackReserve);
+
+    std::vector<size_t> strings;
+    for (const auto &literal : code.strings) {
+        strings.push_back(as.size());
+        for (char c : literal) {
+            as.byte(static_cast<uint8_t>(c));
+        }
+    }
+
+    for (const auto &reference : code.references) {
+        switch (reference.kind) {
+            case x86::Reference::RUNTIME:
+                as.patchRel32(reference.offset, trampolines[reference.index]);
+                break;
+            case x86::Reference::STRING:
+                as.patchRel32(reference.offset, strings[reference.index]);
+                break;
+            case x86::Reference::STACK_LIMIT:
+                as.patchRel32(reference.offset, limit);
+                break;
+        }
+    }
+
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size = (text.size() + page - 1) / page * page;
+    memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        memory = nullptr;
+        return;
+    }
+    memcpy(memory, text.data(), text.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        return;
+    }
+    entry = reinterpret_cast<void (*)(void *)>(static_cast<uint8_t *>(memory) + thunk);
+}
+
+JitProgram::~JitProgram() {
+    if (memory) {
+        munmap(memory, size);
+    }
+    if (stack) {
+        munmap(stack, stackSize);
+    }
+}
+
+int JitProgram::run(int fd) {
+    Runtime runtime;
+    runtime.fd = fd;
+    runtime.output.reserve(2 * flushThreshold);
+    Runtime *previous = current;
+    current = &runtime;
+
+    int status = 0;
+    if (setjmp(runtime.trapped) == 0) {
+        entry(static_cast<uint8_t *>(stack) + stackSize);
+    } else {
+        status = 1;
+    }
+
+    flush(runtime);
+    current = previous;
+    return status;
+}
@@ -0,0 +1,40 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "x86.hpp"
+
+/* JitProgram class
+ * Loads NativeCode into memory of its own and runs it in-process. The code is written while the
+ * mapping is writable and then flipped to read+execute, never both (W^X). Runtime stubs for
+ * print, printi and traps are reached through small trampolines appended to the code, and string
+ * literals and the stack limit are appended as read-only data. main runs on a separate stack of
+ * its own, so deep recursion is caught by the stack limit check instead of crashing the host.
+ */
+class JitProgram {
+private:
+    void *memory;
+    size_t size;
+    void *stack;
+    size_t stackSize;
+    // Enters main on the given stack top
+    void (*entry)(void *stackTop);
+
+public:
+    explicit JitProgram(const x86::NativeCode &code, size_t stackSize = 64 << 20);
+
+    ~JitProgram();
+
+    JitProgram(const JitProgram &) = delete;
+    JitProgram &operator=(const JitProgram &) = delete;
+
+    // False if the memory could not be mapped
+    bool ok() const { return entry != nullptr; }
+
+    // Runs main, writing the program's output to fd. Returns 0, or 1 if it was stopped by a
+    // runtime error
+    int run(int fd = 1);
+};
+
+#endif //JIT_HPP
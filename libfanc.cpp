@@ -0,0 +1,179 @@
+#include "libfanc.hpp"
+#include <streambuf>
+#include <ostream>
+#include "driver.hpp"
+#include "output.hpp"
+#include "semanticvisitor.hpp"
+#include "dataflow.hpp"
+#include "funccache.hpp"
+#include "query.hpp"
+#include <unordered_set>
+
+namespace fanc {
+    namespace {
+        // Appends whatever is written to a string, so the string's capacity is reused
+        class AppendBuf : public std::streambuf {
+        private:
+            std::string &text;
+
+        protected:
+            int_type overflow(int_type c) override {
+                if (c != traits_type::eof()) {
+                    text += traits_type::to_char_type(c);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char *s, std::streamsize n) override {
+                text.append(s, n);
+                return n;
+            }
+
+        public:
+            explicit AppendBuf(std::string &text) : text(text) {}
+        };
+    }
+
+    std::string Result::text() const {
+        for (const auto &diagnostic : diagnostics) {
+            if (diagnostic.severity == Diagnostic::ERROR) {
+                return diagnostic.message;
+            }
+        }
+        return scopes;
+    }
+
+    Session::Session(Options options) : options(options) {
+        // functions replayed from the cache are not annotated, which the flow analyses rely on
+        if (options.cache && !options.warnings) {
+            cache = std::make_unique<FunctionCache>();
+        }
+    }
+
+    Session::~Session() = default;
+
+    void Session::compile(const char *source, size_t size, Result &result) {
+        result.ok = false;
+        result.scopes.clear();
+        result.diagnostics.clear();
+
+        try {
+            buffer.assign(source, size);
+            std::shared_ptr<ast::Node> root = parseBufferLocked(buffer);
+            SemanticVisitor semanticVisitor;
+            semanticVisitor.setFunctionCache(cache.get());
+            root->accept(semanticVisitor);
+
+            AppendBuf buf(result.scopes);
+            std::ostream out(&buf);
+            semanticVisitor.printScopes(out);
+
+            if (options.warnings) {
+                auto funcs = std::dynamic_pointer_cast<ast::Funcs>(root);
+                for (auto &func : funcs->funcs) {
+                    for (auto &warning : analyzeFlow(*func)) {
+                        result.diagnostics.push_back({Diagnostic::WARNING, warning.line, std::move(warning.message)});
+                    }
+                }
+            }
+            result.ok = true;
+        } catch (const output::CompileError &error) {
+            result.scopes.clear();
+            result.diagnostics.clear();
+            result.diagnostics.push_back({Diagnostic::ERROR, error.lineno, error.message});
+        }
+    }
+
+    Result Session::compile(const std::string &source) {
+        Result result;
+        compile(source.data(), source.size(), result);
+        return result;
+    }
+
+    unsigned long Session::cacheHits() const {
+        return cache ? cache->hitCount() : 0;
+    }
+
+    unsigned long Session::cacheMisses() const {
+        return cache ? cache->missCount() : 0;
+    }
+
+    Workspace::Workspace() : earlierChecks(0) {}
+
+    Workspace::~Workspace() = default;
+
+    Result Workspace::update(const char *source, size_t size) {
+        Result result;
+        std::shared_ptr<ast::Funcs> funcs;
+        try {
+            buffer.assign(source, size);
+            funcs = std::dynamic_pointer_cast<ast::Funcs>(parseBufferLocked(buffer));
+        } catch (const output::CompileError &error) {
+            result.diagnostics.push_back({Diagnostic::ERROR, error.lineno, error.message});
+            return result;
+        }
+        result.ok = true;
+
+        // absolute lines, so a function that moved is updated too: its errors and the lines
+        // queries find it by changed
+        std::vector<std::pair<std::string, std::string>> next;
+        std::unordered_set<std::string> names;
+        bool incremental = engine != nullptr;
+        for (auto &func : funcs->funcs) {
+            FingerprintVisitor fingerprint(0);
+            func->accept(fingerprint);
+            next.emplace_back(func->id->value, fingerprint.fingerprint());
+            // a function defined twice cannot be told apart from its twin by name
+            incremental = names.insert(func->id->value).second && incremental;
+        }
+        incremental = incremental && next.size() >= fingerprints.size();
+        for (size_t i = 0; incremental && i < fingerprints.size(); ++i) {
+            incremental = next[i].first == fingerprints[i].first;
+        }
+
+        if (!incremental) {
+            earlierChecks += engine ? engine->functionsChecked() : 0;
+            engine = std::make_unique<QueryEngine>(funcs);
+        } else {
+            for (size_t i = 0; i < next.size(); ++i) {
+                if (i >= fingerprints.size() || next[i].second != fingerprints[i].second) {
+                    engine->updateFunction(funcs->funcs[i]);
+                }
+            }
+        }
+        fingerprints = std::move(next);
+        return result;
+    }
+
+    Result Workspace::update(const std::string &source) {
+        return update(source.data(), source.size());
+    }
+
+    Result Workspace::checkFunction(const std::string &name) {
+        Result result;
+        if (!engine) {
+            result.diagnostics.push_back({Diagnostic::ERROR, -1, "function " + name + " is not defined\n"});
+            return result;
+        }
+        const QueryEngine::FunctionResult &checked = engine->checkFunction(name);
+        result.ok = checked.ok;
+        if (checked.ok) {
+            result.scopes = checked.scopes;
+        } else {
+            result.diagnostics.push_back({Diagnostic::ERROR, checked.line, checked.error});
+        }
+        return result;
+    }
+
+    std::string Workspace::resolve(int line, const std::string &name) {
+        return engine ? engine->describeAt(line, name) : name + " is not resolved\n";
+    }
+
+    std::string Workspace::typeAt(int line, const std::string &name) {
+        return output::toString(engine ? engine->typeAt(line, name) : ast::BuiltInType::UNDEF);
+    }
+
+    unsigned long Workspace::functionsChecked() const {
+        return earlierChecks + (engine ? engine->functionsChecked() : 0);
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef LIBFANC_HPP
+#define LIBFANC_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class FunctionCache;
+class QueryEngine;
+
+/* libfanc
+ * Checks FanC programs held in memory, for services that embed the checker instead of running
+ * one hw3 process per program. Nothing here reads stdin, writes to the standard streams or
+ * exits: the scope dump and the diagnostics come back in a Result. Build with `make lib`, which
+ * leaves libfanc.a and libfanc.so next to hw3.
+ *
+ *     fanc::Session session;
+ *     fanc::Result result;
+ *     for (const std::string &source : programs) {
+ *         session.compile(source.data(), source.size(), result);
+ *         reply(result.text());
+ *     }
+ */
+namespace fanc {
+    struct Diagnostic {
+        enum Severity {
+            ERROR,
+            WARNING
+        };
+
+        Severity severity;
+        // Source line, or -1 for errors not tied to a line
+        int line;
+        // An error is the exact line hw3 prints for it, newline included; a warning is the text
+        // hw3 --warnings prints after the "line N: warning: " prefix
+        std::string message;
+    };
+
+    struct Result {
+        // The program checked without errors
+        bool ok = false;
+        // Scope dump, empty if the check failed
+        std::string scopes;
+        // The error the check stopped at, if any, or the flow warnings when they are enabled
+        std::vector<Diagnostic> diagnostics;
+
+        // Exactly what hw3 prints for the program: the scope dump, or the error
+        std::string text() const;
+    };
+
+    struct Options {
+        // Keep the results of checked functions in memory and reuse them for functions that
+        // come back unchanged in later programs
+        bool cache = true;
+        // Run the flow analyses of hw3 --warnings on programs that check; this needs every
+        // function checked afresh, so it turns the cache off
+        bool warnings = false;
+    };
+
+    /* Session class
+     * Checks one program per call. The function cache lives as long as the session, and a
+     * Result passed back in keeps the capacity of its buffers, so a service checking many
+     * similar programs does little allocation after the first few calls.
+     * Sessions may be used from several threads, one per thread; parsing is serialized.
+     */
+    class Session {
+    private:
+        Options options;
+        std::unique_ptr<FunctionCache> cache;
+        // Copy of the program being checked, which the scanner reads in place; its capacity is
+        // reused by the next call
+        std::string buffer;
+
+    public:
+        explicit Session(Options options = Options());
+        ~Session();
+
+        Session(const Session &) = delete;
+        Session &operator=(const Session &) = delete;
+
+        // Checks the size bytes at source into result, replacing what it held
+        void compile(const char *source, size_t size, Result &result);
+
+        Result compile(const std::string &source);
+
+        // Functions answered from the cache, and functions checked, since the session started
+        unsigned long cacheHits() const;
+        unsigned long cacheMisses() const;
+    };
+
+    /* Workspace class
+     * Keeps one program open for an editor and answers the queries of hw3 --check-function and
+     * --resolve about it. A function is checked the first time a query needs it, and its answer
+     * is reused until it changes: update() takes the whole new text, and only the functions
+     * whose text changed, those added, and those that mention a function whose signature
+     * changed are checked again. Removing, renaming or reordering functions starts over.
+     *
+     *     fanc::Workspace workspace;
+     *     workspace.update(text);
+     *     show(workspace.checkFunction("main"));
+     *     workspace.update(editedText);   // main is checked again only if it was affected
+     */
+    class Workspace {
+    private:
+        std::unique_ptr<QueryEngine> engine;
+        // Fingerprints of the open program's functions, in program order, by name
+        std::vector<std::pair<std::string, std::string>> fingerprints;
+        // Checks run by engines dropped when starting over
+        unsigned long earlierChecks;
+        std::string buffer;
+
+    public:
+        Workspace();
+        ~Workspace();
+
+        Workspace(const Workspace &) = delete;
+        Workspace &operator=(const Workspace &) = delete;
+
+        // Opens the program, or replaces the open one with its new text. A text that does not
+        // parse leaves the program open before in place and comes back as the error.
+        Result update(const char *source, size_t size);
+        Result update(const std::string &source);
+
+        // Checks a single function of the open program; the result's text is what
+        // hw3 --check-function prints
+        Result checkFunction(const std::string &name);
+
+        // What hw3 --resolve LINE:NAME prints for the open program
+        std::string resolve(int line, const std::string &name);
+
+        // Type of the identifier called name written on line, as an expression: "int", "bool",
+        // ..., or "undef" if there is none or its function does not check
+        std::string typeAt(int line, const std::string &name);
+
+        // Function checks run since the workspace was made; reused answers add nothing
+        unsigned long functionsChecked() const;
+    };
+}
+
+#endif //LIBFANC_HPP
@@ -0,0 +1,324 @@
+#include "licm.hpp"
+#include "walker.hpp"
+
+static bool isLeaf(const ast::Exp &exp) {
+    return dynamic_cast<const ast::ID *>(&exp) || dynamic_cast<const ast::Num *>(&exp) ||
+           dynamic_cast<const ast::NumB *>(&exp) || dynamic_cast<const ast::Bool *>(&exp) ||
+           dynamic_cast<const ast::String *>(&exp);
+}
+
+static bool nonZeroLiteral(const ast::Exp &exp) {
+    if (auto num = dynamic_cast<const ast::Num *>(&exp)) {
+        return num->value != 0;
+    }
+    if (auto numB = dynamic_cast<const ast::NumB *>(&exp)) {
+        return numB->value != 0;
+    }
+    return false;
+}
+
+LoopInvariantMover::LoopInvariantMover() : function(nullptr), active(false), invariant(false), hoistedCount(0) {}
+
+/* Helpers */
+
+void LoopInvariantMover::_statement(std::shared_ptr<ast::Statement> &statement) {
+    statement->accept(*this);
+    if (declarations.empty()) {
+        return;
+    }
+    // the locals live in a scope of their own around the loop
+    auto statements = std::make_shared<ast::Statements>();
+    for (auto &declaration : declarations) {
+        statements->push_back(declaration);
+    }
+    statements->push_back(statement);
+    auto block = std::make_shared<ast::Block>(statements);
+    block->line = statement->line;
+    statement = block;
+    declarations.clear();
+}
+
+bool LoopInvariantMover::_operand(std::shared_ptr<ast::Exp> &exp) {
+    invariant = false;
+    exp->accept(*this);
+    return invariant;
+}
+
+void LoopInvariantMover::_hoist(std::shared_ptr<ast::Exp> &exp) {
+    if (isLeaf(*exp)) {
+        return;
+    }
+
+    std::string key = _key(*exp);
+    auto found = hoistedLocals.find(key);
+    std::shared_ptr<ast::ID> local;
+    if (found != hoistedLocals.end()) {
+        local = found->second;
+    } else {
+        // a slot past every one the function uses, so nothing can share it
+        std::string name = "hoisted" + std::to_string(function->computedFrameSize);
+        local = std::make_shared<ast::ID>(name.c_str());
+        local->line = exp->line;
+        local->computedType = exp->computedType;
+        local->computedOffset = function->computedFrameSize++;
+
+        auto type = std::make_shared<ast::PrimitiveType>(exp->computedType);
+        type->line = exp->line;
+        type->computedType = exp->computedType;
+        auto declaration = std::make_shared<ast::VarDecl>(local, type, exp);
+        declaration->line = exp->line;
+        hoisted.push_back(declaration);
+        hoistedLocals.emplace(key, local);
+        hoistedCount++;
+    }
+
+    auto use = std::make_shared<ast::ID>(local->value.c_str());
+    use->line = exp->line;
+    use->computedType = local->computedType;
+    use->computedOffset = local->computedOffset;
+    exp = use;
+}
+
+void LoopInvariantMover::_exp(std::shared_ptr<ast::Exp> &exp) {
+    if (active && _operand(exp)) {
+        _hoist(exp);
+    }
+}
+
+std::string LoopInvariantMover::_key(const ast::Exp &exp) {
+    if (auto id = dynamic_cast<const ast::ID *>(&exp)) {
+        return "v" + std::to_string(id->computedOffset);
+    }
+    if (auto num = dynamic_cast<const ast::Num *>(&exp)) {
+        return std::to_string(num->value);
+    }
+    if (auto numB = dynamic_cast<const ast::NumB *>(&exp)) {
+        return std::to_string(numB->value) + "b";
+    }
+    if (auto boolean = dynamic_cast<const ast::Bool *>(&exp)) {
+        return boolean->value ? "true" : "false";
+    }
+    if (auto binOp = dynamic_cast<const ast::BinOp *>(&exp)) {
+        // the type tells int arithmetic from byte arithmetic
+        return "(" + std::string(1, "+-*/"[binOp->op]) + std::to_string(binOp->computedType) + " " +
+               _key(*binOp->left) + " " + _key(*binOp->right) + ")";
+    }
+    if (auto relOp = dynamic_cast<const ast::RelOp *>(&exp)) {
+        return "(r" + std::to_string(relOp->op) + " " + _key(*relOp->left) + " " + _key(*relOp->right) + ")";
+    }
+    if (auto negation = dynamic_cast<const ast::Not *>(&exp)) {
+        return "(not " + _key(*negation->exp) + ")";
+    }
+    if (auto conjunction = dynamic_cast<const ast::And *>(&exp)) {
+        return "(and " + _key(*conjunction->left) + " " + _key(*conjunction->right) + ")";
+    }
+    if (auto disjunction = dynamic_cast<const ast::Or *>(&exp)) {
+        return "(or " + _key(*disjunction->left) + " " + _key(*disjunction->right) + ")";
+    }
+    if (auto cast = dynamic_cast<const ast::Cast *>(&exp)) {
+        return "(cast" + std::to_string(cast->target_type->computedType) + " " + _key(*cast->exp) + ")";
+    }
+    return "?";
+}
+
+/* Expressions: `invariant` tells whether the expression could be computed before the loop */
+
+void LoopInvariantMover::visit(ast::Num &node) {
+    invariant = true;
+}
+
+void LoopInvariantMover::visit(ast::NumB &node) {
+    invariant = true;
+}
+
+void LoopInvariantMover::visit(ast::String &node) {
+    invariant = true;
+}
+
+void LoopInvariantMover::visit(ast::Bool &node) {
+    invariant = true;
+}
+
+void LoopInvariantMover::visit(ast::ID &node) {
+    invariant = assigned.count(node.computedOffset) == 0;
+}
+
+void LoopInvariantMover::visit(ast::BinOp &node) {
+    bool left = _operand(node.left);
+    bool right = _operand(node.right);
+    // a division that may trap has to stay where it is
+    bool safe = node.op != ast::BinOpType::DIV || nonZeroLiteral(*node.right);
+    invariant = left && right && safe;
+    if (!invariant) {
+        if (left) {
+            _hoist(node.left);
+        }
+        if (right) {
+            _hoist(node.right);
+        }
+    }
+}
+
+void LoopInvariantMover::visit(ast::RelOp &node) {
+    bool left = _operand(node.left);
+    bool right = _operand(node.right);
+    invariant = left && right;
+    if (!invariant) {
+        if (left) {
+            _hoist(node.left);
+        }
+        if (right) {
+            _hoist(node.right);
+        }
+    }
+}
+
+void LoopInvariantMover::visit(ast::Not &node) {
+    invariant = _operand(node.exp);
+}
+
+void LoopInvariantMover::visit(ast::And &node) {
+    bool left = _operand(node.left);
+    bool right = _operand(node.right);
+    invariant = left && right;
+    if (!invariant) {
+        if (left) {
+            _hoist(node.left);
+        }
+        if (right) {
+            _hoist(node.right);
+        }
+    }
+}
+
+void LoopInvariantMover::visit(ast::Or &node) {
+    bool left = _operand(node.left);
+    bool right = _operand(node.right);
+    invariant = left && right;
+    if (!invariant) {
+        if (left) {
+            _hoist(node.left);
+        }
+        if (right) {
+            _hoist(node.right);
+        }
+    }
+}
+
+void LoopInvariantMover::visit(ast::Cast &node) {
+    invariant = _operand(node.exp);
+}
+
+void LoopInvariantMover::visit(ast::ArrayDereference &node) {
+    // the array may be written in the loop, and the index may be out of bounds
+    _exp(node.index);
+    invariant = false;
+}
+
+void LoopInvariantMover::visit(ast::ExpList &node) {
+    for (auto &exp : node.exps) {
+        _exp(exp);
+    }
+}
+
+void LoopInvariantMover::visit(ast::Call &node) {
+    if (node.args) {
+        node.args->accept(*this);
+    }
+    invariant = false;
+}
+
+/* Types */
+
+void LoopInvariantMover::visit(ast::ArrayType &node) {}
+
+void LoopInvariantMover::visit(ast::PrimitiveType &node) {}
+
+/* Statements */
+
+void LoopInvariantMover::visit(ast::ArrayAssign &node) {
+    _exp(node.index);
+    _exp(node.exp);
+}
+
+void LoopInvariantMover::visit(ast::Statements &node) {
+    for (auto &statement : node.statements) {
+        _statement(statement);
+    }
+}
+
+void LoopInvariantMover::visit(ast::Block &node) {
+    node.statements->accept(*this);
+}
+
+void LoopInvariantMover::visit(ast::Break &node) {}
+
+void LoopInvariantMover::visit(ast::Continue &node) {}
+
+void LoopInvariantMover::visit(ast::Return &node) {
+    if (node.exp) {
+        _exp(node.exp);
+    }
+}
+
+void LoopInvariantMover::visit(ast::If &node) {
+    _exp(node.condition);
+    _statement(node.then);
+    if (node.otherwise) {
+        _statement(node.otherwise);
+    }
+}
+
+void LoopInvariantMover::visit(ast::While &node) {
+    if (active) {
+        // nested in the loop being processed: its expressions are that loop's too
+        _exp(node.condition);
+        node.body->accept(*this);
+        return;
+    }
+
+    assigned.clear();
+    AssignmentCollector collector(assigned);
+    node.accept(collector);
+
+    active = true;
+    _exp(node.condition);
+    node.body->accept(*this);
+    active = false;
+    std::vector<std::shared_ptr<ast::Statement>> moved = std::move(hoisted);
+    hoisted.clear();
+    hoistedLocals.clear();
+
+    // then what is invariant only in the nested loops
+    _statement(node.body);
+    declarations = std::move(moved);
+}
+
+void LoopInvariantMover::visit(ast::VarDecl &node) {
+    if (node.init_exp) {
+        _exp(node.init_exp);
+    }
+}
+
+void LoopInvariantMover::visit(ast::Assign &node) {
+    _exp(node.exp);
+}
+
+void LoopInvariantMover::visit(ast::Formal &node) {}
+
+void LoopInvariantMover::visit(ast::Formals &node) {}
+
+void LoopInvariantMover::visit(ast::FuncDecl &node) {
+    function = &node;
+    int before = hoistedCount;
+    node.body->accept(*this);
+    if (hoistedCount > before) {
+        perFunction.emplace_back(node.id->value, hoistedCount - before);
+    }
+}
+
+void LoopInvariantMover::visit(ast::Funcs &node) {
+    for (auto &func : node.funcs) {
+        func->accept(*this);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef LICM_HPP
+#define LICM_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* LoopInvariantMover class
+ * Loop-invariant code motion on a checked tree. In each While, the largest subexpressions whose
+ * variables are never assigned anywhere in the loop (condition and body, nested loops included)
+ * are computed once before it into fresh locals, declared in a Block that wraps the loop:
+ *
+ *     while (i < n * m) { ... }   becomes   { int t = n * m; while (i < t) { ... } }
+ *
+ * Only expressions that are pure and cannot trap are moved, since the loop may run zero times
+ * or leave early through Break: no calls, no array reads, no division by anything but a
+ * non-zero literal. Each new local gets a frame slot past the ones the function already uses,
+ * so nothing else in the frame moves. Outer loops are handled first, so an expression invariant
+ * in several nested loops goes all the way out; identical expressions share one local.
+ */
+class LoopInvariantMover : public Visitor {
+private:
+    ast::FuncDecl *function;
+    // Whether the expressions visited belong to the loop being processed
+    bool active;
+    // Slots assigned or declared anywhere in that loop
+    std::unordered_set<int> assigned;
+    // Whether the expression just visited could be computed before the loop
+    bool invariant;
+    // Declarations of the loop's hoisted expressions, and the local each expression went to
+    std::vector<std::shared_ptr<ast::Statement>> hoisted;
+    std::unordered_map<std::string, std::shared_ptr<ast::ID>> hoistedLocals;
+    // Declarations to put before the statement just visited
+    std::vector<std::shared_ptr<ast::Statement>> declarations;
+    int hoistedCount;
+    std::vector<std::pair<std::string, int>> perFunction;
+
+    void _statement(std::shared_ptr<ast::Statement> &statement);
+    // Visits an operand and returns whether it is invariant, leaving it in place
+    bool _operand(std::shared_ptr<ast::Exp> &exp);
+    // Replaces an invariant expression with a local, unless it is a leaf already
+    void _hoist(std::shared_ptr<ast::Exp> &exp);
+    // Hoists what it can out of a whole expression
+    void _exp(std::shared_ptr<ast::Exp> &exp);
+
+    static std::string _key(const ast::Exp &exp);
+
+public:
+    LoopInvariantMover();
+
+    // Number of expressions hoisted in the whole program
+    int expressionsHoisted() const { return hoistedCount; }
+
+    // Functions with hoisted expressions, in source order, and how many each
+    const std::vector<std::pair<std::string, int>> &hoistedPerFunction() const { return perFunction; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif //LICM_HPP
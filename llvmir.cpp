@@ -0,0 +1,876 @@
+#include "llvmir.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <unistd.h>
+
+namespace llvmir {
+    // Width of a branch target hole: '%' is written before it, then "L<label>" padded with
+    // spaces, or while unpatched the zero-padded position + 1 of the next hole in its list
+    static const size_t holeWidth = 12;
+    static const size_t writeBlock = 1 << 20;
+
+    // Declarations and the runtime every module starts with. User functions are prefixed, so
+    // they cannot clash with these or with the C library. checkStack stops recursion that goes
+    // deeper than 6 MiB below main, which stays inside the usual 8 MiB stack.
+    static const char preamble[] =
+            "declare i32 @printf(i8*, ...)\n"
+            "declare void @exit(i32)\n"
+            "declare void @llvm.memset.p0i8.i64(i8*, i8, i64, i1)\n"
+            "\n"
+            "@.int = private unnamed_addr constant [4 x i8] c\"%d\\0A\\00\"\n"
+            "@.str = private unnamed_addr constant [4 x i8] c\"%s\\0A\\00\"\n"
+            "@.divisionByZero = private unnamed_addr constant [23 x i8] c\"Error division by zero\\00\"\n"
+            "@.outOfBounds = private unnamed_addr constant [20 x i8] c\"Error out of bounds\\00\"\n"
+            "@.stackOverflow = private unnamed_addr constant [21 x i8] c\"Error stack overflow\\00\"\n"
+            "@.stackBase = internal global i64 0\n"
+            "\n"
+            "define internal void @printi(i32 %value) {\n"
+            "  %format = getelementptr inbounds [4 x i8], [4 x i8]* @.int, i32 0, i32 0\n"
+            "  call i32 (i8*, ...) @printf(i8* %format, i32 %value)\n"
+            "  ret void\n"
+            "}\n"
+            "\n"
+            "define internal void @print(i8* %string) {\n"
+            "  %format = getelementptr inbounds [4 x i8], [4 x i8]* @.str, i32 0, i32 0\n"
+            "  call i32 (i8*, ...) @printf(i8* %format, i8* %string)\n"
+            "  ret void\n"
+            "}\n"
+            "\n"
+            "define internal void @trap(i8* %message) {\n"
+            "  call void @print(i8* %message)\n"
+            "  call void @exit(i32 1)\n"
+            "  unreachable\n"
+            "}\n"
+            "\n"
+            "define internal void @checkStack() {\n"
+            "  %here = alloca i8\n"
+            "  %address = ptrtoint i8* %here to i64\n"
+            "  %base = load i64, i64* @.stackBase\n"
+            "  %used = sub i64 %base, %address\n"
+            "  %over = icmp ugt i64 %used, 6291456\n"
+            "  br i1 %over, label %overflow, label %ok\n"
+            "overflow:\n"
+            "  call void @trap(i8* getelementptr inbounds ([21 x i8], [21 x i8]* @.stackOverflow, i32 0, i32 0))\n"
+            "  unreachable\n"
+            "ok:\n"
+            "  ret void\n"
+            "}\n"
+            "\n"
+            "define i32 @main() {\n"
+            "  %here = alloca i8\n"
+            "  %address = ptrtoint i8* %here to i64\n"
+            "  store i64 %address, i64* @.stackBase\n"
+            "  call void @fn.main()\n"
+            "  ret i32 0\n"
+            "}\n";
+
+    static const char *predicate(ast::RelOpType op) {
+        switch (op) {
+            case ast::RelOpType::EQ:
+                return "eq";
+            case ast::RelOpType::NE:
+                return "ne";
+            case ast::RelOpType::LT:
+                return "slt";
+            case ast::RelOpType::GT:
+                return "sgt";
+            case ast::RelOpType::LE:
+                return "sle";
+            case ast::RelOpType::GE:
+                return "sge";
+        }
+        return "eq";
+    }
+
+    Emitter::Emitter(size_t capacity)
+            : result{true, 0}, params(0), nextTemp(0), nextLabel(0), terminated(false),
+              usesDivisionTrap(false), usesBoundsTrap(false) {
+        text.reserve(capacity);
+    }
+
+    bool Emitter::write(int fd) const {
+        const char *data = text.data();
+        size_t size = text.size();
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, std::min(size, writeBlock));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    /* Output helpers */
+
+    void Emitter::_putInt(long long value) {
+        char digits[24];
+        auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+        _put(digits, end - digits);
+    }
+
+    void Emitter::_putValue(Value value) {
+        if (!value.constant) {
+            _put("%t");
+        }
+        _putInt(value.number);
+    }
+
+    void Emitter::_putSlot(int slot) {
+        _put("%s");
+        _putInt(slot);
+    }
+
+    Emitter::Value Emitter::_define() {
+        Value value{false, nextTemp++};
+        _put("  ");
+        _putValue(value);
+        _put(" = ");
+        return value;
+    }
+
+    int Emitter::_label() {
+        int label = nextLabel++;
+        if (!terminated) {
+            _put("  br label %L");
+            _putInt(label);
+            _put("\n");
+        }
+        _put("L");
+        _putInt(label);
+        _put(":\n");
+        terminated = false;
+        return label;
+    }
+
+    void Emitter::_open() {
+        if (terminated) {
+            _label();
+        }
+    }
+
+    /* Backpatching */
+
+    // Writes `link` as the hole at `hole`
+    static void setHole(std::string &text, size_t hole, size_t link) {
+        for (size_t i = holeWidth; i-- > 0; link /= 10) {
+            text[hole - 1 + i] = static_cast<char>('0' + link % 10);
+        }
+    }
+
+    static size_t nextHole(const std::string &text, size_t hole) {
+        size_t next = 0;
+        for (size_t i = 0; i < holeWidth; ++i) {
+            next = next * 10 + (text[hole - 1 + i] - '0');
+        }
+        return next;
+    }
+
+    Emitter::HoleList Emitter::_hole(HoleList list) {
+        size_t hole = text.size() + 1;
+        text.append(holeWidth, '0');
+        setHole(text, hole, list.head);
+        return {hole, list.head ? list.tail : hole};
+    }
+
+    Emitter::HoleList Emitter::_merge(HoleList first, HoleList second) {
+        if (!first.head) {
+            return second;
+        }
+        if (!second.head) {
+            return first;
+        }
+        setHole(text, first.tail, second.head);
+        return {first.head, second.tail};
+    }
+
+    void Emitter::_backpatch(HoleList list, int label) {
+        char name[holeWidth];
+        name[0] = 'L';
+        char *end = std::to_chars(name + 1, name + holeWidth, label).ptr;
+        std::fill(end, name + holeWidth, ' ');
+        for (size_t hole = list.head; hole;) {
+            size_t next = nextHole(text, hole);
+            std::copy(name, name + holeWidth, text.begin() + (hole - 1));
+            hole = next;
+        }
+    }
+
+    Emitter::HoleList Emitter::_jump(HoleList list) {
+        _put("  br label %");
+        list = _hole(list);
+        _put("\n");
+        terminated = true;
+        return list;
+    }
+
+    /* Expressions */
+
+    Emitter::Value Emitter::_value(ast::Exp &exp) {
+        exp.accept(*this);
+        return result;
+    }
+
+    Emitter::Value Emitter::_shift(ast::BinOp &node, Value left) {
+        bool isByte = node.computedType == ast::BuiltInType::BYTE;
+        int shift = node.computedShift;
+        Value value;
+        if (node.op == ast::BinOpType::MUL) {
+            value = _define();
+            _put("shl i32 ");
+            _putValue(left);
+            _put(", ");
+            _putInt(shift);
+            _put("\n");
+            if (isByte) {
+                Value truncated = _define();
+                _put("and i32 ");
+                _putValue(value);
+                _put(", 255\n");
+                value = truncated;
+            }
+            return value;
+        }
+        if (isByte) {
+            value = _define();
+            _put("lshr i32 ");
+            _putValue(left);
+            _put(", ");
+            _putInt(shift);
+            _put("\n");
+            return value;
+        }
+
+        // a negative dividend is biased by 2^shift - 1, so the shift rounds toward zero
+        Value sign = _define();
+        _put("ashr i32 ");
+        _putValue(left);
+        _put(", 31\n");
+        Value bias = _define();
+        _put("lshr i32 ");
+        _putValue(sign);
+        _put(", ");
+        _putInt(32 - shift);
+        _put("\n");
+        Value biased = _define();
+        _put("add i32 ");
+        _putValue(left);
+        _put(", ");
+        _putValue(bias);
+        _put("\n");
+        value = _define();
+        _put("ashr i32 ");
+        _putValue(biased);
+        _put(", ");
+        _putInt(shift);
+        _put("\n");
+        return value;
+    }
+
+    Emitter::Value Emitter::_compare(ast::RelOp &node) {
+        Value left = _value(*node.left);
+        Value right = _value(*node.right);
+        Value bit = _define();
+        _put("icmp ");
+        const char *name = predicate(node.op);
+        _put(name, std::strlen(name));
+        _put(" i32 ");
+        _putValue(left);
+        _put(", ");
+        _putValue(right);
+        _put("\n");
+        return bit;
+    }
+
+    Emitter::Lists Emitter::_condition(ast::Exp &exp) {
+        if (auto boolean = dynamic_cast<ast::Bool *>(&exp)) {
+            HoleList list = _jump({});
+            return boolean->value ? Lists{list, {}} : Lists{{}, list};
+        }
+
+        if (auto notExp = dynamic_cast<ast::Not *>(&exp)) {
+            Lists lists = _condition(*notExp->exp);
+            return {lists.falseList, lists.trueList};
+        }
+
+        if (auto andExp = dynamic_cast<ast::And *>(&exp)) {
+            Lists left = _condition(*andExp->left);
+            _backpatch(left.trueList, _label());
+            Lists right = _condition(*andExp->right);
+            return {right.trueList, _merge(left.falseList, right.falseList)};
+        }
+
+        if (auto orExp = dynamic_cast<ast::Or *>(&exp)) {
+            Lists left = _condition(*orExp->left);
+            _backpatch(left.falseList, _label());
+            Lists right = _condition(*orExp->right);
+            return {_merge(left.trueList, right.trueList), right.falseList};
+        }
+
+        Value bit;
+        if (auto relOp = dynamic_cast<ast::RelOp *>(&exp)) {
+            bit = _compare(*relOp);
+        } else {
+            Value value = _value(exp);
+            bit = _define();
+            _put("icmp ne i32 ");
+            _putValue(value);
+            _put(", 0\n");
+        }
+        _put("  br i1 ");
+        _putValue(bit);
+        _put(", label %");
+        Lists lists{_hole({}), {}};
+        _put(", label %");
+        lists.falseList = _hole({});
+        _put("\n");
+        terminated = true;
+        return lists;
+    }
+
+    Emitter::Value Emitter::_materialize(Lists lists) {
+        int end = nextLabel++;
+        int isTrue = _label();
+        _backpatch(lists.trueList, isTrue);
+        _put("  br label %L");
+        _putInt(end);
+        _put("\n");
+        terminated = true;
+        int isFalse = _label();
+        _backpatch(lists.falseList, isFalse);
+        _put("  br label %L");
+        _putInt(end);
+        _put("\nL");
+        _putInt(end);
+        _put(":\n");
+        terminated = false;
+
+        Value value = _define();
+        _put("phi i32 [1, %L");
+        _putInt(isTrue);
+        _put("], [0, %L");
+        _putInt(isFalse);
+        _put("]\n");
+        return value;
+    }
+
+    void Emitter::_checkIndex(Value index, int length) {
+        if (index.constant && index.number >= 0 && index.number < length) {
+            return;
+        }
+        usesBoundsTrap = true;
+        // unsigned, so negative indices fail too
+        Value outside = _define();
+        _put("icmp uge i32 ");
+        _putValue(index);
+        _put(", ");
+        _putInt(length);
+        _put("\n  br i1 ");
+        _putValue(outside);
+        _put(", label %outOfBounds, label %L");
+        _putInt(nextLabel);
+        _put("\n");
+        terminated = true;
+        _label();
+    }
+
+    void Emitter::visit(ast::Num &node) {
+        result = {true, node.value};
+    }
+
+    void Emitter::visit(ast::NumB &node) {
+        result = {true, node.value};
+    }
+
+    void Emitter::visit(ast::String &node) {}
+
+    void Emitter::visit(ast::Bool &node) {
+        result = {true, node.value};
+    }
+
+    void Emitter::visit(ast::ID &node) {
+        Value value = _define();
+        _put("load i32, i32* ");
+        _putSlot(node.computedOffset + params);
+        _put("\n");
+        result = value;
+    }
+
+    void Emitter::visit(ast::BinOp &node) {
+        bool isByte = node.computedType == ast::BuiltInType::BYTE;
+        Value left = _value(*node.left);
+        Value right = _value(*node.right);
+
+        if (node.computedShift > 0) {
+            result = _shift(node, left);
+            return;
+        }
+
+        if (node.op == ast::BinOpType::DIV) {
+            if (right.constant && right.number == 0) {
+                usesDivisionTrap = true;
+                _put("  br label %divisionByZero\n");
+                terminated = true;
+                _open();
+                result = {true, 0};
+                return;
+            }
+            if (!right.constant) {
+                usesDivisionTrap = true;
+                Value zero = _define();
+                _put("icmp eq i32 ");
+                _putValue(right);
+                _put(", 0\n  br i1 ");
+                _putValue(zero);
+                _put(", label %divisionByZero, label %L");
+                _putInt(nextLabel);
+                _put("\n");
+                terminated = true;
+                _label();
+            }
+        }
+
+        Value value;
+        switch (node.op) {
+            case ast::BinOpType::ADD:
+                value = _define();
+                _put("add i32 ");
+                break;
+            case ast::BinOpType::SUB:
+                value = _define();
+                _put("sub i32 ");
+                break;
+            case ast::BinOpType::MUL:
+                value = _define();
+                _put("mul i32 ");
+                break;
+            case ast::BinOpType::DIV:
+                if (isByte) {
+                    // bytes are never negative, so unsigned division gives the same result
+                    value = _define();
+                    _put("udiv i32 ");
+                    break;
+                }
+                if (right.constant && right.number != -1) {
+                    value = _define();
+                    _put("sdiv i32 ");
+                    break;
+                }
+                if (right.constant) {
+                    // INT_MIN / -1 wraps to INT_MIN like every other int operation
+                    value = _define();
+                    _put("sub i32 0, ");
+                    _putValue(left);
+                    _put("\n");
+                    result = value;
+                    return;
+                }
+                {
+                    // sdiv traps on INT_MIN / -1, so divide by 1 instead and negate
+                    Value isMinusOne = _define();
+                    _put("icmp eq i32 ");
+                    _putValue(right);
+                    _put(", -1\n");
+                    Value divisor = _define();
+                    _put("select i1 ");
+                    _putValue(isMinusOne);
+                    _put(", i32 1, i32 ");
+                    _putValue(right);
+                    _put("\n");
+                    Value quotient = _define();
+                    _put("sdiv i32 ");
+                    _putValue(left);
+                    _put(", ");
+                    _putValue(divisor);
+                    _put("\n");
+                    Value negated = _define();
+                    _put("sub i32 0, ");
+                    _putValue(left);
+                    _put("\n");
+                    value = _define();
+                    _put("select i1 ");
+                    _putValue(isMinusOne);
+                    _put(", i32 ");
+                    _putValue(negated);
+                    _put(", i32 ");
+                    _putValue(quotient);
+                    _put("\n");
+                    result = value;
+                    return;
+                }
+        }
+        _putValue(left);
+        _put(", ");
+        _putValue(right);
+        _put("\n");
+
+        if (isByte && node.op != ast::BinOpType::DIV) {
+            Value truncated = _define();
+            _put("and i32 ");
+            _putValue(value);
+            _put(", 255\n");
+            value = truncated;
+        }
+        result = value;
+    }
+
+    void Emitter::visit(ast::RelOp &node) {
+        Value bit = _compare(node);
+        result = _define();
+        _put("zext i1 ");
+        _putValue(bit);
+        _put(" to i32\n");
+    }
+
+    void Emitter::visit(ast::Not &node) {
+        Value value = _value(*node.exp);
+        result = _define();
+        _put("xor i32 ");
+        _putValue(value);
+        _put(", 1\n");
+    }
+
+    void Emitter::visit(ast::And &node) {
+        result = _materialize(_condition(node));
+    }
+
+    void Emitter::visit(ast::Or &node) {
+        result = _materialize(_condition(node));
+    }
+
+    void Emitter::visit(ast::Cast &node) {
+        Value value = _value(*node.exp);
+        if (node.target_type->computedType == ast::BuiltInType::BYTE &&
+            node.exp->computedType != ast::BuiltInType::BYTE) {
+            result = _define();
+            _put("and i32 ");
+            _putValue(value);
+            _put(", 255\n");
+        } else {
+            result = value;
+        }
+    }
+
+    void Emitter::visit(ast::ArrayDereference &node) {
+        Value index = _value(*node.index);
+        if (!node.computedInBounds) {
+            _checkIndex(index, node.id->computedArrLength);
+        }
+        // a zero-length array has no slot, and the check above always fails
+        if (node.id->computedArrLength == 0) {
+            result = {true, 0};
+            return;
+        }
+        Value element = _define();
+        _put("getelementptr inbounds i32, i32* ");
+        _putSlot(node.id->computedOffset + params);
+        _put(", i32 ");
+        _putValue(index);
+        _put("\n");
+        result = _define();
+        _put("load i32, i32* ");
+        _putValue(element);
+        _put("\n");
+    }
+
+    void Emitter::visit(ast::ExpList &node) {}
+
+    void Emitter::_call(ast::Call &node) {
+        const std::string &name = node.func_id->value;
+        result = {true, 0};
+
+        if (name == "print") {
+            auto literal = dynamic_cast<ast::String *>(node.args->exps[0].get());
+            auto found = stringGlobals.find(literal->index);
+            if (found == stringGlobals.end()) {
+                found = stringGlobals.emplace(literal->index, static_cast<int>(strings.size())).first;
+                strings.push_back(&literal->value());
+            }
+            size_t length = literal->value().size() + 1;
+            _put("  call void @print(i8* getelementptr inbounds ([");
+            _putInt(length);
+            _put(" x i8], [");
+            _putInt(length);
+            _put(" x i8]* @.s");
+            _putInt(found->second);
+            _put(", i32 0, i32 0))\n");
+            return;
+        }
+
+        // 32 arguments fit in place; more are rare enough to allocate
+        Value inPlace[32];
+        std::vector<Value> spilled;
+        size_t count = node.args->exps.size();
+        Value *args = inPlace;
+        if (count > 32) {
+            spilled.resize(count);
+            args = spilled.data();
+        }
+        for (size_t i = 0; i < count; ++i) {
+            args[i] = _value(*node.args->exps[i]);
+        }
+
+        if (name == "printi") {
+            _put("  call void @printi(i32 ");
+            _putValue(args[0]);
+            _put(")\n");
+            return;
+        }
+
+        if (node.computedType == ast::BuiltInType::VOID) {
+            _put("  call void @fn.");
+        } else {
+            result = _define();
+            _put("call i32 @fn.");
+        }
+        _put(name);
+        _put("(");
+        for (size_t i = 0; i < count; ++i) {
+            _put(i ? ", i32 " : "i32 ");
+            _putValue(args[i]);
+        }
+        _put(")\n");
+    }
+
+    void Emitter::visit(ast::Call &node) {
+        _call(node);
+    }
+
+    void Emitter::_string(const std::string &literal) {
+        static const char hex[] = "0123456789ABCDEF";
+        for (char c : literal) {
+            if (c >= ' ' && c <= '~' && c != '"' && c != '\\') {
+                text += c;
+            } else {
+                char escape[3] = {'\\', hex[(c >> 4) & 0xF], hex[c & 0xF]};
+                _put(escape, 3);
+            }
+        }
+    }
+
+    /* Types */
+
+    void Emitter::visit(ast::ArrayType &node) {}
+
+    void Emitter::visit(ast::PrimitiveType &node) {}
+
+    /* Statements */
+
+    void Emitter::visit(ast::ArrayAssign &node) {
+        Value index = _value(*node.index);
+        Value value = _value(*node.exp);
+        if (!node.computedInBounds) {
+            _checkIndex(index, node.id->computedArrLength);
+        }
+        if (node.id->computedArrLength == 0) {
+            return;
+        }
+        Value element = _define();
+        _put("getelementptr inbounds i32, i32* ");
+        _putSlot(node.id->computedOffset + params);
+        _put(", i32 ");
+        _putValue(index);
+        _put("\n  store i32 ");
+        _putValue(value);
+        _put(", i32* ");
+        _putValue(element);
+        _put("\n");
+    }
+
+    void Emitter::visit(ast::Statements &node) {
+        for (auto &statement : node.statements) {
+            _open();
+            statement->accept(*this);
+        }
+    }
+
+    void Emitter::visit(ast::Block &node) {
+        node.statements->accept(*this);
+    }
+
+    void Emitter::visit(ast::Break &node) {
+        breakLists.back() = _jump(breakLists.back());
+    }
+
+    void Emitter::visit(ast::Continue &node) {
+        _put("  br label %L");
+        _putInt(continueLabels.back());
+        _put("\n");
+        terminated = true;
+    }
+
+    void Emitter::visit(ast::Return &node) {
+        if (node.exp) {
+            Value value = _value(*node.exp);
+            _put("  ret i32 ");
+            _putValue(value);
+            _put("\n");
+        } else {
+            _put("  ret void\n");
+        }
+        terminated = true;
+    }
+
+    void Emitter::visit(ast::If &node) {
+        Lists lists = _condition(*node.condition);
+        _backpatch(lists.trueList, _label());
+        node.then->accept(*this);
+        if (node.otherwise) {
+            HoleList next = terminated ? HoleList() : _jump({});
+            _backpatch(lists.falseList, _label());
+            node.otherwise->accept(*this);
+            _backpatch(next, _label());
+        } else {
+            _backpatch(lists.falseList, _label());
+        }
+    }
+
+    void Emitter::visit(ast::While &node) {
+        int condition = _label();
+        Lists lists = _condition(*node.condition);
+        _backpatch(lists.trueList, _label());
+
+        continueLabels.push_back(condition);
+        breakLists.emplace_back();
+        node.body->accept(*this);
+        HoleList breaks = breakLists.back();
+        continueLabels.pop_back();
+        breakLists.pop_back();
+
+        if (!terminated) {
+            _put("  br label %L");
+            _putInt(condition);
+            _put("\n");
+            terminated = true;
+        }
+        _backpatch(_merge(lists.falseList, breaks), _label());
+    }
+
+    void Emitter::visit(ast::VarDecl &node) {
+        int slot = node.id->computedOffset + params;
+        if (node.type->computedIsArray) {
+            int length = node.type->computedArrLength;
+            if (length > 0) {
+                Value bytes = _define();
+                _put("bitcast i32* ");
+                _putSlot(slot);
+                _put(" to i8*\n  call void @llvm.memset.p0i8.i64(i8* ");
+                _putValue(bytes);
+                _put(", i8 0, i64 ");
+                _putInt(4LL * length);
+                _put(", i1 false)\n");
+            }
+            return;
+        }
+
+        Value value = node.init_exp ? _value(*node.init_exp) : Value{true, 0};
+        _put("  store i32 ");
+        _putValue(value);
+        _put(", i32* ");
+        _putSlot(slot);
+        _put("\n");
+    }
+
+    void Emitter::visit(ast::Assign &node) {
+        Value value = _value(*node.exp);
+        _put("  store i32 ");
+        _putValue(value);
+        _put(", i32* ");
+        _putSlot(node.id->computedOffset + params);
+        _put("\n");
+    }
+
+    void Emitter::visit(ast::Formal &node) {}
+
+    void Emitter::visit(ast::Formals &node) {}
+
+    void Emitter::visit(ast::FuncDecl &node) {
+        params = static_cast<int>(node.formals->formals.size());
+        int slots = params + node.computedFrameSize;
+        bool isVoid = node.return_type->computedType == ast::BuiltInType::VOID;
+        nextTemp = 0;
+        nextLabel = 0;
+        terminated = false;
+        usesDivisionTrap = false;
+        usesBoundsTrap = false;
+
+        _put(isVoid ? "\ndefine internal void @fn." : "\ndefine internal i32 @fn.");
+        _put(node.id->value);
+        _put("(");
+        for (int i = 0; i < params; ++i) {
+            _put(i ? ", i32 %p" : "i32 %p");
+            _putInt(i);
+        }
+        _put(") {\nentry:\n");
+
+        // one array holds every slot; each slot gets a pointer of its own up front
+        if (slots > 0) {
+            _put("  %frame = alloca [");
+            _putInt(slots);
+            _put(" x i32]\n");
+        }
+        for (int slot = 0; slot < slots; ++slot) {
+            _put("  ");
+            _putSlot(slot);
+            _put(" = getelementptr inbounds [");
+            _putInt(slots);
+            _put(" x i32], [");
+            _putInt(slots);
+            _put(" x i32]* %frame, i32 0, i32 ");
+            _putInt(slot);
+            _put("\n");
+        }
+        _put("  call void @checkStack()\n");
+        // parameter slots are numbered from the last parameter
+        for (int i = 0; i < params; ++i) {
+            _put("  store i32 %p");
+            _putInt(i);
+            _put(", i32* ");
+            _putSlot(params - 1 - i);
+            _put("\n");
+        }
+
+        node.body->accept(*this);
+
+        // falling off the end of a function that returns a value returns 0
+        if (!terminated) {
+            _put(isVoid ? "  ret void\n" : "  ret i32 0\n");
+        }
+        if (usesDivisionTrap) {
+            _put("divisionByZero:\n"
+                 "  call void @trap(i8* getelementptr inbounds ([23 x i8], [23 x i8]* @.divisionByZero, i32 0, i32 0))\n"
+                 "  unreachable\n");
+        }
+        if (usesBoundsTrap) {
+            _put("outOfBounds:\n"
+                 "  call void @trap(i8* getelementptr inbounds ([20 x i8], [20 x i8]* @.outOfBounds, i32 0, i32 0))\n"
+                 "  unreachable\n");
+        }
+        _put("}\n");
+    }
+
+    void Emitter::visit(ast::Funcs &node) {
+        _put(preamble);
+        for (auto &func : node.funcs) {
+            func->accept(*this);
+        }
+
+        if (!strings.empty()) {
+            _put("\n");
+        }
+        for (size_t i = 0; i < strings.size(); ++i) {
+            const std::string &literal = *strings[i];
+            _put("@.s");
+            _putInt(i);
+            _put(" = private unnamed_addr constant [");
+            _putInt(literal.size() + 1);
+            _put(" x i8] c\"");
+            _string(literal);
+            _put("\\00\"\n");
+        }
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef LLVMIR_HPP
+#define LLVMIR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+namespace llvmir {
+    /* Emitter class
+     * Generates textual LLVM IR for a checked program, runnable with lli. Every value is an i32
+     * (bytes are kept truncated to 8 bits, booleans are 0 or 1) and every variable slot of a
+     * function lives in one stack array, so the IR needs no type information beyond the AST.
+     *
+     * Conditions are lowered to branches with backpatching: a condition produces a true list and
+     * a false list of branch targets still to be filled in, and each target is a fixed-width hole
+     * in the output. Until it is patched, a hole holds the position of the next hole of its list,
+     * so the lists are threaded through the text itself and cost no allocation.
+     *
+     * All of the IR is appended to one buffer reserved up front; instructions are written piece
+     * by piece, never formatted into temporary strings.
+     */
+    class Emitter : public Visitor {
+    private:
+        std::string text;
+
+        // A value operand: a temporary %t<number>, or a constant
+        struct Value {
+            bool constant;
+            int32_t number;
+        };
+
+        // Holes chained through the text, each naming the next by position + 1. The list names
+        // its first and last hole the same way, so lists are merged without walking them; a head
+        // of 0 is the empty list.
+        struct HoleList {
+            size_t head = 0;
+            size_t tail = 0;
+        };
+
+        // Holes of a condition to patch with the label where each outcome goes
+        struct Lists {
+            HoleList trueList;
+            HoleList falseList;
+        };
+
+        // Value of the expression visited last
+        Value result;
+
+        // State of the function being emitted
+        int params;
+        int nextTemp;
+        int nextLabel;
+        // Whether the current block already ended with a terminator
+        bool terminated;
+        bool usesDivisionTrap;
+        bool usesBoundsTrap;
+        // Innermost loop last: the label continue jumps to, and the list of breaks
+        std::vector<int> continueLabels;
+        std::vector<HoleList> breakLists;
+
+        // String pool entries printed, emitted as globals after the functions, and the global
+        // each one's index became
+        std::vector<const std::string *> strings;
+        std::unordered_map<int, int> stringGlobals;
+
+        void _put(const char *data, size_t size) { text.append(data, size); }
+        template<size_t N>
+        void _put(const char (&literal)[N]) { text.append(literal, N - 1); }
+        void _put(const std::string &value) { text.append(value); }
+        void _putInt(long long value);
+        void _putValue(Value value);
+        void _putSlot(int slot);
+
+        // Starts an instruction defining a new temporary and returns it
+        Value _define();
+        // Starts a new block with a fresh label, ending the current one with a jump to it if it is
+        // still open, and returns the label
+        int _label();
+        // Code after a jump or return is unreachable but still needs a block of its own
+        void _open();
+
+        // Writes a hole chained in front of `list` and returns the list starting with it
+        HoleList _hole(HoleList list);
+        HoleList _merge(HoleList first, HoleList second);
+        void _backpatch(HoleList list, int label);
+        // Unconditional jump to a hole; returns the list with it
+        HoleList _jump(HoleList list);
+
+        Value _value(ast::Exp &exp);
+        Lists _condition(ast::Exp &exp);
+        // 0 or 1 from a condition's lists
+        Value _materialize(Lists lists);
+        Value _compare(ast::RelOp &node);
+        // A multiplication or division by 2^computedShift, as shifts
+        Value _shift(ast::BinOp &node, Value left);
+        void _call(ast::Call &node);
+        void _checkIndex(Value index, int length);
+        // Writes decoded text as the contents of an LLVM string constant
+        void _string(const std::string &literal);
+
+    public:
+        // The output buffer starts with room for `capacity` bytes
+        explicit Emitter(size_t capacity = 1 << 20);
+
+        // The module text
+        const std::string &ir() const { return text; }
+        bool write(int fd) const;
+
+        void visit(ast::Num &node) override;
+        void visit(ast::NumB &node) override;
+        void visit(ast::String &node) override;
+        void visit(ast::Bool &node) override;
+        void visit(ast::ID &node) override;
+        void visit(ast::BinOp &node) override;
+        void visit(ast::RelOp &node) override;
+        void visit(ast::Not &node) override;
+        void visit(ast::And &node) override;
+        void visit(ast::Or &node) override;
+        void visit(ast::ArrayType &node) override;
+        void visit(ast::PrimitiveType &node) override;
+        void visit(ast::ArrayDereference &node) override;
+        void visit(ast::ArrayAssign &node) override;
+        void visit(ast::Cast &node) override;
+        void visit(ast::ExpList &node) override;
+        void visit(ast::Call &node) override;
+        void visit(ast::Statements &node) override;
+        void visit(ast::Block &node) override;
+        void visit(ast::Break &node) override;
+        void visit(ast::Continue &node) override;
+        void visit(ast::Return &node) override;
+        void visit(ast::If &node) override;
+        void visit(ast::While &node) override;
+        void visit(ast::VarDecl &node) override;
+        void visit(ast::Assign &node) override;
+        void visit(ast::Formal &node) override;
+        void visit(ast::Formals &node) override;
+        void visit(ast::FuncDecl &node) override;
+        void visit(ast::Funcs &node) override;
+    };
+}
+
+#endif //LLVMIR_HPP
@@ -1,17 +1,556 @@
-#include "output.hpp"
-#include "nodes.hpp"
-#include "semanticvisitor.hpp"
-
-// Extern from the bison-generated parser
-extern int yyparse();
-
-extern std::shared_ptr<ast::Node> program;
-
-int main() {
-    // Parse the input. The result is stored in the global variable `program`
-    yyparse();
-
-    // run semantic analysis
-    SemanticVisitor semanticVisitor;
-    program->accept(semanticVisitor);
-}
+#include "output.hpp"
+#include "nodes.hpp"
+#include "semanticvisitor.hpp"
+#include "funccache.hpp"
+#include "server.hpp"
+#include "batch.hpp"
+#include "query.hpp"
+#include "driver.hpp"
+#include "tailcall.hpp"
+#include "inliner.hpp"
+#include "constfold.hpp"
+#include "simplify.hpp"
+#include "dataflow.hpp"
+#include "deadcode.hpp"
+#include "licm.hpp"
+#include "bounds.hpp"
+#include "vectorize.hpp"
+#include "vm.hpp"
+#include "jit.hpp"
+#include "llvmir.hpp"
+#include "elfobject.hpp"
+#include "ssa.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+
+// Extern from the bison-generated parser
+extern int yyparse();
+
+static void usage() {
+    std::cerr << "usage: hw3 [--tce] [--inline] [--fold] [--simplify] [--dce] [--licm] [--bce] [--vectorize]\n"
+                 "           [--warnings] [--dump-format=text|json | --run | --jit | --emit-llvm |\n"
+                 "            --emit-object FILE | --dump-ssa] [--ssa-stats] [--stats[=FILE]] [--trace FILE] < program\n"
+                 "       hw3 (--incremental[=DIR] | --stream) [--stats[=FILE]] [--trace FILE] < program\n"
+                 "       hw3 --batch[=stream] [--jobs=N] [--incremental[=DIR]] [--stats[=FILE]] [--trace FILE]\n"
+                 "           [FILE... | < list of files]\n"
+                 "       hw3 --serve SOCKET [--jobs=N] [--stats[=FILE]] [--trace FILE]\n"
+                 "       hw3 --connect SOCKET < program\n"
+                 "       hw3 --check-function NAME < program\n"
+                 "       hw3 --resolve LINE:NAME < program" << std::endl;
+}
+
+static CompileServer *runningServer = nullptr;
+
+static void stopServer(int) {
+    runningServer->stop();
+}
+
+// Answers a single editor query without checking the rest of the program
+static int runQuery(const char *checkName, const char *resolveArg) {
+    auto funcs = std::dynamic_pointer_cast<ast::Funcs>(program);
+    QueryEngine engine(funcs);
+
+    if (checkName) {
+        const QueryEngine::FunctionResult &result = engine.checkFunction(checkName);
+        std::cout << (result.ok ? result.scopes : result.error);
+        return 0;
+    }
+
+    const char *colon = strchr(resolveArg, ':');
+    if (!colon) {
+        usage();
+        return 1;
+    }
+    std::cout << engine.describeAt(atoi(resolveArg), colon + 1);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Reuse per-function results stored by earlier runs in this directory
+    const char *cacheDir = nullptr;
+    // Run as a compile server, or hand the program to one
+    const char *serveSocket = nullptr;
+    const char *connectSocket = nullptr;
+    // Single queries for editors
+    const char *checkName = nullptr;
+    const char *resolveArg = nullptr;
+    // Check many files on a pool of workers, each output to its own .res file or all of them
+    // framed on stdout
+    bool batch = false;
+    bool batchStream = false;
+    // Worker threads of --batch and --serve, 0 for one per hardware thread
+    int jobs = 0;
+    std::vector<std::string> batchPaths;
+    // Check one function at a time to bound memory on huge programs
+    bool stream = false;
+    // Optimization passes run on the checked tree
+    bool tailCalls = false;
+    bool inlining = false;
+    bool fold = false;
+    bool simplify = false;
+    bool dce = false;
+    bool licm = false;
+    // Leave out the bounds checks of array accesses proven in range
+    bool bce = false;
+    // Run counted array loops a vector of iterations at a time
+    bool vectorize = false;
+    // Flow analyses on every function
+    bool warnings = false;
+    // Scope dump as newline-delimited JSON, written while the program is being checked
+    bool jsonDump = false;
+    // Execute the checked program instead of printing its scopes
+    bool run = false;
+    // Run it as native code instead
+    bool jit = false;
+    // Print the program as LLVM IR instead of its scopes
+    bool emitLLVM = false;
+    // Write a relocatable ELF object to link into an executable
+    const char *objectPath = nullptr;
+    // Lower to SSA and optimize it: print the IR instead of the scopes, or count what the
+    // passes remove
+    bool dumpSSA = false;
+    bool ssaStats = false;
+    // Report phase times, front-end counters and peak memory to stderr, or as JSON to a file
+    // if one is named; needs a FANC_STATS build
+    const char *statsArg = nullptr;
+    // Write a Chrome trace of the phases, passes and functions
+    const char *tracePath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveSocket = argv[++i];
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            connectSocket = argv[++i];
+        } else if (strcmp(argv[i], "--check-function") == 0 && i + 1 < argc) {
+            checkName = argv[++i];
+        } else if (strcmp(argv[i], "--resolve") == 0 && i + 1 < argc) {
+            resolveArg = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (strcmp(argv[i], "--batch=stream") == 0) {
+            batch = true;
+            batchStream = true;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = atoi(argv[i] + 7);
+        } else if (argv[i][0] != '-') {
+            batchPaths.emplace_back(argv[i]);
+        } else if (strcmp(argv[i], "--tce") == 0) {
+            tailCalls = true;
+        } else if (strcmp(argv[i], "--inline") == 0) {
+            inlining = true;
+        } else if (strcmp(argv[i], "--fold") == 0) {
+            fold = true;
+        } else if (strcmp(argv[i], "--simplify") == 0) {
+            simplify = true;
+        } else if (strcmp(argv[i], "--dce") == 0) {
+            dce = true;
+        } else if (strcmp(argv[i], "--licm") == 0) {
+            licm = true;
+        } else if (strcmp(argv[i], "--bce") == 0) {
+            bce = true;
+        } else if (strcmp(argv[i], "--vectorize") == 0) {
+            vectorize = true;
+        } else if (strcmp(argv[i], "--warnings") == 0) {
+            warnings = true;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run = true;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            run = true;
+            jit = true;
+        } else if (strcmp(argv[i], "--emit-object") == 0 && i + 1 < argc) {
+            objectPath = argv[++i];
+        } else if (strcmp(argv[i], "--emit-llvm") == 0) {
+            emitLLVM = true;
+        } else if (strcmp(argv[i], "--dump-ssa") == 0) {
+            dumpSSA = true;
+        } else if (strcmp(argv[i], "--ssa-stats") == 0) {
+            ssaStats = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsArg = "";
+        } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+            statsArg = argv[i] + 8;
+        } else if (strcmp(argv[i], "--dump-format=json") == 0) {
+            jsonDump = true;
+        } else if (strcmp(argv[i], "--dump-format=text") == 0) {
+            jsonDump = false;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            cacheDir = ".hw3cache";
+        } else if (strncmp(argv[i], "--incremental=", 14) == 0) {
+            cacheDir = argv[i] + 14;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!batchPaths.empty() && !batch) {
+        usage();
+        return 1;
+    }
+    // the batch checker only checks and writes the scope dumps, so any other mode, pass or
+    // backend would be silently ignored
+    if (batch && (serveSocket || connectSocket || checkName || resolveArg || stream || tailCalls || inlining ||
+                  fold || simplify || dce || licm || bce || vectorize || warnings || jsonDump || run || emitLLVM ||
+                  objectPath || dumpSSA || ssaStats)) {
+        usage();
+        return 1;
+    }
+    // the JSON records are written to stdout while the program is checked, where they would be
+    // mixed into what the program prints or the IR, and the end record never written
+    if (jsonDump && (run || emitLLVM || objectPath || dumpSSA)) {
+        usage();
+        return 1;
+    }
+    // streaming checks one function at a time and lets it go, so nothing can run on the whole
+    // tree afterwards, and the other modes read the program themselves
+    if (stream && (cacheDir || serveSocket || connectSocket || checkName || resolveArg || tailCalls || inlining ||
+                   fold || simplify || dce || licm || bce || vectorize || warnings || jsonDump || run || emitLLVM ||
+                   objectPath || dumpSSA || ssaStats)) {
+        usage();
+        return 1;
+    }
+    // a query answers before anything but parsing has run
+    if ((checkName || resolveArg) &&
+        ((checkName && resolveArg) || cacheDir || serveSocket || connectSocket || tailCalls || inlining || fold ||
+         simplify || dce || licm || bce || vectorize || warnings || jsonDump || run || emitLLVM || objectPath ||
+         dumpSSA || ssaStats)) {
+        usage();
+        return 1;
+    }
+    // the server checks with a cache of its own and answers with the plain scope dump, and a
+    // client only hands the program over
+    if ((serveSocket || connectSocket) &&
+        ((serveSocket && connectSocket) || cacheDir || tailCalls || inlining || fold || simplify || dce || licm ||
+         bce || vectorize || warnings || jsonDump || run || emitLLVM || objectPath || dumpSSA || ssaStats)) {
+        usage();
+        return 1;
+    }
+
+    // functions replayed from the cache are not annotated, which the passes and backends rely
+    // on, and do not report their scopes one by one, so --incremental could only be dropped
+    if (cacheDir && (tailCalls || inlining || fold || simplify || dce || licm || bce || vectorize || warnings ||
+                     jsonDump || run || emitLLVM || objectPath || dumpSSA || ssaStats)) {
+        usage();
+        return 1;
+    }
+
+    // only made once the flags are accepted, since it creates its directory
+    std::unique_ptr<FunctionCache> cache;
+    if (cacheDir) {
+        cache = std::make_unique<FunctionCache>(cacheDir);
+    }
+
+    // written when main returns, after the batch workers are done
+    std::unique_ptr<trace::Recorder> traceRecorder;
+    if (tracePath) {
+        traceRecorder = std::make_unique<trace::Recorder>(tracePath);
+    }
+
+#ifdef FANC_STATS
+    std::unique_ptr<stats::Reporter> statsReporter;
+    if (statsArg) {
+        statsReporter = std::make_unique<stats::Reporter>(*statsArg ? statsArg : nullptr);
+    }
+#else
+    if (statsArg) {
+        std::cerr << "--stats needs hw3 built with -DFANC_STATS (make stats)" << std::endl;
+        return 1;
+    }
+#endif
+
+    if (batch) {
+        if (batchPaths.empty()) {
+            std::string path;
+            while (std::getline(std::cin, path)) {
+                if (!path.empty()) {
+                    batchPaths.push_back(path);
+                }
+            }
+        }
+        if (!cache) {
+            cache = std::make_unique<FunctionCache>();
+        }
+        BatchChecker checker(std::move(batchPaths), *cache, jobs);
+        auto start = std::chrono::steady_clock::now();
+        checker.run(batchStream ? &std::cout : nullptr);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << "batch: " << checker.files() << " files in " << static_cast<long>(elapsed.count() * 1000) << " ms, "
+                  << static_cast<long>(checker.files() / std::max(elapsed.count(), 1e-6)) << " files/s on "
+                  << checker.workerCount() << " workers";
+        if (checker.failed()) {
+            std::cerr << ", " << checker.failed() << " failed";
+        }
+        std::cerr << std::endl;
+        return checker.failed() ? 1 : 0;
+    }
+
+    if (serveSocket) {
+        CompileServer server(serveSocket, jobs);
+        if (!server.listen()) {
+            return 1;
+        }
+        // stopped by SIGINT or SIGTERM, main returns normally and writes the trace and stats
+        runningServer = &server;
+        signal(SIGINT, stopServer);
+        signal(SIGTERM, stopServer);
+        bool ok = server.run();
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        runningServer = nullptr;
+        return ok ? 0 : 1;
+    }
+
+    if (connectSocket) {
+        std::string source(std::istreambuf_iterator<char>(std::cin), {});
+        std::string reply;
+        if (!requestCheck(connectSocket, source, reply)) {
+            return 1;
+        }
+        std::cout << reply;
+        return 0;
+    }
+
+    if (stream) {
+        streamCheckSource(stdin, std::cout);
+        return 0;
+    }
+
+    std::unique_ptr<output::JsonScopePrinter> jsonPrinter;
+    if (jsonDump) {
+        jsonPrinter = std::make_unique<output::JsonScopePrinter>(std::cout);
+    }
+
+    try {
+        // Parse the input. The result is stored in the global variable `program`
+        {
+            STATS_PHASE(PARSE);
+            trace::Span span("parse", "phase");
+            yyparse();
+        }
+        STATS_COUNT_NODES(*program);
+
+        if (checkName || resolveArg) {
+            return runQuery(checkName, resolveArg);
+        }
+
+        // run semantic analysis
+        SemanticVisitor semanticVisitor;
+        semanticVisitor.setFunctionCache(cache.get());
+        semanticVisitor.setJsonPrinter(jsonPrinter.get());
+        {
+            STATS_PHASE(SEMANTIC);
+            trace::Span span("semantic", "phase");
+            program->accept(semanticVisitor);
+        }
+
+        if (warnings) {
+            trace::Span span("flow warnings", "pass");
+            auto funcs = std::dynamic_pointer_cast<ast::Funcs>(program);
+            for (auto &func : funcs->funcs) {
+                for (const auto &warning : analyzeFlow(*func)) {
+                    STATS_COUNT(DIAGNOSTICS);
+                    std::cerr << "line " << warning.line << ": warning: " << warning.message << std::endl;
+                }
+            }
+        }
+
+        // before inlining, so a function whose recursion became a loop can still be inlined
+        if (tailCalls) {
+            trace::Span span("tce", "pass");
+            TailCallEliminator eliminator;
+            program->accept(eliminator);
+            std::cerr << "tail calls: " << eliminator.callsEliminated() << " eliminated";
+            const char *separator = " (";
+            for (const auto &function : eliminator.eliminatedPerFunction()) {
+                std::cerr << separator << function.first << " " << function.second;
+                separator = ", ";
+            }
+            std::cerr << (eliminator.eliminatedPerFunction().empty() ? "" : ")") << std::endl;
+        }
+
+        // so the other passes see the inlined bodies
+        if (inlining) {
+            trace::Span span("inline", "pass");
+            Inliner inliner;
+            program->accept(inliner);
+            for (const auto &decision : inliner.report()) {
+                std::cerr << "line " << decision.line << ": ";
+                if (decision.inlined) {
+                    std::cerr << "inlined " << decision.callee << " into " << decision.caller << " (cost "
+                              << decision.cost << ")" << std::endl;
+                } else {
+                    std::cerr << "call to " << decision.callee << " in " << decision.caller << " not inlined: "
+                              << decision.reason << std::endl;
+                }
+            }
+            std::cerr << "inlining: " << inliner.callsInlined() << " of " << inliner.report().size()
+                      << " calls inlined" << std::endl;
+        }
+
+        if (fold) {
+            trace::Span span("fold", "pass");
+            ConstantFolder folder;
+            program->accept(folder);
+            for (int line : folder.divisionsByZero()) {
+                STATS_COUNT(DIAGNOSTICS);
+                std::cerr << "line " << line << ": warning: division by zero" << std::endl;
+            }
+            std::cerr << "constant folding: " << folder.folded() << " expressions folded" << std::endl;
+        }
+
+        if (simplify) {
+            trace::Span span("simplify", "pass");
+            AlgebraicSimplifier simplifier;
+            program->accept(simplifier);
+            std::cerr << "algebraic simplification: " << simplifier.simplified() << " expressions simplified, "
+                      << simplifier.shifts() << " strength-reduced to shifts" << std::endl;
+        }
+
+        // after folding, so conditions that became literals are pruned too
+        if (dce) {
+            trace::Span span("dce", "pass");
+            DeadCodeEliminator eliminator;
+            program->accept(eliminator);
+            std::cerr << "dead code: " << eliminator.statementsRemoved() << " statements removed";
+            for (const auto &name : eliminator.functionsRemoved()) {
+                std::cerr << ", function " << name << " removed";
+            }
+            std::cerr << std::endl;
+        }
+
+        if (licm) {
+            trace::Span span("licm", "pass");
+            LoopInvariantMover mover;
+            program->accept(mover);
+            std::cerr << "loop invariants: " << mover.expressionsHoisted() << " expressions hoisted";
+            const char *separator = " (";
+            for (const auto &function : mover.hoistedPerFunction()) {
+                std::cerr << separator << function.first << " " << function.second;
+                separator = ", ";
+            }
+            std::cerr << (mover.hoistedPerFunction().empty() ? "" : ")") << std::endl;
+        }
+
+        // last, so it sees the loops and locals the other passes leave
+        if (bce) {
+            trace::Span span("bce", "pass");
+            BoundsAnalyzer analyzer;
+            program->accept(analyzer);
+            std::cerr << "bounds checks: " << analyzer.eliminated() << "/" << analyzer.accesses() << " eliminated ("
+                      << analyzer.eliminated() * 100 / std::max(analyzer.accesses(), 1) << "%)";
+            for (const auto &function : analyzer.report()) {
+                std::cerr << ", " << function.name << " " << function.eliminated << "/" << function.accesses << " ("
+                          << function.eliminated * 100 / function.accesses << "%)";
+            }
+            std::cerr << std::endl;
+        }
+
+        if (vectorize) {
+            trace::Span span("vectorize", "pass");
+            LoopVectorizer vectorizer;
+            program->accept(vectorizer);
+            std::cerr << "vectorized loops: " << vectorizer.loopsVectorized() << " of " << vectorizer.loops();
+            const char *separator = " (";
+            for (const auto &function : vectorizer.vectorizedPerFunction()) {
+                std::cerr << separator << function.first << " " << function.second;
+                separator = ", ";
+            }
+            std::cerr << (vectorizer.vectorizedPerFunction().empty() ? "" : ")") << std::endl;
+        }
+
+        if (dumpSSA || ssaStats) {
+            trace::Span span("ssa", "pass");
+            ssa::Module module = ssa::Builder::build(*std::dynamic_pointer_cast<ast::Funcs>(program));
+            ssa::OptimizationStats total;
+            for (auto &function : module.functions) {
+                ssa::OptimizationStats stats = ssa::optimize(function);
+                total.before += stats.before;
+                total.sccp += stats.sccp;
+                total.gvn += stats.gvn;
+                total.dce += stats.dce;
+                total.after += stats.after;
+            }
+            if (ssaStats) {
+                std::cerr << "ssa: " << total.before << " instructions, " << total.before - total.after
+                          << " removed (sccp " << total.sccp << ", gvn " << total.gvn << ", dce " << total.dce
+                          << ")" << std::endl;
+            }
+            if (dumpSSA) {
+                ssa::dump(std::cout, module);
+                return 0;
+            }
+        }
+
+        if (run) {
+            trace::Span span("run", "backend");
+            bytecode::Program compiled = bytecode::Compiler::compile(*std::dynamic_pointer_cast<ast::Funcs>(program));
+            std::cout.flush();
+            if (jit) {
+                JitProgram native(x86::CodeGenerator::generate(compiled));
+                if (native.ok()) {
+                    return native.run();
+                }
+                std::cerr << "jit: cannot map executable memory, using the bytecode VM" << std::endl;
+            }
+            return bytecode::VirtualMachine(compiled).run();
+        }
+
+        if (objectPath) {
+            trace::Span span("emit object", "backend");
+            bytecode::Program compiled = bytecode::Compiler::compile(*std::dynamic_pointer_cast<ast::Funcs>(program));
+            ElfObject object(x86::CodeGenerator::generate(compiled), compiled);
+            if (!object.write(objectPath)) {
+                std::cerr << "cannot write " << objectPath << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+
+        if (emitLLVM) {
+            trace::Span span("emit llvm", "backend");
+            llvmir::Emitter emitter;
+            program->accept(emitter);
+            std::cout.flush();
+            emitter.write(STDOUT_FILENO);
+            return 0;
+        }
+
+        STATS_PHASE(OUTPUT);
+        trace::Span span("output", "phase");
+        if (jsonPrinter) {
+            jsonPrinter->emitEnd();
+        } else {
+            std::cout.flush();
+            semanticVisitor.writeScopes(STDOUT_FILENO);
+        }
+    } catch (const output::CompileError &error) {
+        STATS_PHASE(OUTPUT);
+        trace::Span span("output", "phase");
+        if (jsonPrinter) {
+            jsonPrinter->emitError(error);
+        } else {
+            std::cout << error.message;
+        }
+    }
+
+    if (cache) {
+        unsigned long total = cache->hitCount() + cache->missCount();
+        std::cerr << "function cache: " << cache->hitCount() << "/" << total << " hits ("
+                  << (total ? 100 * cache->hitCount() / total : 0) << "%)" << std::endl;
+    }
+    return 0;
+}
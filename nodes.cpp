@@ -1,4 +1,5 @@
 #include "nodes.hpp"
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -12,9 +13,11 @@ namespace ast {
 
     NumB::NumB(const char *str) : Exp(), value(std::stoi(str)) {}
 
-    String::String(const char *str) : Exp(), value(str) {
-        // Remove the quotes
-        value = value.substr(1, value.size() - 2);
+    String::String(const char *str, std::shared_ptr<StringPool> pool)
+            : Exp(), pool(std::move(pool)), index(this->pool->internLiteral(str)) {}
+
+    const std::string &String::value() const {
+        return pool->text(index);
     }
 
     Bool::Bool(bool value) : Exp(), value(value) {}
@@ -99,7 +102,8 @@ namespace ast {
     }
 
     FuncDecl::FuncDecl(std::shared_ptr<ID> id, std::shared_ptr<Type> return_type, std::shared_ptr<Formals> formals, std::shared_ptr<Statements> body)
-            : Node(), id(std::move(id)), return_type(std::move(return_type)), formals(std::move(formals)), body(std::move(body)) {}
+            : Node(), id(std::move(id)), return_type(std::move(return_type)), formals(std::move(formals)), body(std::move(body)),
+              firstLine(std::min(this->return_type->line, this->id->line)), lastLine(line) {}
 
     Funcs::Funcs(std::shared_ptr<FuncDecl> func) : Node(), funcs({std::move(func)}) {}
 
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include "visitor.hpp"
+#include "stringpool.hpp"
 
 namespace ast {
 
@@ -91,11 +92,16 @@ namespace ast {
     /* String literal */
     class String : public Exp {
     public:
-        // Value of the string
-        std::string value;
+        // Pool of the parse that read the literal, and the index of its decoded text there
+        std::shared_ptr<StringPool> pool;
+        int index;
+
+        // Constructor that receives a C-style string that represents the string *including quotes*,
+        // and interns it into pool
+        String(const char *str, std::shared_ptr<StringPool> pool);
 
-        // Constructor that receives a C-style string that represents the string *including quotes*
-        explicit String(const char *str);
+        // The decoded text
+        const std::string &value() const;
 
         void accept(Visitor &visitor) override {
             visitor.visit(*this);
@@ -121,6 +127,10 @@ namespace ast {
     public:
         // Name of the identifier
         std::string value;
+        // Frame offset of the variable it names, set by the semantic analysis
+        int computedOffset = 0;
+        // Length of the array it names, if it names one
+        int computedArrLength = -1;
 
         // Constructor that receives a C-style string that represents the identifier
         explicit ID(const char *str);
@@ -139,6 +149,9 @@ namespace ast {
         std::shared_ptr<Exp> right;
         // Operation
         BinOpType op;
+        // A multiplication or division whose right operand is the literal 2^computedShift, set by
+        // the algebraic simplifier; the backends shift instead. 0 if not
+        int computedShift = 0;
 
         // Constructor that receives the left and right operands and the operation
         BinOp(std::shared_ptr<Exp> left, std::shared_ptr<Exp> right, BinOpType op);
@@ -218,6 +231,8 @@ namespace ast {
         std::shared_ptr<ID> id;
         // Index expression of the array
         std::shared_ptr<Exp> index;
+        // The index is always within the array's length, set by the bounds-check analysis
+        bool computedInBounds = false;
 
         // Constructor that receives the identifier and the index expression
         ArrayDereference(std::shared_ptr<ID> id, std::shared_ptr<Exp> index);
@@ -408,6 +423,9 @@ namespace ast {
         std::shared_ptr<Exp> condition;
         // Statement to be executed while the condition is true
         std::shared_ptr<Statement> body;
+        // A counted loop over arrays the backends may run several iterations at a time, set by the
+        // vectorizer
+        bool computedVectorizable = false;
 
         // Constructor that receives the condition and the statement to be executed while the condition is true
         While(std::shared_ptr<Exp> condition, std::shared_ptr<Statement> body);
@@ -459,6 +477,8 @@ namespace ast {
         std::shared_ptr<Exp> index;
         // Expression to be assigned
         std::shared_ptr<Exp> exp;
+        // The index is always within the array's length, set by the bounds-check analysis
+        bool computedInBounds = false;
 
         // Constructor that receives the identifier and the expression to be assigned
         ArrayAssign(std::shared_ptr<ID> id, std::shared_ptr<Exp> exp, std::shared_ptr<Exp> index);
@@ -518,6 +538,11 @@ namespace ast {
         std::shared_ptr<Formals> formals;
         // Body of the function
         std::shared_ptr<Statements> body;
+        // Number of frame slots used by local variables (offsets 0 and up), set by the semantic analysis
+        int computedFrameSize = 0;
+        // Lines the function's text spans, from its return type to its closing brace
+        int firstLine;
+        int lastLine;
 
         // Constructor that receives the identifier, the return type, the list of formal parameters, and the body
         FuncDecl(std::shared_ptr<ID> id, std::shared_ptr<Type> return_type, std::shared_ptr<Formals> formals, std::shared_ptr<Statements> body);
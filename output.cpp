@@ -1,10 +1,18 @@
 #include "output.hpp"
+#include "stats.hpp"
 #include <iostream>
+#include <utility>
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
 
 namespace output {
     /* Helper functions */
 
-    std::string toString(ast::BuiltInType type) {
+    // Type names as printed in scope dumps, without building a string
+    static const char *typeName(ast::BuiltInType type) {
         switch (type) {
             case ast::BuiltInType::UNDEF:
                 return "undef";
@@ -22,6 +30,11 @@ namespace output {
                 return "unknown";
         }
     }
+
+    std::string toString(ast::BuiltInType type) {
+        return typeName(type);
+    }
+
     std::string toStringCapital(ast::BuiltInType type) {
         switch (type) {
             case ast::BuiltInType::UNDEF:
@@ -43,132 +56,376 @@ namespace output {
 
     /* Error handling functions */
 
+    CompileError::CompileError(int lineno, std::string message) : lineno(lineno), message(std::move(message)) {
+        STATS_COUNT(DIAGNOSTICS);
+    }
+
+    const char *CompileError::what() const noexcept {
+        return message.c_str();
+    }
+
     void errorLex(int lineno) {
-        std::cout << "line " << lineno << ": lexical error\n";
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ": lexical error\n";
+        throw CompileError(lineno, os.str());
     }
 
     void errorSyn(int lineno) {
-        std::cout << "line " << lineno << ": syntax error\n";
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ": syntax error\n";
+        throw CompileError(lineno, os.str());
     }
 
     void errorUndef(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " variable " << id << " is not defined" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ":" << " variable " << id << " is not defined" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorDefAsFunc(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is a function" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ":" << " symbol " << id << " is a function" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorDefAsVar(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is a variable" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ":" << " symbol " << id << " is a variable" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorDef(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is already defined" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ":" << " symbol " << id << " is already defined" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorUndefFunc(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " function " << id << " is not defined" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ":" << " function " << id << " is not defined" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorMismatch(int lineno) {
-        std::cout << "line " << lineno << ":" << " type mismatch" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ":" << " type mismatch" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorPrototypeMismatch(int lineno, const std::string &id, std::vector<std::string> &paramTypes) {
-        std::cout << "line " << lineno << ": prototype mismatch, function " << id << " expects parameters (";
+        std::ostringstream os;
+        os << "line " << lineno << ": prototype mismatch, function " << id << " expects parameters (";
 
         for (int i = 0; i < paramTypes.size(); ++i) {
-            std::cout << paramTypes[i];
+            os << paramTypes[i];
             if (i != paramTypes.size() - 1)
-                std::cout << ",";
+                os << ",";
         }
 
-        std::cout << ")" << std::endl;
-        exit(0);
+        os << ")" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorUnexpectedBreak(int lineno) {
-        std::cout << "line " << lineno << ":" << " unexpected break statement" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ":" << " unexpected break statement" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorUnexpectedContinue(int lineno) {
-        std::cout << "line " << lineno << ":" << " unexpected continue statement" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ":" << " unexpected continue statement" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void errorMainMissing() {
-        std::cout << "Program has no 'void main()' function" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "Program has no 'void main()' function" << std::endl;
+        throw CompileError(-1, os.str());
     }
 
     void errorByteTooLarge(int lineno, const int value) {
-        std::cout << "line " << lineno << ": byte value " << value << " out of range" << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ": byte value " << value << " out of range" << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     void ErrorInvalidAssignArray(int lineno, const std::string &id_arr) {
-        std::cout << "line " << lineno << ": invalid assignment to array " << id_arr << std::endl;
-        exit(0);
+        std::ostringstream os;
+        os << "line " << lineno << ": invalid assignment to array " << id_arr << std::endl;
+        throw CompileError(lineno, os.str());
     }
 
     /* ScopePrinter class */
 
-    ScopePrinter::ScopePrinter() : indentLevel(0) {}
+    static const char beginGlobal[] = "---begin global scope---\n";
+    static const char endGlobal[] = "---end global scope---\n";
+    static const char beginLine[] = "---begin scope---\n";
+    static const char endLine[] = "---end scope---\n";
 
-    std::string ScopePrinter::indent() const {
-        std::string result;
-        for (int i = 0; i < indentLevel; ++i) {
-            result += "  ";
+    // Indentation for the common nesting depths, two spaces per level
+    static const char indentTable[] = "                                                                ";
+    static const int indentTableLevels = (sizeof(indentTable) - 1) / 2;
+
+    // Buffers start this big, so typical programs never grow them
+    static const size_t initialCapacity = 1 << 16;
+    // Largest single write(2)
+    static const size_t writeBlock = 1 << 20;
+
+    static void appendInt(std::string &dest, int value) {
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        dest.append(digits, result.ptr - digits);
+    }
+
+    static bool writeAll(int fd, const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, std::min(size, writeBlock));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            size -= written;
         }
-        return result;
+        return true;
+    }
+
+    ScopePrinter::ScopePrinter() : indentLevel(0), capturing(false) {
+        buffer.reserve(initialCapacity);
+    }
+
+    std::string &ScopePrinter::out() {
+        return capturing ? captureBuffer : buffer;
+    }
+
+    void ScopePrinter::_indent(std::string &dest) const {
+        int level = indentLevel;
+        while (level > indentTableLevels) {
+            dest.append(indentTable, 2 * indentTableLevels);
+            level -= indentTableLevels;
+        }
+        dest.append(indentTable, 2 * level);
     }
 
     void ScopePrinter::beginScope() {
         indentLevel++;
-        buffer << indent() << "---begin scope---" << std::endl;
+        std::string &dest = out();
+        _indent(dest);
+        dest.append(beginLine, sizeof(beginLine) - 1);
     }
 
     void ScopePrinter::endScope() {
-        buffer << indent() << "---end scope---" << std::endl;
+        std::string &dest = out();
+        _indent(dest);
+        dest.append(endLine, sizeof(endLine) - 1);
         indentLevel--;
     }
 
     void ScopePrinter::emitVar(const std::string &id, const ast::BuiltInType &type, int offset) {
-        buffer << indent() << id << " " << toString(type) << " " << offset << std::endl;
+        std::string &dest = out();
+        _indent(dest);
+        dest += id;
+        dest += ' ';
+        dest += typeName(type);
+        dest += ' ';
+        appendInt(dest, offset);
+        dest += '\n';
     }
 
     void ScopePrinter::emitArr(const std::string &id, const ast::BuiltInType &type, int length , int offset ) {
-        buffer << indent() << id << "[" << length << "]" << " " << toString(type) << " " << offset <<  std::endl;
+        std::string &dest = out();
+        _indent(dest);
+        dest += id;
+        dest += '[';
+        appendInt(dest, length);
+        dest += "] ";
+        dest += typeName(type);
+        dest += ' ';
+        appendInt(dest, offset);
+        dest += '\n';
     }
 
     void ScopePrinter::emitFunc(const std::string &id, const ast::BuiltInType &returnType,
                                 const std::vector<ast::BuiltInType> &paramTypes) {
-        globalsBuffer << id << " " << "(";
+        globalsBuffer += id;
+        globalsBuffer += " (";
 
         for (int i = 0; i < paramTypes.size(); ++i) {
-            globalsBuffer << toString(paramTypes[i]);
+            globalsBuffer += typeName(paramTypes[i]);
             if (i != paramTypes.size() - 1)
-                globalsBuffer << ",";
+                globalsBuffer += ',';
         }
 
-        globalsBuffer << ")" << " -> " << toString(returnType) << std::endl;
+        globalsBuffer += ") -> ";
+        globalsBuffer += typeName(returnType);
+        globalsBuffer += '\n';
+    }
+
+    void ScopePrinter::beginCapture() {
+        captureBuffer.clear();
+        capturing = true;
+    }
+
+    std::string ScopePrinter::endCapture() {
+        capturing = false;
+        buffer += captureBuffer;
+        return captureBuffer;
+    }
+
+    void ScopePrinter::discardScopes() {
+        capturing = false;
+        captureBuffer.clear();
+        buffer.clear();
+        indentLevel = 0;
+    }
+
+    void ScopePrinter::emitRaw(const std::string &lines) {
+        out() += lines;
+    }
+
+    void ScopePrinter::drainScopes(std::ostream &os) {
+        os.write(buffer.data(), buffer.size());
+        // keeps the capacity for the next function
+        buffer.clear();
+    }
+
+    void ScopePrinter::printHead(std::ostream &os) const {
+        os.write(beginGlobal, sizeof(beginGlobal) - 1);
+        os.write(globalsBuffer.data(), globalsBuffer.size());
+    }
+
+    void ScopePrinter::printTail(std::ostream &os) const {
+        os.write(buffer.data(), buffer.size());
+        os.write(endGlobal, sizeof(endGlobal) - 1);
+    }
+
+    bool ScopePrinter::write(int fd) const {
+        return writeAll(fd, beginGlobal, sizeof(beginGlobal) - 1) &&
+               writeAll(fd, globalsBuffer.data(), globalsBuffer.size()) &&
+               writeAll(fd, buffer.data(), buffer.size()) &&
+               writeAll(fd, endGlobal, sizeof(endGlobal) - 1);
     }
 
     std::ostream &operator<<(std::ostream &os, const ScopePrinter &printer) {
-        os << "---begin global scope---" << std::endl;
-        os << printer.globalsBuffer.str();
-        os << printer.buffer.str();
-        os << "---end global scope---" << std::endl;
+        printer.printHead(os);
+        printer.printTail(os);
         return os;
     }
+
+    void appendJsonString(std::string &dest, const std::string &text) {
+        dest += '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                dest += '\\';
+                dest += c;
+            } else if (c == '\n') {
+                dest += "\\n";
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                dest += escaped;
+            } else {
+                dest += c;
+            }
+        }
+        dest += '"';
+    }
+
+    /* JsonScopePrinter class */
+
+    JsonScopePrinter::JsonScopePrinter(std::ostream &os) : os(os), pending(1), depth(0) {}
+
+    std::string &JsonScopePrinter::_symbol(const std::string &id, const ast::BuiltInType &type, int offset) {
+        std::string &symbols = pending[depth];
+        if (!symbols.empty()) {
+            symbols += ',';
+        }
+        symbols += "{\"name\":";
+        appendJsonString(symbols, id);
+        symbols += ",\"type\":\"";
+        symbols += typeName(type);
+        symbols += "\",\"offset\":";
+        appendInt(symbols, offset);
+        return symbols;
+    }
+
+    void JsonScopePrinter::beginFunction(const std::string &name) {
+        function = name;
+    }
+
+    void JsonScopePrinter::beginScope() {
+        depth++;
+        if (depth == static_cast<int>(pending.size())) {
+            pending.emplace_back();
+        }
+        pending[depth].clear();
+    }
+
+    void JsonScopePrinter::endScope() {
+        line.clear();
+        line += "{\"kind\":\"scope\",\"function\":";
+        appendJsonString(line, function);
+        line += ",\"depth\":";
+        appendInt(line, depth);
+        line += ",\"symbols\":[";
+        line += pending[depth];
+        line += "]}\n";
+        os.write(line.data(), line.size());
+
+        depth--;
+        if (depth == 0) {
+            os.flush();
+        }
+    }
+
+    void JsonScopePrinter::emitVar(const std::string &id, const ast::BuiltInType &type, int offset) {
+        _symbol(id, type, offset) += '}';
+    }
+
+    void JsonScopePrinter::emitArr(const std::string &id, const ast::BuiltInType &type, int length, int offset) {
+        std::string &symbols = _symbol(id, type, offset);
+        symbols += ",\"length\":";
+        appendInt(symbols, length);
+        symbols += '}';
+    }
+
+    void JsonScopePrinter::emitFunc(const std::string &id, const ast::BuiltInType &returnType,
+                                    const std::vector<ast::BuiltInType> &paramTypes) {
+        line.clear();
+        line += "{\"kind\":\"function\",\"name\":";
+        appendJsonString(line, id);
+        line += ",\"params\":[";
+        for (size_t i = 0; i < paramTypes.size(); ++i) {
+            if (i) line += ',';
+            line += '"';
+            line += typeName(paramTypes[i]);
+            line += '"';
+        }
+        line += "],\"return\":\"";
+        line += typeName(returnType);
+        line += "\"}\n";
+        os.write(line.data(), line.size());
+    }
+
+    void JsonScopePrinter::emitEnd() {
+        os << "{\"kind\":\"end\"}\n";
+        os.flush();
+    }
+
+    void JsonScopePrinter::emitError(const CompileError &error) {
+        line.clear();
+        line += "{\"kind\":\"error\",\"line\":";
+        appendInt(line, error.lineno);
+        line += ",\"message\":";
+        // without the trailing newline of the text format
+        std::string message = error.message;
+        if (!message.empty() && message.back() == '\n') {
+            message.pop_back();
+        }
+        appendJsonString(line, message);
+        line += "}\n";
+        os.write(line.data(), line.size());
+        os.flush();
+    }
 }
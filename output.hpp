@@ -4,53 +4,81 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <exception>
 #include "visitor.hpp"
 #include "nodes.hpp"
 
 namespace output {
-    /* Error handling functions */
+    /* Error handling functions
+     * Every error function throws a CompileError instead of printing. The message is the exact
+     * text hw3 prints for the error; main() catches it, prints it and stops.
+     */
+
+    class CompileError : public std::exception {
+    public:
+        // Source line the error refers to, or -1 for errors not tied to a line
+        int lineno;
+        // Full error line, including the trailing newline
+        std::string message;
+
+        CompileError(int lineno, std::string message);
+
+        const char *what() const noexcept override;
+    };
 
     std::string toString(ast::BuiltInType type); 
     std::string toStringCapital(ast::BuiltInType type);
 
-    void errorLex(int lineno);
+    // Appends text to dest as a quoted JSON string, escaping what JSON requires
+    void appendJsonString(std::string &dest, const std::string &text);
+
+    [[noreturn]] void errorLex(int lineno);
 
-    void errorSyn(int lineno);
+    [[noreturn]] void errorSyn(int lineno);
 
-    void errorUndef(int lineno, const std::string &id);
+    [[noreturn]] void errorUndef(int lineno, const std::string &id);
 
-    void errorDefAsFunc(int lineno, const std::string &id);
+    [[noreturn]] void errorDefAsFunc(int lineno, const std::string &id);
 
-    void errorUndefFunc(int lineno, const std::string &id);
+    [[noreturn]] void errorUndefFunc(int lineno, const std::string &id);
 
-    void errorDefAsVar(int lineno, const std::string &id);
+    [[noreturn]] void errorDefAsVar(int lineno, const std::string &id);
 
-    void errorDef(int lineno, const std::string &id);
+    [[noreturn]] void errorDef(int lineno, const std::string &id);
 
-    void errorPrototypeMismatch(int lineno, const std::string &id, std::vector<std::string> &paramTypes);
+    [[noreturn]] void errorPrototypeMismatch(int lineno, const std::string &id, std::vector<std::string> &paramTypes);
 
-    void errorMismatch(int lineno);
+    [[noreturn]] void errorMismatch(int lineno);
 
-    void errorUnexpectedBreak(int lineno);
+    [[noreturn]] void errorUnexpectedBreak(int lineno);
 
-    void errorUnexpectedContinue(int lineno);
+    [[noreturn]] void errorUnexpectedContinue(int lineno);
 
-    void errorMainMissing();
+    [[noreturn]] void errorMainMissing();
 
-    void errorByteTooLarge(int lineno, int value);
+    [[noreturn]] void errorByteTooLarge(int lineno, int value);
 
-    void ErrorInvalidAssignArray(int lineno, const std::string &id_arr);
+    [[noreturn]] void ErrorInvalidAssignArray(int lineno, const std::string &id_arr);
 
     /* ScopePrinter class
      * This class is used to print scopes in a human-readable format.
+     * Lines are appended to reusable byte buffers (indentation comes from a fixed table and
+     * numbers are formatted in place), so emitting a line does not allocate once the buffers
+     * have grown, and the dump is written out in large blocks.
      */
     class ScopePrinter {
     private:
-        std::stringstream globalsBuffer;
-        std::stringstream buffer;
+        std::string globalsBuffer;
+        std::string buffer;
         int indentLevel;
 
-        std::string indent() const;
+        // Side buffer used while a single function's scopes are being captured
+        std::string captureBuffer;
+        bool capturing;
+
+        std::string &out();
+
+        void _indent(std::string &dest) const;
 
     public:
         ScopePrinter();
@@ -66,8 +94,78 @@ namespace output {
         void emitFunc(const std::string &id, const ast::BuiltInType &returnType,
                       const std::vector<ast::BuiltInType> &paramTypes);
 
+        // Captures everything emitted until endCapture(), which returns the captured lines
+        // and appends them to the dump as usual
+        void beginCapture();
+
+        std::string endCapture();
+
+        // Drops everything emitted since the global scope, captured or not, and closes any
+        // scope left open
+        void discardScopes();
+
+        // Appends previously captured lines verbatim
+        void emitRaw(const std::string &lines);
+
+        // Writes out the scope lines buffered so far and forgets them, so the dump of a long
+        // program does not have to be held in memory. The global scope lines stay buffered.
+        void drainScopes(std::ostream &os);
+
+        // The dump in two parts: the global scope header with the functions, and the buffered
+        // scope lines with the closing line
+        void printHead(std::ostream &os) const;
+
+        void printTail(std::ostream &os) const;
+
+        // Writes the whole dump straight to a file descriptor, returns false on a write error
+        bool write(int fd) const;
+
         friend std::ostream &operator<<(std::ostream &os, const ScopePrinter &printer);
     };
+
+    /* JsonScopePrinter class
+     * Machine-readable alternative to ScopePrinter, one JSON object per line:
+     *   {"kind":"function","name":"f","params":["int"],"return":"void"}  as each function is declared
+     *   {"kind":"scope","function":"f","depth":1,"symbols":[{"name":"a","type":"int","offset":-1}, ...]}
+     *                                                                    as each scope is closed
+     *   {"kind":"end"} or {"kind":"error","line":3,"message":"..."}     once the check is done
+     * Array symbols also carry "length", and "function" names the function the scope belongs
+     * to. Output is flushed whenever a function's outermost scope closes, so consumers can read
+     * results while the rest of the program is being checked.
+     */
+    class JsonScopePrinter {
+    private:
+        std::ostream &os;
+        // Symbols of each open scope so far, outermost first, as comma separated JSON objects
+        std::vector<std::string> pending;
+        int depth;
+        // Function whose body is being checked
+        std::string function;
+        std::string line;
+
+        std::string &_symbol(const std::string &id, const ast::BuiltInType &type, int offset);
+
+    public:
+        explicit JsonScopePrinter(std::ostream &os);
+
+        // Names the function the scopes that follow belong to
+        void beginFunction(const std::string &name);
+
+        void beginScope();
+
+        void endScope();
+
+        void emitVar(const std::string &id, const ast::BuiltInType &type, int offset);
+
+        void emitArr(const std::string &id, const ast::BuiltInType &type, int length, int offset);
+
+        void emitFunc(const std::string &id, const ast::BuiltInType &returnType,
+                      const std::vector<ast::BuiltInType> &paramTypes);
+
+        void emitEnd();
+
+        void emitError(const CompileError &error);
+    };
 }
 
 #endif //OUTPUT_HPP
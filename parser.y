@@ -3,6 +3,7 @@
 #include "nodes.hpp"
 #include "output.hpp"
 #include <iostream>
+#include <functional>
 
 // bison declarations
 extern int yylineno;
@@ -13,13 +14,18 @@ void yyerror(const char*);
 // root of the AST, set by the parser and used by other parts of the compiler
 std::shared_ptr<ast::Node> program;
 
+// when set, every function is handed over here as soon as it is parsed instead of being kept
+// in `program`
+std::function<void(std::shared_ptr<ast::FuncDecl>)> funcDeclHandler;
+
 using namespace std;
 
 template <typename T>
 std::shared_ptr<T> as(std::shared_ptr<ast::Node> node) {
     auto result = std::dynamic_pointer_cast<T>(node);
-    if (!result && node) { 
-        cout << "Error: Failed to cast AST node to appropriate type on line " << yylineno << endl;
+    if (!result && node) {
+        throw output::CompileError(yylineno, "Error: Failed to cast AST node to appropriate type on line " +
+                                             std::to_string(yylineno) + "\n");
     }
     return result;
 }
@@ -52,11 +58,17 @@ Program
     ;
 
 // TODO: Define grammar here
+// Left recursive, so each function is complete as soon as it is reduced and the parser stack
+// does not grow with the number of functions
 Funcs
     :                                           { $$ = make_shared<ast::Funcs>(); }
-    | FuncDecl Funcs                            { 
-                                                  $$ = $2; 
-                                                  as<ast::Funcs>($$)->push_front(as<ast::FuncDecl>($1)); 
+    | Funcs FuncDecl                            { 
+                                                  $$ = $1; 
+                                                  if (funcDeclHandler) {
+                                                    funcDeclHandler(as<ast::FuncDecl>($2));
+                                                  } else {
+                                                    as<ast::Funcs>($$)->push_back(as<ast::FuncDecl>($2)); 
+                                                  }
                                                 }
     
     ;
@@ -231,5 +243,4 @@ Exp
 
 void yyerror(const char* /*msg*/) {
     output::errorSyn(yylineno);
-    exit(0);
 }
\ No newline at end of file
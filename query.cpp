@@ -0,0 +1,286 @@
+#include "query.hpp"
+#include "walker.hpp"
+#include "semanticvisitor.hpp"
+#include "funccache.hpp"
+#include <algorithm>
+
+namespace {
+    /* Collects every node of a function and its identifiers */
+    class FunctionIndexer : public TreeWalker {
+    public:
+        std::vector<const ast::Node *> nodes;
+        std::vector<ast::ID *> ids;
+
+        using TreeWalker::visit;
+
+        void visit(ast::ID &node) override {
+            ids.push_back(&node);
+            TreeWalker::visit(node);
+        }
+
+    protected:
+        void enter(ast::Node &node) override {
+            nodes.push_back(&node);
+        }
+    };
+}
+
+static bool sameSignature(ast::FuncDecl &a, ast::FuncDecl &b) {
+    auto typeOf = [](ast::Type &type) {
+        auto primitive = dynamic_cast<ast::PrimitiveType *>(&type);
+        return primitive ? primitive->type : ast::BuiltInType::UNDEF;
+    };
+
+    if (typeOf(*a.return_type) != typeOf(*b.return_type) ||
+        a.formals->formals.size() != b.formals->formals.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.formals->formals.size(); ++i) {
+        if (typeOf(*a.formals->formals[i]->type) != typeOf(*b.formals->formals[i]->type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* QueryEngine class implementation */
+
+QueryEngine::QueryEngine(std::shared_ptr<ast::Funcs> program) : program(std::move(program)) {
+    for (auto &func : this->program->funcs) {
+        FunctionState state;
+        state.decl = func;
+        byName.emplace(func->id->value, functions.size());
+        byFirstLine.emplace(func->firstLine, functions.size());
+        functions.push_back(std::move(state));
+    }
+    _declare();
+}
+
+void QueryEngine::_declare() {
+    // signatures only; the function bodies are not looked at
+    signatures = std::make_unique<SemanticVisitor>();
+    declarationError.clear();
+    declarationLine = -1;
+    try {
+        signatures->declareFunctions(*program);
+    } catch (const output::CompileError &error) {
+        declarationError = error.message;
+        declarationLine = error.lineno;
+    }
+}
+
+void QueryEngine::_index(size_t index) {
+    FunctionState &state = functions[index];
+    if (state.indexed) {
+        return;
+    }
+
+    FunctionIndexer indexer;
+    state.decl->accept(indexer);
+    for (auto node : indexer.nodes) {
+        owners[node] = index;
+    }
+    state.nodes = std::move(indexer.nodes);
+    state.ids = std::move(indexer.ids);
+    state.indexed = true;
+}
+
+void QueryEngine::_unindex(size_t index) {
+    FunctionState &state = functions[index];
+    for (auto node : state.nodes) {
+        owners.erase(node);
+    }
+    state.nodes.clear();
+    state.ids.clear();
+    state.indexed = false;
+}
+
+void QueryEngine::_check(size_t index) {
+    FunctionState &state = functions[index];
+    if (state.checked) {
+        return;
+    }
+
+    FingerprintVisitor fingerprint(0);
+    state.decl->accept(fingerprint);
+    state.dependencies = fingerprint.referencedNames();
+
+    state.resolutions.clear();
+    state.result = FunctionResult();
+    state.checked = true;
+    ++checks;
+    if (!declarationError.empty()) {
+        state.result.ok = false;
+        state.result.error = declarationError;
+        state.result.line = declarationLine;
+        return;
+    }
+
+    signatures->setResolutionSink(&state.resolutions);
+    try {
+        state.result.scopes = signatures->captureDetached(*state.decl);
+    } catch (const output::CompileError &error) {
+        state.result.ok = false;
+        state.result.error = error.message;
+        state.result.line = error.lineno;
+    }
+    signatures->setResolutionSink(nullptr);
+}
+
+std::vector<size_t> QueryEngine::_functionsAt(int line) const {
+    // the function starting last at or before the line, and the ones before it ending there
+    std::vector<size_t> found;
+    for (auto it = byFirstLine.upper_bound(line); it != byFirstLine.begin();) {
+        --it;
+        if (functions[it->second].decl->lastLine < line) {
+            break;
+        }
+        found.push_back(it->second);
+    }
+    std::reverse(found.begin(), found.end());
+    return found;
+}
+
+long QueryEngine::_ownerOf(const ast::Node &node) {
+    auto it = owners.find(&node);
+    if (it != owners.end()) {
+        return static_cast<long>(it->second);
+    }
+
+    for (size_t index : _functionsAt(node.line)) {
+        if (functions[index].indexed) {
+            continue;
+        }
+        _index(index);
+        it = owners.find(&node);
+        if (it != owners.end()) {
+            return static_cast<long>(it->second);
+        }
+    }
+    return -1;
+}
+
+const QueryEngine::FunctionResult &QueryEngine::checkFunction(const std::string &name) {
+    auto it = byName.find(name);
+    if (it == byName.end()) {
+        missing = {false, "", "function " + name + " is not defined\n", -1};
+        return missing;
+    }
+    _check(it->second);
+    return functions[it->second].result;
+}
+
+ast::BuiltInType QueryEngine::typeOf(ast::Exp &node) {
+    long index = _ownerOf(node);
+    if (index < 0) {
+        return ast::BuiltInType::UNDEF;
+    }
+    _check(index);
+    // types are stored on the nodes by the checker
+    return functions[index].result.ok ? node.computedType : ast::BuiltInType::UNDEF;
+}
+
+const Symbol *QueryEngine::resolve(ast::ID &id) {
+    long index = _ownerOf(id);
+    if (index < 0) {
+        return nullptr;
+    }
+    _check(index);
+
+    auto &resolutions = functions[index].resolutions;
+    auto it = resolutions.find(&id);
+    return it == resolutions.end() ? nullptr : &it->second;
+}
+
+const Symbol *QueryEngine::resolveAt(int line, const std::string &name) {
+    for (size_t index : _functionsAt(line)) {
+        _index(index);
+        for (auto id : functions[index].ids) {
+            if (id->line == line && id->value == name) {
+                return resolve(*id);
+            }
+        }
+    }
+    return nullptr;
+}
+
+ast::BuiltInType QueryEngine::typeAt(int line, const std::string &name) {
+    for (size_t index : _functionsAt(line)) {
+        _index(index);
+        for (auto id : functions[index].ids) {
+            if (id->line == line && id->value == name) {
+                return typeOf(*id);
+            }
+        }
+    }
+    return ast::BuiltInType::UNDEF;
+}
+
+std::string QueryEngine::describeAt(int line, const std::string &name) {
+    const Symbol *symbol = resolveAt(line, name);
+    if (!symbol) {
+        return name + " is not resolved\n";
+    }
+
+    std::string text = symbol->name + " ";
+    if (symbol->isFunction) {
+        text += "(";
+        for (size_t i = 0; i < symbol->paramTypes.size(); ++i) {
+            text += (i ? "," : "") + output::toString(symbol->paramTypes[i]);
+        }
+        text += ") -> " + output::toString(symbol->type);
+    } else if (symbol->isArray) {
+        text += "[" + std::to_string(symbol->arrLength) + "] " + output::toString(symbol->type) + " " +
+                std::to_string(symbol->offset);
+    } else {
+        text += output::toString(symbol->type) + " " + std::to_string(symbol->offset);
+    }
+    return text + "\n";
+}
+
+void QueryEngine::_forgetLine(size_t index) {
+    auto range = byFirstLine.equal_range(functions[index].decl->firstLine);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == index) {
+            byFirstLine.erase(it);
+            return;
+        }
+    }
+}
+
+void QueryEngine::updateFunction(std::shared_ptr<ast::FuncDecl> func) {
+    const std::string &name = func->id->value;
+    bool signatureChanged = true;
+
+    auto it = byName.find(name);
+    size_t index;
+    if (it == byName.end()) {
+        index = functions.size();
+        byName.emplace(name, index);
+        functions.emplace_back();
+        program->funcs.push_back(func);
+    } else {
+        index = it->second;
+        signatureChanged = !sameSignature(*functions[index].decl, *func);
+        _unindex(index);
+        _forgetLine(index);
+        // functions are kept in program order
+        program->funcs[index] = func;
+    }
+
+    byFirstLine.emplace(func->firstLine, index);
+    FunctionState &state = functions[index];
+    state.decl = std::move(func);
+    state.checked = false;
+
+    if (signatureChanged) {
+        bool declaredBefore = declarationError.empty();
+        _declare();
+        bool everything = !declaredBefore || !declarationError.empty();
+        for (auto &other : functions) {
+            if (other.checked && (everything || other.dependencies.count(name))) {
+                other.checked = false;
+            }
+        }
+    }
+}
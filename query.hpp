@@ -0,0 +1,106 @@
+#ifndef QUERY_HPP
+#define QUERY_HPP
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include "nodes.hpp"
+#include "symtable.hpp"
+#include "semanticvisitor.hpp"
+
+/* QueryEngine class
+ * Answers single questions about a parsed program without checking all of it, for editor
+ * integrations. The function signatures are declared once, and again only when one of them
+ * changes; a function body is checked the first time a query needs it, and its result is
+ * memoized until the function is replaced. Functions are found from the lines their text
+ * spans, so the cost of a query is that of one function, not of the whole program.
+ */
+class QueryEngine {
+public:
+    struct FunctionResult {
+        bool ok = true;
+        // Scope dump lines of the function if ok, otherwise the error that stopped its check
+        std::string scopes;
+        std::string error;
+        // Line of the error, or -1 if it is not tied to one
+        int line = -1;
+    };
+
+private:
+    struct FunctionState {
+        std::shared_ptr<ast::FuncDecl> decl;
+
+        // Filled by _index: every node of the function and its identifiers
+        bool indexed = false;
+        std::vector<const ast::Node *> nodes;
+        std::vector<ast::ID *> ids;
+
+        // Filled by _check
+        bool checked = false;
+        FunctionResult result;
+        std::unordered_map<const ast::ID *, Symbol> resolutions;
+        // Names the body mentions; the result depends on their global signatures
+        std::set<std::string> dependencies;
+    };
+
+    std::shared_ptr<ast::Funcs> program;
+    std::vector<FunctionState> functions;
+    std::unordered_map<std::string, size_t> byName;
+    // Functions by the first line of their text
+    std::multimap<int, size_t> byFirstLine;
+    std::unordered_map<const ast::Node *, size_t> owners;
+    FunctionResult missing;
+
+    // Holds the global scope with every signature declared, or the error declaring them
+    // stopped with (main missing, a function defined twice)
+    std::unique_ptr<SemanticVisitor> signatures;
+    std::string declarationError;
+    int declarationLine = -1;
+    // Function bodies checked, not counting answers that were memoized
+    unsigned long checks = 0;
+
+    void _declare();
+    void _index(size_t index);
+    void _unindex(size_t index);
+    void _forgetLine(size_t index);
+    void _check(size_t index);
+    // Indices of the functions whose text spans the line; more than one only when a function
+    // ends on the line the next one starts
+    std::vector<size_t> _functionsAt(int line) const;
+    // Index of the function containing the node, or -1 if it is not part of the program
+    long _ownerOf(const ast::Node &node);
+
+public:
+    explicit QueryEngine(std::shared_ptr<ast::Funcs> program);
+
+    // Checks a single function (and nothing else); memoized
+    const FunctionResult &checkFunction(const std::string &name);
+
+    // Type of an expression of the program; UNDEF if its function does not check
+    ast::BuiltInType typeOf(ast::Exp &node);
+
+    // Symbol an identifier refers to, or nullptr if it does not resolve
+    const Symbol *resolve(ast::ID &id);
+
+    // Symbol an identifier called `name` written on `line` refers to, or nullptr
+    const Symbol *resolveAt(int line, const std::string &name);
+
+    // Type of the identifier called `name` written on `line`, as an expression; UNDEF if there is
+    // none or its function does not check
+    ast::BuiltInType typeAt(int line, const std::string &name);
+
+    // What hw3 --resolve prints for the identifier called `name` written on `line`
+    std::string describeAt(int line, const std::string &name);
+
+    // Replaces (or adds) a function after its text changed. Memoized results of the function are
+    // dropped, and when its signature changed, so are those of every function mentioning it.
+    void updateFunction(std::shared_ptr<ast::FuncDecl> func);
+
+    // Number of function checks run so far; an answer reused from an earlier query adds nothing
+    unsigned long functionsChecked() const { return checks; }
+};
+
+#endif //QUERY_HPP
@@ -1,6 +1,6 @@
 #!/bin/bash
 
-make clean && make
+make clean && make && make lib
 if [ $? -ne 0 ]; then
     echo "Compilation failed!"
     exit 1
@@ -31,7 +31,18 @@ for test_in in tests/t*.in; do
     fi
 done
 
+# every suite under tests/ prints its own failures and ends with "Failed: N"
+suites_failed=0
+for suite in tests/*/run.sh; do
+    echo
+    echo "Running $(dirname "$suite")..."
+    if ! "$suite"; then
+        ((suites_failed++))
+    fi
+done
+
 echo
 echo "Summary:"
 echo "Passed: $passed"
 echo "Failed: $failed"
+echo "Suites failed: $suites_failed"
@@ -1,10 +1,38 @@
 #include "semanticvisitor.hpp"
+#include "trace.hpp"
 #include <iostream>
+#include <algorithm>
 
-SemanticVisitor::SemanticVisitor() : curr_expected_return_type(ast::BuiltInType::UNDEF), in_while(false) {
+SemanticVisitor::SemanticVisitor() : curr_expected_return_type(ast::BuiltInType::UNDEF), in_while(false), curr_frame_size(0), cache(nullptr), resolutions(nullptr) {
     // Constructor - symbol table is automatically initialized
 }
 
+void SemanticVisitor::setFunctionCache(FunctionCache *functionCache) {
+    cache = functionCache;
+}
+
+void SemanticVisitor::setResolutionSink(std::unordered_map<const ast::ID *, Symbol> *sink) {
+    resolutions = sink;
+}
+
+void SemanticVisitor::_resolved(const ast::ID &id, const Symbol &symbol) {
+    if (resolutions) {
+        (*resolutions)[&id] = symbol;
+    }
+}
+
+void SemanticVisitor::printScopes(std::ostream &os) const {
+    symTable.printScopes(os);
+}
+
+void SemanticVisitor::setJsonPrinter(output::JsonScopePrinter *printer) {
+    symTable.setJsonPrinter(printer);
+}
+
+bool SemanticVisitor::writeScopes(int fd) const {
+    return symTable.writeScopes(fd);
+}
+
 bool SemanticVisitor::_is_numeric(ast::BuiltInType type){
     return (type == ast::BuiltInType::INT || type == ast::BuiltInType::BYTE);
 }
@@ -45,6 +73,9 @@ void SemanticVisitor::visit(ast::ID &node) {
     }
     node.computedType = symbol->type;
     node.computedIsArray = symbol->isArray;
+    node.computedOffset = symbol->offset;
+    node.computedArrLength = symbol->arrLength;
+    _resolved(node, *symbol);
 }
 
 void SemanticVisitor::visit(ast::BinOp &node) {
@@ -234,6 +265,7 @@ void SemanticVisitor::visit(ast::Call &node) {
 
     if (!symbol->isFunction)
         output::errorDefAsVar(node.func_id->line, node.func_id->value);
+    _resolved(*node.func_id, *symbol);
     
     std::vector<std::string> param_types_str = symbol->types_as_string();
 
@@ -355,7 +387,9 @@ void SemanticVisitor::visit(ast::VarDecl &node) {
         arrayLength = node.type->computedArrLength;
     }
 
-    symTable.addVar(node.id->value, node.type->computedType, node.id->line, node.type->computedIsArray, arrayLength);
+    Symbol *symbol = symTable.addVar(node.id->value, node.type->computedType, node.id->line, node.type->computedIsArray, arrayLength);
+    int size = node.type->computedIsArray ? arrayLength : 1;
+    curr_frame_size = std::max(curr_frame_size, symbol->offset + size);
 
     node.id->accept(*this);
 
@@ -381,7 +415,10 @@ void SemanticVisitor::visit(ast::VarDecl &node) {
 void SemanticVisitor::visit(ast::Formal &node) {
     node.type->accept(*this);
     
-    symTable.addParam(node.id->value, node.type->computedType, node.id->line);
+    Symbol *symbol = symTable.addParam(node.id->value, node.type->computedType, node.id->line);
+    node.id->computedType = symbol->type;
+    node.id->computedOffset = symbol->offset;
+    _resolved(*node.id, *symbol);
 }
 
 void SemanticVisitor::visit(ast::Formals &node) {
@@ -398,7 +435,9 @@ void SemanticVisitor::visit(ast::FuncDecl &node) {
     // Save the previous expected return type and set the new one
     ast::BuiltInType prev_expected_return_type = curr_expected_return_type;
     curr_expected_return_type = node.return_type->computedType;
+    curr_frame_size = 0;
     
+    symTable.beginFunction(node.id->value);
     symTable.enterScope();
 
     // accepting the formals to add them to the symbol table
@@ -407,12 +446,13 @@ void SemanticVisitor::visit(ast::FuncDecl &node) {
     node.body->accept(*this);
 
     symTable.exitScope();
+    node.computedFrameSize = curr_frame_size;
     
     // Restore the previous expected return type
     curr_expected_return_type = prev_expected_return_type;
 }
 
-void SemanticVisitor::visit(ast::Funcs &node) {
+void SemanticVisitor::declareFunctions(ast::Funcs &node) {
     // first adding all functions to the symbol table
     for (auto &func : node.funcs)
     {
@@ -443,11 +483,59 @@ void SemanticVisitor::visit(ast::Funcs &node) {
     if (!has_main) {
         output::errorMainMissing();
     }
+}
+
+void SemanticVisitor::checkFunction(ast::FuncDecl &func) {
+    trace::Span span(func.id->value, "function");
+    if (!cache) {
+        func.accept(*this);
+        return;
+    }
+
+    int baseLine = func.id->line;
+    std::string key = FunctionCache::keyFor(func, symTable);
+    FunctionCache::Entry entry;
+    if (cache->lookup(key, entry)) {
+        span.setCategory("function,cached");
+        if (entry.failed) {
+            throw FunctionCache::errorOf(entry, baseLine);
+        }
+        symTable.replayScopes(entry.scopes);
+        return;
+    }
+
+    try {
+        cache->storeScopes(key, captureFunction(func));
+    } catch (const output::CompileError &error) {
+        cache->storeError(key, baseLine, error);
+        throw;
+    }
+}
+
+std::string SemanticVisitor::captureFunction(ast::FuncDecl &func) {
+    symTable.beginCapture();
+    func.accept(*this);
+    return symTable.endCapture();
+}
+
+std::string SemanticVisitor::captureDetached(ast::FuncDecl &func) {
+    in_while = false;
+    try {
+        std::string scopes = captureFunction(func);
+        symTable.discardScopes();
+        return scopes;
+    } catch (const output::CompileError &) {
+        symTable.discardScopes();
+        throw;
+    }
+}
+
+void SemanticVisitor::visit(ast::Funcs &node) {
+    declareFunctions(node);
 
     // then visiting each function to process its body
     for (auto &func : node.funcs)
     {
-        func->accept(*this);
+        checkFunction(*func);
     }
-
 }
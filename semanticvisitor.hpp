@@ -4,6 +4,7 @@
 #include "visitor.hpp"
 #include "nodes.hpp"
 #include "symtable.hpp"
+#include "funccache.hpp"
 
 class SemanticVisitor : public Visitor
 {
@@ -11,13 +12,51 @@ private:
     SymTable symTable;
     ast::BuiltInType curr_expected_return_type;
     bool in_while;
+    // Frame slots used so far by the locals of the function being checked
+    int curr_frame_size;
+    FunctionCache *cache;
+    std::unordered_map<const ast::ID *, Symbol> *resolutions;
+
+    void _resolved(const ast::ID &id, const Symbol &symbol);
 
     bool _is_numeric(ast::BuiltInType type);
     bool _can_assign(ast::BuiltInType from, ast::BuiltInType to);
     
 public:
     SemanticVisitor();
-    
+
+    // Reuse results of previously checked functions; nullptr (the default) checks everything
+    void setFunctionCache(FunctionCache *functionCache);
+
+    // Records the symbol every checked identifier resolves to; nullptr (the default) records nothing
+    void setResolutionSink(std::unordered_map<const ast::ID *, Symbol> *sink);
+
+    // Adds every function signature to the global scope and checks for a single valid main
+    void declareFunctions(ast::Funcs &node);
+
+    // Checks one function body; all functions must have been declared first
+    void checkFunction(ast::FuncDecl &func);
+
+    // Checks one function like checkFunction, bypassing the cache, and returns the scope dump
+    // lines it produced
+    std::string captureFunction(ast::FuncDecl &func);
+
+    // Checks one function like captureFunction but leaves nothing of it behind: its lines are
+    // not added to the dump and, even if it fails, the visitor is ready to check another one.
+    // Lets signatures declared once serve any number of checks.
+    std::string captureDetached(ast::FuncDecl &func);
+
+    void printScopes(std::ostream &os) const;
+
+    // Reports scopes as they close, see SymTable::setJsonPrinter
+    void setJsonPrinter(output::JsonScopePrinter *printer);
+
+    // Writes the dump straight to a file descriptor, bypassing iostreams
+    bool writeScopes(int fd) const;
+
+    // Access to the two halves of the dump and the buffered scope lines, for streaming
+    SymTable &symbols() { return symTable; }
+
     virtual void visit(ast::Num &node) override;
 
     virtual void visit(ast::NumB &node) override;
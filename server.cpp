@@ -0,0 +1,227 @@
+#include "server.hpp"
+#include "driver.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+// Reads until the peer shuts down its writing side; with a timeout, fails once that many
+// milliseconds have passed in total, however slowly the data trickles in, and with a limit,
+// fails as soon as more than that many bytes came
+static bool readAll(int fd, std::string &data, int timeoutMs = -1, size_t limit = std::string::npos) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    char chunk[65536];
+    while (true) {
+        if (timeoutMs >= 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            pollfd ready = {fd, POLLIN, 0};
+            int polled = poll(&ready, 1, std::max<long>(left.count(), 0));
+            if (polled < 0 && errno == EINTR) continue;
+            if (polled <= 0) {
+                return false;
+            }
+        }
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n == 0) {
+            return true;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (static_cast<size_t>(n) > limit - data.size()) {
+            return false;
+        }
+        data.append(chunk, n);
+    }
+}
+
+static bool writeAll(int fd, const std::string &data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        // MSG_NOSIGNAL: a client that went away must not kill the server with SIGPIPE
+        ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+static bool makeAddress(const std::string &path, sockaddr_un &address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "socket path too long: " << path << std::endl;
+        return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+    return true;
+}
+
+/* CompileServer class implementation */
+
+CompileServer::CompileServer(std::string socketPath, int workers)
+        : socketPath(std::move(socketPath)), listenFd(-1), wakeFds{-1, -1}, workers(workers), stopping(false) {
+    if (this->workers <= 0) {
+        this->workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (pipe(wakeFds) < 0) {
+        wakeFds[0] = wakeFds[1] = -1;
+    }
+}
+
+CompileServer::~CompileServer() {
+    _joinWorkers();
+    for (int fd : wakeFds) {
+        if (fd >= 0) close(fd);
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+}
+
+bool CompileServer::listen() {
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        return false;
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << "socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // a stale socket file left by a previous server would make bind fail
+    unlink(socketPath.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+        ::listen(listenFd, SOMAXCONN) < 0) {
+        std::cerr << socketPath << ": " << strerror(errno) << std::endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+void CompileServer::_serve(int fd) {
+    // a client that stops reading its answer must not hold the worker either
+    timeval timeout = {READ_TIMEOUT_MS / 1000, READ_TIMEOUT_MS % 1000 * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string source;
+    if (readAll(fd, source, READ_TIMEOUT_MS, MAX_REQUEST_BYTES)) {
+        writeAll(fd, checkSource(std::move(source), &cache));
+    }
+    close(fd);
+}
+
+void CompileServer::_work() {
+    while (true) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> guard(pendingLock);
+            pendingReady.wait(guard, [this] { return !pending.empty() || stopping; });
+            if (pending.empty()) {
+                return;
+            }
+            fd = pending.front();
+            pending.pop_front();
+        }
+        pendingRoom.notify_one();
+        _serve(fd);
+    }
+}
+
+void CompileServer::_joinWorkers() {
+    {
+        std::lock_guard<std::mutex> guard(pendingLock);
+        stopping = true;
+    }
+    pendingReady.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+bool CompileServer::run() {
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back(&CompileServer::_work, this);
+    }
+
+    size_t capacity = workers * QUEUE_PER_WORKER;
+    bool ok = true;
+    while (true) {
+        {
+            // accept only when there is room, leaving the rest in the backlog
+            std::unique_lock<std::mutex> guard(pendingLock);
+            pendingRoom.wait(guard, [this, capacity] { return pending.size() < capacity; });
+        }
+        pollfd ready[] = {{listenFd, POLLIN, 0}, {wakeFds[0], POLLIN, 0}};
+        if (poll(ready, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "poll: " << strerror(errno) << std::endl;
+            ok = false;
+            break;
+        }
+        if (ready[1].revents) {
+            break;
+        }
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::cerr << "accept: " << strerror(errno) << std::endl;
+            ok = false;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> guard(pendingLock);
+            pending.push_back(fd);
+        }
+        pendingReady.notify_one();
+    }
+
+    _joinWorkers();
+    return ok;
+}
+
+void CompileServer::stop() {
+    char byte = 0;
+    if (write(wakeFds[1], &byte, 1) < 0) {
+        // the pipe is full, so run() is being woken up already
+    }
+}
+
+bool requestCheck(const std::string &socketPath, const std::string &source, std::string &reply) {
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        std::cerr << socketPath << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    // every answer has at least a line, so an empty one means the server dropped the request
+    bool ok = writeAll(fd, source) && shutdown(fd, SHUT_WR) == 0 && readAll(fd, reply) && !reply.empty();
+    close(fd);
+    if (!ok) {
+        std::cerr << socketPath << ": no answer from the server" << std::endl;
+    }
+    return ok;
+}
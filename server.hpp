@@ -0,0 +1,70 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "funccache.hpp"
+
+/* CompileServer class
+ * Serves hw3 over a UNIX domain socket. A client connects, sends one program and shuts down its
+ * writing side; the server answers with exactly what hw3 prints for that program and closes the
+ * connection. Clients are served concurrently by a fixed pool of worker threads and share an
+ * in-memory function cache, so unchanged functions are not checked again between requests.
+ * Accepted connections wait in a bounded queue for a free worker; while it is full, new
+ * clients wait in the socket's backlog. A client that takes longer than READ_TIMEOUT_MS to
+ * send its program, sends more than MAX_REQUEST_BYTES, or stops reading the answer, is dropped
+ * without one.
+ */
+class CompileServer {
+public:
+    static const int READ_TIMEOUT_MS = 10000;
+    // Accepted connections that may wait for a worker, per worker
+    static const size_t QUEUE_PER_WORKER = 4;
+    static const size_t MAX_REQUEST_BYTES = 16 << 20;
+
+private:
+    std::string socketPath;
+    FunctionCache cache;
+    int listenFd;
+    // stop() writes to the second end, which wakes run() up from the first
+    int wakeFds[2];
+    int workers;
+    std::vector<std::thread> threads;
+
+    std::deque<int> pending;
+    std::mutex pendingLock;
+    std::condition_variable pendingReady;
+    std::condition_variable pendingRoom;
+    bool stopping;
+
+    // Serves queued connections until the server stops and the queue is empty
+    void _work();
+    void _serve(int fd);
+    // Lets the workers finish the queued connections and waits for them
+    void _joinWorkers();
+
+public:
+    // A count of 0 workers uses one per hardware thread
+    explicit CompileServer(std::string socketPath, int workers = 0);
+    ~CompileServer();
+
+    // Binds and listens on the socket; prints the reason to stderr and returns false on failure
+    bool listen();
+
+    // Starts the workers, then accepts and queues clients until stop() is called or accepting
+    // fails, and returns once the workers have answered every queued client. Returns false if
+    // accepting failed.
+    bool run();
+
+    // Makes run() return; async-signal-safe, so it may be called from a signal handler
+    void stop();
+};
+
+// Sends a program to a running server and stores its answer in reply
+bool requestCheck(const std::string &socketPath, const std::string &source, std::string &reply);
+
+#endif //SERVER_HPP
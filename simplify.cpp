@@ -0,0 +1,297 @@
+#include "simplify.hpp"
+#include <climits>
+#include <utility>
+#include "constfold.hpp"
+
+AlgebraicSimplifier::AlgebraicSimplifier() : simplifiedCount(0), shiftCount(0) {}
+
+/* Helpers */
+
+void AlgebraicSimplifier::_simplify(std::shared_ptr<ast::Exp> &exp) {
+    result = nullptr;
+    exp->accept(*this);
+    if (result) {
+        exp = result;
+        simplifiedCount++;
+    }
+    result = nullptr;
+}
+
+bool AlgebraicSimplifier::_literal(const ast::Exp &exp, int &value) {
+    return !dynamic_cast<const ast::Bool *>(&exp) && ConstantFolder::literalValue(exp, value);
+}
+
+std::shared_ptr<ast::Exp> AlgebraicSimplifier::_number(int value, ast::BuiltInType type, int line) {
+    std::shared_ptr<ast::Exp> literal;
+    if (type == ast::BuiltInType::BYTE) {
+        auto numB = std::make_shared<ast::NumB>("0");
+        numB->value = value;
+        literal = numB;
+    } else {
+        auto num = std::make_shared<ast::Num>("0");
+        num->value = value;
+        literal = num;
+    }
+    literal->line = line;
+    literal->computedType = type;
+    return literal;
+}
+
+bool AlgebraicSimplifier::_pure(const ast::Exp &exp) {
+    if (dynamic_cast<const ast::ID *>(&exp) || dynamic_cast<const ast::Num *>(&exp) ||
+        dynamic_cast<const ast::NumB *>(&exp) || dynamic_cast<const ast::Bool *>(&exp)) {
+        return true;
+    }
+    if (auto binOp = dynamic_cast<const ast::BinOp *>(&exp)) {
+        int divisor;
+        if (binOp->op == ast::BinOpType::DIV && (!_literal(*binOp->right, divisor) || divisor == 0)) {
+            return false;
+        }
+        return _pure(*binOp->left) && _pure(*binOp->right);
+    }
+    if (auto cast = dynamic_cast<const ast::Cast *>(&exp)) {
+        return _pure(*cast->exp);
+    }
+    return false;
+}
+
+void AlgebraicSimplifier::_reassociate(ast::BinOp &node) {
+    auto inner = dynamic_cast<ast::BinOp *>(node.left.get());
+    int outer, value;
+    if (!inner || inner->computedType != node.computedType || !_literal(*node.right, outer) ||
+        !_literal(*inner->right, value)) {
+        return;
+    }
+    bool additive = node.op == ast::BinOpType::ADD || node.op == ast::BinOpType::SUB;
+    bool innerAdditive = inner->op == ast::BinOpType::ADD || inner->op == ast::BinOpType::SUB;
+    ast::BuiltInType type = node.computedType;
+
+    if (additive && innerAdditive) {
+        // x - c is x + (-c), and both sides wrap the same way
+        if (inner->op == ast::BinOpType::SUB) {
+            value = ConstantFolder::evalBinOp(ast::BinOpType::SUB, 0, value, type);
+        }
+        value = ConstantFolder::evalBinOp(node.op, value, outer, type);
+        node.op = ast::BinOpType::ADD;
+        if (type == ast::BuiltInType::INT && value < 0 && value != INT_MIN) {
+            node.op = ast::BinOpType::SUB;
+            value = -value;
+        }
+    } else if (node.op == ast::BinOpType::MUL && inner->op == ast::BinOpType::MUL) {
+        value = ConstantFolder::evalBinOp(ast::BinOpType::MUL, value, outer, type);
+    } else {
+        return;
+    }
+    node.left = inner->left;
+    node.right = _number(value, type, node.line);
+    node.computedShift = 0;
+    simplifiedCount++;
+}
+
+void AlgebraicSimplifier::_keepLeft(ast::BinOp &node) {
+    if (node.left->computedType == node.computedType) {
+        result = node.left;
+        return;
+    }
+    // a byte in an int operation: it still has to read as an int
+    auto type = std::make_shared<ast::PrimitiveType>(ast::BuiltInType::INT);
+    type->line = node.line;
+    type->computedType = ast::BuiltInType::INT;
+    auto cast = std::make_shared<ast::Cast>(node.left, type);
+    cast->line = node.line;
+    cast->computedType = ast::BuiltInType::INT;
+    result = cast;
+}
+
+/* Expressions */
+
+void AlgebraicSimplifier::visit(ast::Num &node) {}
+
+void AlgebraicSimplifier::visit(ast::NumB &node) {}
+
+void AlgebraicSimplifier::visit(ast::String &node) {}
+
+void AlgebraicSimplifier::visit(ast::Bool &node) {}
+
+void AlgebraicSimplifier::visit(ast::ID &node) {}
+
+void AlgebraicSimplifier::visit(ast::BinOp &node) {
+    _simplify(node.left);
+    _simplify(node.right);
+
+    ast::BuiltInType type = node.computedType;
+    int left, right;
+    bool constantLeft = _literal(*node.left, left);
+    bool constantRight = _literal(*node.right, right);
+    if (constantLeft && constantRight) {
+        // a division by a constant zero is left for the program to trap on
+        if (node.op != ast::BinOpType::DIV || right != 0) {
+            result = _number(ConstantFolder::evalBinOp(node.op, left, right, type), type, node.line);
+        }
+        return;
+    }
+
+    // a literal has no effects, so it can be evaluated after the other operand
+    if (constantLeft && (node.op == ast::BinOpType::ADD || node.op == ast::BinOpType::MUL)) {
+        std::swap(node.left, node.right);
+        right = left;
+        simplifiedCount++;
+    } else if (!constantRight) {
+        return;
+    }
+
+    _reassociate(node);
+    _literal(*node.right, right);
+
+    switch (node.op) {
+        case ast::BinOpType::ADD:
+        case ast::BinOpType::SUB:
+            if (right == 0) {
+                _keepLeft(node);
+            }
+            return;
+        case ast::BinOpType::MUL:
+            if (right == 0 && _pure(*node.left)) {
+                result = _number(0, type, node.line);
+                return;
+            }
+            break;
+        case ast::BinOpType::DIV:
+            break;
+    }
+    if (right == 1) {
+        _keepLeft(node);
+        return;
+    }
+
+    // 2^k for k >= 1; a byte literal is never negative, and an int one never INT_MIN
+    if (right > 1 && (right & (right - 1)) == 0 && node.computedShift == 0) {
+        int shift = 0;
+        while ((1 << shift) != right) {
+            shift++;
+        }
+        node.computedShift = shift;
+        shiftCount++;
+    }
+}
+
+void AlgebraicSimplifier::visit(ast::RelOp &node) {
+    _simplify(node.left);
+    _simplify(node.right);
+}
+
+void AlgebraicSimplifier::visit(ast::Not &node) {
+    _simplify(node.exp);
+}
+
+void AlgebraicSimplifier::visit(ast::And &node) {
+    _simplify(node.left);
+    _simplify(node.right);
+}
+
+void AlgebraicSimplifier::visit(ast::Or &node) {
+    _simplify(node.left);
+    _simplify(node.right);
+}
+
+void AlgebraicSimplifier::visit(ast::Cast &node) {
+    _simplify(node.exp);
+
+    ast::BuiltInType to = node.target_type->computedType;
+    int value;
+    if (_literal(*node.exp, value)) {
+        result = _number(ConstantFolder::evalCast(value, to), to, node.line);
+    } else if (node.exp->computedType == to) {
+        result = node.exp;
+    } else if (auto inner = dynamic_cast<ast::Cast *>(node.exp.get())) {
+        // (byte)(int)b: widening a byte and truncating it back gives the byte
+        if (to == ast::BuiltInType::BYTE && inner->exp->computedType == ast::BuiltInType::BYTE) {
+            result = inner->exp;
+        }
+    }
+}
+
+void AlgebraicSimplifier::visit(ast::ArrayDereference &node) {
+    _simplify(node.index);
+}
+
+void AlgebraicSimplifier::visit(ast::ExpList &node) {
+    for (auto &exp : node.exps) {
+        _simplify(exp);
+    }
+}
+
+void AlgebraicSimplifier::visit(ast::Call &node) {
+    node.args->accept(*this);
+    result = nullptr;
+}
+
+/* Types */
+
+void AlgebraicSimplifier::visit(ast::ArrayType &node) {}
+
+void AlgebraicSimplifier::visit(ast::PrimitiveType &node) {}
+
+/* Statements */
+
+void AlgebraicSimplifier::visit(ast::ArrayAssign &node) {
+    _simplify(node.index);
+    _simplify(node.exp);
+}
+
+void AlgebraicSimplifier::visit(ast::Statements &node) {
+    for (auto &statement : node.statements) {
+        statement->accept(*this);
+    }
+}
+
+void AlgebraicSimplifier::visit(ast::Block &node) {
+    node.statements->accept(*this);
+}
+
+void AlgebraicSimplifier::visit(ast::Break &node) {}
+
+void AlgebraicSimplifier::visit(ast::Continue &node) {}
+
+void AlgebraicSimplifier::visit(ast::Return &node) {
+    if (node.exp) {
+        _simplify(node.exp);
+    }
+}
+
+void AlgebraicSimplifier::visit(ast::If &node) {
+    _simplify(node.condition);
+    node.then->accept(*this);
+    if (node.otherwise) {
+        node.otherwise->accept(*this);
+    }
+}
+
+void AlgebraicSimplifier::visit(ast::While &node) {
+    _simplify(node.condition);
+    node.body->accept(*this);
+}
+
+void AlgebraicSimplifier::visit(ast::VarDecl &node) {
+    if (node.init_exp) {
+        _simplify(node.init_exp);
+    }
+}
+
+void AlgebraicSimplifier::visit(ast::Assign &node) {
+    _simplify(node.exp);
+}
+
+void AlgebraicSimplifier::visit(ast::Formal &node) {}
+
+void AlgebraicSimplifier::visit(ast::Formals &node) {}
+
+void AlgebraicSimplifier::visit(ast::FuncDecl &node) {
+    node.body->accept(*this);
+}
+
+void AlgebraicSimplifier::visit(ast::Funcs &node) {
+    for (auto &func : node.funcs) {
+        func->accept(*this);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef SIMPLIFY_HPP
+#define SIMPLIFY_HPP
+
+#include <memory>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* AlgebraicSimplifier class
+ * Rewrites BinOp and Cast subtrees of a checked tree into cheaper equal ones, bottom up:
+ *
+ *     x + 0, x - 0, x * 1, x / 1   =>  x             (x * 0 => 0 when x has no effects)
+ *     3 + x, 3 * x                 =>  x + 3, x * 3  (literals go to the right)
+ *     (x + 3) - 5, (x * 2) * 4     =>  x - 2, x * 8  (literals combined)
+ *     (int)i, (byte)(int)b         =>  i, b          (casts that change nothing)
+ *
+ * All arithmetic is in the type of the expression, so literals combine modulo 2^32 for int and
+ * 2^8 for byte, and only operations of the same type are combined: in (b + 3b) + 5 the inner sum
+ * wraps at 8 bits and the outer one does not. An operand is only dropped when it has the type
+ * of the whole expression. Multiplication and division by a power of two are marked with
+ * computedShift for the backends, which shift left, or right rounding toward zero as int
+ * division does.
+ */
+class AlgebraicSimplifier : public Visitor {
+private:
+    // Expression that replaces the one just visited, or nullptr to keep it
+    std::shared_ptr<ast::Exp> result;
+    int simplifiedCount;
+    int shiftCount;
+
+    void _simplify(std::shared_ptr<ast::Exp> &exp);
+    // Combines the literal right operand of `node` with that of a left operand of the same kind
+    void _reassociate(ast::BinOp &node);
+    // Replaces `node` with its left operand if that has the same type
+    void _keepLeft(ast::BinOp &node);
+
+    // An expression with no effects that cannot trap, so it may go unevaluated
+    static bool _pure(const ast::Exp &exp);
+    static bool _literal(const ast::Exp &exp, int &value);
+    static std::shared_ptr<ast::Exp> _number(int value, ast::BuiltInType type, int line);
+
+public:
+    AlgebraicSimplifier();
+
+    // Number of expressions rewritten
+    int simplified() const { return simplifiedCount; }
+
+    // Number of multiplications and divisions turned into shifts
+    int shifts() const { return shiftCount; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif //SIMPLIFY_HPP
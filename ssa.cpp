@@ -0,0 +1,1437 @@
+#include "ssa.hpp"
+#include <algorithm>
+#include <climits>
+#include "stringpool.hpp"
+
+namespace ssa {
+    static const char *const opcodeNames[OPCODE_COUNT] = {
+            "const", "param", "undef", "add", "sub", "mul", "div", "addb", "subb", "mulb", "divb",
+            "truncb", "not", "eq", "ne", "lt", "le", "gt", "ge", "phi", "call", "aload", "astore",
+            "azero", "print", "printi", "jmp", "br", "ret", "retv", "nop"
+    };
+
+    const char *opcodeName(Opcode op) {
+        return op < OPCODE_COUNT ? opcodeNames[op] : "?";
+    }
+
+    size_t Function::size() const {
+        size_t total = 0;
+        for (const Block &block : blocks) {
+            if (!block.removed) {
+                total += block.phis.size() + block.instrs.size();
+            }
+        }
+        return total;
+    }
+
+    // Instructions whose value depends only on their operands
+    static bool isPure(Opcode op) {
+        return op == CONST || (op >= ADD && op <= GE);
+    }
+
+    static bool isCommutative(Opcode op) {
+        return op == ADD || op == MUL || op == ADDB || op == MULB || op == EQ || op == NE;
+    }
+
+    bool hasSideEffects(const Function &function, ValueId value) {
+        const Instr &instr = function.instrs[value];
+        switch (instr.op) {
+            case DIV:
+            case DIVB: {
+                const Instr &divisor = function.instrs[function.operand(value, 1)];
+                return divisor.op != CONST || divisor.imm == 0;
+            }
+            case ALOAD: {
+                const Instr &index = function.instrs[function.operand(value, 0)];
+                return index.op != CONST || index.imm < 0 || index.imm >= function.arrays[instr.imm].length;
+            }
+            case CALL:
+            case ASTORE:
+            case AZERO:
+            case PRINT:
+            case PRINTI:
+            case JMP:
+            case BR:
+            case RET:
+            case RETV:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Drops the predecessor `pred` of `block` along with the matching operand of each phi
+    static void removePred(Function &function, BlockId block, BlockId pred) {
+        Block &target = function.blocks[block];
+        auto found = std::find(target.preds.begin(), target.preds.end(), pred);
+        if (found == target.preds.end()) {
+            return;
+        }
+        uint32_t index = static_cast<uint32_t>(found - target.preds.begin());
+        target.preds.erase(found);
+        for (ValueId phi : target.phis) {
+            Instr &instr = function.instrs[phi];
+            for (uint32_t i = index; i + 1 < instr.count; ++i) {
+                function.operand(phi, i) = function.operand(phi, i + 1);
+            }
+            --instr.count;
+        }
+    }
+
+    // Keeps only the instructions of each block that `keep` accepts, turning the others into NOP
+    template<typename Keep>
+    static size_t sweep(Function &function, Keep keep) {
+        size_t removed = 0;
+        for (Block &block : function.blocks) {
+            if (block.removed) {
+                continue;
+            }
+            for (std::vector<ValueId> *list : {&block.phis, &block.instrs}) {
+                size_t kept = 0;
+                for (ValueId value : *list) {
+                    if (keep(value)) {
+                        (*list)[kept++] = value;
+                    } else {
+                        function.instrs[value].op = NOP;
+                        ++removed;
+                    }
+                }
+                list->resize(kept);
+            }
+        }
+        return removed;
+    }
+
+    // Immediate dominators by Cooper, Harvey and Kennedy's iteration over reverse postorder;
+    // returns the blocks in reverse postorder, NONE for the ones the entry does not reach
+    static std::vector<BlockId> dominators(const Function &function, std::vector<BlockId> &idom) {
+        size_t blockCount = function.blocks.size();
+        std::vector<BlockId> postorder;
+        std::vector<char> visited(blockCount, 0);
+        std::vector<std::pair<BlockId, size_t>> stack;
+        stack.emplace_back(0, 0);
+        visited[0] = 1;
+        while (!stack.empty()) {
+            BlockId block = stack.back().first;
+            size_t &next = stack.back().second;
+            const std::vector<BlockId> &succs = function.blocks[block].succs;
+            if (next < succs.size()) {
+                BlockId succ = succs[next++];
+                if (!visited[succ]) {
+                    visited[succ] = 1;
+                    stack.emplace_back(succ, 0);
+                }
+            } else {
+                postorder.push_back(block);
+                stack.pop_back();
+            }
+        }
+        std::vector<BlockId> order(postorder.rbegin(), postorder.rend());
+        std::vector<uint32_t> number(blockCount, NONE);
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            number[order[i]] = i;
+        }
+
+        idom.assign(blockCount, NONE);
+        idom[0] = 0;
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (size_t i = 1; i < order.size(); ++i) {
+                BlockId block = order[i];
+                BlockId chosen = NONE;
+                for (BlockId pred : function.blocks[block].preds) {
+                    if (number[pred] == NONE || idom[pred] == NONE) {
+                        continue;
+                    }
+                    if (chosen == NONE) {
+                        chosen = pred;
+                        continue;
+                    }
+                    BlockId a = pred;
+                    BlockId b = chosen;
+                    while (a != b) {
+                        while (number[a] > number[b]) {
+                            a = idom[a];
+                        }
+                        while (number[b] > number[a]) {
+                            b = idom[b];
+                        }
+                    }
+                    chosen = a;
+                }
+                if (idom[block] != chosen) {
+                    idom[block] = chosen;
+                    changed = true;
+                }
+            }
+        }
+        return order;
+    }
+
+    /* Builder */
+
+    Builder::Builder() : function(nullptr), params(0), current(NONE), result(NONE), undefined(NONE) {}
+
+    Module Builder::build(ast::Funcs &funcs) {
+        Builder builder;
+        funcs.accept(builder);
+        return std::move(builder.module);
+    }
+
+    BlockId Builder::_newBlock() {
+        function->blocks.emplace_back();
+        written.emplace_back();
+        exposed.emplace_back();
+        return static_cast<BlockId>(function->blocks.size() - 1);
+    }
+
+    void Builder::_edge(BlockId from, BlockId to) {
+        function->blocks[from].succs.push_back(to);
+        function->blocks[to].preds.push_back(from);
+    }
+
+    void Builder::_ensureBlock() {
+        if (current == NONE) {
+            current = _newBlock();
+        }
+    }
+
+    ValueId Builder::_instr(Opcode op, int32_t imm, std::initializer_list<ValueId> operands) {
+        ValueId value = static_cast<ValueId>(function->instrs.size());
+        function->instrs.push_back({op, current, imm, static_cast<uint32_t>(function->operands.size()),
+                                    static_cast<uint32_t>(operands.size())});
+        function->operands.insert(function->operands.end(), operands);
+        function->blocks[current].instrs.push_back(value);
+        replacement.push_back(NONE);
+        return value;
+    }
+
+    ValueId Builder::_phi(BlockId block) {
+        ValueId value = static_cast<ValueId>(function->instrs.size());
+        function->instrs.push_back({PHI, block, 0, 0, 0});
+        function->blocks[block].phis.push_back(value);
+        replacement.push_back(NONE);
+        return value;
+    }
+
+    ValueId Builder::_undefined() {
+        if (undefined == NONE) {
+            undefined = static_cast<ValueId>(function->instrs.size());
+            function->instrs.push_back({UNDEF, 0, 0, 0, 0});
+            std::vector<ValueId> &entry = function->blocks[0].instrs;
+            entry.insert(entry.begin(), undefined);
+            replacement.push_back(NONE);
+        }
+        return undefined;
+    }
+
+    void Builder::_jump(BlockId target) {
+        _instr(JMP, 0, {});
+        _edge(current, target);
+        current = NONE;
+    }
+
+    void Builder::_track(int slot) {
+        if (static_cast<size_t>(slot) >= local.size()) {
+            local.resize(slot + 1, NONE);
+            localBlock.resize(slot + 1, NONE);
+            writers.resize(slot + 1);
+        }
+    }
+
+    void Builder::_write(int slot, ValueId value) {
+        _track(slot);
+        local[slot] = value;
+        localBlock[slot] = current;
+        written[current].emplace_back(slot, value);
+        // a block is filled in one go, so its writes of a slot are next to each other
+        if (writers[slot].empty() || writers[slot].back() != current) {
+            writers[slot].push_back(current);
+        }
+    }
+
+    ValueId Builder::_read(int slot) {
+        _track(slot);
+        if (localBlock[slot] == current) {
+            return local[slot];
+        }
+        // an instruction in no block, replaced by the value reaching the block once it is known
+        ValueId placeholder = static_cast<ValueId>(function->instrs.size());
+        function->instrs.push_back({NOP, current, 0, 0, 0});
+        replacement.push_back(NONE);
+        exposed[current].emplace_back(slot, placeholder);
+        local[slot] = placeholder;
+        localBlock[slot] = current;
+        return placeholder;
+    }
+
+    void Builder::_placePhis() {
+        size_t blockCount = function->blocks.size();
+        std::vector<BlockId> idom;
+        std::vector<BlockId> order = dominators(*function, idom);
+
+        // Dominance frontiers, by walking up from each predecessor of a join to its idom
+        std::vector<std::vector<BlockId>> frontier(blockCount);
+        for (BlockId block : order) {
+            const std::vector<BlockId> &preds = function->blocks[block].preds;
+            if (preds.size() < 2) {
+                continue;
+            }
+            for (BlockId pred : preds) {
+                for (BlockId runner = pred; idom[runner] != NONE && runner != idom[block]; runner = idom[runner]) {
+                    if (frontier[runner].empty() || frontier[runner].back() != block) {
+                        frontier[runner].push_back(block);
+                    }
+                }
+            }
+        }
+
+        // Only the slots some block reads before writing need phis
+        std::vector<char> read(local.size(), 0);
+        for (const auto &reads : exposed) {
+            for (const auto &placeholder : reads) {
+                read[placeholder.first] = 1;
+            }
+        }
+        // Phis placed in each block, as (slot, phi)
+        std::vector<std::vector<std::pair<int, ValueId>>> placed(blockCount);
+        std::vector<int> hasPhi(blockCount, -1);
+        std::vector<int> queued(blockCount, -1);
+        std::vector<BlockId> work;
+        for (int slot = 0; slot < static_cast<int>(writers.size()); ++slot) {
+            if (!read[slot]) {
+                continue;
+            }
+            for (BlockId block : writers[slot]) {
+                if (idom[block] != NONE) {
+                    queued[block] = slot;
+                    work.push_back(block);
+                }
+            }
+            while (!work.empty()) {
+                BlockId block = work.back();
+                work.pop_back();
+                for (BlockId join : frontier[block]) {
+                    if (hasPhi[join] == slot) {
+                        continue;
+                    }
+                    hasPhi[join] = slot;
+                    ValueId phi = _phi(join);
+                    Instr &instr = function->instrs[phi];
+                    instr.first = static_cast<uint32_t>(function->operands.size());
+                    instr.count = static_cast<uint32_t>(function->blocks[join].preds.size());
+                    function->operands.resize(function->operands.size() + instr.count, NONE);
+                    placed[join].emplace_back(slot, phi);
+                    if (queued[join] != slot) {
+                        queued[join] = slot;
+                        work.push_back(join);
+                    }
+                }
+            }
+        }
+
+        // Renaming: the dominator tree is walked with the value reaching each slot, restoring
+        // the ones a block overwrote on the way back up
+        std::vector<std::vector<BlockId>> children(blockCount);
+        for (size_t i = 1; i < order.size(); ++i) {
+            children[idom[order[i]]].push_back(order[i]);
+        }
+        std::vector<ValueId> reaching(local.size(), NONE);
+        std::vector<std::pair<int, ValueId>> overwritten;
+        struct Frame {
+            BlockId block;
+            size_t child;
+            size_t mark;
+        };
+        std::vector<Frame> stack;
+        auto enter = [&](BlockId block) {
+            stack.push_back({block, 0, overwritten.size()});
+            for (auto &phi : placed[block]) {
+                overwritten.emplace_back(phi.first, reaching[phi.first]);
+                reaching[phi.first] = phi.second;
+            }
+            for (auto &placeholder : exposed[block]) {
+                ValueId value = reaching[placeholder.first];
+                replacement[placeholder.second] = value != NONE ? value : _undefined();
+            }
+            for (auto &write : written[block]) {
+                overwritten.emplace_back(write.first, reaching[write.first]);
+                reaching[write.first] = write.second;
+            }
+            for (BlockId succ : function->blocks[block].succs) {
+                const std::vector<BlockId> &preds = function->blocks[succ].preds;
+                for (auto &phi : placed[succ]) {
+                    for (uint32_t i = 0; i < preds.size(); ++i) {
+                        if (preds[i] == block) {
+                            function->operand(phi.second, i) = reaching[phi.first];
+                        }
+                    }
+                }
+            }
+        };
+        enter(0);
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            if (frame.child < children[frame.block].size()) {
+                enter(children[frame.block][frame.child++]);
+                continue;
+            }
+            while (overwritten.size() > frame.mark) {
+                reaching[overwritten.back().first] = overwritten.back().second;
+                overwritten.pop_back();
+            }
+            stack.pop_back();
+        }
+
+        // Code the entry does not reach never runs, so whatever it reads is undefined
+        for (BlockId block = 0; block < blockCount; ++block) {
+            if (idom[block] == NONE) {
+                for (auto &placeholder : exposed[block]) {
+                    replacement[placeholder.second] = _undefined();
+                }
+            }
+        }
+        for (BlockId block : order) {
+            for (auto &phi : placed[block]) {
+                for (uint32_t i = 0; i < function->instrs[phi.second].count; ++i) {
+                    ValueId &operand = function->operand(phi.second, i);
+                    if (operand == NONE) {
+                        operand = _undefined();
+                    }
+                }
+            }
+        }
+
+        // A phi whose operands are one value and itself stands for that value; replacing it may
+        // make a phi placed earlier trivial, around loops
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (BlockId block : order) {
+                for (auto &phi : placed[block]) {
+                    if (replacement[phi.second] != NONE) {
+                        continue;
+                    }
+                    ValueId same = NONE;
+                    bool trivial = true;
+                    for (uint32_t i = 0; i < function->instrs[phi.second].count; ++i) {
+                        ValueId value = _resolve(function->operand(phi.second, i));
+                        if (value == same || value == phi.second) {
+                            continue;
+                        }
+                        if (same != NONE) {
+                            trivial = false;
+                            break;
+                        }
+                        same = value;
+                    }
+                    if (trivial) {
+                        replacement[phi.second] = same != NONE ? same : _undefined();
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // The phis left that no instruction uses, even through other phis, are dropped
+        std::vector<char> used(function->instrs.size(), 0);
+        std::vector<ValueId> reached;
+        for (BlockId block : order) {
+            for (auto &phi : placed[block]) {
+                used[phi.second] = 1;
+            }
+        }
+        auto use = [&](ValueId value) {
+            value = _resolve(value);
+            if (used[value] == 1) {
+                used[value] = 2;
+                reached.push_back(value);
+            }
+        };
+        for (const Block &block : function->blocks) {
+            for (const std::vector<ValueId> *list : {&block.phis, &block.instrs}) {
+                for (ValueId value : *list) {
+                    if (used[value] != 0) {
+                        continue;
+                    }
+                    for (uint32_t i = 0; i < function->instrs[value].count; ++i) {
+                        use(function->operand(value, i));
+                    }
+                }
+            }
+        }
+        while (!reached.empty()) {
+            ValueId phi = reached.back();
+            reached.pop_back();
+            for (uint32_t i = 0; i < function->instrs[phi].count; ++i) {
+                use(function->operand(phi, i));
+            }
+        }
+        for (BlockId block : order) {
+            if (placed[block].empty()) {
+                continue;
+            }
+            std::vector<ValueId> &phis = function->blocks[block].phis;
+            size_t kept = 0;
+            for (ValueId phi : phis) {
+                if (used[phi] == 1 || replacement[phi] != NONE) {
+                    function->instrs[phi].op = NOP;
+                } else {
+                    phis[kept++] = phi;
+                }
+            }
+            phis.resize(kept);
+        }
+    }
+
+    ValueId Builder::_resolve(ValueId value) {
+        while (replacement[value] != NONE) {
+            value = replacement[value];
+        }
+        return value;
+    }
+
+    ValueId Builder::_value(ast::Exp &exp) {
+        exp.accept(*this);
+        return result;
+    }
+
+    void Builder::_branch(ast::Exp &exp, BlockId whenTrue, BlockId whenFalse) {
+        if (auto boolean = dynamic_cast<ast::Bool *>(&exp)) {
+            _jump(boolean->value ? whenTrue : whenFalse);
+            return;
+        }
+        if (auto negation = dynamic_cast<ast::Not *>(&exp)) {
+            _branch(*negation->exp, whenFalse, whenTrue);
+            return;
+        }
+        if (auto conjunction = dynamic_cast<ast::And *>(&exp)) {
+            BlockId right = _newBlock();
+            _branch(*conjunction->left, right, whenFalse);
+            current = right;
+            _branch(*conjunction->right, whenTrue, whenFalse);
+            return;
+        }
+        if (auto disjunction = dynamic_cast<ast::Or *>(&exp)) {
+            BlockId right = _newBlock();
+            _branch(*disjunction->left, whenTrue, right);
+            current = right;
+            _branch(*disjunction->right, whenTrue, whenFalse);
+            return;
+        }
+
+        ValueId condition = _value(exp);
+        _instr(BR, 0, {condition});
+        _edge(current, whenTrue);
+        _edge(current, whenFalse);
+        current = NONE;
+    }
+
+    ValueId Builder::_materialize(ast::Exp &exp) {
+        BlockId whenTrue = _newBlock();
+        BlockId whenFalse = _newBlock();
+        BlockId join = _newBlock();
+        _branch(exp, whenTrue, whenFalse);
+
+        current = whenTrue;
+        ValueId one = _instr(CONST, 1, {});
+        _jump(join);
+        current = whenFalse;
+        ValueId zero = _instr(CONST, 0, {});
+        _jump(join);
+        current = join;
+
+        ValueId phi = _phi(join);
+        Instr &instr = function->instrs[phi];
+        instr.first = static_cast<uint32_t>(function->operands.size());
+        instr.count = 2;
+        function->operands.push_back(one);
+        function->operands.push_back(zero);
+        return phi;
+    }
+
+    int Builder::_slot(const ast::ID &id) const {
+        return id.computedOffset + params;
+    }
+
+    /* Expressions */
+
+    void Builder::visit(ast::Num &node) {
+        result = _instr(CONST, node.value, {});
+    }
+
+    void Builder::visit(ast::NumB &node) {
+        result = _instr(CONST, node.value, {});
+    }
+
+    void Builder::visit(ast::String &node) {
+        result = NONE;
+    }
+
+    void Builder::visit(ast::Bool &node) {
+        result = _instr(CONST, node.value ? 1 : 0, {});
+    }
+
+    void Builder::visit(ast::ID &node) {
+        result = _read(_slot(node));
+    }
+
+    void Builder::visit(ast::BinOp &node) {
+        bool isByte = node.computedType == ast::BuiltInType::BYTE;
+        ValueId left = _value(*node.left);
+        ValueId right = _value(*node.right);
+        Opcode op = ADD;
+        switch (node.op) {
+            case ast::BinOpType::ADD:
+                op = isByte ? ADDB : ADD;
+                break;
+            case ast::BinOpType::SUB:
+                op = isByte ? SUBB : SUB;
+                break;
+            case ast::BinOpType::MUL:
+                op = isByte ? MULB : MUL;
+                break;
+            case ast::BinOpType::DIV:
+                op = isByte ? DIVB : DIV;
+                break;
+        }
+        result = _instr(op, 0, {left, right});
+    }
+
+    void Builder::visit(ast::RelOp &node) {
+        ValueId left = _value(*node.left);
+        ValueId right = _value(*node.right);
+        Opcode op = EQ;
+        switch (node.op) {
+            case ast::RelOpType::EQ:
+                op = EQ;
+                break;
+            case ast::RelOpType::NE:
+                op = NE;
+                break;
+            case ast::RelOpType::LT:
+                op = LT;
+                break;
+            case ast::RelOpType::GT:
+                op = GT;
+                break;
+            case ast::RelOpType::LE:
+                op = LE;
+                break;
+            case ast::RelOpType::GE:
+                op = GE;
+                break;
+        }
+        result = _instr(op, 0, {left, right});
+    }
+
+    void Builder::visit(ast::Not &node) {
+        ValueId value = _value(*node.exp);
+        result = _instr(NOT, 0, {value});
+    }
+
+    void Builder::visit(ast::And &node) {
+        result = _materialize(node);
+    }
+
+    void Builder::visit(ast::Or &node) {
+        result = _materialize(node);
+    }
+
+    void Builder::visit(ast::ArrayDereference &node) {
+        ValueId index = _value(*node.index);
+        result = _instr(ALOAD, arrayAt[_slot(*node.id)], {index});
+    }
+
+    void Builder::visit(ast::Cast &node) {
+        ValueId value = _value(*node.exp);
+        if (node.target_type->computedType == ast::BuiltInType::BYTE &&
+            node.exp->computedType != ast::BuiltInType::BYTE) {
+            value = _instr(TRUNCB, 0, {value});
+        }
+        result = value;
+    }
+
+    void Builder::visit(ast::ExpList &node) {}
+
+    void Builder::_call(ast::Call &node) {
+        const std::string &name = node.func_id->value;
+        if (name == "print") {
+            auto literal = dynamic_cast<ast::String *>(node.args->exps[0].get());
+            auto found = stringIndices.find(literal->index);
+            if (found == stringIndices.end()) {
+                found = stringIndices.emplace(literal->index, static_cast<int>(module.strings.size())).first;
+                module.strings.push_back(literal->value());
+            }
+            result = _instr(PRINT, found->second, {});
+            return;
+        }
+        if (name == "printi") {
+            ValueId value = _value(*node.args->exps[0]);
+            result = _instr(PRINTI, 0, {value});
+            return;
+        }
+
+        std::vector<ValueId> args;
+        args.reserve(node.args->exps.size());
+        for (auto &exp : node.args->exps) {
+            args.push_back(_value(*exp));
+        }
+        result = _instr(CALL, functionIndex[name], {});
+        function->instrs[result].count = static_cast<uint32_t>(args.size());
+        function->operands.insert(function->operands.end(), args.begin(), args.end());
+    }
+
+    void Builder::visit(ast::Call &node) {
+        _call(node);
+    }
+
+    /* Types */
+
+    void Builder::visit(ast::ArrayType &node) {}
+
+    void Builder::visit(ast::PrimitiveType &node) {}
+
+    /* Statements */
+
+    void Builder::visit(ast::ArrayAssign &node) {
+        ValueId index = _value(*node.index);
+        ValueId value = _value(*node.exp);
+        _instr(ASTORE, arrayAt[_slot(*node.id)], {index, value});
+    }
+
+    void Builder::visit(ast::Statements &node) {
+        for (auto &statement : node.statements) {
+            _ensureBlock();
+            statement->accept(*this);
+        }
+    }
+
+    void Builder::visit(ast::Block &node) {
+        node.statements->accept(*this);
+    }
+
+    void Builder::visit(ast::Break &node) {
+        _jump(breakTargets.back());
+    }
+
+    void Builder::visit(ast::Continue &node) {
+        _jump(continueTargets.back());
+    }
+
+    void Builder::visit(ast::Return &node) {
+        if (node.exp) {
+            ValueId value = _value(*node.exp);
+            _instr(RET, 0, {value});
+        } else {
+            _instr(RETV, 0, {});
+        }
+        current = NONE;
+    }
+
+    void Builder::visit(ast::If &node) {
+        BlockId then = _newBlock();
+        BlockId otherwise = node.otherwise ? _newBlock() : NONE;
+        BlockId join = _newBlock();
+        _branch(*node.condition, then, node.otherwise ? otherwise : join);
+
+        current = then;
+        node.then->accept(*this);
+        if (current != NONE) {
+            _jump(join);
+        }
+        if (node.otherwise) {
+            current = otherwise;
+            node.otherwise->accept(*this);
+            if (current != NONE) {
+                _jump(join);
+            }
+        }
+        current = join;
+    }
+
+    void Builder::visit(ast::While &node) {
+        BlockId header = _newBlock();
+        BlockId body = _newBlock();
+        BlockId exit = _newBlock();
+        _jump(header);
+        current = header;
+        _branch(*node.condition, body, exit);
+
+        continueTargets.push_back(header);
+        breakTargets.push_back(exit);
+        current = body;
+        node.body->accept(*this);
+        if (current != NONE) {
+            _jump(header);
+        }
+        continueTargets.pop_back();
+        breakTargets.pop_back();
+
+        current = exit;
+    }
+
+    void Builder::visit(ast::VarDecl &node) {
+        int slot = _slot(*node.id);
+        if (node.type->computedIsArray) {
+            // the same slot may start a different array in a later scope
+            arrayAt[slot] = static_cast<int>(function->arrays.size());
+            function->arrays.push_back({slot, node.type->computedArrLength});
+            _instr(AZERO, arrayAt[slot], {});
+            return;
+        }
+        ValueId value = node.init_exp ? _value(*node.init_exp) : _instr(CONST, 0, {});
+        _write(slot, value);
+    }
+
+    void Builder::visit(ast::Assign &node) {
+        ValueId value = _value(*node.exp);
+        _write(_slot(*node.id), value);
+    }
+
+    void Builder::visit(ast::Formal &node) {}
+
+    void Builder::visit(ast::Formals &node) {}
+
+    void Builder::visit(ast::FuncDecl &node) {
+        function = &module.functions[functionIndex[node.id->value]];
+        params = static_cast<int>(node.formals->formals.size());
+        function->params = params;
+        function->returnsValue = node.return_type->computedType != ast::BuiltInType::VOID;
+        local.clear();
+        localBlock.clear();
+        written.clear();
+        exposed.clear();
+        writers.clear();
+        arrayAt.clear();
+        replacement.clear();
+        undefined = NONE;
+
+        current = _newBlock();
+        // parameter slots are numbered from the last parameter
+        for (int i = 0; i < params; ++i) {
+            _write(params - 1 - i, _instr(PARAM, i, {}));
+        }
+
+        node.body->accept(*this);
+        // falling off the end of a function that returns a value returns 0
+        if (current != NONE) {
+            if (function->returnsValue) {
+                ValueId zero = _instr(CONST, 0, {});
+                _instr(RET, 0, {zero});
+            } else {
+                _instr(RETV, 0, {});
+            }
+        }
+
+        _placePhis();
+        // uses of the placeholders and of the trivial phis
+        for (ValueId &operand : function->operands) {
+            operand = _resolve(operand);
+        }
+    }
+
+    void Builder::visit(ast::Funcs &node) {
+        for (auto &func : node.funcs) {
+            functionIndex[func->id->value] = static_cast<int>(module.functions.size());
+            module.functions.emplace_back();
+            module.functions.back().name = func->id->value;
+        }
+        for (auto &func : node.funcs) {
+            func->accept(*this);
+        }
+    }
+
+    /* Sparse conditional constant propagation */
+
+    enum Lattice : uint8_t {
+        TOP,        // no value seen yet
+        CONSTANT,
+        BOTTOM      // more than one value
+    };
+
+    // Computes a pure instruction on constant operands; false if it would trap
+    static bool fold(Opcode op, int32_t a, int32_t b, int32_t &out) {
+        uint32_t ua = static_cast<uint32_t>(a);
+        uint32_t ub = static_cast<uint32_t>(b);
+        switch (op) {
+            case ADD:
+                out = static_cast<int32_t>(ua + ub);
+                return true;
+            case SUB:
+                out = static_cast<int32_t>(ua - ub);
+                return true;
+            case MUL:
+                out = static_cast<int32_t>(ua * ub);
+                return true;
+            case DIV:
+                if (b == 0) {
+                    return false;
+                }
+                out = a == INT32_MIN && b == -1 ? a : a / b;
+                return true;
+            case ADDB:
+                out = static_cast<int32_t>((ua + ub) & 0xFF);
+                return true;
+            case SUBB:
+                out = static_cast<int32_t>((ua - ub) & 0xFF);
+                return true;
+            case MULB:
+                out = static_cast<int32_t>((ua * ub) & 0xFF);
+                return true;
+            case DIVB:
+                if (b == 0) {
+                    return false;
+                }
+                out = static_cast<int32_t>(ua / ub);
+                return true;
+            case TRUNCB:
+                out = static_cast<int32_t>(ua & 0xFF);
+                return true;
+            case NOT:
+                out = !a;
+                return true;
+            case EQ:
+                out = a == b;
+                return true;
+            case NE:
+                out = a != b;
+                return true;
+            case LT:
+                out = a < b;
+                return true;
+            case LE:
+                out = a <= b;
+                return true;
+            case GT:
+                out = a > b;
+                return true;
+            case GE:
+                out = a >= b;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Users of every value, as a compressed sparse row: uses[start[v], start[v + 1])
+    static void collectUses(const Function &function, std::vector<uint32_t> &start, std::vector<ValueId> &uses) {
+        start.assign(function.instrs.size() + 1, 0);
+        for (const Block &block : function.blocks) {
+            if (block.removed) {
+                continue;
+            }
+            for (const std::vector<ValueId> *list : {&block.phis, &block.instrs}) {
+                for (ValueId value : *list) {
+                    const Instr &instr = function.instrs[value];
+                    for (uint32_t i = 0; i < instr.count; ++i) {
+                        ++start[function.operand(value, i) + 1];
+                    }
+                }
+            }
+        }
+        for (size_t v = 1; v < start.size(); ++v) {
+            start[v] += start[v - 1];
+        }
+        uses.resize(start.back());
+        std::vector<uint32_t> next(start.begin(), start.end() - 1);
+        for (const Block &block : function.blocks) {
+            if (block.removed) {
+                continue;
+            }
+            for (const std::vector<ValueId> *list : {&block.phis, &block.instrs}) {
+                for (ValueId value : *list) {
+                    const Instr &instr = function.instrs[value];
+                    for (uint32_t i = 0; i < instr.count; ++i) {
+                        uses[next[function.operand(value, i)]++] = value;
+                    }
+                }
+            }
+        }
+    }
+
+    size_t propagateConstants(Function &function) {
+        size_t before = function.size();
+        size_t count = function.instrs.size();
+        size_t blockCount = function.blocks.size();
+        std::vector<uint8_t> state(count, TOP);
+        std::vector<int32_t> constant(count, 0);
+        std::vector<char> reachable(blockCount, 0);
+        // Executable flag of each incoming edge, the edges of block b starting at edgeStart[b]
+        std::vector<uint32_t> edgeStart(blockCount + 1, 0);
+        for (size_t b = 0; b < blockCount; ++b) {
+            edgeStart[b + 1] = edgeStart[b] + static_cast<uint32_t>(function.blocks[b].preds.size());
+        }
+        std::vector<char> executable(edgeStart.back(), 0);
+        std::vector<uint32_t> useStart;
+        std::vector<ValueId> uses;
+        collectUses(function, useStart, uses);
+
+        std::vector<std::pair<BlockId, BlockId>> flowWork;
+        std::vector<ValueId> ssaWork;
+        flowWork.emplace_back(NONE, 0);
+
+        auto lower = [&](ValueId value, uint8_t to, int32_t number) {
+            if (state[value] == BOTTOM || to == TOP) {
+                return;
+            }
+            if (state[value] == CONSTANT) {
+                if (to == CONSTANT && number == constant[value]) {
+                    return;
+                }
+                to = BOTTOM;
+            }
+            state[value] = to;
+            constant[value] = number;
+            ssaWork.push_back(value);
+        };
+
+        auto evaluate = [&](ValueId value) {
+            const Instr &instr = function.instrs[value];
+            const Block &block = function.blocks[instr.block];
+            switch (instr.op) {
+                case CONST:
+                    lower(value, CONSTANT, instr.imm);
+                    return;
+                case PARAM:
+                case UNDEF:
+                case CALL:
+                case ALOAD:
+                    lower(value, BOTTOM, 0);
+                    return;
+                case PHI: {
+                    uint8_t met = TOP;
+                    int32_t number = 0;
+                    for (uint32_t i = 0; i < instr.count && met != BOTTOM; ++i) {
+                        if (!executable[edgeStart[instr.block] + i]) {
+                            continue;
+                        }
+                        ValueId operand = function.operand(value, i);
+                        if (state[operand] == TOP) {
+                            continue;
+                        }
+                        if (state[operand] == BOTTOM || (met == CONSTANT && constant[operand] != number)) {
+                            met = BOTTOM;
+                        } else {
+                            met = CONSTANT;
+                            number = constant[operand];
+                        }
+                    }
+                    lower(value, met, number);
+                    return;
+                }
+                case JMP:
+                    flowWork.emplace_back(instr.block, block.succs[0]);
+                    return;
+                case BR: {
+                    ValueId condition = function.operand(value, 0);
+                    if (state[condition] == BOTTOM || (state[condition] == CONSTANT && constant[condition])) {
+                        flowWork.emplace_back(instr.block, block.succs[0]);
+                    }
+                    if (state[condition] == BOTTOM || (state[condition] == CONSTANT && !constant[condition])) {
+                        flowWork.emplace_back(instr.block, block.succs[1]);
+                    }
+                    return;
+                }
+                default:
+                    break;
+            }
+            if (!isPure(instr.op)) {
+                return;
+            }
+            int32_t numbers[2] = {0, 0};
+            for (uint32_t i = 0; i < instr.count; ++i) {
+                ValueId operand = function.operand(value, i);
+                if (state[operand] != CONSTANT) {
+                    lower(value, state[operand], 0);
+                    return;
+                }
+                numbers[i] = constant[operand];
+            }
+            int32_t folded;
+            if (fold(instr.op, numbers[0], numbers[1], folded)) {
+                lower(value, CONSTANT, folded);
+            } else {
+                lower(value, BOTTOM, 0);
+            }
+        };
+
+        while (!flowWork.empty() || !ssaWork.empty()) {
+            while (!flowWork.empty()) {
+                BlockId from = flowWork.back().first;
+                BlockId to = flowWork.back().second;
+                flowWork.pop_back();
+                const Block &block = function.blocks[to];
+                if (from != NONE) {
+                    size_t i = std::find(block.preds.begin(), block.preds.end(), from) - block.preds.begin();
+                    if (executable[edgeStart[to] + i]) {
+                        continue;
+                    }
+                    executable[edgeStart[to] + i] = 1;
+                }
+                for (ValueId phi : block.phis) {
+                    evaluate(phi);
+                }
+                if (!reachable[to]) {
+                    reachable[to] = 1;
+                    for (ValueId value : block.instrs) {
+                        evaluate(value);
+                    }
+                }
+            }
+            while (!ssaWork.empty() && flowWork.empty()) {
+                ValueId value = ssaWork.back();
+                ssaWork.pop_back();
+                for (uint32_t u = useStart[value]; u < useStart[value + 1]; ++u) {
+                    if (reachable[function.instrs[uses[u]].block]) {
+                        evaluate(uses[u]);
+                    }
+                }
+            }
+        }
+
+        // constants in place of what computes them, jumps in place of decided branches
+        for (BlockId b = 0; b < blockCount; ++b) {
+            Block &block = function.blocks[b];
+            if (block.removed || !reachable[b]) {
+                continue;
+            }
+            std::vector<ValueId> constantPhis;
+            size_t kept = 0;
+            for (ValueId phi : block.phis) {
+                if (state[phi] == CONSTANT) {
+                    constantPhis.push_back(phi);
+                } else {
+                    block.phis[kept++] = phi;
+                }
+            }
+            block.phis.resize(kept);
+            block.instrs.insert(block.instrs.begin(), constantPhis.begin(), constantPhis.end());
+
+            for (ValueId value : block.instrs) {
+                Instr &instr = function.instrs[value];
+                if (state[value] == CONSTANT && (isPure(instr.op) || instr.op == PHI)) {
+                    instr.op = CONST;
+                    instr.imm = constant[value];
+                    instr.count = 0;
+                }
+            }
+            ValueId terminator = block.instrs.back();
+            Instr &instr = function.instrs[terminator];
+            if (instr.op == BR && state[function.operand(terminator, 0)] == CONSTANT) {
+                bool taken = constant[function.operand(terminator, 0)] != 0;
+                BlockId target = block.succs[taken ? 0 : 1];
+                BlockId other = block.succs[taken ? 1 : 0];
+                instr.op = JMP;
+                instr.count = 0;
+                block.succs.assign(1, target);
+                removePred(function, other, b);
+            }
+        }
+
+        // blocks no executable path reaches
+        for (BlockId b = 0; b < blockCount; ++b) {
+            Block &block = function.blocks[b];
+            if (block.removed || reachable[b]) {
+                continue;
+            }
+            for (BlockId succ : block.succs) {
+                if (reachable[succ]) {
+                    removePred(function, succ, b);
+                }
+            }
+            for (const std::vector<ValueId> *list : {&block.phis, &block.instrs}) {
+                for (ValueId value : *list) {
+                    function.instrs[value].op = NOP;
+                }
+            }
+            block = Block();
+            block.removed = true;
+        }
+        return before - function.size();
+    }
+
+    /* Global value numbering */
+
+    namespace {
+        struct ValueKey {
+            uint32_t op;
+            int32_t imm;
+            ValueId left;
+            ValueId right;
+
+            bool operator==(const ValueKey &other) const {
+                return op == other.op && imm == other.imm && left == other.left && right == other.right;
+            }
+        };
+
+        struct ValueKeyHash {
+            size_t operator()(const ValueKey &key) const {
+                uint64_t hash = key.op * 0x9E3779B97F4A7C15ULL;
+                hash = (hash ^ static_cast<uint32_t>(key.imm)) * 0xC2B2AE3D27D4EB4FULL;
+                hash = (hash ^ key.left) * 0x165667B19E3779F9ULL;
+                hash = (hash ^ key.right) * 0x9E3779B97F4A7C15ULL;
+                return static_cast<size_t>(hash ^ hash >> 29);
+            }
+        };
+    }
+
+    size_t numberValues(Function &function) {
+        size_t count = function.instrs.size();
+        std::vector<BlockId> idom;
+        std::vector<BlockId> order = dominators(function, idom);
+        std::vector<std::vector<BlockId>> children(function.blocks.size());
+        for (size_t i = 1; i < order.size(); ++i) {
+            children[idom[order[i]]].push_back(order[i]);
+        }
+
+        std::vector<ValueId> leader(count, NONE);
+        auto find = [&](ValueId value) {
+            while (leader[value] != NONE) {
+                value = leader[value];
+            }
+            return value;
+        };
+
+        std::unordered_map<ValueKey, ValueId, ValueKeyHash> table;
+        std::vector<ValueKey> inserted;
+        size_t replaced = 0;
+        // Blocks of the dominator tree being walked, with the next child and the size of
+        // `inserted` on entry
+        struct Frame {
+            BlockId block;
+            size_t child;
+            size_t mark;
+        };
+        std::vector<Frame> stack;
+
+        auto enter = [&](BlockId b) {
+            stack.push_back({b, 0, inserted.size()});
+            Block &block = function.blocks[b];
+
+            std::unordered_map<uint64_t, ValueId> phis;
+            for (ValueId phi : block.phis) {
+                const Instr &instr = function.instrs[phi];
+                ValueId same = NONE;
+                bool trivial = true;
+                uint64_t hash = 0;
+                for (uint32_t i = 0; i < instr.count; ++i) {
+                    ValueId &operand = function.operand(phi, i);
+                    operand = find(operand);
+                    hash = (hash ^ operand) * 0x9E3779B97F4A7C15ULL;
+                    if (operand == phi || operand == same) {
+                        continue;
+                    }
+                    trivial = trivial && same == NONE;
+                    same = operand;
+                }
+                if (trivial && same != NONE) {
+                    leader[phi] = same;
+                    ++replaced;
+                    continue;
+                }
+                auto found = phis.find(hash);
+                if (found == phis.end()) {
+                    phis.emplace(hash, phi);
+                    continue;
+                }
+                // the same operands from the same predecessors compute the same value
+                const Instr &other = function.instrs[found->second];
+                bool equal = other.count == instr.count;
+                for (uint32_t i = 0; equal && i < instr.count; ++i) {
+                    equal = function.operand(found->second, i) == function.operand(phi, i);
+                }
+                if (equal) {
+                    leader[phi] = found->second;
+                    ++replaced;
+                }
+            }
+
+            for (ValueId value : block.instrs) {
+                Instr &instr = function.instrs[value];
+                for (uint32_t i = 0; i < instr.count; ++i) {
+                    ValueId &operand = function.operand(value, i);
+                    operand = find(operand);
+                }
+                if (!isPure(instr.op)) {
+                    continue;
+                }
+                ValueKey key = {instr.op, instr.imm, instr.count > 0 ? function.operand(value, 0) : NONE,
+                                instr.count > 1 ? function.operand(value, 1) : NONE};
+                if (isCommutative(instr.op) && key.left > key.right) {
+                    std::swap(key.left, key.right);
+                }
+                auto found = table.find(key);
+                if (found != table.end()) {
+                    leader[value] = found->second;
+                    ++replaced;
+                } else {
+                    table.emplace(key, value);
+                    inserted.push_back(key);
+                }
+            }
+        };
+
+        if (!order.empty()) {
+            enter(0);
+        }
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            if (frame.child < children[frame.block].size()) {
+                enter(children[frame.block][frame.child++]);
+                continue;
+            }
+            for (size_t i = frame.mark; i < inserted.size(); ++i) {
+                table.erase(inserted[i]);
+            }
+            inserted.resize(frame.mark);
+            stack.pop_back();
+        }
+
+        // phi operands on back edges were numbered before their definitions were
+        for (ValueId &operand : function.operands) {
+            operand = find(operand);
+        }
+        sweep(function, [&](ValueId value) { return leader[value] == NONE; });
+        return replaced;
+    }
+
+    /* Dead-code elimination */
+
+    size_t eliminateDeadCode(Function &function) {
+        std::vector<char> live(function.instrs.size(), 0);
+        std::vector<ValueId> work;
+        for (const Block &block : function.blocks) {
+            if (block.removed) {
+                continue;
+            }
+            for (ValueId value : block.instrs) {
+                if (hasSideEffects(function, value)) {
+                    live[value] = 1;
+                    work.push_back(value);
+                }
+            }
+        }
+        while (!work.empty()) {
+            ValueId value = work.back();
+            work.pop_back();
+            const Instr &instr = function.instrs[value];
+            for (uint32_t i = 0; i < instr.count; ++i) {
+                ValueId operand = function.operand(value, i);
+                if (!live[operand]) {
+                    live[operand] = 1;
+                    work.push_back(operand);
+                }
+            }
+        }
+        return sweep(function, [&](ValueId value) { return live[value] != 0; });
+    }
+
+    OptimizationStats optimize(Function &function) {
+        OptimizationStats stats;
+        stats.before = function.size();
+        stats.sccp = propagateConstants(function);
+        stats.gvn = numberValues(function);
+        stats.dce = eliminateDeadCode(function);
+        stats.after = function.size();
+        return stats;
+    }
+
+    /* Listing */
+
+    static bool definesValue(const Module &module, const Instr &instr) {
+        switch (instr.op) {
+            case CALL:
+                return module.functions[instr.imm].returnsValue;
+            case ASTORE:
+            case AZERO:
+            case PRINT:
+            case PRINTI:
+            case JMP:
+            case BR:
+            case RET:
+            case RETV:
+                return false;
+            default:
+                return true;
+        }
+    }
+
+    static void dumpInstr(std::ostream &os, const Module &module, const Function &function, ValueId value) {
+        const Instr &instr = function.instrs[value];
+        const Block &block = function.blocks[instr.block];
+        os << "  ";
+        if (definesValue(module, instr)) {
+            os << '%' << value << " = ";
+        }
+        os << opcodeName(instr.op);
+        switch (instr.op) {
+            case CONST:
+            case PARAM:
+                os << ' ' << instr.imm;
+                break;
+            case PHI:
+                for (uint32_t i = 0; i < instr.count; ++i) {
+                    os << (i ? ", [%" : " [%") << function.operand(value, i) << ", b" << block.preds[i] << ']';
+                }
+                break;
+            case CALL:
+                os << ' ' << module.functions[instr.imm].name << '(';
+                for (uint32_t i = 0; i < instr.count; ++i) {
+                    os << (i ? ", %" : "%") << function.operand(value, i);
+                }
+                os << ')';
+                break;
+            case ALOAD:
+                os << " a" << instr.imm << "[%" << function.operand(value, 0) << ']';
+                break;
+            case ASTORE:
+                os << " a" << instr.imm << "[%" << function.operand(value, 0) << "], %" << function.operand(value, 1);
+                break;
+            case AZERO:
+                os << " a" << instr.imm;
+                break;
+            case PRINT:
+                os << " \"" << StringPool::escape(module.strings[instr.imm]) << '"';
+                break;
+            case JMP:
+                os << " b" << block.succs[0];
+                break;
+            case BR:
+                os << " %" << function.operand(value, 0) << ", b" << block.succs[0] << ", b" << block.succs[1];
+                break;
+            default:
+                for (uint32_t i = 0; i < instr.count; ++i) {
+                    os << (i ? ", %" : " %") << function.operand(value, i);
+                }
+        }
+        os << '\n';
+    }
+
+    void dump(std::ostream &os, const Module &module) {
+        for (const Function &function : module.functions) {
+            os << "function " << function.name << '(' << function.params
+               << (function.returnsValue ? ") -> int\n" : ")\n");
+            for (size_t a = 0; a < function.arrays.size(); ++a) {
+                os << "  a" << a << ": slot " << function.arrays[a].slot << ", length "
+                   << function.arrays[a].length << '\n';
+            }
+            for (size_t b = 0; b < function.blocks.size(); ++b) {
+                const Block &block = function.blocks[b];
+                if (block.removed) {
+                    continue;
+                }
+                os << 'b' << b << ':';
+                for (size_t i = 0; i < block.preds.size(); ++i) {
+                    os << (i ? ", b" : " ; preds b") << block.preds[i];
+                }
+                os << '\n';
+                for (ValueId phi : block.phis) {
+                    dumpInstr(os, module, function, phi);
+                }
+                for (ValueId value : block.instrs) {
+                    dumpInstr(os, module, function, value);
+                }
+            }
+        }
+    }
+}
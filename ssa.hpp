@@ -0,0 +1,244 @@
+#ifndef SSA_HPP
+#define SSA_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+namespace ssa {
+    typedef uint32_t ValueId;
+    typedef uint32_t BlockId;
+    const uint32_t NONE = UINT32_MAX;
+
+    /* Three-address SSA instructions
+     * Scalar variables become SSA values; arrays stay in memory and are reached through ALOAD
+     * and ASTORE. Every instruction defines the value with its own id, whether or not it is
+     * used. Values are 32-bit, bytes kept below 256 and booleans 0 or 1.
+     */
+    enum Opcode : uint8_t {
+        CONST,      // imm
+        PARAM,      // parameter imm
+        UNDEF,      // a variable read before it is ever assigned
+        ADD,        // operands 0 and 1, int arithmetic wraps at 32 bits
+        SUB,
+        MUL,
+        DIV,        // traps on division by zero
+        ADDB,       // byte arithmetic wraps at 8 bits, division is unsigned
+        SUBB,
+        MULB,
+        DIVB,
+        TRUNCB,     // operand & 0xFF
+        NOT,
+        EQ,
+        NE,
+        LT,
+        LE,
+        GT,
+        GE,
+        PHI,        // one operand per predecessor, in the order of Block::preds
+        CALL,       // function imm with the operands as arguments
+        ALOAD,      // element operand 0 of array imm, traps out of bounds
+        ASTORE,     // element operand 0 of array imm = operand 1
+        AZERO,      // array imm = all zeros
+        PRINT,      // string imm
+        PRINTI,
+        JMP,        // to succs[0]
+        BR,         // to succs[0] if operand 0, else succs[1]
+        RET,        // returns operand 0
+        RETV,       // returns from a void function
+        NOP,        // removed
+        OPCODE_COUNT
+    };
+
+    struct Instr {
+        Opcode op;
+        BlockId block;
+        int32_t imm;
+        // Operands are the slice [first, first + count) of Function::operands
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct Block {
+        std::vector<ValueId> phis;
+        // The body, then one terminator
+        std::vector<ValueId> instrs;
+        std::vector<BlockId> preds;
+        std::vector<BlockId> succs;
+        bool removed = false;
+    };
+
+    struct Array {
+        int slot;
+        int length;
+    };
+
+    struct Function {
+        std::string name;
+        int params = 0;
+        bool returnsValue = false;
+        // Indexed by ValueId
+        std::vector<Instr> instrs;
+        std::vector<ValueId> operands;
+        std::vector<Block> blocks;
+        std::vector<Array> arrays;
+
+        ValueId operand(ValueId value, uint32_t i) const { return operands[instrs[value].first + i]; }
+        ValueId &operand(ValueId value, uint32_t i) { return operands[instrs[value].first + i]; }
+        // Instructions left in blocks that are still in the graph
+        size_t size() const;
+    };
+
+    struct Module {
+        std::vector<Function> functions;
+        // print arguments, escapes decoded, each distinct one once
+        std::vector<std::string> strings;
+    };
+
+    const char *opcodeName(Opcode op);
+
+    // Whether removing an unused instruction could change what the program does
+    bool hasSideEffects(const Function &function, ValueId value);
+
+    /* Builder class
+     * Lowers a checked ast::Funcs tree to SSA form while walking it. A variable read takes the
+     * value last written to it in the same block; the first read of a variable a block has not
+     * written yet is left as a placeholder. Once the function is done, phis are placed at the
+     * iterated dominance frontiers of the blocks writing each variable such a read can reach
+     * (Cytron et al.), one walk of the dominator tree resolves the placeholders and fills the
+     * phi operands, and the phis that turn out trivial or unused are dropped. And, Or and Not in
+     * conditions become branches.
+     */
+    class Builder : public Visitor {
+    private:
+        Module module;
+        std::unordered_map<std::string, int> functionIndex;
+        // Index in module.strings of each string pool entry printed so far
+        std::unordered_map<int, int> stringIndices;
+        Function *function;
+        int params;
+        // Block code is appended to, or NONE after a jump or return
+        BlockId current;
+        // Value of the expression visited last
+        ValueId result;
+
+        // Value last written to each variable slot in the block being filled, valid where
+        // localBlock is that block
+        std::vector<ValueId> local;
+        std::vector<BlockId> localBlock;
+        // Per block, the values written to slots, in order, as (slot, value)
+        std::vector<std::vector<std::pair<int, ValueId>>> written;
+        // Per block, the placeholders of the slots read before being written there
+        std::vector<std::vector<std::pair<int, ValueId>>> exposed;
+        // Blocks that write each slot
+        std::vector<std::vector<BlockId>> writers;
+        // Array of each slot that starts one
+        std::unordered_map<int, int> arrayAt;
+        // Placeholders and trivial phis, and the value each one stands for
+        std::vector<ValueId> replacement;
+        ValueId undefined;
+
+        std::vector<BlockId> continueTargets;
+        std::vector<BlockId> breakTargets;
+
+        BlockId _newBlock();
+        void _edge(BlockId from, BlockId to);
+        // Continues in a block of its own when the code is unreachable
+        void _ensureBlock();
+
+        ValueId _instr(Opcode op, int32_t imm, std::initializer_list<ValueId> operands);
+        ValueId _phi(BlockId block);
+        void _jump(BlockId target);
+
+        void _track(int slot);
+        void _write(int slot, ValueId value);
+        ValueId _read(int slot);
+        // Places the phis of the function just built and resolves the placeholders
+        void _placePhis();
+        ValueId _resolve(ValueId value);
+        ValueId _undefined();
+
+        ValueId _value(ast::Exp &exp);
+        void _branch(ast::Exp &exp, BlockId whenTrue, BlockId whenFalse);
+        // 0 or 1 from a condition, as a phi at the join of its branches
+        ValueId _materialize(ast::Exp &exp);
+        int _slot(const ast::ID &id) const;
+        void _call(ast::Call &node);
+
+    public:
+        Builder();
+
+        // Entry point: lowers a checked program
+        static Module build(ast::Funcs &funcs);
+
+        void visit(ast::Num &node) override;
+        void visit(ast::NumB &node) override;
+        void visit(ast::String &node) override;
+        void visit(ast::Bool &node) override;
+        void visit(ast::ID &node) override;
+        void visit(ast::BinOp &node) override;
+        void visit(ast::RelOp &node) override;
+        void visit(ast::Not &node) override;
+        void visit(ast::And &node) override;
+        void visit(ast::Or &node) override;
+        void visit(ast::ArrayType &node) override;
+        void visit(ast::PrimitiveType &node) override;
+        void visit(ast::ArrayDereference &node) override;
+        void visit(ast::ArrayAssign &node) override;
+        void visit(ast::Cast &node) override;
+        void visit(ast::ExpList &node) override;
+        void visit(ast::Call &node) override;
+        void visit(ast::Statements &node) override;
+        void visit(ast::Block &node) override;
+        void visit(ast::Break &node) override;
+        void visit(ast::Continue &node) override;
+        void visit(ast::Return &node) override;
+        void visit(ast::If &node) override;
+        void visit(ast::While &node) override;
+        void visit(ast::VarDecl &node) override;
+        void visit(ast::Assign &node) override;
+        void visit(ast::Formal &node) override;
+        void visit(ast::Formals &node) override;
+        void visit(ast::FuncDecl &node) override;
+        void visit(ast::Funcs &node) override;
+    };
+
+    // Instructions each pass removed from a function
+    struct OptimizationStats {
+        size_t before = 0;
+        size_t sccp = 0;
+        size_t gvn = 0;
+        size_t dce = 0;
+        size_t after = 0;
+    };
+
+    /* Optimizations
+     * Each runs in time close to linear in the size of the function.
+     *
+     * Sparse conditional constant propagation (Wegman and Zadeck) finds the values that are
+     * constant on every executable path, turns them into constants, branches on them into jumps,
+     * and drops the blocks that can never run.
+     *
+     * Global value numbering walks the dominator tree with a scoped table of the pure
+     * instructions seen on the way down, so an instruction computed again where an identical one
+     * dominates it is replaced by that one, and a phi whose operands are all the same value by the
+     * value.
+     *
+     * Dead-code elimination keeps the instructions with side effects and, transitively, what they
+     * use, and removes the rest.
+     */
+    size_t propagateConstants(Function &function);
+    size_t numberValues(Function &function);
+    size_t eliminateDeadCode(Function &function);
+    // All three, in that order
+    OptimizationStats optimize(Function &function);
+
+    // Human-readable listing of the IR
+    void dump(std::ostream &os, const Module &module);
+}
+
+#endif //SSA_HPP
@@ -0,0 +1,184 @@
+#include "stats.hpp"
+
+#ifdef FANC_STATS
+
+#include <cxxabi.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include "walker.hpp"
+
+namespace stats {
+    std::atomic<unsigned long> counters[COUNTER_COUNT];
+
+    static const char *const phaseNames[PHASE_COUNT] = {"lex", "parse", "semantic", "output"};
+    static const char *const counterNames[COUNTER_COUNT] = {
+            "tokens", "symbol lookups", "scope pushes", "scope pops", "diagnostics"
+    };
+    static const char *const counterKeys[COUNTER_COUNT] = {
+            "tokens", "symbol_lookups", "scope_pushes", "scope_pops", "diagnostics"
+    };
+
+    static std::atomic<long long> wallNanos[PHASE_COUNT];
+    static std::atomic<long long> cpuNanos[PHASE_COUNT];
+    // Peak RSS of the process so far, in KB, sampled when the phase last ended: the most memory
+    // used by any phase up to then, not by this phase alone; 0 if never sampled
+    static std::atomic<long> peakRss[PHASE_COUNT];
+    static std::map<std::string, unsigned long> nodeKinds;
+    static std::mutex nodeKindsLock;
+
+    static long long nanosSince(clockid_t clock, const timespec &start) {
+        timespec now;
+        clock_gettime(clock, &now);
+        return (now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec);
+    }
+
+    PhaseTimer::PhaseTimer(Phase phase) : phase(phase) {
+        clock_gettime(CLOCK_MONOTONIC, &wallStart);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+    }
+
+    PhaseTimer::~PhaseTimer() {
+        wallNanos[phase] += nanosSince(CLOCK_MONOTONIC, wallStart);
+        cpuNanos[phase] += nanosSince(CLOCK_THREAD_CPUTIME_ID, cpuStart);
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        peakRss[phase] = usage.ru_maxrss;
+    }
+
+    LexTimer::LexTimer() {
+        clock_gettime(CLOCK_MONOTONIC, &wallStart);
+    }
+
+    LexTimer::~LexTimer() {
+        wallNanos[LEX] += nanosSince(CLOCK_MONOTONIC, wallStart);
+    }
+
+    namespace {
+        // Counts every node by its class name, without the ast:: prefix
+        class NodeCounter : public TreeWalker {
+        private:
+            std::map<std::type_index, std::string> names;
+
+        public:
+            std::map<std::string, unsigned long> kinds;
+
+        protected:
+            void enter(ast::Node &node) override {
+                auto found = names.find(typeid(node));
+                if (found == names.end()) {
+                    int status;
+                    char *demangled = abi::__cxa_demangle(typeid(node).name(), nullptr, nullptr, &status);
+                    std::string name = status == 0 ? demangled : typeid(node).name();
+                    free(demangled);
+                    if (name.compare(0, 5, "ast::") == 0) {
+                        name = name.substr(5);
+                    }
+                    found = names.emplace(typeid(node), name).first;
+                }
+                kinds[found->second]++;
+            }
+        };
+    }
+
+    void countNodes(ast::Node &root) {
+        NodeCounter counter;
+        root.accept(counter);
+        std::lock_guard<std::mutex> guard(nodeKindsLock);
+        for (const auto &kind : counter.kinds) {
+            nodeKinds[kind.first] += kind.second;
+        }
+    }
+
+    // Wall time of a phase in ms; parsing is reported without the lexing done inside it
+    static double wallMillis(int phase) {
+        long long value = wallNanos[phase];
+        if (phase == PARSE) {
+            value -= wallNanos[LEX];
+        }
+        return value / 1e6;
+    }
+
+    void report(std::ostream &os) {
+        char line[160];
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            snprintf(line, sizeof(line), "stats: %-8s %10.3f ms wall", phaseNames[phase], wallMillis(phase));
+            os << line;
+            if (phase != LEX) {
+                snprintf(line, sizeof(line), " %10.3f ms cpu", cpuNanos[phase] / 1e6);
+                os << line;
+            }
+            if (peakRss[phase]) {
+                os << ", peak rss so far " << peakRss[phase] << " KB";
+            }
+            os << '\n';
+        }
+
+        os << "stats:";
+        for (int counter = 0; counter < COUNTER_COUNT; ++counter) {
+            os << (counter ? ", " : " ") << counterNames[counter] << " " << counters[counter];
+        }
+        os << '\n';
+
+        unsigned long total = 0;
+        for (const auto &kind : nodeKinds) {
+            total += kind.second;
+        }
+        os << "stats: ast nodes " << total;
+        const char *separator = " (";
+        for (const auto &kind : nodeKinds) {
+            os << separator << kind.first << " " << kind.second;
+            separator = ", ";
+        }
+        os << (nodeKinds.empty() ? "" : ")") << std::endl;
+    }
+
+    void reportJson(std::ostream &os) {
+        char number[32];
+        os << "{\"phases\":{";
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            os << (phase ? "," : "") << '"' << phaseNames[phase] << "\":{";
+            snprintf(number, sizeof(number), "%.3f", wallMillis(phase));
+            os << "\"wall_ms\":" << number;
+            if (phase != LEX) {
+                snprintf(number, sizeof(number), "%.3f", cpuNanos[phase] / 1e6);
+                os << ",\"cpu_ms\":" << number;
+            }
+            if (peakRss[phase]) {
+                os << ",\"peak_rss_so_far_kb\":" << peakRss[phase];
+            }
+            os << '}';
+        }
+        os << "},\"counters\":{";
+        for (int counter = 0; counter < COUNTER_COUNT; ++counter) {
+            os << (counter ? "," : "") << '"' << counterKeys[counter] << "\":" << counters[counter];
+        }
+        os << "},\"ast_nodes\":{";
+        const char *separator = "";
+        for (const auto &kind : nodeKinds) {
+            os << separator << '"' << kind.first << "\":" << kind.second;
+            separator = ",";
+        }
+        os << "}}" << std::endl;
+    }
+
+    Reporter::~Reporter() {
+        if (!path) {
+            report(std::cerr);
+            return;
+        }
+        std::ofstream out(path);
+        reportJson(out);
+        if (!out) {
+            std::cerr << "cannot write " << path << std::endl;
+        }
+    }
+}
+
+#endif //FANC_STATS
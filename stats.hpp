@@ -0,0 +1,106 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+/* Front-end statistics for hw3 --stats
+ * Counters and phase timers are compiled in only with -DFANC_STATS (make stats); in other
+ * builds STATS_COUNT and STATS_PHASE expand to nothing and this header declares nothing else.
+ *
+ *     STATS_COUNT(SYMBOL_LOOKUPS);    // bumps a counter
+ *     STATS_PHASE(SEMANTIC);          // charges the rest of the enclosing block to a phase
+ *     STATS_COUNT_NODES(*root);       // adds up the nodes of a parsed tree by kind
+ *
+ * Lexing runs inside parsing, one token at a time, so only its wall time is taken per token
+ * and the report shows parsing without it; its CPU time and RSS stay with parsing. Phases
+ * timed on several threads, as in batch mode, add up.
+ */
+#ifdef FANC_STATS
+
+#include <atomic>
+#include <ctime>
+#include <ostream>
+#include "nodes.hpp"
+
+namespace stats {
+    enum Phase {
+        LEX,
+        PARSE,
+        SEMANTIC,
+        OUTPUT,
+        PHASE_COUNT
+    };
+
+    enum Counter {
+        TOKENS,
+        SYMBOL_LOOKUPS,
+        SCOPE_PUSHES,
+        SCOPE_POPS,
+        DIAGNOSTICS,
+        COUNTER_COUNT
+    };
+
+    // Relaxed atomics: the server and batch modes check on several threads
+    extern std::atomic<unsigned long> counters[COUNTER_COUNT];
+
+    /* PhaseTimer class
+     * Adds the wall time of its lifetime and the CPU time its thread used meanwhile to a
+     * phase, and records the peak RSS of the process when it ends.
+     */
+    class PhaseTimer {
+    private:
+        Phase phase;
+        timespec wallStart;
+        timespec cpuStart;
+
+    public:
+        explicit PhaseTimer(Phase phase);
+        ~PhaseTimer();
+    };
+
+    /* LexTimer class
+     * Adds the wall time of its lifetime to lexing, from the monotonic clock alone: it wraps
+     * every token, where reading the thread CPU clock and the RSS as well would cost several
+     * times the lexing it measures.
+     */
+    class LexTimer {
+    private:
+        timespec wallStart;
+
+    public:
+        LexTimer();
+        ~LexTimer();
+    };
+
+    // Counts the nodes of a tree by kind
+    void countNodes(ast::Node &root);
+
+    // Writes everything collected so far: report lines for stderr, or one JSON object
+    void report(std::ostream &os);
+    void reportJson(std::ostream &os);
+
+    /* Reporter class
+     * Writes the report when it goes out of scope, so main reports whichever way it returns:
+     * to stderr, or as JSON to the file at path if one is given.
+     */
+    class Reporter {
+    private:
+        const char *path;
+
+    public:
+        explicit Reporter(const char *path) : path(path) {}
+        ~Reporter();
+    };
+}
+
+#define STATS_COUNT(counter) (stats::counters[stats::counter].fetch_add(1, std::memory_order_relaxed))
+#define STATS_PHASE(phase) stats::PhaseTimer statsPhaseTimer(stats::phase)
+#define STATS_COUNT_NODES(root) stats::countNodes(root)
+
+#else
+
+#define STATS_COUNT(counter) ((void) 0)
+#define STATS_PHASE(phase) ((void) 0)
+#define STATS_COUNT_NODES(root) ((void) 0)
+
+#endif //FANC_STATS
+
+#endif //STATS_HPP
@@ -0,0 +1,72 @@
+#include "stringpool.hpp"
+#include <cstring>
+
+int StringPool::intern(const std::string &text) {
+    auto found = indices.find(text);
+    if (found != indices.end()) {
+        return found->second;
+    }
+    int index = static_cast<int>(texts.size());
+    texts.push_back(text);
+    indices.emplace(texts.back(), index);
+    return index;
+}
+
+int StringPool::internLiteral(const char *literal) {
+    // the scanner only accepts \n, \t, \r, \" and \\, between the quotes
+    std::string text;
+    size_t end = std::strlen(literal) - 1;
+    for (size_t i = 1; i < end; ++i) {
+        if (literal[i] != '\\' || i + 1 == end) {
+            text += literal[i];
+            continue;
+        }
+        switch (literal[++i]) {
+            case 'n':
+                text += '\n';
+                break;
+            case 't':
+                text += '\t';
+                break;
+            case 'r':
+                text += '\r';
+                break;
+            default:
+                text += literal[i];
+        }
+    }
+    return intern(text);
+}
+
+const std::string &StringPool::text(int index) const {
+    return texts[index];
+}
+
+int StringPool::size() const {
+    return static_cast<int>(texts.size());
+}
+
+std::string StringPool::escape(const std::string &text) {
+    std::string literal;
+    for (char c : text) {
+        switch (c) {
+            case '\n':
+                literal += "\\n";
+                break;
+            case '\t':
+                literal += "\\t";
+                break;
+            case '\r':
+                literal += "\\r";
+                break;
+            case '"':
+            case '\\':
+                literal += '\\';
+                literal += c;
+                break;
+            default:
+                literal += c;
+        }
+    }
+    return literal;
+}
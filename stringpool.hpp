@@ -0,0 +1,40 @@
+#ifndef STRINGPOOL_HPP
+#define STRINGPOOL_HPP
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/* StringPool class
+ * Holds every distinct string literal of one parse once, with its escape sequences decoded. The
+ * scanner starts a pool for each parse and interns each literal into it as it reads it; a String
+ * node keeps its index and shares the pool, so a literal printed a thousand times is stored once,
+ * the backends can emit one constant per index, and the pool goes away with the last tree that
+ * uses it. A server or library session therefore holds the literals of the programs it still
+ * has, not of every program it has seen. Entries never change or move once interned, so
+ * references to them stay valid while other literals are added. Only the parse that made a pool
+ * adds to it; after that it may be read from several threads.
+ */
+class StringPool {
+private:
+    std::deque<std::string> texts;
+    // Views into texts
+    std::unordered_map<std::string_view, int> indices;
+
+public:
+    // Index of the decoded text, adding it if it is new
+    int intern(const std::string &text);
+
+    // Interns a literal as written in the source, including the quotes
+    int internLiteral(const char *literal);
+
+    const std::string &text(int index) const;
+
+    int size() const;
+
+    // Escapes decoded text back the way a source literal writes it, without the quotes
+    static std::string escape(const std::string &text);
+};
+
+#endif //STRINGPOOL_HPP
@@ -1,4 +1,5 @@
 #include "symtable.hpp"
+#include "stats.hpp"
 #include <iostream>
 
 
@@ -12,7 +13,7 @@ std::vector<std::string> Symbol::types_as_string() {
 
 /* SymTable class implementation */
 
-SymTable::SymTable() {
+SymTable::SymTable() : jsonPrinter(nullptr) {
     // Initialize with global scope
     scopesStack.push(Scope());
     int currentOffset = 0;
@@ -31,15 +32,20 @@ void SymTable::_check_before_add(const std::string& name, int lineno) {
 }
 
 void SymTable::enterScope() {
+    STATS_COUNT(SCOPE_PUSHES);
     scopesStack.push(Scope());
 
     int currentOffset = offsetsStack.top();
     offsetsStack.push(currentOffset);
 
     scopePrinter.beginScope();
+    if (jsonPrinter) {
+        jsonPrinter->beginScope();
+    }
 }
 
 void SymTable::exitScope() {
+    STATS_COUNT(SCOPE_POPS);
     // Remove symbols from global map for this scope
     Table& currentTable = scopesStack.top().table;
     for (const auto& entry : currentTable) {
@@ -49,13 +55,16 @@ void SymTable::exitScope() {
     scopesStack.pop();
     offsetsStack.pop();
     scopePrinter.endScope();
+    if (jsonPrinter) {
+        jsonPrinter->endScope();
+    }
 }
 
 Scope& SymTable::getCurrentScope() {
     return scopesStack.top();
 }
 
-void SymTable::addVar(const std::string& name, ast::BuiltInType type, int lineno, bool isArray, int arrLength) {
+Symbol* SymTable::addVar(const std::string& name, ast::BuiltInType type, int lineno, bool isArray, int arrLength) {
 
     _check_before_add(name, lineno);
     
@@ -67,17 +76,24 @@ void SymTable::addVar(const std::string& name, ast::BuiltInType type, int lineno
     int currentOffset = offsetsStack.top();
     Symbol entry(name, type, lineno, currentOffset, false, isArray, arrLength);
     scopesStack.top().table.push_back(entry);
-    symbols[name] = entry;
+    Symbol* added = &(symbols[name] = entry);
     
     if (isArray) {
         scopePrinter.emitArr(name, type, arrLength, currentOffset);
+        if (jsonPrinter) {
+            jsonPrinter->emitArr(name, type, arrLength, currentOffset);
+        }
         // Increment offset by array length for arrays
         offsetsStack.top() += arrLength;
     } else {
         scopePrinter.emitVar(name, type, currentOffset);
+        if (jsonPrinter) {
+            jsonPrinter->emitVar(name, type, currentOffset);
+        }
         // Increment offset by 1 for regular variables
         offsetsStack.top() += 1;
     }
+    return added;
 }
 
 void SymTable::addFunc(const std::string& name, ast::BuiltInType returnType, int lineno,
@@ -91,9 +107,12 @@ void SymTable::addFunc(const std::string& name, ast::BuiltInType returnType, int
     symbols[name] = entry;
     
     scopePrinter.emitFunc(name, returnType, paramTypes);
+    if (jsonPrinter) {
+        jsonPrinter->emitFunc(name, returnType, paramTypes);
+    }
 }
 
-void SymTable::addParam(const std::string& name, ast::BuiltInType type, int lineno) {
+Symbol* SymTable::addParam(const std::string& name, ast::BuiltInType type, int lineno) {
     
     _check_before_add(name, lineno);
     // Decrement offset first to get negative values
@@ -103,9 +122,13 @@ void SymTable::addParam(const std::string& name, ast::BuiltInType type, int line
     Symbol entry(name, type, lineno, currentOffset, false, false, -1);
     // Insert at the beginning of the vector for reverse order
     scopesStack.top().table.insert(scopesStack.top().table.begin(), entry);
-    symbols[name] = entry;
+    Symbol* added = &(symbols[name] = entry);
     
     scopePrinter.emitVar(name, type, currentOffset);
+    if (jsonPrinter) {
+        jsonPrinter->emitVar(name, type, currentOffset);
+    }
+    return added;
 }
 
 bool SymTable::exists(const std::string& name) const {
@@ -113,6 +136,7 @@ bool SymTable::exists(const std::string& name) const {
 }
 
 Symbol* SymTable::lookup(const std::string& name) {
+    STATS_COUNT(SYMBOL_LOOKUPS);
     // First check the global map for existence
     auto globalIt = symbols.find(name);
     if (globalIt != symbols.end()) {
@@ -123,6 +147,64 @@ Symbol* SymTable::lookup(const std::string& name) {
     return nullptr;
 }
 
-void SymTable::printScopes() const {
-    std::cout << scopePrinter;
+void SymTable::setJsonPrinter(output::JsonScopePrinter *printer) {
+    jsonPrinter = printer;
+    if (!jsonPrinter) {
+        return;
+    }
+    // only the global scope is open before checking starts
+    for (const auto &symbol : scopesStack.top().table) {
+        if (symbol.isFunction) {
+            jsonPrinter->emitFunc(symbol.name, symbol.type, symbol.paramTypes);
+        }
+    }
+}
+
+void SymTable::beginFunction(const std::string &name) {
+    if (jsonPrinter) {
+        jsonPrinter->beginFunction(name);
+    }
+}
+
+void SymTable::beginCapture() {
+    scopePrinter.beginCapture();
+}
+
+std::string SymTable::endCapture() {
+    return scopePrinter.endCapture();
+}
+
+void SymTable::replayScopes(const std::string &lines) {
+    scopePrinter.emitRaw(lines);
+}
+
+void SymTable::discardScopes() {
+    while (scopesStack.size() > 1) {
+        for (const auto &entry : scopesStack.top().table) {
+            symbols.erase(entry.name);
+        }
+        scopesStack.pop();
+        offsetsStack.pop();
+    }
+    scopePrinter.discardScopes();
+}
+
+void SymTable::drainScopes(std::ostream &os) {
+    scopePrinter.drainScopes(os);
+}
+
+void SymTable::printHead(std::ostream &os) const {
+    scopePrinter.printHead(os);
+}
+
+void SymTable::printTail(std::ostream &os) const {
+    scopePrinter.printTail(os);
+}
+
+void SymTable::printScopes(std::ostream &os) const {
+    os << scopePrinter;
+}
+
+bool SymTable::writeScopes(int fd) const {
+    return scopePrinter.write(fd);
 }
@@ -53,29 +53,51 @@ private:
     // ScopePrinter for output
     output::ScopePrinter scopePrinter;
 
+    // Optional machine-readable dump, fed alongside scopePrinter
+    output::JsonScopePrinter *jsonPrinter;
+
     void _check_before_add(const std::string& name, int lineno);
 
 public:
     SymTable();
-    ~SymTable() { printScopes(); }
     
     // Scope management
     void enterScope();
     void exitScope();
     Scope& getCurrentScope();
     
-    // Symbol management
-    void addVar(const std::string& name, ast::BuiltInType type, int lineno, bool isArray = false, int arrLength = -1);
+    // Symbol management; addVar and addParam return the symbol added, so callers need no lookup
+    Symbol* addVar(const std::string& name, ast::BuiltInType type, int lineno, bool isArray = false, int arrLength = -1);
     void addFunc(const std::string& name, ast::BuiltInType returnType, int lineno,
                  const std::vector<ast::BuiltInType>& paramTypes);
-    void addParam(const std::string& name, ast::BuiltInType type, int lineno);
+    Symbol* addParam(const std::string& name, ast::BuiltInType type, int lineno);
     
     // Symbol lookup
     bool exists(const std::string& name) const;
     Symbol* lookup(const std::string& name);
     
+    // Also reports every scope to `printer` as it closes; the functions declared so far are
+    // reported right away
+    void setJsonPrinter(output::JsonScopePrinter *printer);
+    // Names the function whose scopes follow, for the JSON dump
+    void beginFunction(const std::string &name);
+
+    // Per-function scope capture, used by the function cache
+    void beginCapture();
+    std::string endCapture();
+    void replayScopes(const std::string &lines);
+    // Closes the scopes a failed check left open, without reporting them, and drops the
+    // scope lines, leaving only the global scope
+    void discardScopes();
+
+    // Streams the scope lines buffered so far, see ScopePrinter::drainScopes
+    void drainScopes(std::ostream &os);
+    void printHead(std::ostream &os) const;
+    void printTail(std::ostream &os) const;
+
     // Print current state (handled internally by ScopePrinter)
-    void printScopes() const;
+    void printScopes(std::ostream &os) const;
+    bool writeScopes(int fd) const;
 };
 
 #endif //SYMTABLE_HPP
@@ -0,0 +1,203 @@
+#include "tailcall.hpp"
+
+TailCallEliminator::TailCallEliminator()
+        : function(nullptr), tail(false), loops(0), eliminatedCount(0) {}
+
+/* Helpers */
+
+void TailCallEliminator::_statement(std::shared_ptr<ast::Statement> &statement, bool inTail) {
+    replacement = nullptr;
+    tail = inTail;
+    statement->accept(*this);
+    if (replacement) {
+        statement = replacement;
+        replacement = nullptr;
+    }
+}
+
+bool TailCallEliminator::_selfCall(const ast::Node &node) const {
+    auto call = dynamic_cast<const ast::Call *>(&node);
+    return call && loops == 0 && call->func_id->value == function->id->value;
+}
+
+std::shared_ptr<ast::Statement> TailCallEliminator::_jump(ast::Call &call) {
+    auto &formals = function->formals->formals;
+    auto &args = call.args->exps;
+
+    // parameters passed on unchanged need no assignment
+    std::vector<size_t> changed;
+    for (size_t i = 0; i < formals.size(); i++) {
+        auto id = dynamic_cast<ast::ID *>(args[i].get());
+        if (!id || id->computedOffset != formals[i]->id->computedOffset) {
+            changed.push_back(i);
+        }
+    }
+
+    auto statements = std::make_shared<ast::Statements>();
+    auto assign = [&](size_t i, std::shared_ptr<ast::Exp> value) {
+        auto param = std::make_shared<ast::ID>(*formals[i]->id);
+        param->line = call.line;
+        auto assignment = std::make_shared<ast::Assign>(param, value);
+        assignment->line = call.line;
+        statements->push_back(assignment);
+    };
+
+    if (changed.size() == 1) {
+        assign(changed[0], args[changed[0]]);
+    } else if (!changed.empty()) {
+        if (nextValues.empty()) {
+            for (auto &formal : formals) {
+                std::string name = formal->id->value + std::to_string(function->computedFrameSize);
+                auto local = std::make_shared<ast::ID>(name.c_str());
+                local->line = function->line;
+                local->computedType = formal->id->computedType;
+                local->computedOffset = function->computedFrameSize++;
+                nextValues.push_back(local);
+            }
+        }
+        for (size_t i : changed) {
+            auto local = std::make_shared<ast::ID>(*nextValues[i]);
+            auto type = std::make_shared<ast::PrimitiveType>(local->computedType);
+            type->line = call.line;
+            type->computedType = local->computedType;
+            auto declaration = std::make_shared<ast::VarDecl>(local, type, args[i]);
+            declaration->line = call.line;
+            statements->push_back(declaration);
+        }
+        for (size_t i : changed) {
+            assign(i, std::make_shared<ast::ID>(*nextValues[i]));
+        }
+    }
+
+    auto again = std::make_shared<ast::Continue>();
+    again->line = call.line;
+    statements->push_back(again);
+    auto block = std::make_shared<ast::Block>(statements);
+    block->line = call.line;
+    eliminatedCount++;
+    return block;
+}
+
+/* Expressions: calls in them are never tail calls */
+
+void TailCallEliminator::visit(ast::Num &node) {}
+
+void TailCallEliminator::visit(ast::NumB &node) {}
+
+void TailCallEliminator::visit(ast::String &node) {}
+
+void TailCallEliminator::visit(ast::Bool &node) {}
+
+void TailCallEliminator::visit(ast::ID &node) {}
+
+void TailCallEliminator::visit(ast::BinOp &node) {}
+
+void TailCallEliminator::visit(ast::RelOp &node) {}
+
+void TailCallEliminator::visit(ast::Not &node) {}
+
+void TailCallEliminator::visit(ast::And &node) {}
+
+void TailCallEliminator::visit(ast::Or &node) {}
+
+void TailCallEliminator::visit(ast::Cast &node) {}
+
+void TailCallEliminator::visit(ast::ArrayDereference &node) {}
+
+void TailCallEliminator::visit(ast::ExpList &node) {}
+
+/* Types */
+
+void TailCallEliminator::visit(ast::ArrayType &node) {}
+
+void TailCallEliminator::visit(ast::PrimitiveType &node) {}
+
+/* Statements */
+
+void TailCallEliminator::visit(ast::Call &node) {
+    // falling off the end of a function that returns a value returns 0, not the call's value
+    if (tail && function->return_type->computedType == ast::BuiltInType::VOID && _selfCall(node)) {
+        replacement = _jump(node);
+    }
+}
+
+void TailCallEliminator::visit(ast::ArrayAssign &node) {}
+
+void TailCallEliminator::visit(ast::Statements &node) {
+    bool inTail = tail;
+    auto &statements = node.statements;
+    for (size_t i = 0; i < statements.size(); i++) {
+        bool last = i + 1 == statements.size();
+        // a call right before `return;` is as much the last thing done as one at the end
+        auto next = last ? nullptr : dynamic_cast<ast::Return *>(statements[i + 1].get());
+        _statement(statements[i], (inTail && last) || (next && !next->exp));
+    }
+}
+
+void TailCallEliminator::visit(ast::Block &node) {
+    node.statements->accept(*this);
+}
+
+void TailCallEliminator::visit(ast::Break &node) {}
+
+void TailCallEliminator::visit(ast::Continue &node) {}
+
+void TailCallEliminator::visit(ast::Return &node) {
+    if (node.exp && _selfCall(*node.exp)) {
+        replacement = _jump(*dynamic_cast<ast::Call *>(node.exp.get()));
+    }
+}
+
+void TailCallEliminator::visit(ast::If &node) {
+    bool inTail = tail;
+    _statement(node.then, inTail);
+    if (node.otherwise) {
+        _statement(node.otherwise, inTail);
+    }
+}
+
+void TailCallEliminator::visit(ast::While &node) {
+    loops++;
+    _statement(node.body, false);
+    loops--;
+}
+
+void TailCallEliminator::visit(ast::VarDecl &node) {}
+
+void TailCallEliminator::visit(ast::Assign &node) {}
+
+void TailCallEliminator::visit(ast::Formal &node) {}
+
+void TailCallEliminator::visit(ast::Formals &node) {}
+
+void TailCallEliminator::visit(ast::FuncDecl &node) {
+    function = &node;
+    nextValues.clear();
+    int before = eliminatedCount;
+
+    tail = true;
+    node.body->accept(*this);
+    if (eliminatedCount == before) {
+        return;
+    }
+    perFunction.emplace_back(node.id->value, eliminatedCount - before);
+
+    // the body runs once more for every tail call, and leaves the loop where it used to end
+    auto leave = std::make_shared<ast::Break>();
+    leave->line = node.line;
+    node.body->push_back(leave);
+    auto condition = std::make_shared<ast::Bool>(true);
+    condition->line = node.line;
+    condition->computedType = ast::BuiltInType::BOOL;
+    auto loopBody = std::make_shared<ast::Block>(node.body);
+    loopBody->line = node.line;
+    auto loop = std::make_shared<ast::While>(condition, loopBody);
+    loop->line = node.line;
+    node.body = std::make_shared<ast::Statements>(loop);
+}
+
+void TailCallEliminator::visit(ast::Funcs &node) {
+    for (auto &func : node.funcs) {
+        func->accept(*this);
+    }
+}
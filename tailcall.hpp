@@ -0,0 +1,91 @@
+#ifndef TAILCALL_HPP
+#define TAILCALL_HPP
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* TailCallEliminator class
+ * Turns self tail calls into jumps back to the function's entry on a checked tree, so the
+ * recursion runs in one frame. The body is wrapped in `while (true) { ...; break; }`, and each
+ * tail call assigns its arguments to the parameters and continues the loop:
+ *
+ *     int sum(int n, int acc) {             int sum(int n, int acc) {
+ *         if (n == 0) return acc;               while (true) {
+ *         return sum(n - 1, acc + n);   =>          if (n == 0) return acc;
+ *     }                                             { int n0 = n - 1; int acc1 = acc + n;
+ *                                                     n = n0; acc = acc1; continue; }
+ *                                                   break;
+ *                                               }
+ *                                           }
+ *
+ * A tail call is `return f(...)` in f, or in a void f a call to f that is the last thing the
+ * function does. The arguments go through fresh locals first when more than one parameter
+ * changes, since each argument still reads the parameters' old values. Locals declared in the
+ * body are declared again on each pass, so they start over as they would in a new frame. Calls
+ * inside a While are left alone: continue there would only restart that loop.
+ */
+class TailCallEliminator : public Visitor {
+private:
+    ast::FuncDecl *function;
+    // Statement that replaces the one just visited, or nullptr to keep it
+    std::shared_ptr<ast::Statement> replacement;
+    // The statement being visited is the last thing the function does
+    bool tail;
+    // Enclosing loops of the statement being visited
+    int loops;
+    // Locals that hold the next value of each parameter, made on first use in a function
+    std::vector<std::shared_ptr<ast::ID>> nextValues;
+    int eliminatedCount;
+    std::vector<std::pair<std::string, int>> perFunction;
+
+    void _statement(std::shared_ptr<ast::Statement> &statement, bool inTail);
+    bool _selfCall(const ast::Node &node) const;
+    // The parameter assignments and continue that replace a tail call
+    std::shared_ptr<ast::Statement> _jump(ast::Call &call);
+
+public:
+    TailCallEliminator();
+
+    // Number of tail calls turned into jumps in the whole program
+    int callsEliminated() const { return eliminatedCount; }
+
+    // Functions with eliminated tail calls, in source order, and how many each
+    const std::vector<std::pair<std::string, int>> &eliminatedPerFunction() const { return perFunction; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif //TAILCALL_HPP
@@ -0,0 +1,94 @@
+#!/bin/bash
+# Checks that every backend runs a program the way the bytecode VM does: each program in
+# allTests, and each tests/*.in, that checks without errors runs with --run, and must print the
+# same, with the same exit status, with
+#   - jit: the x86-64 JIT, --jit
+#   - llvm: the LLVM IR of --emit-llvm, run by lli
+#   - object: the ELF object of --emit-object, linked by ld and run
+# The SSA form has no way to run, so it must only be built and dumped, --dump-ssa, for every
+# program. A program that recurses without end overflows the stack at a depth
+# that differs between backends, so there the shorter output only has to start the longer one.
+# Backends whose tools are missing here are skipped, and so are the programs that do not finish
+# within $TIME_LIMIT seconds on the VM, some of which never end.
+#
+#   tests/backends/run.sh             # from the repository root, after make
+#   HW3=/path/to/hw3 tests/backends/run.sh
+
+HW3=${HW3:-./hw3}
+TIME_LIMIT=${TIME_LIMIT:-5}
+TEST_DIR=$(dirname "$0")
+failed=0
+skipped=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# same_output RESULT EXPECTED: whether the backend printed what the VM did, up to where either
+# overflowed the stack
+same_output() {
+    if [ "$(tail -n 1 "$1")" != "Error stack overflow" ] || [ "$(tail -n 1 "$2")" != "Error stack overflow" ]; then
+        cmp -s "$1" "$2"
+        return
+    fi
+    local result expected
+    result=$(head -n -1 "$1" | wc -c)
+    expected=$(head -n -1 "$2" | wc -c)
+    cmp -s -n $((result < expected ? result : expected)) "$1" "$2"
+}
+
+# backend NAME: runs the program on stdin with backend NAME; what it prints, and its exit status
+backend() {
+    case $1 in
+        jit)
+            timeout "$TIME_LIMIT" "$HW3" --jit
+            ;;
+        llvm)
+            "$HW3" --emit-llvm > "$work/program.ll" || return
+            timeout "$TIME_LIMIT" lli "$work/program.ll"
+            ;;
+        object)
+            "$HW3" --emit-object "$work/program.o" > /dev/null || return
+            ld -o "$work/program" "$work/program.o" && timeout "$TIME_LIMIT" "$work/program"
+            ;;
+    esac
+}
+
+backends=(jit)
+if command -v lli > /dev/null; then
+    backends+=(llvm)
+fi
+if command -v ld > /dev/null; then
+    backends+=(object)
+fi
+
+for test_in in "$TEST_DIR"/../../allTests/*/*.in "$TEST_DIR"/../*.in; do
+    test_name=${test_in#"$TEST_DIR/../"}
+    test_name=${test_name#../allTests/}
+    test_name=${test_name%.in}
+    if [ "$("$HW3" < "$test_in" 2> /dev/null | head -n 1)" != "---begin global scope---" ]; then
+        continue
+    fi
+    timeout "$TIME_LIMIT" "$HW3" --run < "$test_in" > "$work/expected" 2>&1
+    status=$?
+    if [ $status = 124 ]; then
+        ((skipped++))
+        continue
+    fi
+    for name in "${backends[@]}"; do
+        rm -f "$work/program.o" "$work/program"
+        backend "$name" < "$test_in" > "$work/result" 2>&1
+        if [ $? != $status ] || ! same_output "$work/result" "$work/expected"; then
+            echo "$test_name ($name): FAILED"
+            ((failed++))
+        fi
+    done
+    if ! "$HW3" --dump-ssa < "$test_in" > /dev/null 2>&1; then
+        echo "$test_name (ssa): FAILED"
+        ((failed++))
+    fi
+done
+
+if [ $skipped != 0 ]; then
+    echo "skipped: $skipped programs that did not finish on the VM"
+fi
+echo "Failed: $failed"
+exit $failed
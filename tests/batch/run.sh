@@ -0,0 +1,78 @@
+#!/bin/bash
+# Checks hw3 --batch: every program here is checked in one batch, on one worker and on several,
+# with the files named on the command line and read from stdin, and each .res file must match
+# the .out file, which holds what a plain run prints. A missing file is reported and fails the
+# batch without stopping the others. --batch=stream must write stream.frames, one frame per
+# readable file in the order given, and flags the batch checker cannot honor must be refused.
+#
+#   tests/batch/run.sh                # from the repository root, after make
+#   HW3=/path/to/hw3 tests/batch/run.sh
+
+HW3=${HW3:-./hw3}
+HW3=$(cd "$(dirname "$HW3")" && pwd)/$(basename "$HW3")
+TEST_DIR=$(cd "$(dirname "$0")" && pwd)
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+names=()
+for test_in in "$TEST_DIR"/*.in; do
+    names+=("$(basename "$test_in" .in)")
+done
+
+# fresh NAME: a directory of its own under $work holding a copy of every program
+fresh() {
+    rm -rf "${work:?}/$1"
+    mkdir "$work/$1"
+    cp "$TEST_DIR"/*.in "$work/$1"
+}
+
+# compare_res NAME: every .res in directory NAME must match its .out
+compare_res() {
+    local test_name
+    for test_name in "${names[@]}"; do
+        if ! diff -q "$work/$1/$test_name.res" "$TEST_DIR/$test_name.out" > /dev/null 2>&1; then
+            echo "$test_name ($1): FAILED"
+            ((failed++))
+        fi
+    done
+}
+
+for jobs in 1 4; do
+    fresh "args-$jobs"
+    (cd "$work/args-$jobs" && "$HW3" --batch --jobs=$jobs "${names[@]/%/.in}" missing.in 2> /dev/null)
+    if [ $? != 1 ] || [ -e "$work/args-$jobs/missing.res" ]; then
+        echo "missing file (args-$jobs): FAILED"
+        ((failed++))
+    fi
+    compare_res "args-$jobs"
+
+    fresh "stdin-$jobs"
+    (cd "$work/stdin-$jobs" && printf '%s.in\n' "${names[@]}" | "$HW3" --batch --jobs=$jobs 2> /dev/null) || {
+        echo "stdin-$jobs: FAILED, nonzero exit"
+        ((failed++))
+    }
+    compare_res "stdin-$jobs"
+
+    fresh "stream-$jobs"
+    (cd "$work/stream-$jobs" && "$HW3" --batch=stream --jobs=$jobs scopes.in syntax-error.in missing.in \
+        semantic-error.in scopes.in > "$work/frames" 2> /dev/null)
+    if [ $? != 1 ] || ! diff -q "$work/frames" "$TEST_DIR/stream.frames" > /dev/null || \
+       [ -n "$(ls "$work/stream-$jobs"/*.res 2> /dev/null)" ]; then
+        echo "stream (jobs $jobs): FAILED"
+        ((failed++))
+    fi
+done
+
+for flags in --run --jit --emit-llvm "--emit-object program.o" --dump-ssa --ssa-stats --dump-format=json \
+             --warnings --tce --inline --fold --simplify --dce --licm --bce --vectorize --stream; do
+    fresh refused
+    (cd "$work/refused" && "$HW3" --batch $flags scopes.in > /dev/null 2>&1)
+    if [ $? != 1 ] || [ -e "$work/refused/scopes.res" ]; then
+        echo "--batch $flags: FAILED, not refused"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
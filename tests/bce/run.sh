@@ -0,0 +1,13 @@
+#!/bin/bash
+# Checks bounds-check elimination: every program here must report the checks removed in its
+# .report file, and must print the same without and with --bce (see tests/pass-suite.sh), so
+# the checks that stay still fire.
+#
+#   tests/bce/run.sh                  # from the repository root, after make
+#   HW3=/path/to/hw3 tests/bce/run.sh
+
+TEST_DIR=$(dirname "$0")
+PASS=--bce
+FLAG_SETS=("" "--bce" "--licm --bce")
+source "$TEST_DIR/../pass-suite.sh"
+run_suite
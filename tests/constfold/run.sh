@@ -0,0 +1,13 @@
+#!/bin/bash
+# Checks constant folding: every program here must report the expressions folded and the divisions
+# by zero warned about in its .report file, and must print the same without and with --fold (see
+# tests/pass-suite.sh).
+#
+#   tests/constfold/run.sh            # from the repository root, after make
+#   HW3=/path/to/hw3 tests/constfold/run.sh
+
+TEST_DIR=$(dirname "$0")
+PASS=--fold
+FLAG_SETS=("" "--fold" "--fold --simplify")
+source "$TEST_DIR/../pass-suite.sh"
+run_suite
@@ -0,0 +1,13 @@
+#!/bin/bash
+# Checks dead code elimination: every program here must report the statements and functions
+# removed in its .report file, and must print the same without and with --dce (see
+# tests/pass-suite.sh).
+#
+#   tests/dce/run.sh                  # from the repository root, after make
+#   HW3=/path/to/hw3 tests/dce/run.sh
+
+TEST_DIR=$(dirname "$0")
+PASS=--dce
+FLAG_SETS=("" "--dce" "--fold --dce")
+source "$TEST_DIR/../pass-suite.sh"
+run_suite
@@ -0,0 +1,56 @@
+#!/bin/bash
+# Checks that --incremental never changes what hw3 prints: every program here is checked cold,
+# with an empty cache, and then warm, replayed from the cache the first run filled, and both
+# must print the .out file, which holds what a plain run prints. The warm run must replay every
+# function. Last, all programs are checked in turn against one shared cache, so a function
+# whose text is cached from another program is replayed only when the signatures it uses match.
+# Flags that need every function checked afresh, the passes and backends, must be refused with it.
+#
+#   tests/incremental/run.sh          # from the repository root, after make
+#   HW3=/path/to/hw3 tests/incremental/run.sh
+
+HW3=${HW3:-./hw3}
+TEST_DIR=$(dirname "$0")
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# check NAME CACHE HITS: checks program NAME against CACHE; HITS is the expected hit count,
+# "all" for every function or "any" to not look at it
+check() {
+    local test_name=$1 cache=$2 hits=$3
+    "$HW3" --incremental="$cache" < "$TEST_DIR/$test_name.in" > "$work/result" 2> "$work/stderr"
+    if ! diff -q "$work/result" "$TEST_DIR/$test_name.out" > /dev/null; then
+        echo "$test_name ($cache): FAILED"
+        ((failed++))
+        return
+    fi
+    local counts
+    counts=$(sed -n 's/^function cache: \([0-9]*\/[0-9]*\) hits.*/\1/p' "$work/stderr")
+    if [ "$hits" = all ] && [ "${counts%/*}" != "${counts#*/}" ] || [ "$hits" = 0 ] && [ "${counts%/*}" != 0 ]; then
+        echo "$test_name ($cache): FAILED, $counts hits"
+        ((failed++))
+    fi
+}
+
+for test_in in "$TEST_DIR"/*.in; do
+    test_name=$(basename "$test_in" .in)
+    check "$test_name" "$work/$test_name" 0
+    check "$test_name" "$work/$test_name" all
+done
+
+for test_name in functions error signature functions; do
+    check "$test_name" "$work/shared" any
+done
+
+for flags in --tce --inline --fold --simplify --dce --licm --bce --vectorize --warnings --dump-format=json \
+             --run --jit --emit-llvm "--emit-object $work/program.o" --dump-ssa --ssa-stats; do
+    "$HW3" --incremental="$work/refused" $flags < "$TEST_DIR/functions.in" > "$work/result" 2>&1
+    if [ $? != 1 ] || [ -e "$work/refused" ] || [ -e "$work/program.o" ] || grep -qv '^ \|^usage' "$work/result"; then
+        echo "--incremental $flags: FAILED, not refused"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
@@ -0,0 +1,13 @@
+#!/bin/bash
+# Checks the inliner: every program here must report the decision on each call and the calls
+# inlined in its .report file, recursive ones left alone, and must print the same without and
+# with --inline (see tests/pass-suite.sh).
+#
+#   tests/inline/run.sh               # from the repository root, after make
+#   HW3=/path/to/hw3 tests/inline/run.sh
+
+TEST_DIR=$(dirname "$0")
+PASS=--inline
+FLAG_SETS=("" "--inline" "--tce --inline")
+source "$TEST_DIR/../pass-suite.sh"
+run_suite
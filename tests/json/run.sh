@@ -0,0 +1,34 @@
+#!/bin/bash
+# Checks the newline-delimited JSON scope dump: for every program here, hw3 --dump-format=json
+# must print the .out file, one JSON object per line. Modes that print something else to stdout
+# must be refused with it.
+#
+#   tests/json/run.sh                 # from the repository root, after make
+#   HW3=/path/to/hw3 tests/json/run.sh
+
+HW3=${HW3:-./hw3}
+TEST_DIR=$(dirname "$0")
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+for test_in in "$TEST_DIR"/*.in; do
+    test_name=$(basename "$test_in" .in)
+    "$HW3" --dump-format=json < "$test_in" > "$work/result" 2>&1
+    if ! diff -q "$work/result" "$TEST_DIR/$test_name.out" > /dev/null; then
+        echo "$test_name: FAILED"
+        ((failed++))
+    fi
+done
+
+# the records would be mixed into the program's output or the IR
+for flags in --run --jit --emit-llvm "--emit-object $work/program.o" --dump-ssa; do
+    "$HW3" --dump-format=json $flags < "$TEST_DIR/scopes.in" > "$work/result" 2>&1
+    if [ $? != 1 ] || grep -q '^{' "$work/result" || [ -e "$work/program.o" ]; then
+        echo "--dump-format=json $flags: FAILED, not refused"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
@@ -0,0 +1,56 @@
+#!/bin/bash
+# Checks libfanc from clients linked against it:
+#   - session.cpp checks the programs here in two sessions on two threads, linked once with
+#     libfanc.a and once with libfanc.so, and what it prints must match session.out; each
+#     result's text must also be exactly what hw3 prints for the program
+#   - workspace.cpp edits a program in a Workspace, and the answers and the number of functions
+#     checked again after each edit must match workspace.out
+#
+#   tests/libfanc/run.sh              # from the repository root, after make and make lib
+#   HW3=/path/to/hw3 LIB_DIR=/path/to/lib tests/libfanc/run.sh
+
+HW3=${HW3:-./hw3}
+LIB_DIR=$(cd "${LIB_DIR:-.}" && pwd)
+TEST_DIR=$(dirname "$0")
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+CXX=${CXX:-g++}
+"$CXX" -std=c++17 -pthread -I"$TEST_DIR/../.." -o "$work/static" "$TEST_DIR/session.cpp" "$LIB_DIR/libfanc.a" &&
+"$CXX" -std=c++17 -pthread -I"$TEST_DIR/../.." -o "$work/shared" "$TEST_DIR/session.cpp" \
+    -L"$LIB_DIR" -lfanc -Wl,-rpath,"$LIB_DIR" &&
+"$CXX" -std=c++17 -pthread -I"$TEST_DIR/../.." -o "$work/workspace" "$TEST_DIR/workspace.cpp" "$LIB_DIR/libfanc.a"
+if [ $? != 0 ]; then
+    echo "cannot build the clients"
+    exit 1
+fi
+
+for client in static shared; do
+    "$work/$client" "$TEST_DIR"/*.in > "$work/result" 2>&1
+    if ! diff -q "$work/result" "$TEST_DIR/session.out" > /dev/null; then
+        echo "$client: FAILED"
+        ((failed++))
+    fi
+done
+
+"$work/workspace" > "$work/result" 2>&1
+if ! diff -q "$work/result" "$TEST_DIR/workspace.out" > /dev/null; then
+    echo "workspace: FAILED"
+    ((failed++))
+fi
+
+# the text of a result is the scope dump or the error, as hw3 prints it
+for test_in in "$TEST_DIR"/*.in; do
+    test_name=$(basename "$test_in")
+    "$HW3" < "$test_in" > "$work/plain" 2> /dev/null
+    sed -n "/^== $test_name (cached session, pass 1): /,/^== /p" "$TEST_DIR/session.out" | \
+        grep -v "^== \|^error at line \|^warning at line " > "$work/text"
+    if ! cmp -s "$work/plain" "$work/text"; then
+        echo "$test_name (text): FAILED"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
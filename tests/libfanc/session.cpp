@@ -0,0 +1,72 @@
+// Client of libfanc for tests/libfanc/run.sh: checks the programs named on the command line in
+// two sessions at once, on two threads, and prints what each session returned, in order.
+//   - the first session keeps its function cache and checks every program twice, so the second
+//     pass is answered from the cache
+//   - the second session runs the flow warnings and checks every program once
+// Every result is printed next to the exact text hw3 would print for it, and each session
+// ends with its cache counts.
+#include "libfanc.hpp"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void print(std::ostream &out, const std::string &title, const fanc::Result &result) {
+    out << "== " << title << ": " << (result.ok ? "ok" : "failed") << "\n";
+    // an error's message is the text hw3 prints, below
+    for (const auto &diagnostic : result.diagnostics) {
+        if (diagnostic.severity == fanc::Diagnostic::ERROR) {
+            out << "error at line " << diagnostic.line << "\n";
+        } else {
+            out << "warning at line " << diagnostic.line << ": " << diagnostic.message << "\n";
+        }
+    }
+    out << result.text();
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> names;
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream in(argv[i]);
+        if (!in) {
+            std::cerr << "cannot read " << argv[i] << std::endl;
+            return 1;
+        }
+        std::string name = argv[i];
+        names.push_back(name.substr(name.find_last_of('/') + 1));
+        sources.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::ostringstream cached;
+    std::thread first([&] {
+        fanc::Session session;
+        fanc::Result result;
+        for (int pass = 1; pass <= 2; ++pass) {
+            for (size_t i = 0; i < sources.size(); ++i) {
+                session.compile(sources[i].data(), sources[i].size(), result);
+                print(cached, names[i] + " (cached session, pass " + std::to_string(pass) + ")", result);
+            }
+        }
+        cached << "cached session: " << session.cacheHits() << " hits, " << session.cacheMisses() << " misses\n";
+    });
+
+    std::ostringstream warned;
+    std::thread second([&] {
+        fanc::Options options;
+        options.warnings = true;
+        fanc::Session session(options);
+        for (size_t i = 0; i < sources.size(); ++i) {
+            print(warned, names[i] + " (warnings session)", session.compile(sources[i]));
+        }
+        warned << "warnings session: " << session.cacheHits() << " hits, " << session.cacheMisses() << " misses\n";
+    });
+
+    first.join();
+    second.join();
+    std::cout << cached.str() << warned.str();
+    return 0;
+}
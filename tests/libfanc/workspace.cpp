@@ -0,0 +1,92 @@
+// Client of libfanc for tests/libfanc/run.sh: edits one program in a Workspace step by step and
+// prints, after each step, the answer for every function and how many functions had to be
+// checked again for them; everything else was reused from earlier steps.
+#include "libfanc.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const char *const functionNames[] = {"twice", "quad", "other", "main", "helper"};
+
+static const char *const original =
+        "int twice(int x) {\n"
+        "    return x * 2;\n"
+        "}\n"
+        "int quad(int x) {\n"
+        "    int y = twice(x);\n"
+        "    return twice(y);\n"
+        "}\n"
+        "void other() {\n"
+        "    print(\"other\");\n"
+        "}\n"
+        "void main() {\n"
+        "    printi(quad(3));\n"
+        "    other();\n"
+        "}\n";
+
+static fanc::Workspace workspace;
+static unsigned long checkedBefore = 0;
+
+static void show(const std::string &step, const fanc::Result &update) {
+    std::cout << "== " << step << "\n";
+    if (!update.ok) {
+        std::cout << "update failed at line " << update.diagnostics[0].line << ": " << update.text();
+    }
+    for (const char *name : functionNames) {
+        fanc::Result result = workspace.checkFunction(name);
+        std::cout << name << ": ";
+        if (result.ok) {
+            std::cout << "ok\n" << result.text();
+        } else {
+            std::cout << "error at line " << result.diagnostics[0].line << ": " << result.text();
+        }
+    }
+    std::cout << "checked again: " << workspace.functionsChecked() - checkedBefore << "\n";
+    checkedBefore = workspace.functionsChecked();
+}
+
+static std::string replace(std::string text, const std::string &from, const std::string &to) {
+    text.replace(text.find(from), from.size(), to);
+    return text;
+}
+
+int main() {
+    std::string text = original;
+    show("open", workspace.update(text));
+    show("query again", fanc::Result{true});
+    std::cout << "resolve 5:twice: " << workspace.resolve(5, "twice");
+    std::cout << "resolve 5:y: " << workspace.resolve(5, "y");
+    std::cout << "type 6:y: " << workspace.typeAt(6, "y") << "\n";
+
+    // a body changes on the same lines: only that function
+    text = replace(text, "print(\"other\")", "print(\"changed\")");
+    show("edit the body of other", workspace.update(text));
+
+    // a signature changes: the function, and quad, which calls it and no longer matches;
+    // main does not mention twice and keeps its answer
+    text = replace(text, "int twice(int x) {\n    return x * 2;", "int twice(int x, int y) {\n    return x * y;");
+    show("add a parameter to twice", workspace.update(text));
+    std::cout << "resolve 5:twice: " << workspace.resolve(5, "twice");
+
+    // the callers are fixed: only quad
+    text = replace(text, "twice(x);", "twice(x, 2);");
+    text = replace(text, "twice(y);", "twice(y, 2);");
+    show("pass the new argument in quad", workspace.update(text));
+    std::cout << "type 6:y: " << workspace.typeAt(6, "y") << "\n";
+
+    // a text that does not parse keeps the program open before
+    show("break the syntax", workspace.update(replace(text, "return x * y;", "return x * ;")));
+
+    // a function added at the end: only itself, when asked for
+    text += "int helper() {\n    return quad(1);\n}\n";
+    show("add helper", workspace.update(text));
+
+    // lines above a function shift: every function below is checked again, at its new lines
+    text = replace(text, "void other() {\n", "void other() {\n\n");
+    show("insert a line in other", workspace.update(text));
+
+    // removing a function starts over
+    text = replace(text, "void other() {\n\n    print(\"changed\");\n}\n", "");
+    show("remove other", workspace.update(text));
+    return 0;
+}
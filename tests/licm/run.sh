@@ -0,0 +1,12 @@
+#!/bin/bash
+# Checks loop-invariant code motion: every program here must report the expressions hoisted in
+# its .report file, and must print the same without and with --licm (see tests/pass-suite.sh).
+#
+#   tests/licm/run.sh                 # from the repository root, after make
+#   HW3=/path/to/hw3 tests/licm/run.sh
+
+TEST_DIR=$(dirname "$0")
+PASS=--licm
+FLAG_SETS=("" "--licm" "--fold --licm")
+source "$TEST_DIR/../pass-suite.sh"
+run_suite
@@ -0,0 +1,83 @@
+#!/bin/bash
+# Shared by the run.sh of the optimization pass suites, which set these and source this file:
+#
+#   PASS       the flag of the pass under test, e.g. --licm
+#   FLAG_SETS  flag sets every program runs with, e.g. ("" "--licm" "--fold --licm")
+#
+# Every program NAME.in here is checked two ways:
+#   - its report: what hw3 $PASS writes to stderr must match NAME.report, so a pass that
+#     stops doing its work fails even when the programs still print the right thing
+#   - its meaning: it runs with each engine and flag set, and what it prints must match
+#     NAME.out, which holds what it prints without the pass. A program whose outcome the pass
+#     is meant to change, like recursion too deep to run without --tce, has NAME.plain.out
+#     for the flag sets without the pass; lli has no stack limit of its own, so it only runs
+#     such a program with the pass.
+# Engines that cannot run here are skipped.
+
+HW3=${HW3:-./hw3}
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# engine NAME: runs hw3 with the flags of engine NAME plus the rest, on stdin; only what the
+# program prints is kept, the pass reports go to stderr
+engine() {
+    local name=$1
+    shift
+    case $name in
+        llvm)
+            "$HW3" --emit-llvm "$@" > "$work/program.ll" 2> /dev/null && lli "$work/program.ll"
+            ;;
+        *)
+            "$HW3" "--$name" "$@" 2> /dev/null
+            ;;
+    esac
+}
+
+engines=(run jit)
+if command -v lli > /dev/null; then
+    engines+=(llvm)
+fi
+
+# check_report TEST_IN
+check_report() {
+    local test_in=$1
+    local test_name
+    test_name=$(basename "$test_in" .in)
+    "$HW3" $PASS < "$test_in" 2> "$work/report" > /dev/null
+    if ! diff -q "$work/report" "$TEST_DIR/$test_name.report" > /dev/null 2>&1; then
+        echo "$test_name ($PASS report): FAILED"
+        ((failed++))
+    fi
+}
+
+# check_output TEST_IN
+check_output() {
+    local test_in=$1
+    local test_name name flags expected
+    test_name=$(basename "$test_in" .in)
+    for name in "${engines[@]}"; do
+        for flags in "${FLAG_SETS[@]}"; do
+            expected="$TEST_DIR/$test_name.out"
+            if [[ " $flags " != *" $PASS "* && -e "$TEST_DIR/$test_name.plain.out" ]]; then
+                [ "$name" = llvm ] && continue
+                expected="$TEST_DIR/$test_name.plain.out"
+            fi
+            engine "$name" $flags < "$test_in" > "$work/result" 2>&1
+            if ! diff -q "$work/result" "$expected" > /dev/null; then
+                echo "$test_name ($name $flags): FAILED"
+                ((failed++))
+            fi
+        done
+    done
+}
+
+run_suite() {
+    local test_in
+    for test_in in "$TEST_DIR"/*.in; do
+        check_report "$test_in"
+        check_output "$test_in"
+    done
+    echo "Failed: $failed"
+    exit $failed
+}
@@ -0,0 +1,36 @@
+#!/bin/bash
+# Checks the editor queries: each line of the queries file is run as hw3's arguments on
+# program.in, and the outputs, each under a "$ arguments" line, must match program.out. Flags
+# that would run after the query, or a mode of their own, must be refused with it.
+#
+#   tests/query/run.sh                # from the repository root, after make
+#   HW3=/path/to/hw3 tests/query/run.sh
+
+HW3=${HW3:-./hw3}
+HW3=$(cd "$(dirname "$HW3")" && pwd)/$(basename "$HW3")
+TEST_DIR=$(dirname "$0")
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+while read -r query; do
+    echo "\$ $query"
+    "$HW3" $query < "$TEST_DIR/program.in" 2>&1
+done < "$TEST_DIR/queries" > "$work/result"
+if ! diff -q "$work/result" "$TEST_DIR/program.out" > /dev/null; then
+    echo "queries: FAILED"
+    ((failed++))
+fi
+
+for flags in --incremental --stream --tce --inline --fold --simplify --dce --licm --bce --vectorize --warnings \
+             --dump-format=json --run --jit --emit-llvm "--emit-object $work/program.o" --dump-ssa --ssa-stats \
+             "--resolve 9:y"; do
+    (cd "$work" && "$HW3" --check-function main $flags < "$OLDPWD/$TEST_DIR/program.in" > "$work/result" 2>&1)
+    if [ $? != 1 ] || [ -e "$work/program.o" ] || [ -e "$work/.hw3cache" ] || grep -qv '^ \|^usage' "$work/result"; then
+        echo "--check-function main $flags: FAILED, not refused"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
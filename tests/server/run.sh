@@ -0,0 +1,73 @@
+#!/bin/bash
+# Checks the compile server: hw3 --serve is started on a socket, every tests/*.in program is sent
+# to it at once through hw3 --connect, and each reply must be exactly what a plain run prints. A
+# request larger than the server accepts must be refused without stopping it, and SIGTERM must
+# stop it cleanly: exit status 0, the socket removed and the --trace file written.
+#
+#   tests/server/run.sh               # from the repository root, after make
+#   HW3=/path/to/hw3 tests/server/run.sh
+
+HW3=${HW3:-./hw3}
+TEST_DIR=$(dirname "$0")
+failed=0
+work=$(mktemp -d)
+socket="$work/hw3.sock"
+trap 'kill $server 2> /dev/null; rm -rf "$work"' EXIT
+
+"$HW3" --serve "$socket" --jobs=4 --trace "$work/trace.json" 2> "$work/server.err" &
+server=$!
+for i in $(seq 50); do
+    [ -S "$socket" ] && break
+    sleep 0.1
+done
+
+pids=()
+for test_in in "$TEST_DIR"/../*.in; do
+    test_name=$(basename "$test_in" .in)
+    "$HW3" < "$test_in" > "$work/$test_name.plain" 2> /dev/null
+    "$HW3" --connect "$socket" < "$test_in" > "$work/$test_name.reply" 2>&1 &
+    pids+=($!)
+done
+for pid in "${pids[@]}"; do
+    wait $pid
+done
+for test_in in "$TEST_DIR"/../*.in; do
+    test_name=$(basename "$test_in" .in)
+    if ! cmp -s "$work/$test_name.reply" "$work/$test_name.plain"; then
+        echo "$test_name: FAILED"
+        ((failed++))
+    fi
+done
+
+# 16 MB is the most the server reads of one request
+head -c $((17 << 20)) /dev/zero | tr '\0' ' ' | "$HW3" --connect "$socket" > "$work/reply" 2> /dev/null
+if [ $? != 1 ] || [ -s "$work/reply" ]; then
+    echo "oversized request: FAILED, not refused"
+    ((failed++))
+fi
+"$HW3" --connect "$socket" < "$TEST_DIR/../t1.in" > "$work/reply" 2>&1
+if ! cmp -s "$work/reply" "$work/t1.plain"; then
+    echo "after the oversized request: FAILED"
+    ((failed++))
+fi
+
+kill -TERM $server
+wait $server
+status=$?
+if [ $status != 0 ] || [ -e "$socket" ] || ! grep -q '"traceEvents"' "$work/trace.json" 2> /dev/null; then
+    echo "shutdown: FAILED (status $status)"
+    ((failed++))
+fi
+
+for flags in "--connect $socket" --incremental --tce --inline --fold --simplify --dce --licm --bce --vectorize \
+             --warnings --dump-format=json --run --jit --emit-llvm "--emit-object $work/program.o" --dump-ssa \
+             --ssa-stats; do
+    "$HW3" --serve "$socket" $flags < /dev/null > "$work/result" 2>&1
+    if [ $? != 1 ] || [ -e "$socket" ] || grep -qv '^ \|^usage' "$work/result"; then
+        echo "--serve $flags: FAILED, not refused"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
@@ -0,0 +1,12 @@
+#!/bin/bash
+# Checks the algebraic simplifier: every program here must report the simplifications in its
+# .report file, and must print the same without and with --simplify (see tests/pass-suite.sh).
+#
+#   tests/simplify/run.sh             # from the repository root, after make
+#   HW3=/path/to/hw3 tests/simplify/run.sh
+
+TEST_DIR=$(dirname "$0")
+PASS=--simplify
+FLAG_SETS=("" "--simplify" "--fold --simplify")
+source "$TEST_DIR/../pass-suite.sh"
+run_suite
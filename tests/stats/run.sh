@@ -0,0 +1,65 @@
+#!/bin/bash
+# Checks hw3 --stats, which needs hw3 built with -DFANC_STATS (make stats); other builds must
+# refuse it, and the rest of this suite is skipped for them. Each NAME.stats here holds what
+# --stats reports for ../NAME.in apart from the timings: the counters and the AST node kinds,
+# so a lookup that stops being counted, or bookkeeping that starts to be, fails. The phase lines
+# and the JSON of --stats=FILE must have the expected fields, and the program's own output must
+# not change.
+#
+#   tests/stats/run.sh                # from the repository root, after make stats
+#   HW3=/path/to/hw3 tests/stats/run.sh
+
+HW3=${HW3:-./hw3}
+TEST_DIR=$(dirname "$0")
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+if "$HW3" --stats < /dev/null 2>&1 | grep -q "needs hw3 built with -DFANC_STATS"; then
+    "$HW3" --stats < "$TEST_DIR/../t1.in" > "$work/result" 2>&1
+    if [ $? != 1 ] || [ "$(wc -l < "$work/result")" != 1 ]; then
+        echo "--stats without FANC_STATS: FAILED, not refused"
+        ((failed++))
+    fi
+    echo "skipped: not a FANC_STATS build"
+    echo "Failed: $failed"
+    exit $failed
+fi
+
+phase='^stats: [a-z]+ +[0-9]+\.[0-9]{3} ms wall'
+for expected in "$TEST_DIR"/*.stats; do
+    test_name=$(basename "$expected" .stats)
+    test_in="$TEST_DIR/../$test_name.in"
+    "$HW3" --stats < "$test_in" > "$work/result" 2> "$work/stats"
+    "$HW3" < "$test_in" > "$work/plain" 2> /dev/null
+    if ! cmp -s "$work/result" "$work/plain"; then
+        echo "$test_name (output): FAILED"
+        ((failed++))
+    fi
+    grep '^stats:' "$work/stats" | grep -Ev "$phase" > "$work/counters"
+    if ! diff -q "$work/counters" "$expected" > /dev/null; then
+        echo "$test_name (counters): FAILED"
+        ((failed++))
+    fi
+    # lexing has no CPU time or RSS of its own, see stats.hpp
+    grep -E "$phase" "$work/stats" | sed -E 's/[0-9]+(\.[0-9]+)?/N/g' > "$work/phases"
+    printf '%s\n' "stats: lex N ms wall" \
+                  "stats: parse N ms wall N ms cpu, peak rss so far N KB" \
+                  "stats: semantic N ms wall N ms cpu, peak rss so far N KB" \
+                  "stats: output N ms wall N ms cpu, peak rss so far N KB" > "$work/expected"
+    if ! diff -q <(tr -s ' ' < "$work/phases") "$work/expected" > /dev/null; then
+        echo "$test_name (phases): FAILED"
+        ((failed++))
+    fi
+
+    "$HW3" --stats="$work/stats.json" < "$test_in" > /dev/null 2>&1
+    counters=$(sed -n 's/^stats: tokens \([0-9]*\), symbol lookups \([0-9]*\), scope pushes \([0-9]*\), scope pops \([0-9]*\), diagnostics \([0-9]*\)$/"tokens":\1,"symbol_lookups":\2,"scope_pushes":\3,"scope_pops":\4,"diagnostics":\5/p' "$expected")
+    if ! grep -q "\"counters\":{$counters}" "$work/stats.json" 2> /dev/null ||
+       [ "$(grep -o '"peak_rss_so_far_kb":[0-9]*' "$work/stats.json" | wc -l)" != 3 ]; then
+        echo "$test_name (json): FAILED"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
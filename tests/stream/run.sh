@@ -0,0 +1,41 @@
+#!/bin/bash
+# Checks that --stream prints exactly what a plain run prints: every program here and every
+# tests/*.in program is checked with --stream, once from the file itself and once through a
+# pipe, which is first copied to a temporary file, and both must match the .out file. Flags that
+# need the whole tree, or a mode of their own, must be refused with it.
+#
+#   tests/stream/run.sh               # from the repository root, after make
+#   HW3=/path/to/hw3 tests/stream/run.sh
+
+HW3=${HW3:-./hw3}
+HW3=$(cd "$(dirname "$HW3")" && pwd)/$(basename "$HW3")
+TEST_DIR=$(dirname "$0")
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+for test_in in "$TEST_DIR"/*.in "$TEST_DIR"/../*.in; do
+    test_name=$(basename "$test_in" .in)
+    test_out="${test_in%.in}.out"
+    "$HW3" --stream < "$test_in" > "$work/file" 2>&1
+    cat "$test_in" | "$HW3" --stream > "$work/pipe" 2>&1
+    for input in file pipe; do
+        if ! diff -q "$work/$input" "$test_out" > /dev/null; then
+            echo "$test_name ($input): FAILED"
+            ((failed++))
+        fi
+    done
+done
+
+for flags in --incremental --tce --inline --fold --simplify --dce --licm --bce --vectorize --warnings \
+             --dump-format=json --run --jit --emit-llvm "--emit-object $work/program.o" --dump-ssa --ssa-stats \
+             "--check-function main" "--resolve 1:main"; do
+    (cd "$work" && "$HW3" --stream $flags < "$OLDPWD/$TEST_DIR/forward-call.in" > "$work/result" 2>&1)
+    if [ $? != 1 ] || [ -e "$work/program.o" ] || [ -e "$work/.hw3cache" ] || grep -qv '^ \|^usage' "$work/result"; then
+        echo "--stream $flags: FAILED, not refused"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
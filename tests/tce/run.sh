@@ -0,0 +1,13 @@
+#!/bin/bash
+# Checks tail-call elimination: every program here must report the calls eliminated in its
+# .report file, and must print the same without and with --tce (see tests/pass-suite.sh), but
+# for deep.in, whose recursion only fits in the stack once its tail calls are loops.
+#
+#   tests/tce/run.sh                  # from the repository root, after make
+#   HW3=/path/to/hw3 tests/tce/run.sh
+
+TEST_DIR=$(dirname "$0")
+PASS=--tce
+FLAG_SETS=("" "--tce" "--tce --inline")
+source "$TEST_DIR/../pass-suite.sh"
+run_suite
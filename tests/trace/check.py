@@ -0,0 +1,38 @@
+# Used by tests/trace/run.sh: checks that a --trace file is a valid Chrome trace and prints its
+# spans, one "thread: category name" line each, sorted, for run.sh to compare.
+#   - it must parse as JSON, with every event a thread_name record ("M") or a complete span ("X")
+#     with every field the viewers need and a duration that is not negative
+#   - every thread with spans must be named
+#   - the spans of a thread must nest: each one begins and ends within the span it begins in
+import json
+import sys
+
+EPSILON = 0.002  # times are written in microseconds with three decimals
+
+with open(sys.argv[1]) as file:
+    trace = json.load(file)
+
+names = {}
+spans = {}
+for event in trace["traceEvents"]:
+    if event["ph"] == "M":
+        assert event["name"] == "thread_name", event
+        names[event["tid"]] = event["args"]["name"]
+    else:
+        assert event["ph"] == "X", event
+        assert isinstance(event["name"], str) and isinstance(event["cat"], str), event
+        assert event["pid"] == 1 and event["dur"] >= 0 and event["ts"] >= 0, event
+        spans.setdefault(event["tid"], []).append(event)
+
+lines = []
+for tid, events in spans.items():
+    assert tid in names, "thread %d has no name" % tid
+    open_ends = []
+    for event in sorted(events, key=lambda event: (event["ts"], -event["dur"])):
+        while open_ends and open_ends[-1] <= event["ts"] + EPSILON:
+            open_ends.pop()
+        end = event["ts"] + event["dur"]
+        assert not open_ends or end <= open_ends[-1] + EPSILON, "span %s overlaps its parent" % event
+        open_ends.append(end)
+        lines.append("%s: %s %s" % (names[tid], event["cat"], event["name"]))
+print("\n".join(sorted(lines)))
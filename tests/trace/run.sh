@@ -0,0 +1,43 @@
+#!/bin/bash
+# Checks hw3 --trace: every trace written must be a valid Chrome trace whose spans nest on each
+# thread (see check.py), and must hold the spans in the .spans file of its case:
+#   - program.spans: program.in checked with passes and run, on one thread
+#   - batch.spans: a batch of files on several workers, one of them named with characters JSON
+#     must escape; main and the workers take the files in any order, so only the file spans are
+#     compared, whatever thread they are on
+# Needs python3, and is skipped without it.
+#
+#   tests/trace/run.sh                # from the repository root, after make
+#   HW3=/path/to/hw3 tests/trace/run.sh
+
+HW3=${HW3:-./hw3}
+HW3=$(cd "$(dirname "$HW3")" && pwd)/$(basename "$HW3")
+TEST_DIR=$(cd "$(dirname "$0")" && pwd)
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+if ! command -v python3 > /dev/null; then
+    echo "skipped: no python3"
+    echo "Failed: 0"
+    exit 0
+fi
+
+"$HW3" --trace "$work/program.json" --fold --dce --run < "$TEST_DIR/program.in" > /dev/null 2>&1
+if ! python3 "$TEST_DIR/check.py" "$work/program.json" > "$work/spans" ||
+   ! diff -q "$work/spans" "$TEST_DIR/program.spans" > /dev/null; then
+    echo "program: FAILED"
+    ((failed++))
+fi
+
+cp "$TEST_DIR/program.in" "$work/plain.in"
+cp "$TEST_DIR/program.in" "$work/quote\"back\\slash	tab.in"
+(cd "$work" && "$HW3" --batch --jobs=3 --trace "$work/batch.json" plain.in "quote\"back\\slash	tab.in" > /dev/null 2>&1)
+if ! python3 "$TEST_DIR/check.py" "$work/batch.json" > "$work/spans" ||
+   ! grep ' file ' "$work/spans" | sed 's/^[^:]*:/thread:/' | diff -q - "$TEST_DIR/batch.spans" > /dev/null; then
+    echo "batch: FAILED"
+    ((failed++))
+fi
+
+echo "Failed: $failed"
+exit $failed
@@ -0,0 +1,12 @@
+#!/bin/bash
+# Checks the loop vectorizer: every program here must report the loops vectorized in its .report
+# file, and must print the same without and with --vectorize (see tests/pass-suite.sh).
+#
+#   tests/vectorize/run.sh            # from the repository root, after make
+#   HW3=/path/to/hw3 tests/vectorize/run.sh
+
+TEST_DIR=$(dirname "$0")
+PASS=--vectorize
+FLAG_SETS=("" "--vectorize" "--bce --vectorize")
+source "$TEST_DIR/../pass-suite.sh"
+run_suite
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Checks the flow warnings of --warnings: for every program here, the warnings hw3 prints on
+# stderr must match the .out file, and the scope dump on stdout must be the one a run without
+# --warnings prints.
+#
+#   tests/warnings/run.sh             # from the repository root, after make
+#   HW3=/path/to/hw3 tests/warnings/run.sh
+
+HW3=${HW3:-./hw3}
+TEST_DIR=$(dirname "$0")
+failed=0
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+for test_in in "$TEST_DIR"/*.in; do
+    test_name=$(basename "$test_in" .in)
+    "$HW3" --warnings < "$test_in" > "$work/dump" 2> "$work/warnings"
+    "$HW3" < "$test_in" > "$work/plain" 2> /dev/null
+    if ! diff -q "$work/warnings" "$TEST_DIR/$test_name.out" > /dev/null || ! cmp -s "$work/dump" "$work/plain"; then
+        echo "$test_name: FAILED"
+        ((failed++))
+    fi
+done
+
+echo "Failed: $failed"
+exit $failed
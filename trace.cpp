@@ -0,0 +1,128 @@
+#include "trace.hpp"
+#include "output.hpp"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+    namespace {
+        struct Event {
+            std::string name;
+            const char *category;
+            // Nanoseconds since the recorder started
+            long long start;
+            long long duration;
+        };
+
+        // Events of one thread, only ever touched by that thread until the trace is written
+        struct ThreadBuffer {
+            int tid;
+            std::string name;
+            std::vector<Event> events;
+        };
+    }
+
+    static std::atomic<bool> recording(false);
+    static std::chrono::steady_clock::time_point origin;
+    static std::mutex registryLock;
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    static thread_local ThreadBuffer *threadBuffer = nullptr;
+
+    static ThreadBuffer &localBuffer() {
+        if (!threadBuffer) {
+            std::lock_guard<std::mutex> guard(registryLock);
+            buffers.push_back(std::make_unique<ThreadBuffer>());
+            threadBuffer = buffers.back().get();
+            threadBuffer->tid = static_cast<int>(buffers.size());
+            threadBuffer->name = threadBuffer->tid == 1 ? "main" : "thread " + std::to_string(threadBuffer->tid);
+            threadBuffer->events.reserve(1024);
+        }
+        return *threadBuffer;
+    }
+
+    static long long nanos(std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+
+    // Trace times are in microseconds; fractions keep short spans apart
+    static void writeMicros(std::ostream &os, long long nanos) {
+        char text[32];
+        snprintf(text, sizeof(text), "%lld.%03lld", nanos / 1000, nanos % 1000);
+        os << text;
+    }
+
+    static void writeString(std::ostream &os, const std::string &text) {
+        std::string quoted;
+        output::appendJsonString(quoted, text);
+        os << quoted;
+    }
+
+    bool enabled() {
+        return recording.load(std::memory_order_relaxed);
+    }
+
+    void nameThread(const std::string &name) {
+        if (enabled()) {
+            localBuffer().name = name;
+        }
+    }
+
+    Span::Span(const char *name, const char *category) : active(enabled()), category(category) {
+        if (active) {
+            this->name = name;
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    Span::Span(const std::string &name, const char *category) : active(enabled()), category(category) {
+        if (active) {
+            this->name = name;
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    Span::~Span() {
+        if (active) {
+            auto end = std::chrono::steady_clock::now();
+            localBuffer().events.push_back({std::move(name), category, nanos(start - origin), nanos(end - start)});
+        }
+    }
+
+    Recorder::Recorder(std::string path) : path(std::move(path)) {
+        origin = std::chrono::steady_clock::now();
+        recording = true;
+        // the thread that starts recording comes first, as "main"
+        localBuffer();
+    }
+
+    Recorder::~Recorder() {
+        recording = false;
+        std::ofstream out(path);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        const char *separator = "\n";
+        for (const auto &buffer : buffers) {
+            out << separator << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":";
+            writeString(out, buffer->name);
+            out << "}}";
+            separator = ",\n";
+            for (const auto &event : buffer->events) {
+                out << separator << "{\"ph\":\"X\",\"name\":";
+                writeString(out, event.name);
+                out << ",\"cat\":\"" << event.category << "\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":";
+                writeMicros(out, event.start);
+                out << ",\"dur\":";
+                writeMicros(out, event.duration);
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+        if (!out) {
+            std::cerr << "cannot write " << path << std::endl;
+        }
+    }
+}
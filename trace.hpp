@@ -0,0 +1,64 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <string>
+
+/* Trace-event timeline for hw3 --trace FILE
+ * Spans of the compilation phases and of every function checked, written as a Chrome trace
+ * (chrome://tracing, or ui.perfetto.dev) when the Recorder started by main goes away. Each
+ * thread that records gets its own track.
+ *
+ *     trace::Span span("semantic", "phase");
+ *
+ * Every thread appends to a buffer of its own, so recording takes no lock; a thread takes the
+ * registry lock once, for its first event. When tracing is off, a Span only reads one flag.
+ */
+namespace trace {
+    // Whether a Recorder is running
+    bool enabled();
+
+    // Names the track of the calling thread
+    void nameThread(const std::string &name);
+
+    /* Span class
+     * Records a complete event from its construction to its destruction on the calling
+     * thread's track. The category groups spans in the viewer: "phase", "pass", "function"...
+     */
+    class Span {
+    private:
+        bool active;
+        std::string name;
+        const char *category;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        Span(const char *name, const char *category);
+        Span(const std::string &name, const char *category);
+        ~Span();
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+        // Changes the category, for spans that turn out to be of another kind once started
+        void setCategory(const char *newCategory) { category = newCategory; }
+    };
+
+    /* Recorder class
+     * Turns tracing on for its lifetime and writes every recorded event to path when it goes
+     * away; threads that recorded must have finished by then.
+     */
+    class Recorder {
+    private:
+        std::string path;
+
+    public:
+        explicit Recorder(std::string path);
+        ~Recorder();
+
+        Recorder(const Recorder &) = delete;
+        Recorder &operator=(const Recorder &) = delete;
+    };
+}
+
+#endif //TRACE_HPP
@@ -0,0 +1,177 @@
+#include "vectorize.hpp"
+
+LoopVectorizer::LoopVectorizer() : function(nullptr), loopCount(0), vectorizedCount(0) {}
+
+/* Helpers */
+
+bool LoopVectorizer::_isCounter(const ast::Exp &exp, int counter) {
+    auto id = dynamic_cast<const ast::ID *>(&exp);
+    return id && !id->computedIsArray && id->computedOffset == counter;
+}
+
+bool LoopVectorizer::_vectorizable(const ast::While &node) const {
+    // i < n or i <= n, with an int i and a literal or variable n
+    auto condition = dynamic_cast<const ast::RelOp *>(node.condition.get());
+    if (!condition || (condition->op != ast::RelOpType::LT && condition->op != ast::RelOpType::LE)) {
+        return false;
+    }
+    auto counterId = dynamic_cast<const ast::ID *>(condition->left.get());
+    if (!counterId || counterId->computedIsArray || counterId->computedType != ast::BuiltInType::INT) {
+        return false;
+    }
+    int counter = counterId->computedOffset;
+    auto boundId = dynamic_cast<const ast::ID *>(condition->right.get());
+    bool literal = dynamic_cast<const ast::Num *>(condition->right.get()) ||
+                   dynamic_cast<const ast::NumB *>(condition->right.get());
+    if (!literal && (!boundId || boundId->computedIsArray || boundId->computedOffset == counter)) {
+        return false;
+    }
+
+    auto block = dynamic_cast<const ast::Block *>(node.body.get());
+    if (!block || block->statements->statements.size() < 2) {
+        return false;
+    }
+    const auto &statements = block->statements->statements;
+
+    // i = i + 1 or i = 1 + i, last
+    auto step = dynamic_cast<const ast::Assign *>(statements.back().get());
+    if (!step || step->id->computedOffset != counter) {
+        return false;
+    }
+    auto sum = dynamic_cast<const ast::BinOp *>(step->exp.get());
+    if (!sum || sum->op != ast::BinOpType::ADD) {
+        return false;
+    }
+    auto one = dynamic_cast<const ast::Num *>(sum->right.get());
+    const ast::Exp *other = sum->left.get();
+    if (!one) {
+        one = dynamic_cast<const ast::Num *>(sum->left.get());
+        other = sum->right.get();
+    }
+    if (!one || one->value != 1 || !_isCounter(*other, counter)) {
+        return false;
+    }
+
+    // everything before it stores to an array at the counter
+    for (size_t i = 0; i + 1 < statements.size(); i++) {
+        auto store = dynamic_cast<const ast::ArrayAssign *>(statements[i].get());
+        if (!store || !_isCounter(*store->index, counter) || !_lanes(*store->exp, counter)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LoopVectorizer::_lanes(const ast::Exp &exp, int counter) const {
+    if (dynamic_cast<const ast::Num *>(&exp) || dynamic_cast<const ast::NumB *>(&exp)) {
+        return true;
+    }
+    if (auto id = dynamic_cast<const ast::ID *>(&exp)) {
+        return !id->computedIsArray;
+    }
+    if (auto element = dynamic_cast<const ast::ArrayDereference *>(&exp)) {
+        return _isCounter(*element->index, counter);
+    }
+    if (auto binOp = dynamic_cast<const ast::BinOp *>(&exp)) {
+        return binOp->op != ast::BinOpType::DIV && _lanes(*binOp->left, counter) && _lanes(*binOp->right, counter);
+    }
+    if (auto cast = dynamic_cast<const ast::Cast *>(&exp)) {
+        return _lanes(*cast->exp, counter);
+    }
+    return false;
+}
+
+/* Expressions */
+
+void LoopVectorizer::visit(ast::Num &node) {}
+
+void LoopVectorizer::visit(ast::NumB &node) {}
+
+void LoopVectorizer::visit(ast::String &node) {}
+
+void LoopVectorizer::visit(ast::Bool &node) {}
+
+void LoopVectorizer::visit(ast::ID &node) {}
+
+void LoopVectorizer::visit(ast::BinOp &node) {}
+
+void LoopVectorizer::visit(ast::RelOp &node) {}
+
+void LoopVectorizer::visit(ast::Not &node) {}
+
+void LoopVectorizer::visit(ast::And &node) {}
+
+void LoopVectorizer::visit(ast::Or &node) {}
+
+void LoopVectorizer::visit(ast::Cast &node) {}
+
+void LoopVectorizer::visit(ast::ArrayDereference &node) {}
+
+void LoopVectorizer::visit(ast::ExpList &node) {}
+
+void LoopVectorizer::visit(ast::Call &node) {}
+
+/* Types */
+
+void LoopVectorizer::visit(ast::ArrayType &node) {}
+
+void LoopVectorizer::visit(ast::PrimitiveType &node) {}
+
+/* Statements */
+
+void LoopVectorizer::visit(ast::ArrayAssign &node) {}
+
+void LoopVectorizer::visit(ast::Statements &node) {
+    for (auto &statement : node.statements) {
+        statement->accept(*this);
+    }
+}
+
+void LoopVectorizer::visit(ast::Block &node) {
+    node.statements->accept(*this);
+}
+
+void LoopVectorizer::visit(ast::Break &node) {}
+
+void LoopVectorizer::visit(ast::Continue &node) {}
+
+void LoopVectorizer::visit(ast::Return &node) {}
+
+void LoopVectorizer::visit(ast::If &node) {
+    node.then->accept(*this);
+    if (node.otherwise) {
+        node.otherwise->accept(*this);
+    }
+}
+
+void LoopVectorizer::visit(ast::While &node) {
+    loopCount++;
+    node.computedVectorizable = _vectorizable(node);
+    if (node.computedVectorizable) {
+        vectorizedCount++;
+        if (perFunction.empty() || perFunction.back().first != function->id->value) {
+            perFunction.emplace_back(function->id->value, 0);
+        }
+        perFunction.back().second++;
+    }
+    node.body->accept(*this);
+}
+
+void LoopVectorizer::visit(ast::VarDecl &node) {}
+
+void LoopVectorizer::visit(ast::Assign &node) {}
+
+void LoopVectorizer::visit(ast::Formal &node) {}
+
+void LoopVectorizer::visit(ast::Formals &node) {}
+
+void LoopVectorizer::visit(ast::FuncDecl &node) {
+    function = &node;
+    node.body->accept(*this);
+}
+
+void LoopVectorizer::visit(ast::Funcs &node) {
+    for (auto &func : node.funcs) {
+        func->accept(*this);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef VECTORIZE_HPP
+#define VECTORIZE_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* LoopVectorizer class
+ * Finds the While loops of a checked tree that can run several iterations at a time and sets
+ * computedVectorizable on them; the backends then run whole vectors of iterations before the
+ * loop and let the loop itself finish the rest. A loop qualifies when it counts an int up by one
+ * to a literal or a variable and its body only stores to arrays at the counter:
+ *
+ *     while (i < n) {
+ *         a[i] = b[i] * k + c[i];
+ *         i = i + 1;
+ *     }
+ *
+ * The stored values may use array elements at the counter, the counter itself, variables and
+ * literals, combined with +, - and * and casts; no division, since it can trap, and no calls.
+ * Every access is then at the current index, so no iteration reads what another one writes, and
+ * the only variable that changes is the counter, so all the others are the same in every lane.
+ * Whether the counter stays within the arrays is left to the backends, which check the whole
+ * range once before running the vectors.
+ */
+class LoopVectorizer : public Visitor {
+private:
+    const ast::FuncDecl *function;
+    int loopCount;
+    int vectorizedCount;
+    std::vector<std::pair<std::string, int>> perFunction;
+
+    bool _vectorizable(const ast::While &node) const;
+    // Whether every lane can compute `exp` for its own iteration
+    bool _lanes(const ast::Exp &exp, int counter) const;
+    static bool _isCounter(const ast::Exp &exp, int counter);
+
+public:
+    LoopVectorizer();
+
+    // Number of loops in the whole program, and how many of them were vectorized
+    int loops() const { return loopCount; }
+    int loopsVectorized() const { return vectorizedCount; }
+
+    // Functions with vectorized loops, in source order, and how many each
+    const std::vector<std::pair<std::string, int>> &vectorizedPerFunction() const { return perFunction; }
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+#endif //VECTORIZE_HPP
@@ -0,0 +1,500 @@
+#include "vm.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <charconv>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace bytecode {
+    // Buffered output is written out once it grows past this
+    static const size_t flushThreshold = 1 << 16;
+    // Iterations of a vector loop run per pass over its body, a multiple of every lane width
+    static const int strip = 256;
+
+    /* Lane kernels */
+
+#if defined(__x86_64__)
+    // SSE2 has no 32-bit multiply: multiply the even and the odd lanes to 64 bits and keep the
+    // low halves
+    static inline __m128i multiplySse2(__m128i x, __m128i y) {
+        __m128i even = _mm_mul_epu32(x, y);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    static void lanesSse2(VectorOpcode op, int32_t *out, const int32_t *x, const int32_t *y, int count) {
+#define LOAD(from) _mm_loadu_si128(reinterpret_cast<const __m128i *>(from))
+#define STORE(to, value) _mm_storeu_si128(reinterpret_cast<__m128i *>(to), value)
+        switch (op) {
+            case VADD:
+                for (int k = 0; k < count; k += 4) STORE(out + k, _mm_add_epi32(LOAD(x + k), LOAD(y + k)));
+                break;
+            case VSUB:
+                for (int k = 0; k < count; k += 4) STORE(out + k, _mm_sub_epi32(LOAD(x + k), LOAD(y + k)));
+                break;
+            case VMUL:
+                for (int k = 0; k < count; k += 4) STORE(out + k, multiplySse2(LOAD(x + k), LOAD(y + k)));
+                break;
+            default: {
+                __m128i mask = _mm_set1_epi32(0xFF);
+                for (int k = 0; k < count; k += 4) STORE(out + k, _mm_and_si128(LOAD(x + k), mask));
+                break;
+            }
+        }
+#undef STORE
+#undef LOAD
+    }
+
+    // The AVX2 intrinsics are only available in a function compiled for AVX2
+    __attribute__((target("avx2")))
+    static void lanesAvx2(VectorOpcode op, int32_t *out, const int32_t *x, const int32_t *y, int count) {
+#define LOAD(from) _mm256_loadu_si256(reinterpret_cast<const __m256i *>(from))
+#define STORE(to, value) _mm256_storeu_si256(reinterpret_cast<__m256i *>(to), value)
+        switch (op) {
+            case VADD:
+                for (int k = 0; k < count; k += 8) STORE(out + k, _mm256_add_epi32(LOAD(x + k), LOAD(y + k)));
+                break;
+            case VSUB:
+                for (int k = 0; k < count; k += 8) STORE(out + k, _mm256_sub_epi32(LOAD(x + k), LOAD(y + k)));
+                break;
+            case VMUL:
+                for (int k = 0; k < count; k += 8) STORE(out + k, _mm256_mullo_epi32(LOAD(x + k), LOAD(y + k)));
+                break;
+            default: {
+                __m256i mask = _mm256_set1_epi32(0xFF);
+                for (int k = 0; k < count; k += 8) STORE(out + k, _mm256_and_si256(LOAD(x + k), mask));
+                break;
+            }
+        }
+#undef STORE
+#undef LOAD
+    }
+#else
+    static void lanesPortable(VectorOpcode op, int32_t *out, const int32_t *x, const int32_t *y, int count) {
+        for (int k = 0; k < count; ++k) {
+            uint32_t left = static_cast<uint32_t>(x[k]);
+            switch (op) {
+                case VADD:
+                    out[k] = static_cast<int32_t>(left + static_cast<uint32_t>(y[k]));
+                    break;
+                case VSUB:
+                    out[k] = static_cast<int32_t>(left - static_cast<uint32_t>(y[k]));
+                    break;
+                case VMUL:
+                    out[k] = static_cast<int32_t>(left * static_cast<uint32_t>(y[k]));
+                    break;
+                default:
+                    out[k] = x[k] & 0xFF;
+                    break;
+            }
+        }
+    }
+#endif
+
+    /* VirtualMachine class */
+
+    VirtualMachine::VirtualMachine(const Program &program, int fd, size_t capacity)
+            : program(program), registers(new int32_t[capacity]), capacity(capacity), fd(fd) {
+        output.reserve(2 * flushThreshold);
+
+        size_t most = 0;
+        for (const auto &loop : program.loops) {
+            most = std::max(most, static_cast<size_t>(loop.vectors));
+        }
+        lanes.resize(most * strip);
+        vectors.resize(most);
+#if defined(__x86_64__)
+        bool avx2 = __builtin_cpu_supports("avx2");
+        laneWidth = avx2 ? 8 : 4;
+        kernel = avx2 ? lanesAvx2 : lanesSse2;
+#else
+        laneWidth = 4;
+        kernel = lanesPortable;
+#endif
+    }
+
+    VirtualMachine::~VirtualMachine() {
+        _flush();
+    }
+
+    void VirtualMachine::_flush() {
+        const char *data = output.data();
+        size_t size = output.size();
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            data += written;
+            size -= written;
+        }
+        output.clear();
+    }
+
+    int VirtualMachine::_trap(const char *message) {
+        output += message;
+        output += '\n';
+        _flush();
+        return 1;
+    }
+
+    void VirtualMachine::_vectorLoop(const VectorLoop &loop, int32_t *r) {
+        int64_t begin = r[loop.counter];
+        int64_t end = loop.immediate ? loop.bound : r[loop.bound];
+        if (loop.inclusive) {
+            end++;
+        }
+        // the loop itself runs up to the access that traps
+        if (begin < 0 || end > loop.length || end - begin < laneWidth) {
+            return;
+        }
+
+        int64_t stop = begin + (end - begin) / laneWidth * laneWidth;
+        for (int64_t first = begin; first < stop; first += strip) {
+            int count = static_cast<int>(std::min<int64_t>(strip, stop - first));
+            for (const VectorInstr &instr : loop.body) {
+                int32_t *own = lanes.data() + static_cast<size_t>(instr.a) * strip;
+                switch (instr.op) {
+                    case VLOAD:
+                        vectors[instr.a] = r + instr.b + first;
+                        continue;
+                    case VSTORE:
+                        // a value loaded from the same array is stored onto itself
+                        memmove(r + instr.b + first, vectors[instr.a], count * sizeof(int32_t));
+                        continue;
+                    case VSPLAT:
+                    case VSPLATK:
+                        std::fill(own, own + count, instr.op == VSPLAT ? r[instr.b] : instr.b);
+                        break;
+                    case VINDEX:
+                        for (int k = 0; k < count; ++k) {
+                            own[k] = static_cast<int32_t>(first + k);
+                        }
+                        break;
+                    default:
+                        kernel(instr.op, own, vectors[instr.b], vectors[instr.c], count);
+                        break;
+                }
+                vectors[instr.a] = own;
+            }
+        }
+        r[loop.counter] = static_cast<int32_t>(stop);
+    }
+
+    int VirtualMachine::run() {
+        static void *dispatch[OPCODE_COUNT] = {
+                &&op_LOADK,
+                &&op_MOV,
+                &&op_ADD,
+                &&op_SUB,
+                &&op_MUL,
+                &&op_DIV,
+                &&op_ADDB,
+                &&op_SUBB,
+                &&op_MULB,
+                &&op_DIVB,
+                &&op_ADDI,
+                &&op_SUBI,
+                &&op_SHLI,
+                &&op_SHLBI,
+                &&op_SHRI,
+                &&op_TRUNCB,
+                &&op_NOT,
+                &&op_EQ,
+                &&op_NE,
+                &&op_LT,
+                &&op_LE,
+                &&op_GT,
+                &&op_GE,
+                &&op_JMP,
+                &&op_JZ,
+                &&op_JNZ,
+                &&op_JEQ,
+                &&op_JNE,
+                &&op_JLT,
+                &&op_JLE,
+                &&op_JGT,
+                &&op_JGE,
+                &&op_JEQI,
+                &&op_JNEI,
+                &&op_JLTI,
+                &&op_JLEI,
+                &&op_JGTI,
+                &&op_JGEI,
+                &&op_ALOAD,
+                &&op_ASTORE,
+                &&op_ALOADU,
+                &&op_ASTOREU,
+                &&op_ZERO,
+                &&op_CALL,
+                &&op_RET,
+                &&op_RETV,
+                &&op_PRINT,
+                &&op_PRINTI,
+                &&op_VLOOP
+        };
+
+        struct Frame {
+            const Instr *returnPc;
+            int32_t *base;
+            int32_t result;
+        };
+        std::vector<Frame> frames;
+
+        const Instr *code = program.code.data();
+        const Function *functions = program.functions.data();
+        int32_t *limit = registers.get() + capacity;
+        int32_t *r = registers.get();
+        const Instr *pc = code + functions[program.main].entry;
+        if (functions[program.main].registers > static_cast<int>(capacity)) {
+            return _trap("Error stack overflow");
+        }
+
+// int arithmetic is done unsigned, so it wraps around instead of overflowing
+#define WRAP(a, op, b) static_cast<int32_t>(static_cast<uint32_t>(a) op static_cast<uint32_t>(b))
+#define DISPATCH() goto *dispatch[pc->op]
+#define NEXT() ++pc; DISPATCH()
+
+        DISPATCH();
+
+        op_LOADK:
+        r[pc->a] = pc->b;
+        NEXT();
+
+        op_MOV:
+        r[pc->a] = r[pc->b];
+        NEXT();
+
+        op_ADD:
+        r[pc->a] = WRAP(r[pc->b], +, r[pc->c]);
+        NEXT();
+
+        op_SUB:
+        r[pc->a] = WRAP(r[pc->b], -, r[pc->c]);
+        NEXT();
+
+        op_MUL:
+        r[pc->a] = WRAP(r[pc->b], *, r[pc->c]);
+        NEXT();
+
+        op_DIV: {
+            int32_t divisor = r[pc->c];
+            if (divisor == 0) {
+                return _trap("Error division by zero");
+            }
+            // INT_MIN / -1 wraps back to INT_MIN
+            r[pc->a] = divisor == -1 ? WRAP(0, -, r[pc->b]) : r[pc->b] / divisor;
+            NEXT();
+        }
+
+        op_ADDB:
+        r[pc->a] = (r[pc->b] + r[pc->c]) & 0xFF;
+        NEXT();
+
+        op_SUBB:
+        r[pc->a] = (r[pc->b] - r[pc->c]) & 0xFF;
+        NEXT();
+
+        op_MULB:
+        r[pc->a] = (r[pc->b] * r[pc->c]) & 0xFF;
+        NEXT();
+
+        op_DIVB:
+        if (r[pc->c] == 0) {
+            return _trap("Error division by zero");
+        }
+        r[pc->a] = static_cast<uint32_t>(r[pc->b]) / static_cast<uint32_t>(r[pc->c]);
+        NEXT();
+
+        op_ADDI:
+        r[pc->a] = WRAP(r[pc->b], +, pc->c);
+        NEXT();
+
+        op_SUBI:
+        r[pc->a] = WRAP(r[pc->b], -, pc->c);
+        NEXT();
+
+        op_SHLI:
+        r[pc->a] = WRAP(r[pc->b], <<, pc->c);
+        NEXT();
+
+        op_SHLBI:
+        r[pc->a] = (static_cast<uint32_t>(r[pc->b]) << pc->c) & 0xFF;
+        NEXT();
+
+        op_SHRI: {
+            // a negative dividend is biased by 2^c - 1, so the shift rounds toward zero
+            int32_t value = r[pc->b];
+            r[pc->a] = (value + ((value >> 31) & ((1 << pc->c) - 1))) >> pc->c;
+            NEXT();
+        }
+
+        op_TRUNCB:
+        r[pc->a] = r[pc->b] & 0xFF;
+        NEXT();
+
+        op_NOT:
+        r[pc->a] = !r[pc->b];
+        NEXT();
+
+        op_EQ:
+        r[pc->a] = r[pc->b] == r[pc->c];
+        NEXT();
+
+        op_NE:
+        r[pc->a] = r[pc->b] != r[pc->c];
+        NEXT();
+
+        op_LT:
+        r[pc->a] = r[pc->b] < r[pc->c];
+        NEXT();
+
+        op_LE:
+        r[pc->a] = r[pc->b] <= r[pc->c];
+        NEXT();
+
+        op_GT:
+        r[pc->a] = r[pc->b] > r[pc->c];
+        NEXT();
+
+        op_GE:
+        r[pc->a] = r[pc->b] >= r[pc->c];
+        NEXT();
+
+        op_JMP:
+        pc = code + pc->a;
+        DISPATCH();
+
+        op_JZ:
+        pc = r[pc->a] ? pc + 1 : code + pc->b;
+        DISPATCH();
+
+        op_JNZ:
+        pc = r[pc->a] ? code + pc->b : pc + 1;
+        DISPATCH();
+
+#define COMPARE_BRANCH(name, op, right) \
+        op_##name: \
+        pc = r[pc->a] op right ? code + pc->c : pc + 1; \
+        DISPATCH();
+
+        COMPARE_BRANCH(JEQ, ==, r[pc->b])
+        COMPARE_BRANCH(JNE, !=, r[pc->b])
+        COMPARE_BRANCH(JLT, <, r[pc->b])
+        COMPARE_BRANCH(JLE, <=, r[pc->b])
+        COMPARE_BRANCH(JGT, >, r[pc->b])
+        COMPARE_BRANCH(JGE, >=, r[pc->b])
+        COMPARE_BRANCH(JEQI, ==, pc->b)
+        COMPARE_BRANCH(JNEI, !=, pc->b)
+        COMPARE_BRANCH(JLTI, <, pc->b)
+        COMPARE_BRANCH(JLEI, <=, pc->b)
+        COMPARE_BRANCH(JGTI, >, pc->b)
+        COMPARE_BRANCH(JGEI, >=, pc->b)
+
+#undef COMPARE_BRANCH
+
+        op_ALOAD: {
+            // a negative index wraps to a huge unsigned one
+            uint32_t index = static_cast<uint32_t>(r[pc->c]);
+            if (index >= static_cast<uint32_t>(pc->d)) {
+                return _trap("Error out of bounds");
+            }
+            r[pc->a] = r[pc->b + index];
+            NEXT();
+        }
+
+        op_ASTORE: {
+            uint32_t index = static_cast<uint32_t>(r[pc->c]);
+            if (index >= static_cast<uint32_t>(pc->d)) {
+                return _trap("Error out of bounds");
+            }
+            r[pc->b + index] = r[pc->a];
+            NEXT();
+        }
+
+        op_ALOADU:
+        r[pc->a] = r[pc->b + r[pc->c]];
+        NEXT();
+
+        op_ASTOREU:
+        r[pc->b + r[pc->c]] = r[pc->a];
+        NEXT();
+
+        op_ZERO:
+        std::fill(r + pc->a, r + pc->a + pc->b, 0);
+        NEXT();
+
+        op_CALL: {
+            const Function &callee = functions[pc->b];
+            int32_t *base = r + pc->c;
+            // a function without registers still takes a frame
+            if (limit - base < callee.registers || frames.size() >= capacity / 16) {
+                return _trap("Error stack overflow");
+            }
+            frames.push_back({pc + 1, r, pc->a});
+            r = base;
+            pc = code + callee.entry;
+            DISPATCH();
+        }
+
+        op_RET: {
+            int32_t value = r[pc->a];
+            if (frames.empty()) {
+                return 0;
+            }
+            const Frame &frame = frames.back();
+            r = frame.base;
+            pc = frame.returnPc;
+            if (frame.result >= 0) {
+                r[frame.result] = value;
+            }
+            frames.pop_back();
+            DISPATCH();
+        }
+
+        op_RETV: {
+            if (frames.empty()) {
+                return 0;
+            }
+            const Frame &frame = frames.back();
+            r = frame.base;
+            pc = frame.returnPc;
+            frames.pop_back();
+            DISPATCH();
+        }
+
+        op_PRINT:
+        output += program.strings[pc->a];
+        output += '\n';
+        if (output.size() > flushThreshold) {
+            _flush();
+        }
+        NEXT();
+
+        op_PRINTI: {
+            char digits[16];
+            auto result = std::to_chars(digits, digits + sizeof(digits), r[pc->a]);
+            output.append(digits, result.ptr - digits);
+            output += '\n';
+            if (output.size() > flushThreshold) {
+                _flush();
+            }
+            NEXT();
+        }
+
+        op_VLOOP:
+        _vectorLoop(program.loops[pc->a], r);
+        NEXT();
+
+#undef NEXT
+#undef DISPATCH
+#undef WRAP
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef VM_HPP
+#define VM_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+
+namespace bytecode {
+    /* VirtualMachine class
+     * Runs a compiled Program from main. Dispatch is threaded through a table of label addresses
+     * (computed goto). Function register windows live on one preallocated register stack: a call
+     * places its arguments at the start of the callee's window, so no copying happens on entry.
+     * Output of print and printi is buffered and written to the file descriptor in large blocks.
+     * Division by zero, out of bounds array accesses and running out of register stack stop the
+     * program with an error line. Vector loops run a strip of iterations at a time, one
+     * instruction of their body over the whole strip before the next, with AVX2 where the
+     * processor has it and SSE2 otherwise.
+     */
+    class VirtualMachine {
+    public:
+        // Lane-wise VADD, VSUB, VMUL or VTRUNCB over `count` lanes, a multiple of the lane width
+        typedef void (*LaneKernel)(VectorOpcode op, int32_t *out, const int32_t *x, const int32_t *y, int count);
+
+    private:
+        const Program &program;
+        std::unique_ptr<int32_t[]> registers;
+        size_t capacity;
+        std::string output;
+        int fd;
+        // Lanes of the vector registers, a strip each, and where each register's lanes are: its
+        // own, or the array elements it loaded
+        std::vector<int32_t> lanes;
+        std::vector<const int32_t *> vectors;
+        int laneWidth;
+        LaneKernel kernel;
+
+        void _flush();
+        int _trap(const char *message);
+        // Runs the whole vectors of iterations of a vector loop, if they stay in bounds
+        void _vectorLoop(const VectorLoop &loop, int32_t *r);
+
+    public:
+        // The register stack holds `capacity` registers in total
+        explicit VirtualMachine(const Program &program, int fd = 1, size_t capacity = 1 << 24);
+
+        ~VirtualMachine();
+
+        // Runs main. Returns 0, or 1 if the program was stopped by a runtime error
+        int run();
+    };
+}
+
+#endif //VM_HPP
@@ -0,0 +1,191 @@
+#include "walker.hpp"
+
+void TreeWalker::visit(ast::Num &node) {
+    enter(node);
+}
+
+void TreeWalker::visit(ast::NumB &node) {
+    enter(node);
+}
+
+void TreeWalker::visit(ast::String &node) {
+    enter(node);
+}
+
+void TreeWalker::visit(ast::Bool &node) {
+    enter(node);
+}
+
+void TreeWalker::visit(ast::ID &node) {
+    enter(node);
+}
+
+void TreeWalker::visit(ast::BinOp &node) {
+    enter(node);
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void TreeWalker::visit(ast::RelOp &node) {
+    enter(node);
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void TreeWalker::visit(ast::Not &node) {
+    enter(node);
+    node.exp->accept(*this);
+}
+
+void TreeWalker::visit(ast::And &node) {
+    enter(node);
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void TreeWalker::visit(ast::Or &node) {
+    enter(node);
+    node.left->accept(*this);
+    node.right->accept(*this);
+}
+
+void TreeWalker::visit(ast::ArrayType &node) {
+    enter(node);
+    node.length->accept(*this);
+}
+
+void TreeWalker::visit(ast::PrimitiveType &node) {
+    enter(node);
+}
+
+void TreeWalker::visit(ast::ArrayDereference &node) {
+    enter(node);
+    node.id->accept(*this);
+    node.index->accept(*this);
+}
+
+void TreeWalker::visit(ast::ArrayAssign &node) {
+    enter(node);
+    node.id->accept(*this);
+    node.index->accept(*this);
+    node.exp->accept(*this);
+}
+
+void TreeWalker::visit(ast::Cast &node) {
+    enter(node);
+    node.target_type->accept(*this);
+    node.exp->accept(*this);
+}
+
+void TreeWalker::visit(ast::ExpList &node) {
+    enter(node);
+    for (auto &child : node.exps) {
+        child->accept(*this);
+    }
+}
+
+void TreeWalker::visit(ast::Call &node) {
+    enter(node);
+    node.func_id->accept(*this);
+    node.args->accept(*this);
+}
+
+void TreeWalker::visit(ast::Statements &node) {
+    enter(node);
+    for (auto &child : node.statements) {
+        child->accept(*this);
+    }
+}
+
+void TreeWalker::visit(ast::Block &node) {
+    enter(node);
+    node.statements->accept(*this);
+}
+
+void TreeWalker::visit(ast::Break &node) {
+    enter(node);
+}
+
+void TreeWalker::visit(ast::Continue &node) {
+    enter(node);
+}
+
+void TreeWalker::visit(ast::Return &node) {
+    enter(node);
+    if (node.exp) {
+        node.exp->accept(*this);
+    }
+}
+
+void TreeWalker::visit(ast::If &node) {
+    enter(node);
+    node.condition->accept(*this);
+    node.then->accept(*this);
+    if (node.otherwise) {
+        node.otherwise->accept(*this);
+    }
+}
+
+void TreeWalker::visit(ast::While &node) {
+    enter(node);
+    node.condition->accept(*this);
+    node.body->accept(*this);
+}
+
+void TreeWalker::visit(ast::VarDecl &node) {
+    enter(node);
+    node.id->accept(*this);
+    node.type->accept(*this);
+    if (node.init_exp) {
+        node.init_exp->accept(*this);
+    }
+}
+
+void TreeWalker::visit(ast::Assign &node) {
+    enter(node);
+    node.id->accept(*this);
+    node.exp->accept(*this);
+}
+
+void TreeWalker::visit(ast::Formal &node) {
+    enter(node);
+    node.id->accept(*this);
+    node.type->accept(*this);
+}
+
+void TreeWalker::visit(ast::Formals &node) {
+    enter(node);
+    for (auto &child : node.formals) {
+        child->accept(*this);
+    }
+}
+
+void TreeWalker::visit(ast::FuncDecl &node) {
+    enter(node);
+    node.id->accept(*this);
+    node.return_type->accept(*this);
+    node.formals->accept(*this);
+    node.body->accept(*this);
+}
+
+void TreeWalker::visit(ast::Funcs &node) {
+    enter(node);
+    for (auto &child : node.funcs) {
+        child->accept(*this);
+    }
+}
+
+void CallCollector::visit(ast::Call &node) {
+    callees.push_back(node.func_id->value);
+    TreeWalker::visit(node);
+}
+
+void AssignmentCollector::visit(ast::Assign &node) {
+    offsets.insert(node.id->computedOffset);
+    TreeWalker::visit(node);
+}
+
+void AssignmentCollector::visit(ast::VarDecl &node) {
+    offsets.insert(node.id->computedOffset);
+    TreeWalker::visit(node);
+}
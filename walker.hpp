@@ -0,0 +1,79 @@
+#ifndef WALKER_HPP
+#define WALKER_HPP
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "visitor.hpp"
+#include "nodes.hpp"
+
+/* TreeWalker class
+ * A visitor that walks the whole tree in source order. enter() is called on every node before
+ * its children are visited. Passes override enter() or the visit methods of the nodes they care
+ * about, and call TreeWalker::visit to keep descending.
+ */
+class TreeWalker : public Visitor {
+protected:
+    virtual void enter(ast::Node &node) {}
+
+public:
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::ArrayType &node) override;
+    void visit(ast::PrimitiveType &node) override;
+    void visit(ast::ArrayDereference &node) override;
+    void visit(ast::ArrayAssign &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Block &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+};
+
+/* CallCollector class
+ * Collects the names of the functions called anywhere in a subtree, once per call.
+ */
+class CallCollector : public TreeWalker {
+public:
+    std::vector<std::string> callees;
+
+    using TreeWalker::visit;
+
+    void visit(ast::Call &node) override;
+};
+
+/* AssignmentCollector class
+ * Collects the frame offsets of the variables a subtree assigns or declares.
+ */
+class AssignmentCollector : public TreeWalker {
+public:
+    std::unordered_set<int> &offsets;
+
+    explicit AssignmentCollector(std::unordered_set<int> &offsets) : offsets(offsets) {}
+
+    using TreeWalker::visit;
+
+    void visit(ast::Assign &node) override;
+    void visit(ast::VarDecl &node) override;
+};
+
+#endif //WALKER_HPP
@@ -0,0 +1,951 @@
+#include "x86.hpp"
+#include <algorithm>
+#include <climits>
+
+namespace x86 {
+    const char *trapMessage(int trap) {
+        switch (trap) {
+            case TRAP_DIVISION_BY_ZERO:
+                return "Error division by zero";
+            case TRAP_OUT_OF_BOUNDS:
+                return "Error out of bounds";
+            default:
+                return "Error stack overflow";
+        }
+    }
+
+    /* Operand */
+
+    Operand Operand::r(int reg) {
+        return {true, reg, 0, -1, 1, 0, false};
+    }
+
+    Operand Operand::mem(int base, int32_t disp) {
+        return {false, 0, base, -1, 1, disp, false};
+    }
+
+    Operand Operand::mem(int base, int index, int scale, int32_t disp) {
+        return {false, 0, base, index, scale, disp, false};
+    }
+
+    Operand Operand::ripRelative() {
+        return {false, 0, 0, -1, 1, 0, true};
+    }
+
+    /* Assembler class */
+
+    Assembler::Assembler(std::vector<uint8_t> &code) : code(code) {}
+
+    void Assembler::byte(uint8_t value) {
+        code.push_back(value);
+    }
+
+    void Assembler::dword(uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            code.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void Assembler::qword(uint64_t value) {
+        dword(static_cast<uint32_t>(value));
+        dword(static_cast<uint32_t>(value >> 32));
+    }
+
+    void Assembler::patch32(size_t offset, int32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            code[offset + i] = static_cast<uint8_t>(static_cast<uint32_t>(value) >> (8 * i));
+        }
+    }
+
+    void Assembler::patchRel32(size_t field, size_t target) {
+        patch32(field, static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(field + 4)));
+    }
+
+    void Assembler::_rex(bool wide, int reg, const Operand &rm, bool force) {
+        int rex = (wide ? 8 : 0) | ((reg >> 3) << 2);
+        if (rm.isReg) {
+            rex |= rm.reg >> 3;
+        } else if (!rm.rip) {
+            rex |= (rm.index >= 0 ? (rm.index >> 3) << 1 : 0) | (rm.base >> 3);
+        }
+        if (rex || force) {
+            byte(0x40 | rex);
+        }
+    }
+
+    size_t Assembler::_modrm(int reg, const Operand &rm) {
+        if (rm.isReg) {
+            byte(0xC0 | (reg & 7) << 3 | (rm.reg & 7));
+            return 0;
+        }
+        if (rm.rip) {
+            byte(0x05 | (reg & 7) << 3);
+            size_t field = size();
+            dword(0);
+            return field;
+        }
+
+        // rbp and r13 as a base always need a displacement, so one is always emitted
+        bool small = rm.disp >= -128 && rm.disp <= 127;
+        int mod = small ? 1 : 2;
+        if (rm.index < 0 && (rm.base & 7) != RSP) {
+            byte(mod << 6 | (reg & 7) << 3 | (rm.base & 7));
+        } else {
+            int scaleBits = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+            int index = rm.index < 0 ? RSP : rm.index;
+            byte(mod << 6 | (reg & 7) << 3 | 4);
+            byte(scaleBits << 6 | (index & 7) << 3 | (rm.base & 7));
+        }
+        if (small) {
+            byte(static_cast<uint8_t>(rm.disp));
+        } else {
+            dword(static_cast<uint32_t>(rm.disp));
+        }
+        return 0;
+    }
+
+    size_t Assembler::op(std::initializer_list<uint8_t> opcode, int reg, const Operand &rm, bool wide) {
+        _rex(wide, reg, rm);
+        for (uint8_t b : opcode) {
+            byte(b);
+        }
+        return _modrm(reg, rm);
+    }
+
+    void Assembler::movImm(int reg, int32_t value) {
+        if (reg >= 8) {
+            byte(0x41);
+        }
+        byte(0xB8 | (reg & 7));
+        dword(static_cast<uint32_t>(value));
+    }
+
+    void Assembler::movImm64(int reg, uint64_t value) {
+        byte(0x48 | (reg >> 3));
+        byte(0xB8 | (reg & 7));
+        qword(value);
+    }
+
+    void Assembler::group1(int ext, const Operand &rm, int32_t value, bool wide) {
+        if (value >= -128 && value <= 127) {
+            op({0x83}, ext, rm, wide);
+            byte(static_cast<uint8_t>(value));
+        } else {
+            op({0x81}, ext, rm, wide);
+            dword(static_cast<uint32_t>(value));
+        }
+    }
+
+    void Assembler::storeImm(const Operand &rm, int32_t value) {
+        op({0xC7}, 0, rm);
+        dword(static_cast<uint32_t>(value));
+    }
+
+    void Assembler::push(int reg) {
+        if (reg >= 8) {
+            byte(0x41);
+        }
+        byte(0x50 | (reg & 7));
+    }
+
+    void Assembler::pop(int reg) {
+        if (reg >= 8) {
+            byte(0x41);
+        }
+        byte(0x58 | (reg & 7));
+    }
+
+    void Assembler::ret() {
+        byte(0xC3);
+    }
+
+    size_t Assembler::call() {
+        byte(0xE8);
+        size_t field = size();
+        dword(0);
+        return field;
+    }
+
+    size_t Assembler::jmp() {
+        byte(0xE9);
+        size_t field = size();
+        dword(0);
+        return field;
+    }
+
+    size_t Assembler::jcc(Cond cond) {
+        byte(0x0F);
+        byte(0x80 | cond);
+        size_t field = size();
+        dword(0);
+        return field;
+    }
+
+    void Assembler::setcc(Cond cond, int reg) {
+        op({0x0F, static_cast<uint8_t>(0x90 | cond)}, 0, Operand::r(reg));
+    }
+
+    void Assembler::syscall() {
+        byte(0x0F);
+        byte(0x05);
+    }
+
+    void Assembler::sse(uint8_t prefix, uint8_t opcode, int reg, const Operand &rm) {
+        // the mandatory prefix goes before REX
+        byte(prefix);
+        _rex(false, reg, rm);
+        byte(0x0F);
+        byte(opcode);
+        _modrm(reg, rm);
+    }
+
+    /* CodeGenerator class */
+
+    // Registers the allocator hands out; all callee-saved, so values survive calls
+    static const int allocatable[] = {RBX, R12, R13, R14, R15};
+    static const int allocatableCount = sizeof(allocatable) / sizeof(allocatable[0]);
+
+    // xmm registers of vector loops: vector registers from xmm0, then two scratch registers, the
+    // lane offsets 0 to 3 and the byte mask
+    static const int vectorRegisters = 12;
+    static const int XMM_SCRATCH = 12;
+    static const int XMM_SCRATCH2 = 13;
+    static const int XMM_LANES = 14;
+    static const int XMM_MASK = 15;
+
+    static Cond branchCond(bytecode::Opcode op) {
+        switch (op) {
+            case bytecode::JEQ:
+            case bytecode::JEQI:
+            case bytecode::EQ:
+                return CC_E;
+            case bytecode::JNE:
+            case bytecode::JNEI:
+            case bytecode::NE:
+                return CC_NE;
+            case bytecode::JLT:
+            case bytecode::JLTI:
+            case bytecode::LT:
+                return CC_L;
+            case bytecode::JLE:
+            case bytecode::JLEI:
+            case bytecode::LE:
+                return CC_LE;
+            case bytecode::JGT:
+            case bytecode::JGTI:
+            case bytecode::GT:
+                return CC_G;
+            default:
+                return CC_GE;
+        }
+    }
+
+    // Jump target of a branch instruction, or -1
+    static int jumpTarget(const bytecode::Instr &instr) {
+        switch (instr.op) {
+            case bytecode::JMP:
+                return instr.a;
+            case bytecode::JZ:
+            case bytecode::JNZ:
+                return instr.b;
+            default:
+                if (instr.op >= bytecode::JEQ && instr.op <= bytecode::JGEI) {
+                    return instr.c;
+                }
+                return -1;
+        }
+    }
+
+    CodeGenerator::CodeGenerator(const bytecode::Program &program) : program(program), as(native.text) {}
+
+    NativeCode CodeGenerator::generate(const bytecode::Program &program) {
+        CodeGenerator generator(program);
+        generator.native.strings = program.strings;
+        generator.native.main = program.main;
+        generator.native.functions.resize(program.functions.size());
+
+        // functions are contiguous in the bytecode, in declaration order
+        std::vector<int> order(program.functions.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<int>(i);
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return program.functions[a].entry < program.functions[b].entry;
+        });
+        for (size_t i = 0; i < order.size(); ++i) {
+            int begin = program.functions[order[i]].entry;
+            int end = i + 1 < order.size() ? program.functions[order[i + 1]].entry
+                                           : static_cast<int>(program.code.size());
+            generator._function(order[i], begin, end);
+        }
+
+        Assembler &as = generator.as;
+        for (const auto &call : generator.calls) {
+            as.patchRel32(call.first, generator.native.functions[call.second]);
+        }
+
+        // one shared block per trap: the stack is aligned wherever it is jumped to from
+        std::vector<size_t> trapBlocks(TRAP_COUNT, 0);
+        for (int trap = 0; trap < TRAP_COUNT; ++trap) {
+            trapBlocks[trap] = as.size();
+            as.movImm(RDI, trap);
+            generator._runtimeCall(RT_TRAP);
+        }
+        for (const auto &trap : generator.traps) {
+            as.patchRel32(trap.first, trapBlocks[trap.second]);
+        }
+
+        return std::move(generator.native);
+    }
+
+    /* Helpers */
+
+    Operand CodeGenerator::_home(int reg) const {
+        const Home &home = homes[reg];
+        return home.inReg ? Operand::r(home.reg) : Operand::mem(RBP, home.disp);
+    }
+
+    void CodeGenerator::_load(int to, int reg) {
+        const Home &home = homes[reg];
+        if (home.inReg && home.reg == to) {
+            return;
+        }
+        as.op({0x8B}, to, _home(reg));
+    }
+
+    void CodeGenerator::_store(int reg, int from) {
+        const Home &home = homes[reg];
+        if (home.inReg && home.reg == from) {
+            return;
+        }
+        as.op({0x89}, from, _home(reg));
+    }
+
+    void CodeGenerator::_runtimeCall(RuntimeFunction function) {
+        native.references.push_back({as.call(), Reference::RUNTIME, function});
+    }
+
+    void CodeGenerator::_trapIf(Cond cond, Trap trap) {
+        traps.emplace_back(as.jcc(cond), trap);
+    }
+
+    /* Register allocation */
+
+    void CodeGenerator::_allocate(int begin, int end, const bytecode::Function &function) {
+        int count = function.registers;
+        std::vector<int> start(count, INT_MAX);
+        std::vector<int> stop(count, -1);
+        std::vector<char> inMemory(count, 0);
+
+        auto touch = [&](int reg, int at) {
+            start[reg] = std::min(start[reg], at);
+            stop[reg] = std::max(stop[reg], at);
+        };
+        auto array = [&](int base, int length) {
+            for (int reg = base; reg < base + length; ++reg) {
+                inMemory[reg] = 1;
+            }
+        };
+
+        for (int param = 0; param < function.params; ++param) {
+            touch(param, begin - 1);
+        }
+        for (int at = begin; at < end; ++at) {
+            const bytecode::Instr &instr = program.code[at];
+            switch (instr.op) {
+                case bytecode::LOADK:
+                case bytecode::JZ:
+                case bytecode::JNZ:
+                case bytecode::RET:
+                case bytecode::PRINTI:
+                    touch(instr.a, at);
+                    break;
+                case bytecode::MOV:
+                case bytecode::ADDI:
+                case bytecode::SUBI:
+                case bytecode::SHLI:
+                case bytecode::SHLBI:
+                case bytecode::SHRI:
+                case bytecode::TRUNCB:
+                case bytecode::NOT:
+                case bytecode::JEQ:
+                case bytecode::JNE:
+                case bytecode::JLT:
+                case bytecode::JLE:
+                case bytecode::JGT:
+                case bytecode::JGE:
+                    touch(instr.a, at);
+                    touch(instr.b, at);
+                    break;
+                case bytecode::JEQI:
+                case bytecode::JNEI:
+                case bytecode::JLTI:
+                case bytecode::JLEI:
+                case bytecode::JGTI:
+                case bytecode::JGEI:
+                    touch(instr.a, at);
+                    break;
+                case bytecode::ALOAD:
+                case bytecode::ASTORE:
+                case bytecode::ALOADU:
+                case bytecode::ASTOREU:
+                    touch(instr.a, at);
+                    touch(instr.c, at);
+                    array(instr.b, instr.d);
+                    break;
+                case bytecode::ZERO:
+                    array(instr.a, instr.b);
+                    break;
+                case bytecode::CALL:
+                    if (instr.a >= 0) {
+                        touch(instr.a, at);
+                    }
+                    for (int arg = 0; arg < program.functions[instr.b].params; ++arg) {
+                        touch(instr.c + arg, at);
+                    }
+                    break;
+                case bytecode::VLOOP: {
+                    const bytecode::VectorLoop &loop = program.loops[instr.a];
+                    touch(loop.counter, at);
+                    if (!loop.immediate) {
+                        touch(loop.bound, at);
+                    }
+                    for (const auto &vector : loop.body) {
+                        if (vector.op == bytecode::VSPLAT) {
+                            touch(vector.b, at);
+                        } else if (vector.op == bytecode::VLOAD || vector.op == bytecode::VSTORE) {
+                            array(vector.b, vector.c);
+                        }
+                    }
+                    break;
+                }
+                case bytecode::JMP:
+                case bytecode::RETV:
+                case bytecode::PRINT:
+                case bytecode::OPCODE_COUNT:
+                    break;
+                default:
+                    // three register arithmetic and comparisons
+                    touch(instr.a, at);
+                    touch(instr.b, at);
+                    touch(instr.c, at);
+                    break;
+            }
+        }
+
+        // a register live anywhere in a loop is live in all of it
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int at = begin; at < end; ++at) {
+                int target = jumpTarget(program.code[at]);
+                if (target < 0 || target > at) {
+                    continue;
+                }
+                for (int reg = 0; reg < count; ++reg) {
+                    if (stop[reg] >= target && start[reg] <= at && (start[reg] > target || stop[reg] < at)) {
+                        start[reg] = std::min(start[reg], target);
+                        stop[reg] = std::max(stop[reg], at);
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // linear scan, spilling whichever interval ends last
+        std::vector<int> intervals;
+        for (int reg = 0; reg < count; ++reg) {
+            if (stop[reg] >= 0 && !inMemory[reg]) {
+                intervals.push_back(reg);
+            }
+        }
+        std::sort(intervals.begin(), intervals.end(), [&](int a, int b) {
+            return start[a] < start[b];
+        });
+
+        homes.assign(count, {false, 0, 0});
+        std::vector<int> active;
+        std::vector<int> freeRegs(allocatable, allocatable + allocatableCount);
+        std::vector<char> used(16, 0);
+        for (int reg : intervals) {
+            for (auto it = active.begin(); it != active.end();) {
+                if (stop[*it] < start[reg]) {
+                    freeRegs.push_back(homes[*it].reg);
+                    it = active.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            if (!freeRegs.empty()) {
+                homes[reg] = {true, freeRegs.back(), 0};
+                freeRegs.pop_back();
+                active.push_back(reg);
+            } else {
+                auto last = std::max_element(active.begin(), active.end(), [&](int a, int b) {
+                    return stop[a] < stop[b];
+                });
+                if (stop[*last] > stop[reg]) {
+                    homes[reg] = homes[*last];
+                    homes[*last].inReg = false;
+                    *last = reg;
+                }
+            }
+            if (homes[reg].inReg) {
+                used[homes[reg].reg] = 1;
+            }
+        }
+
+        savedRegs.clear();
+        for (int reg : allocatable) {
+            if (used[reg]) {
+                savedRegs.push_back(reg);
+            }
+        }
+
+        // frame: saved registers below rbp, then the locals, lowest register lowest
+        int saved = 8 * static_cast<int>(savedRegs.size());
+        int locals = 4 * (count - function.params);
+        for (int reg = 0; reg < count; ++reg) {
+            if (homes[reg].inReg) continue;
+            homes[reg].disp = reg < function.params ? 16 + 4 * reg : -saved - locals + 4 * (reg - function.params);
+        }
+    }
+
+    /* Code generation */
+
+    void CodeGenerator::_function(int index, int begin, int end) {
+        const bytecode::Function &function = program.functions[index];
+        _allocate(begin, end, function);
+
+        int outgoing = 0;
+        for (int at = begin; at < end; ++at) {
+            if (program.code[at].op == bytecode::CALL) {
+                outgoing = std::max(outgoing, program.functions[program.code[at].b].params);
+            }
+        }
+        int saved = 8 * static_cast<int>(savedRegs.size());
+        int frame = (saved + 4 * (function.registers - function.params) + 4 * outgoing + 15) / 16 * 16 - saved;
+
+        native.functions[index] = as.size();
+        as.push(RBP);
+        as.op({0x89}, RSP, Operand::r(RBP), true);
+        for (int reg : savedRegs) {
+            as.push(reg);
+        }
+        if (frame > 0) {
+            as.group1(5, Operand::r(RSP), frame, true);
+        }
+        native.references.push_back({as.op({0x3B}, RSP, Operand::ripRelative(), true), Reference::STACK_LIMIT, 0});
+        _trapIf(CC_B, TRAP_STACK_OVERFLOW);
+        for (int param = 0; param < function.params; ++param) {
+            if (homes[param].inReg) {
+                as.op({0x8B}, homes[param].reg, Operand::mem(RBP, 16 + 4 * param));
+            }
+        }
+
+        nativeAt.assign(end - begin, 0);
+        jumps.clear();
+        returns.clear();
+        for (int at = begin; at < end; ++at) {
+            nativeAt[at - begin] = as.size();
+            _instr(program.code[at]);
+        }
+        for (const auto &jump : jumps) {
+            as.patchRel32(jump.first, nativeAt[jump.second - begin]);
+        }
+
+        size_t epilogue = as.size();
+        for (size_t field : returns) {
+            as.patchRel32(field, epilogue);
+        }
+        as.op({0x8D}, RSP, Operand::mem(RBP, -saved), true);
+        for (auto it = savedRegs.rbegin(); it != savedRegs.rend(); ++it) {
+            as.pop(*it);
+        }
+        as.pop(RBP);
+        as.ret();
+    }
+
+    void CodeGenerator::_instr(const bytecode::Instr &instr) {
+        switch (instr.op) {
+            case bytecode::LOADK:
+                if (homes[instr.a].inReg) {
+                    as.movImm(homes[instr.a].reg, instr.b);
+                } else {
+                    as.storeImm(_home(instr.a), instr.b);
+                }
+                break;
+
+            case bytecode::MOV:
+                if (homes[instr.a].inReg) {
+                    _load(homes[instr.a].reg, instr.b);
+                } else {
+                    _load(RAX, instr.b);
+                    _store(instr.a, RAX);
+                }
+                break;
+
+            case bytecode::ADD:
+            case bytecode::SUB:
+            case bytecode::MUL:
+            case bytecode::ADDB:
+            case bytecode::SUBB:
+            case bytecode::MULB: {
+                _load(RAX, instr.b);
+                if (instr.op == bytecode::ADD || instr.op == bytecode::ADDB) {
+                    as.op({0x03}, RAX, _home(instr.c));
+                } else if (instr.op == bytecode::SUB || instr.op == bytecode::SUBB) {
+                    as.op({0x2B}, RAX, _home(instr.c));
+                } else {
+                    as.op({0x0F, 0xAF}, RAX, _home(instr.c));
+                }
+                if (instr.op >= bytecode::ADDB) {
+                    as.group1(4, Operand::r(RAX), 0xFF);
+                }
+                _store(instr.a, RAX);
+                break;
+            }
+
+            case bytecode::DIV: {
+                _load(RCX, instr.c);
+                as.op({0x85}, RCX, Operand::r(RCX));
+                _trapIf(CC_E, TRAP_DIVISION_BY_ZERO);
+                _load(RAX, instr.b);
+                // INT_MIN / -1 wraps back to INT_MIN instead of faulting
+                as.group1(7, Operand::r(RCX), -1);
+                size_t divide = as.jcc(CC_NE);
+                as.op({0xF7}, 3, Operand::r(RAX));
+                size_t done = as.jmp();
+                as.patchRel32(divide, as.size());
+                as.byte(0x99);
+                as.op({0xF7}, 7, Operand::r(RCX));
+                as.patchRel32(done, as.size());
+                _store(instr.a, RAX);
+                break;
+            }
+
+            case bytecode::DIVB:
+                _load(RCX, instr.c);
+                as.op({0x85}, RCX, Operand::r(RCX));
+                _trapIf(CC_E, TRAP_DIVISION_BY_ZERO);
+                _load(RAX, instr.b);
+                as.op({0x33}, RDX, Operand::r(RDX));
+                as.op({0xF7}, 6, Operand::r(RCX));
+                _store(instr.a, RAX);
+                break;
+
+            case bytecode::ADDI:
+            case bytecode::SUBI: {
+                int ext = instr.op == bytecode::ADDI ? 0 : 5;
+                if (instr.a == instr.b) {
+                    as.group1(ext, _home(instr.a), instr.c);
+                } else {
+                    _load(RAX, instr.b);
+                    as.group1(ext, Operand::r(RAX), instr.c);
+                    _store(instr.a, RAX);
+                }
+                break;
+            }
+
+            case bytecode::SHLI:
+            case bytecode::SHLBI:
+                _load(RAX, instr.b);
+                as.op({0xC1}, 4, Operand::r(RAX));
+                as.byte(static_cast<uint8_t>(instr.c));
+                if (instr.op == bytecode::SHLBI) {
+                    as.group1(4, Operand::r(RAX), 0xFF);
+                }
+                _store(instr.a, RAX);
+                break;
+
+            case bytecode::SHRI:
+                // ecx = 2^c - 1 for a negative dividend, 0 otherwise, so sar rounds toward zero
+                _load(RAX, instr.b);
+                as.op({0x8B}, RCX, Operand::r(RAX));
+                as.op({0xC1}, 7, Operand::r(RCX));
+                as.byte(31);
+                as.group1(4, Operand::r(RCX), (1 << instr.c) - 1);
+                as.op({0x03}, RAX, Operand::r(RCX));
+                as.op({0xC1}, 7, Operand::r(RAX));
+                as.byte(static_cast<uint8_t>(instr.c));
+                _store(instr.a, RAX);
+                break;
+
+            case bytecode::TRUNCB:
+            case bytecode::NOT:
+                _load(RAX, instr.b);
+                if (instr.op == bytecode::TRUNCB) {
+                    as.group1(4, Operand::r(RAX), 0xFF);
+                } else {
+                    as.group1(6, Operand::r(RAX), 1);
+                }
+                _store(instr.a, RAX);
+                break;
+
+            case bytecode::EQ:
+            case bytecode::NE:
+            case bytecode::LT:
+            case bytecode::LE:
+            case bytecode::GT:
+            case bytecode::GE:
+                _load(RAX, instr.b);
+                as.op({0x3B}, RAX, _home(instr.c));
+                as.setcc(branchCond(instr.op), RAX);
+                as.op({0x0F, 0xB6}, RAX, Operand::r(RAX));
+                _store(instr.a, RAX);
+                break;
+
+            case bytecode::JMP:
+                jumps.emplace_back(as.jmp(), instr.a);
+                break;
+
+            case bytecode::JZ:
+            case bytecode::JNZ:
+                if (homes[instr.a].inReg) {
+                    as.op({0x85}, homes[instr.a].reg, _home(instr.a));
+                } else {
+                    as.group1(7, _home(instr.a), 0);
+                }
+                jumps.emplace_back(as.jcc(instr.op == bytecode::JZ ? CC_E : CC_NE), instr.b);
+                break;
+
+            case bytecode::JEQ:
+            case bytecode::JNE:
+            case bytecode::JLT:
+            case bytecode::JLE:
+            case bytecode::JGT:
+            case bytecode::JGE:
+                if (homes[instr.a].inReg) {
+                    as.op({0x3B}, homes[instr.a].reg, _home(instr.b));
+                } else {
+                    _load(RAX, instr.a);
+                    as.op({0x3B}, RAX, _home(instr.b));
+                }
+                jumps.emplace_back(as.jcc(branchCond(instr.op)), instr.c);
+                break;
+
+            case bytecode::JEQI:
+            case bytecode::JNEI:
+            case bytecode::JLTI:
+            case bytecode::JLEI:
+            case bytecode::JGTI:
+            case bytecode::JGEI:
+                as.group1(7, _home(instr.a), instr.b);
+                jumps.emplace_back(as.jcc(branchCond(instr.op)), instr.c);
+                break;
+
+            case bytecode::ALOAD:
+            case bytecode::ASTORE:
+            case bytecode::ALOADU:
+            case bytecode::ASTOREU: {
+                // bounds check unsigned, so negative indices fail too; ecx is then a valid
+                // zero-extended index
+                _load(RCX, instr.c);
+                if (instr.op == bytecode::ALOAD || instr.op == bytecode::ASTORE) {
+                    as.group1(7, Operand::r(RCX), instr.d);
+                    _trapIf(CC_AE, TRAP_OUT_OF_BOUNDS);
+                }
+                // a zero-length array has no home, and the check above always traps
+                Operand element = Operand::mem(RBP, RCX, 4, instr.d > 0 ? homes[instr.b].disp : 0);
+                if (instr.op == bytecode::ALOAD || instr.op == bytecode::ALOADU) {
+                    as.op({0x8B}, RAX, element);
+                    _store(instr.a, RAX);
+                } else {
+                    _load(RAX, instr.a);
+                    as.op({0x89}, RAX, element);
+                }
+                break;
+            }
+
+            case bytecode::ZERO:
+                if (instr.b == 0) {
+                    break;
+                }
+                as.op({0x8D}, RDI, _home(instr.a), true);
+                as.movImm(RCX, instr.b);
+                as.op({0x33}, RAX, Operand::r(RAX));
+                // rep stosd
+                as.byte(0xF3);
+                as.byte(0xAB);
+                break;
+
+            case bytecode::CALL: {
+                int params = program.functions[instr.b].params;
+                for (int arg = 0; arg < params; ++arg) {
+                    _load(RAX, instr.c + arg);
+                    as.op({0x89}, RAX, Operand::mem(RSP, 4 * arg));
+                }
+                calls.emplace_back(as.call(), instr.b);
+                if (instr.a >= 0) {
+                    _store(instr.a, RAX);
+                }
+                break;
+            }
+
+            case bytecode::RET:
+                _load(RAX, instr.a);
+                returns.push_back(as.jmp());
+                break;
+
+            case bytecode::RETV:
+                returns.push_back(as.jmp());
+                break;
+
+            case bytecode::PRINT:
+                native.references.push_back({as.op({0x8D}, RDI, Operand::ripRelative(), true), Reference::STRING, instr.a});
+                as.movImm(RSI, static_cast<int32_t>(program.strings[instr.a].size()));
+                _runtimeCall(RT_PRINT);
+                break;
+
+            case bytecode::PRINTI:
+                _load(RDI, instr.a);
+                _runtimeCall(RT_PRINTI);
+                break;
+
+            case bytecode::VLOOP:
+                _vectorLoop(program.loops[instr.a]);
+                break;
+
+            case bytecode::OPCODE_COUNT:
+                break;
+        }
+    }
+
+    void CodeGenerator::_vectorLoop(const bytecode::VectorLoop &loop) {
+        // without enough xmm registers the scalar loop runs it all
+        if (loop.vectors > vectorRegisters) {
+            return;
+        }
+
+        // eax = i, edx = the end; skip unless 0 <= i < end <= length
+        std::vector<size_t> skips;
+        _load(RAX, loop.counter);
+        if (loop.immediate) {
+            as.movImm(RDX, loop.bound);
+        } else {
+            _load(RDX, loop.bound);
+        }
+        as.op({0x85}, RAX, Operand::r(RAX));
+        skips.push_back(as.jcc(CC_S));
+        as.group1(7, Operand::r(RDX), loop.length);
+        skips.push_back(as.jcc(loop.inclusive ? CC_GE : CC_G));
+        if (loop.inclusive) {
+            as.group1(0, Operand::r(RDX), 1);
+        }
+        as.op({0x3B}, RAX, Operand::r(RDX));
+        skips.push_back(as.jcc(CC_GE));
+
+        bool lanes = false;
+        bool mask = false;
+        for (const auto &vector : loop.body) {
+            lanes = lanes || vector.op == bytecode::VINDEX;
+            mask = mask || vector.op == bytecode::VTRUNCB;
+        }
+        auto broadcast = [&](int xmm) {
+            as.sse(0x66, 0x70, xmm, Operand::r(xmm));
+            as.byte(0);
+        };
+        if (lanes) {
+            // {0, 1, 2, 3}: 3, 2 and 1 each go into lane 0 and the whole moves up a lane
+            auto shift = [&]() {
+                as.sse(0x66, 0x73, 7, Operand::r(XMM_LANES));
+                as.byte(4);
+            };
+            as.movImm(RCX, 3);
+            as.sse(0x66, 0x6E, XMM_LANES, Operand::r(RCX));
+            for (int lane = 2; lane > 0; --lane) {
+                shift();
+                as.movImm(RCX, lane);
+                as.sse(0x66, 0x6E, XMM_SCRATCH, Operand::r(RCX));
+                as.sse(0x66, 0xEB, XMM_LANES, Operand::r(XMM_SCRATCH));
+            }
+            shift();
+        }
+        if (mask) {
+            as.movImm(RCX, 0xFF);
+            as.sse(0x66, 0x6E, XMM_MASK, Operand::r(RCX));
+            broadcast(XMM_MASK);
+        }
+
+        // four iterations per pass while i + 4 <= end
+        size_t top = as.size();
+        as.op({0x8D}, RCX, Operand::mem(RAX, 4));
+        as.op({0x3B}, RCX, Operand::r(RDX));
+        size_t done = as.jcc(CC_G);
+        for (const auto &vector : loop.body) {
+            int a = vector.a;
+            int b = vector.b;
+            int c = vector.c;
+            switch (vector.op) {
+                case bytecode::VLOAD:
+                case bytecode::VSTORE: {
+                    Operand elements = Operand::mem(RBP, RAX, 4, c > 0 ? homes[b].disp : 0);
+                    as.sse(0xF3, vector.op == bytecode::VLOAD ? 0x6F : 0x7F, a, elements);
+                    break;
+                }
+                case bytecode::VSPLAT:
+                    as.sse(0x66, 0x6E, a, _home(b));
+                    broadcast(a);
+                    break;
+                case bytecode::VSPLATK:
+                    as.movImm(RCX, b);
+                    as.sse(0x66, 0x6E, a, Operand::r(RCX));
+                    broadcast(a);
+                    break;
+                case bytecode::VINDEX:
+                    as.sse(0x66, 0x6E, a, Operand::r(RAX));
+                    broadcast(a);
+                    as.sse(0x66, 0xFE, a, Operand::r(XMM_LANES));
+                    break;
+                case bytecode::VADD:
+                case bytecode::VSUB: {
+                    uint8_t opcode = vector.op == bytecode::VADD ? 0xFE : 0xFA;
+                    // movdqa a, b would overwrite c first
+                    int target = a == c && a != b ? XMM_SCRATCH : a;
+                    if (target != b) {
+                        as.sse(0x66, 0x6F, target, Operand::r(b));
+                    }
+                    as.sse(0x66, opcode, target, Operand::r(c));
+                    if (target != a) {
+                        as.sse(0x66, 0x6F, a, Operand::r(target));
+                    }
+                    break;
+                }
+                case bytecode::VMUL:
+                    // no pmulld in SSE2: the odd lanes' products, then the even ones', low
+                    // halves interleaved back
+                    as.sse(0x66, 0x6F, XMM_SCRATCH, Operand::r(b));
+                    as.sse(0x66, 0x73, 2, Operand::r(XMM_SCRATCH));
+                    as.byte(32);
+                    as.sse(0x66, 0x6F, XMM_SCRATCH2, Operand::r(c));
+                    as.sse(0x66, 0x73, 2, Operand::r(XMM_SCRATCH2));
+                    as.byte(32);
+                    as.sse(0x66, 0xF4, XMM_SCRATCH, Operand::r(XMM_SCRATCH2));
+                    as.sse(0x66, 0x6F, XMM_SCRATCH2, Operand::r(b));
+                    as.sse(0x66, 0xF4, XMM_SCRATCH2, Operand::r(c));
+                    as.sse(0x66, 0x70, a, Operand::r(XMM_SCRATCH2));
+                    as.byte(0x08);
+                    as.sse(0x66, 0x70, XMM_SCRATCH, Operand::r(XMM_SCRATCH));
+                    as.byte(0x08);
+                    as.sse(0x66, 0x62, a, Operand::r(XMM_SCRATCH));
+                    break;
+                case bytecode::VTRUNCB:
+                    if (a != b) {
+                        as.sse(0x66, 0x6F, a, Operand::r(b));
+                    }
+                    as.sse(0x66, 0xDB, a, Operand::r(XMM_MASK));
+                    break;
+            }
+        }
+        as.group1(0, Operand::r(RAX), 4);
+        as.patchRel32(as.jmp(), top);
+
+        // the scalar loop that follows runs the rest
+        as.patchRel32(done, as.size());
+        _store(loop.counter, RAX);
+        for (size_t skip : skips) {
+            as.patchRel32(skip, as.size());
+        }
+    }
+}
@@ -0,0 +1,185 @@
+#ifndef X86_HPP
+#define X86_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+
+namespace x86 {
+    enum Reg {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15
+    };
+
+    // Condition codes, as used in the jcc and setcc opcodes
+    enum Cond {
+        CC_B = 0x2,
+        CC_AE = 0x3,
+        CC_E = 0x4,
+        CC_NE = 0x5,
+        CC_BE = 0x6,
+        CC_A = 0x7,
+        CC_S = 0x8,
+        CC_NS = 0x9,
+        CC_L = 0xC,
+        CC_GE = 0xD,
+        CC_LE = 0xE,
+        CC_G = 0xF
+    };
+
+    // A register, or a memory operand [base + index * scale + disp] or [rip + disp]
+    struct Operand {
+        bool isReg;
+        int reg;
+        int base;
+        int index;
+        int scale;
+        int32_t disp;
+        bool rip;
+
+        static Operand r(int reg);
+        static Operand mem(int base, int32_t disp);
+        static Operand mem(int base, int index, int scale, int32_t disp);
+        static Operand ripRelative();
+    };
+
+    /* Assembler class
+     * Appends x86-64 instructions to a byte vector. Only the forms the code generator needs are
+     * provided. Instructions with a rel32 field return the offset of that field so it can be
+     * patched once the target is known; rel32 is always relative to the end of the field.
+     */
+    class Assembler {
+    private:
+        std::vector<uint8_t> &code;
+
+        void _rex(bool wide, int reg, const Operand &rm, bool force = false);
+        // ModRM, SIB and displacement; returns the offset of a rip-relative displacement
+        size_t _modrm(int reg, const Operand &rm);
+
+    public:
+        explicit Assembler(std::vector<uint8_t> &code);
+
+        size_t size() const { return code.size(); }
+        void byte(uint8_t value);
+        void dword(uint32_t value);
+        void qword(uint64_t value);
+        void patch32(size_t offset, int32_t value);
+        // Points a rel32 field at `target`
+        void patchRel32(size_t field, size_t target);
+
+        // opcode reg, r/m with 32-bit operands, or 64-bit ones if `wide`. Returns the offset of
+        // the displacement of a rip-relative operand, or 0.
+        size_t op(std::initializer_list<uint8_t> opcode, int reg, const Operand &rm, bool wide = false);
+
+        void movImm(int reg, int32_t value);
+        void movImm64(int reg, uint64_t value);
+        // op r/m32, imm32 for the group 1 opcodes (0 add, 4 and, 5 sub, 7 cmp)
+        void group1(int ext, const Operand &rm, int32_t value, bool wide = false);
+        void storeImm(const Operand &rm, int32_t value);
+        void push(int reg);
+        void pop(int reg);
+        void ret();
+        size_t call();
+        size_t jmp();
+        size_t jcc(Cond cond);
+        void setcc(Cond cond, int reg);
+        void syscall();
+        // SSE instruction `prefix 0F opcode` with xmm register `reg` (or an opcode extension) and
+        // an xmm register or memory operand; an imm8 follows separately where the form has one
+        void sse(uint8_t prefix, uint8_t opcode, int reg, const Operand &rm);
+    };
+
+    // What a rel32 field left open in the generated code refers to
+    struct Reference {
+        enum Kind {
+            RUNTIME,        // call to runtime function `index`
+            STRING,         // the bytes of string `index`
+            STACK_LIMIT     // 8-byte lowest allowed stack pointer
+        };
+
+        size_t offset;
+        Kind kind;
+        int index;
+    };
+
+    // Runtime functions the generated code calls, with the System V calling convention
+    enum RuntimeFunction {
+        RT_PRINT,       // (const char *text, int length)
+        RT_PRINTI,      // (int value)
+        RT_TRAP,        // (int trap), does not return
+        RUNTIME_COUNT
+    };
+
+    enum Trap {
+        TRAP_DIVISION_BY_ZERO,
+        TRAP_OUT_OF_BOUNDS,
+        TRAP_STACK_OVERFLOW,
+        TRAP_COUNT
+    };
+
+    // The error line a trap prints, the same as the bytecode VM's
+    const char *trapMessage(int trap);
+
+    /* Native code for a whole program
+     * Functions use their own calling convention: arguments are stored by the caller into the
+     * bottom of its frame, one 4-byte slot per parameter in the order of the callee's
+     * parameter slots, and the result comes back in eax. Every function preserves rbx, rbp and
+     * r12 to r15 and keeps rsp 16-byte aligned, so a function without parameters, main in
+     * particular, can be called as a plain C function taking nothing.
+     */
+    struct NativeCode {
+        std::vector<uint8_t> text;
+        // Offset of each function's first instruction, in bytecode function order
+        std::vector<size_t> functions;
+        std::vector<Reference> references;
+        std::vector<std::string> strings;
+        int main;
+    };
+
+    /* CodeGenerator class
+     * Translates bytecode to x86-64, one bytecode instruction at a time. A linear-scan register
+     * allocator keeps the most used frame slots and temporaries in the callee-saved registers
+     * rbx and r12 to r15; the rest live in the frame, arrays always. Vector loops become SSE2
+     * loops of four lanes, one xmm register per vector register, so the code runs on any x86-64.
+     */
+    class CodeGenerator {
+    private:
+        const bytecode::Program &program;
+        NativeCode native;
+        Assembler as;
+
+        // Where each register of the function being generated lives
+        struct Home {
+            bool inReg;
+            int reg;
+            int32_t disp;
+        };
+        std::vector<Home> homes;
+        std::vector<int> savedRegs;
+        // Native offset of each bytecode instruction, and jumps to patch: rel32 field, target
+        std::vector<size_t> nativeAt;
+        std::vector<std::pair<size_t, int>> jumps;
+        std::vector<std::pair<size_t, int>> calls;
+        std::vector<std::pair<size_t, int>> traps;
+        std::vector<size_t> returns;
+
+        Operand _home(int reg) const;
+        void _load(int to, int reg);
+        void _store(int reg, int from);
+        void _runtimeCall(RuntimeFunction function);
+        void _trapIf(Cond cond, Trap trap);
+        void _vectorLoop(const bytecode::VectorLoop &loop);
+
+        void _allocate(int begin, int end, const bytecode::Function &function);
+        void _function(int index, int begin, int end);
+        void _instr(const bytecode::Instr &instr);
+
+    public:
+        explicit CodeGenerator(const bytecode::Program &program);
+
+        static NativeCode generate(const bytecode::Program &program);
+    };
+}
+
+#endif //X86_HPP